@@ -241,25 +241,25 @@ int main(int argc, char** argv)
     //Manage uploads
     io_service.post([&](){
 
-        //Get Storage Provider
-        const StorageProvider& provider = vessel->get_storage_provider();
-
         //Start backing up files
         for ( ;; )
         {
 
-            //Create a new UploadManager
-            std::unique_ptr<UploadManager> upload_manager = std::make_unique<UploadManager>(provider);
+            std::unique_ptr<UploadManager> upload_manager;
 
             try
             {
+                //Providers are read again on every run, so changes on the server are picked up
+                upload_manager = std::make_unique<UploadManager>( vessel->get_storage_providers() );
                 upload_manager->run_uploader();
+
+                //Objects of deleted files are removed between runs, never while their paths are uploaded
+                upload_manager->run_retention();
             }
             catch( const std::exception& ex )
             {
+                //Also wait after a failed run, the providers may not be reachable yet
                 log->add_exception(ex);
-                continue;
-
             }
 
             //Free memory before sleep
@@ -8,10 +8,14 @@
 #include <iterator>
 #include <memory>
 #include <map>
+#include <set>
+#include <mutex>
+#include <ctime>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/date_time/date_facet.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/xml_parser.hpp>
 #include <boost/foreach.hpp>
@@ -27,14 +31,26 @@
 #include <vessel/network/http_stream.hpp>
 #include <vessel/filesystem/file.hpp>
 #include <vessel/crypto/hash_util.hpp>
+#include <vessel/compression/compress.hpp>
+#include <vessel/crypto/file_cipher.hpp>
 #include <vessel/aws/aws_exception.hpp>
 
+#define AWS_STREAM_CHUNK_SZ 65536 //Bytes signed and sent per aws-chunked chunk (S3 minimum is 8KB)
+#define AWS_STREAMING_PAYLOAD "STREAMING-AWS4-HMAC-SHA256-PAYLOAD"
+#define AWS_UNSIGNED_PAYLOAD "UNSIGNED-PAYLOAD" //Only used over HTTPS
+#define AWS_COPY_MAX_SZ 5368709120 //Largest object copied with a single CopyObject request
+#define AWS_COPY_PART_SZ 536870912 //Bytes copied per UploadPartCopy request
+#define AWS_MAX_PARTS 10000 //Most parts in a multipart upload
+#define AWS_DEFAULT_REGION "us-east-1" //Signing region of S3-compatible servers without a configured region
+#define AWS_DELETE_MAX_KEYS 1000 //Most objects removed with one DeleteObjects request
+
 using namespace Vessel::Types;
 using namespace Vessel::Exception;
 using namespace Vessel::Database;
 using namespace Vessel::File;
 using namespace Vessel::Networking;
 using namespace Vessel::Utilities;
+using namespace Vessel::Compression;
 
 namespace Vessel {
     namespace Networking {
@@ -51,9 +67,10 @@ namespace Vessel {
                     NoFlags = 0,
                     ReducedRedundancy = 1,
                     Multipart = 2,
-                    Streaming = 4,
-                    Encrypted = 6,
-                    SkipMultiInit = 8 //Skips the initialization of a multipart upload if the upload id already exists
+                    Streaming = 4, //Sign and send the object or part in aws-chunked chunks as it is read. Ignored for compressed or encrypted uploads
+                    SkipMultiInit = 8, //Skips the initialization of a multipart upload if the upload id already exists
+                    Compressed = 16, //Gzip the object for a single request upload. Ignored for multipart uploads
+                    Encrypted = 32 //Client side encryption of every part. Requires a cipher (set_cipher)
                 };
 
                 friend AwsFlags operator|(AwsFlags a, AwsFlags b)
@@ -93,15 +110,63 @@ namespace Vessel {
                 */
                 std::string complete_multipart_upload(const std::vector<UploadTagSet>& etags, const std::string& upload_id);
 
-                /*! \fn bool upload_stream_chunk(int part_number, const std::string& prev_signature );
-                    \brief Streaming file upload to the AWS S3 REST API
-                    \return Returns true if the upload was successful, or false if there was an error
+                /*! \fn bool copy_object(const BackupFile& bf, const std::string& source_key, bool& compressed, bool& encrypted);
+                    \brief Copies an object to the path of a file on S3, without sending the content. Objects over AWS_COPY_MAX_SZ are copied in parts (UploadPartCopy).
+                    The copy keeps the encoding and metadata of the source object
+                    \param compressed Set to true if the source object is gzip encoded
+                    \param encrypted Set to true if the source object is encrypted
+                    \return Returns false if the source object does not exist
+                */
+                bool copy_object(const BackupFile& bf, const std::string& source_key, bool& compressed, bool& encrypted);
+
+                /*! \fn bool list_parts(const std::string& upload_id, std::vector<UploadTagSet>& parts);
+                    \brief Lists the parts S3 holds for a multipart upload (ListParts)
+                    \return Returns false if the multipart upload no longer exists
                 */
-                bool upload_stream_chunk(int part_number, const std::string& prev_signature );
+                bool list_parts(const std::string& upload_id, std::vector<UploadTagSet>& parts);
+
+                /*! \fn bool abort_multipart_upload(const std::string& upload_id);
+                    \brief Aborts a multipart upload so S3 discards the stored parts
+                    \return Returns true if the upload was aborted or did not exist
+                */
+                bool abort_multipart_upload(const std::string& upload_id);
+
+                /*! \fn std::set<std::string> delete_objects(const std::vector<std::string>& object_keys);
+                    \brief Removes up to AWS_DELETE_MAX_KEYS objects with one request (DeleteObjects). Objects that do not exist count as removed
+                    \return Returns the keys of the objects S3 could not remove
+                */
+                std::set<std::string> delete_objects(const std::vector<std::string>& object_keys);
+
+                /*! \fn static bool is_path_style(const std::string& hostname, const std::string& bucket_name);
+                    \return Returns true if the bucket is the first segment of the request path. Virtual-hosted servers carry it in the host name, which starts with "<bucket>."
+                */
+                static bool is_path_style(const std::string& hostname, const std::string& bucket_name);
+
+                /*! \fn static std::string get_resource_path(const std::string& bucket_name, bool path_style, const std::string& object_key);
+                    \return Returns the encoded request path, also signed as the canonical URI, of an object or of the bucket if the key is empty
+                */
+                static std::string get_resource_path(const std::string& bucket_name, bool path_style, const std::string& object_key);
+
+                /*! \fn static std::string get_signing_region(const std::string& region);
+                    \return Returns the region requests are signed for, AWS_DEFAULT_REGION if the provider has none
+                */
+                static std::string get_signing_region(const std::string& region);
+
+                /*! \fn static std::string get_delete_body(const std::vector<std::string>& object_keys);
+                    \brief Builds the XML body of a quiet DeleteObjects request
+                    \return Returns the body listing every key
+                */
+                static std::string get_delete_body(const std::vector<std::string>& object_keys);
+
+                /*! \fn static std::map<std::string,std::string> get_delete_errors(const std::string& response);
+                    \brief Reads the Error elements of a DeleteObjects response
+                    \return Returns the error code of every key S3 could not remove
+                */
+                static std::map<std::string,std::string> get_delete_errors(const std::string& response);
 
                 /*! \fn std::string get_last_signature();
-                    \brief Returns the signature for the previous upload part
-                    \return Returns the signature for the previous upload part
+                    \brief Returns the signature of the last chunk of a streaming upload
+                    \return Returns the signature of the last chunk of a streaming upload
                 */
                 std::string get_last_signature();
 
@@ -137,13 +202,43 @@ namespace Vessel {
                 */
                 std::string get_file_uri_path();
 
+                /*! \fn void set_object_key(const std::string& object_key);
+                    \brief Stores the initialized upload under the given key instead of the path of the file. Call after init_upload
+                */
+                void set_object_key(const std::string& object_key);
+
+                /*! \fn std::string get_object_key(const std::string& parent_path, const std::string& file_name);
+                    \return Returns the relative path on the cloud server of a file in a directory
+                */
+                std::string get_object_key(const std::string& parent_path, const std::string& file_name);
+
                 /*! \fn  size_t get_current_part_size();
                     \brief Returns the total size in bytes of the current part to be uploaded
                     \return Returns the total size in bytes of the current part to be uploaded
                 */
                 size_t get_current_part_size();
 
+                /*! \fn void set_cipher(std::shared_ptr<FileCipher> cipher);
+                    \brief Sets the cipher used to encrypt the file when the Encrypted flag is set
+                */
+                void set_cipher(std::shared_ptr<FileCipher> cipher);
+
+                /*! \fn size_t get_compressed_size();
+                    \return Returns the size of the compressed object, or 0 if the object is not compressed
+                */
+                size_t get_compressed_size();
+
             private:
+
+                struct SigningKey
+                {
+                    std::string key;
+                    std::time_t expires; //UTC midnight after the date of the key
+                };
+
+                static std::map<std::string,SigningKey> m_signing_keys; //Signing keys shared by all clients, keyed by signing scope
+                static std::mutex m_signing_key_mutex;
+
                 LocalDatabase* m_ldb;
                 BackupFile m_file;
                 std::map<std::string,std::string> m_headers;
@@ -154,7 +249,8 @@ namespace Vessel {
                 std::string m_amzdate_short; //Shortened version of the AMZ date eg. 20130524
                 std::string m_amzdate_clean; //Example: Fri, 24 May 2013 00:00:00 GMT
                 std::string m_content_sha256; //SHA-256 hash of the file contents
-                std::shared_ptr<std::string> m_file_content; //Content of the current file or part
+                std::shared_ptr<std::string> m_file_content; //Content of the current file
+                size_t m_part_length; //Bytes of the current part sent from its pooled buffer
                 std::string m_content_md5; //MD5 hash of the current file or part
                 std::string m_previous_signature; //The previous signature used for streaming uploads
                 std::string m_request_payload;
@@ -163,8 +259,17 @@ namespace Vessel {
                 std::string m_user_id; //Vessel User ID
                 int m_current_part; //For multipart uploads, the current part index
                 bool m_multipart; //Indicates whether or not a multipart upload
-                bool m_streaming; //Indicates whether or not a streaming upload (for unknown filesizes)
+                bool m_streaming; //Indicates whether or not a streaming upload (aws-chunked)
+                size_t m_stream_offset; //File offset of the object or part being streamed
+                size_t m_stream_length; //Bytes of the file streamed with the request (x-amz-decoded-content-length)
+                bool m_unsigned_payload; //Payloads are not SHA-256 hashed, integrity is checked with Content-MD5
                 bool m_reduced_redundancy; //Default = False
+                bool m_path_style; //The bucket is the first segment of the request path instead of part of the host name
+                bool m_aws_endpoint; //The server is an AWS endpoint, not an S3-compatible server
+                bool m_compressed; //The object is sent gzip encoded
+                size_t m_compressed_size; //Size of the gzip encoded object
+                bool m_encrypted; //Every part is sealed with m_cipher before it is hashed and sent
+                std::shared_ptr<FileCipher> m_cipher;
                 bool m_remote_signing; //Remote sign S3 requests via Vessel REST API
                 size_t m_part_size; //part size bytes for multipart uploads
                 StorageProvider m_storage_provider;
@@ -187,12 +292,24 @@ namespace Vessel {
                 */
                 std::string get_signature_v4();
 
-                /*! \fn std::string get_stream_signature_v4(const std::string& prev_signature);
-                    \param prev_signature The signature of the previous part or the seed signature if the first part
-                    \brief Returns the AWS V4 signature for a parted upload
-                    \return Returns the AWS V4 signature for a parted upload
+                /*! \fn std::string get_stream_signature_v4(const std::string& signing_key, const std::string& prev_signature, const char* data, size_t length);
+                    \param prev_signature The signature of the previous chunk or the seed signature if the first chunk
+                    \brief Returns the AWS V4 signature of an aws-chunked chunk
+                    \return Returns the AWS V4 signature of an aws-chunked chunk
                 */
-                std::string get_stream_signature_v4(const std::string& prev_signature);
+                std::string get_stream_signature_v4(const std::string& signing_key, const std::string& prev_signature, const char* data, size_t length);
+
+                /*! \fn int send_stream_request(HttpRequest& request);
+                    \brief Signs the request with the seed signature and streams m_stream_length bytes of the file from m_stream_offset.
+                    Each chunk is read, signed and written before the next one is read
+                    \return Returns the HTTP status
+                */
+                int send_stream_request(HttpRequest& request);
+
+                /*! \fn static size_t get_stream_length(size_t decoded_length);
+                    \return Returns the Content-Length of an aws-chunked body, including the chunk headers and the final empty chunk
+                */
+                static size_t get_stream_length(size_t decoded_length);
 
                 /*! \fn std::string get_amz_headers();
                     \brief Returns the amz headers used for the canonical request
@@ -207,22 +324,49 @@ namespace Vessel {
                 std::string get_signed_headers();
 
                 /*! \fn std::string get_signing_key();
-                    \brief Returns the key used to sign AWS S3 requests
+                    \brief Returns the key used to sign AWS S3 requests. Keys are cached until the end of the UTC day,
+                    so the Vessel API is asked for a remote signing key once per provider and day
                     \return Returns the key used to sign AWS S3 requests
                 */
                 std::string get_signing_key();
 
+                /*! \fn std::string get_signing_scope();
+                    \return Returns the cache key of the signing key: signing mode, provider, date, region and service
+                */
+                std::string get_signing_scope();
+
+                /*! \fn int send_signed_request(const HttpRequest& request);
+                    \brief Sends a request to S3. The cached signing key is dropped if the signature is rejected
+                    \return Returns the HTTP status
+                */
+                int send_signed_request(const HttpRequest& request);
+
                 /*! \fn std::string api_get_signing_key();
                     \brief Returns the base64 encoded signing key using the Vessel REST API
                     \return Returns the base64 encoded signing key using the Vessel REST API
                 */
                 std::string api_get_signing_key();
 
+                /*! \fn void add_meta_headers(HttpRequest& request);
+                    \brief Adds the x-amz-meta- headers of the object to a request
+                */
+                void add_meta_headers(HttpRequest& request);
+
                 /*! \fn void build_request_headers();
                     \brief Internal call to store request headers in a std::map
                 */
                 void build_request_headers();
 
+                /*! \fn void init_endpoint();
+                    \brief Selects path-style or virtual-hosted addressing from the server and bucket, and the signing region
+                */
+                void init_endpoint();
+
+                /*! \fn std::string get_resource_path(const std::string& object_key);
+                    \return Returns the encoded request path of an object, or of the bucket if the key is empty
+                */
+                std::string get_resource_path(const std::string& object_key);
+
                 /*! \fn init_amz_date();
                     \brief Internal call to build the dates used by the AWS S3 API. Includes ISO8601 date and nice version
                 */
@@ -239,6 +383,18 @@ namespace Vessel {
                 */
                 std::string parse_upload_id( const std::string& response );
 
+                /*! \fn bool head_object(const std::string& object_key, size_t& object_size, std::map<std::string,std::string>& properties);
+                    \brief Reads the size, encoding and vessel metadata of an object (HeadObject)
+                    \return Returns false if the object does not exist
+                */
+                bool head_object(const std::string& object_key, size_t& object_size, std::map<std::string,std::string>& properties);
+
+                /*! \fn std::string copy_part(const std::string& copy_source, int part, size_t first_byte, size_t last_byte, const std::string& upload_id);
+                    \brief Copies a byte range of the source object into a part of the current multipart upload (UploadPartCopy)
+                    \return Returns the ETag of the part
+                */
+                std::string copy_part(const std::string& copy_source, int part, size_t first_byte, size_t last_byte, const std::string& upload_id);
+
                 /*! \fn void read_key_file();
                     \brief If remote signing is disabled, reads the AWS credentials from an aws.key file
                 */
@@ -8,10 +8,17 @@
 #include <sstream>
 #include <vector>
 #include <map>
+#include <set>
+#include <mutex>
+#include <ctime>
+#include <thread>
+#include <chrono>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/date_time/date_facet.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/property_tree/ptree.hpp>
+#include <boost/property_tree/xml_parser.hpp>
 
 #include <cryptopp/cryptlib.h>
 #include <cryptopp/hmac.h>
@@ -24,14 +31,23 @@
 #include <vessel/network/http_stream.hpp>
 #include <vessel/filesystem/file.hpp>
 #include <vessel/crypto/hash_util.hpp>
+#include <vessel/compression/compress.hpp>
+#include <vessel/crypto/file_cipher.hpp>
 #include <vessel/azure/azure_exception.hpp>
 
+#define AZURE_SAS_LIFETIME 3600 //Default lifetime in seconds of a SAS token if not defined in DB
+#define AZURE_SAS_REFRESH 300 //SAS tokens are refreshed this many seconds before they expire
+#define AZURE_COPY_WAIT_SECS 300 //Longest wait for a pending Copy Blob to finish
+#define AZURE_BATCH_MAX_BLOBS 256 //Most sub-requests in one Blob Batch request
+#define AZURE_BATCH_VERSION "2020-04-08" //Oldest service version with Blob Batch requests scoped to a container
+
 using namespace Vessel::Types;
 using namespace Vessel::Exception;
 using namespace Vessel::Database;
 using namespace Vessel::File;
 using namespace Vessel::Networking;
 using namespace Vessel::Utilities;
+using namespace Vessel::Compression;
 
 namespace Vessel {
     namespace Networking {
@@ -78,11 +94,61 @@ namespace Vessel {
                 */
                 std::string get_block_list();
 
+                /*! \fn bool list_blocks(std::vector<UploadTagSet>& blocks);
+                    \brief Lists the uncommitted blocks of the current blob (Get Block List)
+                    \return Returns false if the blob no longer exists
+                */
+                bool list_blocks(std::vector<UploadTagSet>& blocks);
+
+                /*! \fn bool copy_blob(const BackupFile& file, const std::string& source_path, bool& compressed, bool& encrypted);
+                    \brief Copies a blob of the container to the path of a file with Copy Blob, without sending the content.
+                    The copy keeps the properties and metadata of the source blob
+                    \param compressed Set to true if the source blob is gzip encoded
+                    \param encrypted Set to true if the source blob is encrypted
+                    \return Returns false if the source blob does not exist
+                */
+                bool copy_blob(const BackupFile& file, const std::string& source_path, bool& compressed, bool& encrypted);
+
+                /*! \fn std::set<std::string> delete_blobs(const std::vector<std::string>& paths);
+                    \brief Removes up to AZURE_BATCH_MAX_BLOBS blobs of the container with one Blob Batch request. Blobs that do not exist count as removed.
+                    Every sub-request is authorized on its own, with remote signing and no SAS this is one Vessel API request per blob
+                    \return Returns the paths of the blobs Azure could not remove
+                */
+                std::set<std::string> delete_blobs(const std::vector<std::string>& paths);
+
+                /*! \fn static std::vector<int> get_batch_statuses(const std::string& response, size_t count);
+                    \brief Reads the status of every sub-response of a Blob Batch response, in the order of the sub-requests
+                    \param count Number of sub-requests of the batch
+                    \return Returns the HTTP status of each sub-request, 0 if the response has no sub-response for it
+                */
+                static std::vector<int> get_batch_statuses(const std::string& response, size_t count);
+
+                /*! \fn static bool is_blob_deleted(int status);
+                    \return Returns true if the status of a delete sub-request means the blob no longer exists
+                */
+                static bool is_blob_deleted(int status);
+
                 /*! \fn void remote_signing(bool flag);
-                    \brief Enables or disables remote signing the request. Local key file is used for local
+                    \brief Enables or disables remote signing the request. Local key file is used for local.
+                    With remote signing and azure_sas enabled, requests are authorized with a container SAS issued by the Vessel API
                 */
                 void remote_signing(bool flag);
 
+                /*! \fn void set_compression(bool flag);
+                    \brief Enables gzip encoding of single blob uploads. Blocks are never compressed
+                */
+                void set_compression(bool flag);
+
+                /*! \fn void set_cipher(std::shared_ptr<FileCipher> cipher);
+                    \brief Sets the cipher used to encrypt the blob and its blocks. Encryption is disabled if the cipher is empty
+                */
+                void set_cipher(std::shared_ptr<FileCipher> cipher);
+
+                /*! \fn size_t get_compressed_size();
+                    \return Returns the size of the last compressed blob, or 0 if the blob was sent uncompressed
+                */
+                size_t get_compressed_size();
+
                 /*! \fn std::string last_request_id();
                     \brief Returns the last Azure request id
                     \return Returns the last Azure request id
@@ -106,8 +172,39 @@ namespace Vessel {
                 */
                 std::string get_padded_block_id(const std::string& id);
 
+                /*! \fn std::string get_file_uri_path();
+                    \brief Returns the relative URI path of the file
+                    \return Returns the relative URI path of the file
+                */
+                std::string get_file_uri_path();
+
+                /*! \fn void set_object_key(const std::string& object_key);
+                    \brief Stores the initialized upload under the given path instead of the path of the file. Call after init_upload
+                */
+                void set_object_key(const std::string& object_key);
+
+                /*! \fn std::string get_object_key(const std::string& parent_path, const std::string& file_name);
+                    \return Returns the relative URI path of a file in a directory
+                */
+                std::string get_object_key(const std::string& parent_path, const std::string& file_name);
+
             private:
+
+                struct SasToken
+                {
+                    std::string token; //Query string of the SAS, without the leading ?
+                    std::time_t expires;
+                };
+
+                static std::map<std::string,SasToken> m_sas_tokens; //SAS tokens shared by all clients, keyed by provider id
+                static std::mutex m_sas_mutex;
+
                 bool m_remote_signing;
+                bool m_sas_enabled; //Authorize remote requests with a SAS token instead of signing every request
+                bool m_compression; //Compress single blob uploads
+                size_t m_compressed_size;
+                std::shared_ptr<FileCipher> m_cipher; //Client side encryption of the blob and its blocks
+                std::map<std::string,std::string> m_metadata; //x-ms-meta- values, set on the requests that create or commit the blob
                 std::string m_xms_date;
                 std::string m_xms_version;
                 std::string m_xms_blob_type;
@@ -131,6 +228,12 @@ namespace Vessel {
                 BackupFile m_file;
                 StorageProvider m_storage_provider;
 
+                /*! \fn bool get_blob_properties(const std::string& path, std::map<std::string,std::string>& properties);
+                    \brief Reads the encoding, vessel metadata and copy status of a blob (Get Blob Properties)
+                    \return Returns false if the blob does not exist
+                */
+                bool get_blob_properties(const std::string& path, std::map<std::string,std::string>& properties);
+
                 /*! \fn std::string get_ms_date();
                     \brief Returns the current RFC 1123 formatted date/time
                     \return Returns the current RFC 1123 formatted date/time
@@ -161,11 +264,10 @@ namespace Vessel {
                 */
                 void build_headers();
 
-                /*! \fn std::string get_file_uri_path();
-                    \brief Returns the relative URI path of the file
-                    \return Returns the relative URI path of the file
+                /*! \fn void add_meta_headers(HttpRequest& request);
+                    \brief Adds the x-ms-meta- headers of the blob to a request
                 */
-                std::string get_file_uri_path();
+                void add_meta_headers(HttpRequest& request);
 
                 /*! \fn std::string get_ms_signature();
                     \brief Returns the base 64 encoded signature for the request
@@ -173,6 +275,29 @@ namespace Vessel {
                 */
                 std::string get_ms_signature();
 
+                /*! \fn void authorize(HttpRequest& request);
+                    \brief Adds the SAS token to the request URL, or the SharedKey authorization header if no SAS token is available
+                */
+                void authorize(HttpRequest& request);
+
+                /*! \fn int send_signed_request(const HttpRequest& request);
+                    \brief Sends a request to Azure. The cached SAS token is dropped if the request is rejected
+                    \return Returns the HTTP status
+                */
+                int send_signed_request(const HttpRequest& request);
+
+                /*! \fn std::string get_sas_token();
+                    \brief Returns the cached SAS token of the provider. A new token is requested shortly before the cached token expires
+                    \return Returns the SAS query string, or an empty string if the Vessel API did not issue a token
+                */
+                std::string get_sas_token();
+
+                /*! \fn bool api_get_sas(SasToken& sas);
+                    \brief Requests a short-lived container SAS token from the Vessel API
+                    \return Returns false if the API did not issue a token
+                */
+                bool api_get_sas(SasToken& sas);
+
                 /*! \fn void read_key_file()
                     \brief Reads the Azure key file and imports AccountName, ContainerName, and SharedKey
                 */
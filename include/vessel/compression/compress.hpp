@@ -5,11 +5,14 @@
 #include <assert.h>
 #include <fstream>
 #include <sstream>
+#include <vector>
+#include <set>
 #include <string.h>
 #include <math.h>
 #include <iomanip>
 #include <zlib.h>
 #include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
 
 #if defined(MSDOS) || defined(OS2) || defined(WIN32) || defined(__CYGWIN__)
 #  include <fcntl.h>
@@ -21,6 +24,7 @@
 
 #define Z_COMP_LEVEL 6
 #define Z_CHUNK 32768
+#define Z_READ_CHUNK 1048576 //Size of the reads when compressing a file (1MB)
 #define GZIP_ENCODING 16
 
 namespace Vessel {
@@ -44,6 +48,26 @@ namespace Vessel {
                 //Compress file and save to temp file
                 void compress_file( const std::string & in, const std::string & out );
 
+                /*! \fn std::string compress_file( const std::string& in );
+                    \brief Compresses a file into a single gzip member, reading the file in Z_READ_CHUNK blocks
+                    \return Returns the compressed contents, or an empty string if the file could not be read
+                */
+                std::string compress_file( const std::string& in );
+
+                /*! \fn bool start_compression();
+                    \brief Starts a gzip stream. Data passed to compress() is deflated into the same stream until end_compression()
+                    \return Returns false if the stream could not be initialized
+                */
+                bool start_compression();
+
+                /*! \fn std::string compress( const char* data, size_t len, bool finish = false );
+                    \brief Deflates the next block of the stream. The last block must be passed with finish set
+                    \return Returns the compressed output that is ready for the block
+                */
+                std::string compress( const char* data, size_t len, bool finish = false );
+
+                void end_compression();
+
                 //Decompress file and save to temp file
                 void decompress_file( const std::string & in, const std::string & out );
 
@@ -53,10 +77,17 @@ namespace Vessel {
                 //Set compression level
                 void set_z_level ( int level );
 
+                /*! \fn static bool is_compressible( const std::string& file_type );
+                    \return Returns false for file types that are already compressed (archives, images, audio and video)
+                */
+                static bool is_compressible( const std::string& file_type );
+
             private:
 
                 z_stream m_zs_decomp;
+                z_stream m_zs_comp;
                 int m_z_level; //Compression level
+                bool m_compressing; //A compression stream is open
 
         };
 
@@ -0,0 +1,44 @@
+#ifndef CRYPTOEXCEPTION_H
+#define CRYPTOEXCEPTION_H
+
+#include <iostream>
+#include <string>
+#include <exception>
+
+namespace Vessel {
+    namespace Exception {
+
+        class CryptoException : public std::exception
+        {
+            public:
+
+                enum ErrorCode
+                {
+                    NoError = 0,
+                    BadKey,
+                    BadKeyFile,
+                    DecryptFailed
+                };
+
+                CryptoException(ErrorCode e, const std::string& msg) : _code(e)
+                {
+                    _msg = "CryptoException: " + msg + " (ErrorCode: " + std::to_string((int)e) + ")";
+                }
+
+                ErrorCode get_code() { return _code; }
+
+                virtual const char* what() const noexcept override
+                {
+                    return _msg.c_str();
+                }
+
+            private:
+                std::string _msg;
+                ErrorCode _code;
+
+        };
+
+    }
+}
+
+#endif
@@ -0,0 +1,130 @@
+#ifndef FILECIPHER_H
+#define FILECIPHER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include <cryptopp/cryptlib.h>
+#include <cryptopp/aes.h>
+#include <cryptopp/gcm.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/secblock.h>
+
+#include <vessel/log/log.hpp>
+#include <vessel/database/local_db.hpp>
+#include <vessel/crypto/hash_util.hpp>
+#include <vessel/crypto/crypto_exception.hpp>
+
+#define CIPHER_KEY_SZ 32 //AES-256
+#define CIPHER_NONCE_PREFIX_SZ 8 //Random per file, followed by the part number in the IV
+#define CIPHER_IV_SZ 12
+#define CIPHER_TAG_SZ 16 //GCM tag appended to every encrypted part
+#define CIPHER_WRAP_VERSION 1
+#define CIPHER_NAME "AES-256-GCM"
+#define CIPHER_TENANT_KEY_FILE "keys/tenant.key" //Default tenant key file if not defined in DB
+
+using namespace Vessel::Exception;
+using namespace Vessel::Logging;
+using namespace Vessel::Database;
+
+namespace fs = boost::filesystem;
+
+namespace Vessel {
+    namespace Utilities {
+
+        /*! \class FileCipher
+            \brief AES-256-GCM encryption of upload parts with a random key per file.
+
+            Every part is sealed on its own, so parts can be uploaded, retried and restored independently:
+                IV   = nonce prefix (8 bytes, random per file) + part number (4 bytes, big endian)
+                AAD  = part number (4 bytes, big endian) + last part flag (1 byte)
+                Part = ciphertext (same size as the plaintext) + tag (CIPHER_TAG_SZ)
+
+            The last part flag stops a stored object from being truncated at a part boundary without detection.
+
+            The file key and nonce prefix are wrapped with AES-256-GCM under the tenant key and stored with the
+            object, so the storage provider and the Vessel server never see a usable key.
+        */
+        class FileCipher
+        {
+
+            public:
+
+                /*! \fn FileCipher(const std::string& tenant_key);
+                    \brief Generates a new file key
+                */
+                FileCipher(const std::string& tenant_key);
+
+                /*! \fn FileCipher(const std::string& tenant_key, const std::string& wrapped_key);
+                    \brief Unwraps the key of a file. Throws a CryptoException if the key was not wrapped with the tenant key
+                */
+                FileCipher(const std::string& tenant_key, const std::string& wrapped_key);
+
+                /*! \fn std::string get_wrapped_key() const;
+                    \return Returns the base64 encoded file key, wrapped under the tenant key
+                */
+                std::string get_wrapped_key() const { return m_wrapped_key; }
+
+                /*! \fn void encrypt_part(std::string& buffer, int part_number, bool last);
+                    \brief Encrypts a part in place and appends the tag. Reserve CIPHER_TAG_SZ extra bytes to avoid a reallocation
+                */
+                void encrypt_part(std::string& buffer, int part_number, bool last);
+
+                /*! \fn void encrypt_part(char* buffer, size_t length, int part_number, bool last);
+                    \brief Encrypts length bytes in place and writes the tag after them. The buffer must hold length + CIPHER_TAG_SZ bytes
+                */
+                void encrypt_part(char* buffer, size_t length, int part_number, bool last);
+
+                /*! \fn bool decrypt_part(std::string& buffer, int part_number, bool last);
+                    \brief Verifies and decrypts a part in place and removes the tag
+                    \return Returns false if the part was modified, reordered or is not the expected last part
+                */
+                bool decrypt_part(std::string& buffer, int part_number, bool last);
+
+                /*! \fn static std::string get_tenant_key();
+                    \brief Reads the tenant key file. A new key is generated if the file does not exist
+                    \return Returns the raw tenant key
+                */
+                static std::string get_tenant_key();
+
+                /*! \fn static bool is_enabled();
+                    \return Returns true if encrypt_transfer is enabled
+                */
+                static bool is_enabled();
+
+                /*! \fn static size_t get_encrypted_size(size_t part_size);
+                    \return Returns the size of an encrypted part
+                */
+                static size_t get_encrypted_size(size_t part_size) { return part_size + CIPHER_TAG_SZ; }
+
+            private:
+                CryptoPP::SecByteBlock m_key;
+                CryptoPP::SecByteBlock m_nonce_prefix;
+                std::string m_wrapped_key;
+                CryptoPP::GCM<CryptoPP::AES>::Encryption m_encryption;
+                CryptoPP::GCM<CryptoPP::AES>::Decryption m_decryption;
+
+                void init_ciphers();
+
+                void get_part_iv(int part_number, CryptoPP::byte* iv) const;
+                static void get_part_aad(int part_number, bool last, CryptoPP::byte* aad);
+
+                /*! \fn static std::string wrap_key(const std::string& tenant_key, const std::string& key);
+                    \return Returns the version, wrap IV, sealed key and tag, base64 encoded
+                */
+                static std::string wrap_key(const std::string& tenant_key, const std::string& key);
+
+                /*! \fn static std::string unwrap_key(const std::string& tenant_key, const std::string& wrapped_key);
+                    \return Returns the file key and nonce prefix
+                */
+                static std::string unwrap_key(const std::string& tenant_key, const std::string& wrapped_key);
+
+        };
+
+    }
+}
+
+#endif // FILECIPHER_H
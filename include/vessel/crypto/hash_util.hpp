@@ -45,6 +45,12 @@ namespace Vessel {
                 */
                 static std::string get_sha256_hash(const std::string& data);
 
+                /*! \fn static std::string get_sha256_hash(const char* data, size_t length);
+                    \brief Returns a sha-256 hash string of a buffer without copying it
+                    \return Returns a sha-256 hash string
+                */
+                static std::string get_sha256_hash(const char* data, size_t length);
+
                 /*! \fn static std::string get_md5_hash(const std::string& data, bool base64=false);
                     \brief Returns a md5 hash string
                     \param base64 Base64 encodes the string if set to true
@@ -52,6 +58,13 @@ namespace Vessel {
                 */
                 static std::string get_md5_hash(const std::string& data, bool base64=false);
 
+                /*! \fn static std::string get_md5_hash(const char* data, size_t length, bool base64=false);
+                    \brief Returns a md5 hash string
+                    \param base64 Base64 encodes the string if set to true
+                    \return Returns a md5 hash string
+                */
+                static std::string get_md5_hash(const char* data, size_t length, bool base64=false);
+
                 /*! \fn static std::string get_base64(const std::string& data);
                     \brief Returns a base64 encoded string
                     \return Returns a base64 encoded string
@@ -138,11 +138,12 @@ namespace Vessel{
                 */
                 void end_transaction();
 
-                /*! \fn void purge_file( unsigned char* file_id );
+                /*! \fn void purge_file( unsigned char* file_id, bool remove_object = false );
                     \param file_id Binary File ID
+                    \param remove_object The file was deleted or moved, its backed up object is added to the delete journal
                     \brief Removes a file from the database
                 */
-                void purge_file( unsigned char* file_id );
+                void purge_file( unsigned char* file_id, bool remove_object = false );
 
                 /*! \fn void purge_upload(unsigned int upload_id);
                     \param upload_id Database Upload Id
@@ -210,6 +211,11 @@ namespace Vessel{
                 */
                 void clean_files();
 
+                /*! \fn void journal_delete( unsigned char* file_id );
+                    \brief Adds the object a file was backed up to to the delete journal. Objects held by the Vessel API and files stored in the pack repository are not journaled
+                */
+                void journal_delete( unsigned char* file_id );
+
             protected:
                 ~LocalDatabase();
         };
@@ -0,0 +1,126 @@
+#ifndef BUFFERPOOL_H
+#define BUFFERPOOL_H
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <map>
+#include <mutex>
+
+#include <vessel/log/log.hpp>
+#include <vessel/database/local_db.hpp>
+
+#define BUFFER_POOL_BUDGET 268435456 //Default memory budget for part buffers if not defined in DB (256MB)
+#define BUFFER_HUGE_PAGE_SZ 2097152 //Buffers are aligned to huge pages when upload_huge_pages is enabled (2MB)
+#define BUFFER_SEND_SZ 1048576 //Bytes of a buffer copied into the request stream at a time (1MB)
+
+using namespace Vessel::Logging;
+using namespace Vessel::Database;
+
+namespace Vessel {
+    namespace File {
+
+        class BufferPool;
+
+        /*! \class PartBuffer
+            \brief A page aligned buffer taken from the BufferPool. The memory is returned to the pool when the buffer is destroyed
+        */
+        class PartBuffer
+        {
+
+            public:
+
+                PartBuffer(char* data, size_t capacity);
+                ~PartBuffer();
+
+                PartBuffer(const PartBuffer&) = delete;
+                PartBuffer& operator=(const PartBuffer&) = delete;
+
+                char* data() { return m_data; }
+                const char* data() const { return m_data; }
+                size_t size() const { return m_size; }
+                size_t capacity() const { return m_capacity; }
+
+                /*! \fn void resize(size_t size);
+                    \brief Sets the number of bytes in use. The buffer is never reallocated, size must not exceed the capacity
+                */
+                void resize(size_t size);
+
+                /*! \fn bool read_chunk(std::string& chunk, size_t& offset) const;
+                    \brief Copies the next BUFFER_SEND_SZ bytes from offset into chunk and moves the offset, to stream the buffer as a request body
+                    \return Returns false if there are no bytes left
+                */
+                bool read_chunk(std::string& chunk, size_t& offset) const;
+
+            private:
+                char* m_data;
+                size_t m_capacity;
+                size_t m_size;
+
+        };
+
+        /*! \class BufferPool
+            \brief Reusable part buffers within a fixed memory budget (upload_memory_budget).
+
+            Buffers are page aligned and kept for the next part when they are released, so parts of the same size
+            do not allocate. Cached buffers are freed before a new buffer would exceed the budget. Buffers are only
+            released by their holder, so a request that does not fit is logged and served over budget instead of waiting.
+        */
+        class BufferPool
+        {
+
+            public:
+
+                /*! \fn static BufferPool& get_pool();
+                    \return Returns the buffer pool of the process
+                */
+                static BufferPool& get_pool();
+
+                ~BufferPool();
+
+                BufferPool(const BufferPool&) = delete;
+                BufferPool& operator=(const BufferPool&) = delete;
+
+                /*! \fn std::shared_ptr<PartBuffer> acquire(size_t size);
+                    \brief Takes a buffer of at least size bytes. A buffer that does not fit in the budget is logged, it never blocks
+                    \return Returns an empty buffer with a capacity of at least size bytes
+                */
+                std::shared_ptr<PartBuffer> acquire(size_t size);
+
+                size_t get_budget() const { return m_budget; }
+
+                /*! \fn size_t get_in_use();
+                    \return Returns the bytes held by buffers that are in use
+                */
+                size_t get_in_use();
+
+            private:
+
+                BufferPool();
+
+                size_t m_budget;
+                size_t m_alignment;
+                size_t m_in_use;
+                size_t m_cached;
+                bool m_huge_pages;
+                std::multimap<size_t, char*> m_free; //Released buffers by capacity
+                std::mutex m_mutex;
+
+                friend class PartBuffer;
+
+                void release(char* data, size_t capacity);
+
+                /*! \fn void trim(size_t capacity);
+                    \brief Frees cached buffers until a new buffer of capacity bytes fits in the budget
+                */
+                void trim(size_t capacity);
+
+                char* allocate(size_t capacity);
+                void free_buffer(char* data);
+
+        };
+
+    }
+}
+
+#endif // BUFFERPOOL_H
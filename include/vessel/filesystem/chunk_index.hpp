@@ -0,0 +1,71 @@
+#ifndef CHUNKINDEX_H
+#define CHUNKINDEX_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ctime>
+
+#include <vessel/types.hpp>
+#include <vessel/log/log.hpp>
+#include <vessel/database/local_db.hpp>
+#include <vessel/filesystem/file.hpp>
+
+#define CDC_MIN_FILE_SZ 67108864 //Default size in bytes of the smallest file that is chunked if not defined in DB (64MB)
+
+using namespace Vessel::Types;
+using namespace Vessel::Logging;
+using namespace Vessel::Database;
+
+namespace Vessel {
+    namespace File {
+
+        /*! \class ChunkIndex
+            \brief Local index of the file chunks that have been uploaded, keyed by the SHA-256 hash of the chunk.
+
+            Chunks are stored in packs, so the location of a chunk is the object key of its pack and the
+            offset of the chunk in the pack. The ordered chunk list of each chunked file is kept in
+            backup_file_chunk so a file can be rebuilt from its chunks.
+        */
+        class ChunkIndex
+        {
+
+            public:
+                ChunkIndex();
+
+                /*! \fn bool contains(const std::string& hash);
+                    \return Returns true if a chunk with this hash has already been uploaded
+                */
+                bool contains(const std::string& hash);
+
+                /*! \fn bool add_chunk(const std::string& hash, sqlite3_int64 pack_id, size_t offset, size_t length);
+                    \brief Records the pack and offset of an uploaded chunk
+                */
+                bool add_chunk(const std::string& hash, sqlite3_int64 pack_id, size_t offset, size_t length);
+
+                /*! \fn bool get_location(const std::string& hash, std::string& object_key, size_t& offset);
+                    \brief Finds the object key of the pack holding a chunk and the offset of the chunk in it
+                    \return Returns false if the chunk is not in the index
+                */
+                bool get_location(const std::string& hash, std::string& object_key, size_t& offset);
+
+                /*! \fn bool save_recipe(std::shared_ptr<unsigned char> file_id, const std::vector<ChunkRef>& chunks);
+                    \brief Replaces the ordered chunk list of a file
+                */
+                bool save_recipe(std::shared_ptr<unsigned char> file_id, const std::vector<ChunkRef>& chunks);
+
+                /*! \fn static bool is_chunkable(const BackupFile& file);
+                    \return Returns true if the file is large enough to be split in content-defined chunks
+                */
+                static bool is_chunkable(const BackupFile& file);
+
+            private:
+                LocalDatabase* m_database;
+
+        };
+
+    }
+}
+
+#endif // CHUNKINDEX_H
@@ -0,0 +1,77 @@
+#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+#define CDC_MIN_SZ 262144 //Default minimum chunk size (256KB)
+#define CDC_AVG_SZ 1048576 //Default average chunk size (1MB)
+#define CDC_MAX_SZ 4194304 //Default maximum chunk size (4MB)
+#define CDC_BUFFER_SZ 16777216 //Size of the read buffer used when chunking files (16MB)
+#define CDC_NORMALIZATION 2 //FastCDC normalization level (bits added/removed from the mask around the average size)
+
+namespace Vessel {
+    namespace File {
+
+        /*! \class Chunker
+            \brief FastCDC content-defined chunker.
+
+            Boundaries depend only on the bytes around them, so an insert or delete in the middle of a
+            file only changes the chunks around the edit. The gear table is generated from a fixed seed
+            and must never change, otherwise the boundaries of previously stored chunks are lost.
+        */
+        class Chunker
+        {
+
+            public:
+
+                /*! \typedef ChunkCallback
+                    \brief Called for each chunk with the chunk data, its length and its offset in the file. Return false to stop chunking
+                */
+                typedef std::function<bool(const char* data, size_t length, size_t offset)> ChunkCallback;
+
+                Chunker(size_t min_size = CDC_MIN_SZ, size_t avg_size = CDC_AVG_SZ, size_t max_size = CDC_MAX_SZ);
+
+                /*! \fn size_t find_boundary(const unsigned char* data, size_t length) const;
+                    \brief Finds the end of the first chunk in the buffer. The buffer must hold at least max_size bytes unless it is the end of the data
+                    \return Returns the length of the first chunk
+                */
+                size_t find_boundary(const unsigned char* data, size_t length) const;
+
+                /*! \fn bool chunk_file(const std::string& file_path, const ChunkCallback& callback) const;
+                    \brief Reads a file in CDC_BUFFER_SZ blocks and calls the callback for every chunk
+                    \return Returns false if the file could not be read or the callback stopped chunking
+                */
+                bool chunk_file(const std::string& file_path, const ChunkCallback& callback) const;
+
+                size_t get_min_size() const { return m_min_size; }
+                size_t get_avg_size() const { return m_avg_size; }
+                size_t get_max_size() const { return m_max_size; }
+
+            private:
+                size_t m_min_size;
+                size_t m_avg_size;
+                size_t m_max_size;
+                uint64_t m_mask_s; //Stricter mask used before the average size is reached
+                uint64_t m_mask_l; //Looser mask used after the average size is reached
+
+                /*! \fn static const uint64_t* get_gear_table();
+                    \brief Returns the 256 entry gear table
+                */
+                static const uint64_t* get_gear_table();
+
+                /*! \fn static uint64_t get_mask(int bits);
+                    \brief Returns a mask with the given number of bits spread over the upper half of a 64 bit word
+                */
+                static uint64_t get_mask(int bits);
+
+        };
+
+    }
+}
+
+#endif // CHUNKER_H
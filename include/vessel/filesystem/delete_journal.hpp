@@ -0,0 +1,102 @@
+#ifndef DELETEJOURNAL_H
+#define DELETEJOURNAL_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <ctime>
+
+#include <vessel/types.hpp>
+#include <vessel/log/log.hpp>
+#include <vessel/database/local_db.hpp>
+
+#define DELETE_RETENTION_DAYS 30 //Default days the object of a deleted file is kept on the provider if not defined in DB
+#define DELETE_RETRY_SECS 300 //Journaled deletes that were sent are not sent again for this many seconds
+
+using namespace Vessel::Types;
+using namespace Vessel::Logging;
+using namespace Vessel::Database;
+
+namespace Vessel {
+    namespace File {
+
+        /*! \class DeleteJournal
+            \brief Journal of the provider objects of deleted and moved files, kept in backup_delete_journal.
+
+            Files are added when they are purged from the catalog. An entry is only removed once the provider
+            confirmed the delete, so deletes that were interrupted are sent again on the next run. Deletes
+            are idempotent, an object that no longer exists counts as removed.
+        */
+        class DeleteJournal
+        {
+
+            public:
+                DeleteJournal();
+
+                /*! \typedef RemoveCallback
+                    \brief Removes the objects of a batch from the provider
+                    \return Returns the delete ids of the objects the provider removed
+                */
+                typedef std::function<std::vector<unsigned long>(const std::vector<DeletedFile>& files)> RemoveCallback;
+
+                /*! \fn size_t remove_expired(const std::string& provider_id, size_t batch_size, const RemoveCallback& remove_files);
+                    \brief Sends the expired files of a provider to remove_files in batches of at most batch_size, until the journal
+                    has no expired files left or a batch removes nothing. Exceptions of remove_files are passed on, the batch is sent
+                    again once DELETE_RETRY_SECS have passed
+                    \return Returns the number of objects removed
+                */
+                size_t remove_expired(const std::string& provider_id, size_t batch_size, const RemoveCallback& remove_files);
+
+                /*! \fn bool get_expired(const std::string& provider_id, size_t limit, std::vector<DeletedFile>& files);
+                    \brief Lists the oldest files of a provider that were deleted longer than delete_retention_days ago.
+                    Files sent in the last DELETE_RETRY_SECS are left out
+                    \return Returns false if the journal could not be read
+                */
+                bool get_expired(const std::string& provider_id, size_t limit, std::vector<DeletedFile>& files);
+
+                /*! \fn bool is_backed_up(const DeletedFile& file);
+                    \return Returns true if a file at the same path has been backed up to the provider again, its object must be kept
+                */
+                bool is_backed_up(const DeletedFile& file);
+
+                /*! \fn bool is_referenced(const DeletedFile& file);
+                    \brief Duplicate files registered on the server point at the object of a file with the same content
+                    \return Returns true if a backed up file has the same content, its object must be kept for now
+                */
+                bool is_referenced(const DeletedFile& file);
+
+                /*! \fn void start_delete(const std::vector<DeletedFile>& files);
+                    \brief Records the attempt before the delete is sent
+                */
+                void start_delete(const std::vector<DeletedFile>& files);
+
+                /*! \fn void postpone(const std::vector<DeletedFile>& files);
+                    \brief Leaves the files out of get_expired for DELETE_RETRY_SECS without counting an attempt
+                */
+                void postpone(const std::vector<DeletedFile>& files);
+
+                /*! \fn void remove(const std::vector<unsigned long>& delete_ids);
+                    \brief Removes the entries of the objects the provider removed
+                */
+                void remove(const std::vector<unsigned long>& delete_ids);
+
+                /*! \fn void remove_orphans();
+                    \brief Removes the entries of providers that no longer exist
+                */
+                void remove_orphans();
+
+                /*! \fn static int get_retention_days();
+                    \return Returns the days the object of a deleted file is kept, 0 removes it on the next run
+                */
+                static int get_retention_days();
+
+            private:
+                LocalDatabase* m_database;
+
+        };
+
+    }
+}
+
+#endif // DELETEJOURNAL_H
@@ -19,6 +19,7 @@
 #include <vessel/database/local_db.hpp>
 #include <vessel/crypto/hash_util.hpp>
 #include <vessel/filesystem/file_exception.hpp>
+#include <vessel/filesystem/buffer_pool.hpp>
 
 #define BACKUP_LARGE_SZ 52428800 //Default size in bytes of what should be considered a larger file (50MB)
 #define BACKUP_CHUNK_SZ 52428800 //Default chunk size if not defined in DB (50MB)
@@ -56,7 +57,7 @@ namespace Vessel {
             };
 
             public:
-                BackupFile(){}
+                BackupFile() : m_part_size(m_chunk_size) {}
                 BackupFile(const fs::path& file_path); //Load file from filesystem
                 BackupFile(std::shared_ptr<unsigned char> file_id); //Load file from database
 
@@ -200,11 +201,29 @@ namespace Vessel {
                 */
                 static size_t get_chunk_size();
 
-                /*! \fn std::string get_file_part(unsigned int num);
+                /*! \fn void set_part_size( size_t part_sz );
+                    \brief Sets the part size in bytes used by this file for multipart uploads. Defaults to the global chunk size
+                */
+                void set_part_size( size_t part_sz );
+
+                /*! \fn size_t get_part_size() const;
+                    \brief Returns the part size in bytes used by this file for multipart uploads
+                */
+                size_t get_part_size() const;
+
+                /*! \fn std::string get_file_part(unsigned int num, size_t reserve=0);
                     \brief
+                    \param reserve Extra capacity in bytes for data appended to the part, such as an encryption tag
                     \return Returns the bytes of a file for the given part number
                 */
-                std::string get_file_part(unsigned int num);
+                std::string get_file_part(unsigned int num, size_t reserve=0);
+
+                /*! \fn std::shared_ptr<PartBuffer> read_part(unsigned int num, size_t reserve=0);
+                    \brief Reads a part from disk into a buffer of the BufferPool. Blocks while the pool is exhausted
+                    \param reserve Extra capacity in bytes for data appended to the part, such as an encryption tag
+                    \return Returns the buffer holding the part, or an empty pointer if the file could not be read
+                */
+                std::shared_ptr<PartBuffer> read_part(unsigned int num, size_t reserve=0);
 
                 /*! \fn std::string get_chunk(size_t offset, size_t length);
                     \brief
@@ -256,12 +275,46 @@ namespace Vessel {
                 bool is_readable();
 
                 /*! \fn update_last_backup();
-                    \fn update_last_backup(const BackupFile& file);
-                    \fn update_last_backup(std::shared_ptr<unsigned char> file_id);
-                    \brief Sets the last backup time for the file to the current UNIX timestamp
+                    \fn update_last_backup(std::shared_ptr<unsigned char> file_id, const std::string& hash);
+                    \brief Sets the last backup time for the file to the current UNIX timestamp and stores the SHA-1 hash of the backed up content
                 */
                 void update_last_backup();
-                static void update_last_backup(std::shared_ptr<unsigned char> file_id);
+                static void update_last_backup(std::shared_ptr<unsigned char> file_id, const std::string& hash);
+
+                /*! \fn static void reset_last_backup(std::shared_ptr<unsigned char> file_id);
+                    \brief Clears the last backup of a file whose content was lost before it was stored, so it is queued again
+                */
+                static void reset_last_backup(std::shared_ptr<unsigned char> file_id);
+
+                /*! \fn void update_compressed_size(size_t compressed_size);
+                    \brief Stores the size of the compressed upload of the file. 0 if the file was uploaded uncompressed
+                */
+                void update_compressed_size(size_t compressed_size);
+
+                /*! \fn void update_provider(const std::string& provider_id);
+                    \fn static void update_provider(std::shared_ptr<unsigned char> file_id, const std::string& provider_id);
+                    \brief Records the storage provider that holds the last backup of the file as an object of its own.
+                    Empty if the last backup is packed or a reference to other content
+                */
+                void update_provider(const std::string& provider_id);
+                static void update_provider(std::shared_ptr<unsigned char> file_id, const std::string& provider_id);
+
+                /*! \fn bool find_moved_file(const std::string& provider_id, MovedFile& moved) const;
+                    \brief Looks for a catalog entry with the same size and modified time whose file no longer exists,
+                    and whose last backup is an object of its own on the provider
+                    \return Returns true if the file may have been moved or renamed from the entry. The content hash must still be compared
+                */
+                bool find_moved_file(const std::string& provider_id, MovedFile& moved) const;
+
+                /*! \fn std::string get_last_backup_hash() const;
+                    \return Returns the SHA-1 hash of the file contents at the last backup, or an empty string if the file has not been backed up
+                */
+                std::string get_last_backup_hash() const;
+
+                /*! \fn static bool is_content_backed_up(const std::string& hash);
+                    \return Returns true if a file with the same SHA-1 content hash has already been backed up
+                */
+                static bool is_content_backed_up(const std::string& hash);
 
                 /*! \fn static std::string strip_slashes(const std::string& str);
                     \brief Removes slashes from a file path
@@ -280,6 +333,7 @@ namespace Vessel {
                 unsigned int m_upload_id; //!< Internal upload id for the file
                 std::string m_upload_key; //!< Server Upload ID/Key of the file
                 static size_t m_chunk_size; //!< Size in bytes in a file part for multi part uploads
+                size_t m_part_size; //!< Size in bytes of a file part for this file (see PartSizer)
                 bool m_readable; //Can the file be opened for reading?
 
                 /*! \fn void update_attributes()
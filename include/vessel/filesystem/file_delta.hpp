@@ -0,0 +1,150 @@
+#ifndef FILEDELTA_H
+#define FILEDELTA_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <boost/filesystem.hpp>
+#include <cryptopp/sha.h>
+
+#include <vessel/log/log.hpp>
+#include <vessel/filesystem/rolling_checksum.hpp>
+
+#define DELTA_MIN_FILE_SZ 67108864 //Default size in bytes of the smallest file that keeps a block signature if not defined in DB (64MB)
+#define DELTA_MIN_BLOCK_SZ 2048 //Smallest block size of a file signature
+#define DELTA_MAX_BLOCK_SZ 131072 //Largest block size of a file signature
+#define DELTA_BUFFER_SZ 16777216 //Size of the read buffer used when computing deltas (16MB)
+#define DELTA_MAX_LITERAL 1048576 //Largest literal instruction written to a delta (1MB)
+#define DELTA_MIN_FILTER_BITS 16 //Smallest weak checksum filter (2^16 bits)
+#define DELTA_MAX_FILTER_BITS 24 //Largest weak checksum filter (2^24 bits, 2MB)
+#define DELTA_FILTER_MULTIPLIER 0x9E3779B1U //Spreads the weak checksums over the filter bits
+#define DELTA_STRONG_SZ 20 //Size in bytes of the strong (SHA-1) block hash
+#define SIGNATURE_MAGIC "VESSSIG1"
+#define DELTA_MAGIC "VESSDLT1"
+
+namespace fs = boost::filesystem;
+
+namespace Vessel {
+    namespace File {
+
+        /*! \struct BlockSignature
+            \brief Weak and strong checksums of a fixed size block of a file
+        */
+        struct BlockSignature
+        {
+            uint32_t weak;
+            unsigned char strong[DELTA_STRONG_SZ];
+        };
+        typedef struct BlockSignature BlockSignature;
+
+        /*! \class FileSignature
+            \brief Block signatures of the last backed up version of a file.
+
+            File layout (integers are little endian):
+                [SIGNATURE_MAGIC][block size: 4 bytes][file size: 8 bytes]
+                [one entry per full block: weak checksum (4 bytes) + SHA-1 (20 bytes)]
+
+            The trailing partial block has no signature and is always sent as literal data.
+        */
+        class FileSignature
+        {
+
+            public:
+                FileSignature();
+
+                /*! \fn bool generate(const std::string& file_path);
+                    \brief Reads a file and computes the signature of every full block
+                    \return Returns false if the file could not be read
+                */
+                bool generate(const std::string& file_path);
+
+                /*! \fn bool load(const std::string& signature_path);
+                    \return Returns false if the signature does not exist or is invalid
+                */
+                bool load(const std::string& signature_path);
+
+                /*! \fn bool save(const std::string& signature_path) const;
+                    \brief Writes the signature to a temporary file and renames it over the previous signature
+                */
+                bool save(const std::string& signature_path) const;
+
+                /*! \fn static size_t get_block_size(size_t file_size);
+                    \return Returns the block size used for a file: the square root of the file size rounded to 1KB, as in rsync
+                */
+                static size_t get_block_size(size_t file_size);
+
+                size_t get_block_size() const { return m_block_size; }
+                size_t get_file_size() const { return m_file_size; }
+                const std::vector<BlockSignature>& get_blocks() const { return m_blocks; }
+
+            private:
+                size_t m_block_size;
+                size_t m_file_size;
+                std::vector<BlockSignature> m_blocks;
+
+        };
+
+        /*! \class FileDelta
+            \brief Computes the delta of a file against the signature of its previous version.
+
+            Delta layout (integers are little endian):
+                [DELTA_MAGIC][block size: 4 bytes][new file size: 8 bytes]
+                [instructions]
+
+            Instructions:
+                'L' [length: 4 bytes] [literal bytes]
+                'C' [first block: 4 bytes] [block count: 4 bytes]    Copy blocks from the previous version
+
+            The file is scanned with a RollingChecksum. Weak checksums are first tested against a bit filter
+            sized to the signature, so most positions cost a roll, a bit test and no hash table lookup. The strong hash is
+            only computed when the weak checksum matches a block.
+        */
+        class FileDelta
+        {
+
+            public:
+                FileDelta(const FileSignature& signature);
+
+                /*! \fn bool encode(const std::string& file_path, const std::string& delta_path);
+                    \brief Writes the delta of a file against the signature
+                    \return Returns false if the file could not be read or the delta could not be written
+                */
+                bool encode(const std::string& file_path, const std::string& delta_path);
+
+                size_t get_literal_bytes() const { return m_literal_bytes; }
+                size_t get_copied_bytes() const { return m_copied_bytes; }
+                size_t get_delta_size() const { return m_delta_size; }
+
+            private:
+                const FileSignature& m_signature;
+                std::unordered_map<uint32_t, std::vector<uint32_t> > m_weak_index; //Weak checksum => block numbers
+                std::vector<uint64_t> m_filter; //Bit filter of the weak checksums
+                int m_filter_bits; //log2 of the number of bits in the filter
+
+                std::ofstream m_stream;
+                size_t m_literal_bytes;
+                size_t m_copied_bytes;
+                size_t m_delta_size;
+                int64_t m_copy_start; //First block of the pending copy instruction, -1 if none
+                uint32_t m_copy_count;
+
+                /*! \fn int64_t find_block(uint32_t weak, const unsigned char* data);
+                    \return Returns the number of a block matching the data, or -1
+                */
+                int64_t find_block(uint32_t weak, const unsigned char* data);
+
+                void write_literal(const char* data, size_t length);
+                void write_copy(uint32_t block);
+                void flush_copy();
+
+                inline uint32_t get_filter_bit(uint32_t weak) const { return ( weak * DELTA_FILTER_MULTIPLIER ) >> ( 32 - m_filter_bits ); }
+
+        };
+
+    }
+}
+
+#endif // FILEDELTA_H
@@ -17,7 +17,8 @@ namespace Vessel {
                     NoError = 0,
                     FileNotFound,
                     ReadError,
-                    DirNotFound
+                    DirNotFound,
+                    WriteError
                 };
 
                 FileException(ErrorCode e, const std::string& msg) : _code(e)
@@ -0,0 +1,134 @@
+#ifndef FILEPACK_H
+#define FILEPACK_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <ctime>
+#include <boost/filesystem.hpp>
+
+#include <vessel/types.hpp>
+#include <vessel/log/log.hpp>
+#include <vessel/database/local_db.hpp>
+#include <vessel/crypto/hash_util.hpp>
+#include <vessel/filesystem/file.hpp>
+#include <vessel/filesystem/file_exception.hpp>
+#include <vessel/filesystem/chunk_index.hpp>
+
+#define PACK_MAX_FILE_SZ 1048576 //Default size in bytes of the largest file that is packed if not defined in DB (1MB)
+#define PACK_TARGET_SZ 16777216 //Default size in bytes of a pack if not defined in DB (16MB)
+#define PACK_MAGIC "VESSPACK" //Last 8 bytes of a pack
+#define PACK_FOOTER_SZ 16 //Index offset (8 bytes, little endian) + PACK_MAGIC
+
+using namespace Vessel::Types;
+using namespace Vessel::Logging;
+using namespace Vessel::Database;
+using namespace Vessel::File;
+
+namespace fs = boost::filesystem;
+
+namespace Vessel {
+    namespace File {
+
+        /*! \class FilePack
+            \brief Packs small files and file chunks into a single object so they can be uploaded with one request.
+
+            Pack layout:
+                [entry contents, back to back]
+                [index: one line per entry "<type> <id> <offset> <length> <hash>\n"]
+                [footer: index offset as 8 byte little endian integer, PACK_MAGIC]
+
+            Entry types:
+                file    Contents of a small file (id: file id, hash: SHA-1)
+                chunk   Content-defined chunk of a large file (id and hash: SHA-256)
+                recipe  Ordered chunk list of a large file (id: file id, hash: SHA-1 of the file)
+
+            Contents are stored uncompressed, so a single entry can be restored with a ranged read
+            using the offset and length recorded in the local database and the Vessel catalog.
+        */
+        class FilePack
+        {
+
+            public:
+                FilePack();
+                ~FilePack();
+
+                /*! \fn bool add_file(BackupFile& file);
+                    \brief Appends the contents of a file to the pack
+                    \return Returns false if the file could not be read or the pack is closed
+                */
+                bool add_file(BackupFile& file);
+
+                /*! \fn bool add_chunk(const std::string& hash, const char* data, size_t length);
+                    \brief Appends a file chunk to the pack
+                    \return Returns false if the chunk could not be written or the pack is closed
+                */
+                bool add_chunk(const std::string& hash, const char* data, size_t length);
+
+                /*! \fn bool add_recipe(BackupFile& file, const std::string& recipe);
+                    \brief Appends the chunk recipe of a large file to the pack
+                    \return Returns false if the recipe could not be written or the pack is closed
+                */
+                bool add_recipe(BackupFile& file, const std::string& recipe);
+
+                /*! \fn bool has_chunk(const std::string& hash) const;
+                    \return Returns true if the chunk has already been added to this pack
+                */
+                bool has_chunk(const std::string& hash) const;
+
+                /*! \fn void close();
+                    \brief Writes the pack index and footer. The pack is renamed to the SHA-1 hash of its contents
+                */
+                void close();
+
+                /*! \fn void save(const std::string& vessel_id, const std::string& object_key, const std::string& provider_id);
+                    \brief Records the pack, the storage provider that holds it and the offset of each packed file in the local database
+                */
+                void save(const std::string& vessel_id, const std::string& object_key, const std::string& provider_id);
+
+                /*! \fn void remove();
+                    \brief Deletes the local pack file
+                */
+                void remove();
+
+                /*! \fn bool is_full() const;
+                    \return Returns true if the pack has reached the target pack size
+                */
+                bool is_full() const;
+
+                /*! \fn static bool is_packable(const BackupFile& file);
+                    \return Returns true if the file is small enough to be packed
+                */
+                static bool is_packable(const BackupFile& file);
+
+                std::string get_pack_path() const { return m_pack_path.string(); }
+                size_t get_size() const { return m_size; }
+                int get_total_files() const { return m_entries.size(); }
+                bool empty() const { return m_entries.empty(); }
+                const std::vector<PackEntry>& get_entries() const { return m_entries; }
+
+            private:
+                fs::path m_pack_path; //Local path of the pack
+                std::ofstream m_stream;
+                std::vector<PackEntry> m_entries;
+                size_t m_size; //Total bytes of packed file content
+                size_t m_target_size;
+                bool m_closed;
+                std::set<std::string> m_chunks; //Hashes of the chunks in the pack
+
+                void write_index();
+
+                /*! \fn bool write_entry(PackEntry& entry, const char* data, size_t length);
+                    \brief Writes the entry contents at the end of the pack and adds the entry to the index
+                */
+                bool write_entry(PackEntry& entry, const char* data, size_t length);
+
+        };
+
+    }
+}
+
+#endif // FILEPACK_H
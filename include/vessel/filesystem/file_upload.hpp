@@ -4,10 +4,16 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <boost/algorithm/string.hpp>
 
 #include <vessel/log/log.hpp>
 #include <vessel/database/local_db.hpp>
 #include <vessel/filesystem/file.hpp>
+#include <vessel/crypto/file_cipher.hpp>
 
 using namespace Vessel::Logging;
 using namespace Vessel::Database;
@@ -31,22 +37,68 @@ namespace Vessel {
                 int get_total_parts() const { return m_total_parts; }
                 int get_offset() const { return m_offset; }
                 int get_weight() const { return m_weight; }
-                unsigned int get_chunk_size() const { return m_chunk_size; }
+                size_t get_chunk_size() const { return m_chunk_size; }
                 unsigned long get_last_modified() const { return m_last_modified; }
                 bool exists() const { return m_exists; }
                 BackupFile get_file();
                 std::shared_ptr<unsigned char> get_file_id() { return m_file_id; }
                 void update_key(const std::string& upload_key);
+                void update_chunk_size(size_t chunk_size);
                 int get_current_part() const;
                 void add_part(const FilePart& part) const;
                 std::vector<UploadTagSet> get_part_tags() const;
 
+                /*! \fn bool has_parts() const;
+                    \return Returns true if any part of the upload has been stored
+                */
+                bool has_parts() const;
+
+                /*! \fn std::vector<int> get_missing_parts() const;
+                    \return Returns the part numbers that have not been uploaded, in ascending order
+                */
+                std::vector<int> get_missing_parts() const;
+
+                /*! \fn void sync_parts(const std::vector<UploadTagSet>& remote_parts);
+                    \brief Reconciles the stored parts with the parts held by the storage provider.
+                    Stored parts the provider does not hold with the same tag and size are removed so they are uploaded again.
+                    Parts the provider holds that were not stored (interrupted before the part was saved) are added.
+                */
+                void sync_parts(const std::vector<UploadTagSet>& remote_parts);
+
+                /*! \fn void clear_parts();
+                    \brief Removes the stored parts and the upload key so the upload starts over
+                */
+                void clear_parts();
+
+                /*! \fn bool is_file_unchanged() const;
+                    \brief Compares the size and last write time recorded when the upload key was set with the file on disk
+                    \return Returns true if the file has not changed since the upload was started
+                */
+                bool is_file_unchanged() const;
+
+                /*! \fn size_t get_part_bytes(int part_number) const;
+                    \return Returns the expected size in bytes of a part as stored by the provider, including the tag of an encrypted part
+                */
+                size_t get_part_bytes(int part_number) const;
+
                 int get_error_count() const;
                 int increment_error();
 
                 void update_vessel_id(const std::string& id);
                 std::string get_vessel_id();
 
+                /*! \fn void update_encryption_key(const std::string& wrapped_key);
+                    \brief Stores the wrapped file key so a resumed upload encrypts the remaining parts with the same key
+                */
+                void update_encryption_key(const std::string& wrapped_key);
+                std::string get_encryption_key() const { return m_encryption_key; }
+
+                /*! \fn void update_provider(const std::string& provider_id);
+                    \brief Assigns the upload to a storage provider. The Vessel registration of another provider is dropped, the upload is registered again
+                */
+                void update_provider(const std::string& provider_id);
+                std::string get_provider_id() const { return m_provider_id; }
+
 
             private:
                 BackupFile m_file;
@@ -54,13 +106,17 @@ namespace Vessel {
                 std::string m_file_hash;
                 std::string m_signature;
                 std::string m_vessel_id;
+                std::string m_encryption_key; //Wrapped file key of an encrypted upload
+                std::string m_provider_id; //Storage provider the upload was started with
                 std::shared_ptr<unsigned char> m_file_id;
                 unsigned int m_upload_id;
                 int m_total_parts;
                 int m_offset;
                 int m_weight;
-                unsigned int m_chunk_size;
+                size_t m_chunk_size;
                 unsigned long m_last_modified;
+                size_t m_file_size; //Size of the file when the upload key was set
+                unsigned long m_file_modified; //Last write time of the file when the upload key was set
                 bool m_exists;
 
                 void init();
@@ -0,0 +1,156 @@
+#ifndef LOCALSTORE_H
+#define LOCALSTORE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include <vessel/types.hpp>
+#include <vessel/log/log.hpp>
+#include <vessel/database/local_db.hpp>
+#include <vessel/crypto/file_cipher.hpp>
+#include <vessel/filesystem/file.hpp>
+#include <vessel/filesystem/file_exception.hpp>
+
+#define LOCAL_FSYNC 1 //Default sync mode if not defined in DB (0 none, 1 every object, 2 once per batch)
+#define LOCAL_TMP_EXT ".vessel-tmp" //Objects are written to a temporary file next to their final path
+#define LOCAL_KEY_EXT ".vessel-key" //Wrapped key and part size of an encrypted object
+#define LOCAL_COPY_SZ 1073741824 //Largest number of bytes requested from a single copy_file_range or sendfile call (1GB)
+#define LOCAL_BUFFER_SZ 1048576 //Buffer size in bytes of the read/write fallback (1MB)
+#define LOCAL_DELETE_BATCH 1000 //Objects of deleted files removed per journal batch
+
+using namespace Vessel::Types;
+using namespace Vessel::Logging;
+using namespace Vessel::Database;
+
+namespace fs = boost::filesystem;
+
+namespace Vessel {
+    namespace File {
+
+        /*! \class LocalStore
+            \brief Stores backup objects as files under a root directory, such as a local disk or an NFS mount.
+
+            Objects are written to a temporary file in the directory of the object and renamed into place, so a
+            reader never sees a partial object. Plain objects are copied without passing through user space where
+            the file systems allow it:
+
+                Reflink:   FICLONE, the object shares the extents of the source (Btrfs, XFS)
+                CopyRange: copy_file_range, the kernel or the NFS server copies the data (NFS 4.2 server-side copy)
+                SendFile:  sendfile, the data is copied in the kernel
+                ReadWrite: read and write through a buffer
+
+            local_fsync sets when the objects are made durable:
+
+                0 (none):  the file system flushes the objects
+                1 (each):  every object and its directory are synced before it is reported as stored
+                2 (batch): objects are renamed into place immediately and synced together by sync()
+        */
+        class LocalStore
+        {
+
+            public:
+
+                enum CopyMethod
+                {
+                    Reflink = 0,
+                    CopyRange,
+                    SendFile,
+                    ReadWrite
+                };
+
+                enum SyncMode
+                {
+                    SyncNone = 0,
+                    SyncEach,
+                    SyncBatch
+                };
+
+                /*! \fn LocalStore(const std::string& root_path);
+                    \param root_path Directory holding the objects. Throws a FileException if it does not exist
+                */
+                LocalStore(const std::string& root_path);
+
+                /*! \fn CopyMethod store_file(const std::string& source_path, const std::string& object_key);
+                    \brief Copies a file to an object. Throws a FileException if the file could not be read or the object written
+                    \return Returns the method the content was copied with
+                */
+                CopyMethod store_file(const std::string& source_path, const std::string& object_key);
+
+                /*! \fn void store_parts(BackupFile& file, const std::string& object_key, FileCipher& cipher);
+                    \brief Writes a file as sealed parts, the wrapped key and part size are written to a key file next to the object.
+                    Throws a FileException if the file could not be read or the object written
+                */
+                void store_parts(BackupFile& file, const std::string& object_key, FileCipher& cipher);
+
+                /*! \fn bool copy_object(const std::string& source_key, const std::string& object_key, bool& encrypted);
+                    \brief Copies an object and its key file within the store. Throws a FileException if the object could not be written
+                    \return Returns false if the source object does not exist
+                */
+                bool copy_object(const std::string& source_key, const std::string& object_key, bool& encrypted);
+
+                /*! \fn bool remove_object(const std::string& object_key);
+                    \brief Removes an object and its key file. An object that does not exist counts as removed
+                    \return Returns false if the object could not be removed
+                */
+                bool remove_object(const std::string& object_key);
+
+                /*! \fn void sync();
+                    \brief Makes the objects stored since the last sync durable. Does nothing unless local_fsync is batch.
+                    Throws a FileException if the sync failed, the objects are then synced by the next call
+                */
+                void sync();
+
+                /*! \fn std::string get_object_path(const std::string& object_key) const;
+                    \return Returns the path of an object under the root directory
+                */
+                std::string get_object_path(const std::string& object_key) const;
+
+                SyncMode get_sync_mode() const { return m_sync_mode; }
+
+                /*! \fn void set_sync_mode(SyncMode mode);
+                    \brief Overrides local_fsync. Objects stored before a change from batch mode are still synced by sync()
+                */
+                void set_sync_mode(SyncMode mode) { m_sync_mode = mode; }
+
+                /*! \fn size_t get_pending_objects() const;
+                    \return Returns the number of objects stored since the last successful sync in batch mode
+                */
+                size_t get_pending_objects() const { return m_pending_objects; }
+
+            private:
+                fs::path m_root_path;
+                SyncMode m_sync_mode;
+                std::set<std::string> m_pending_paths; //Objects and directories not synced yet in batch mode
+                size_t m_pending_objects;
+
+                /*! \fn CopyMethod copy_content(const std::string& source_path, const std::string& target_path);
+                    \brief Copies the content of a file to a new file with the fastest method the file systems support
+                */
+                CopyMethod copy_content(const std::string& source_path, const std::string& target_path);
+
+                /*! \fn std::string begin_object(const std::string& object_key);
+                    \brief Creates the directories of an object
+                    \return Returns the temporary path the object is written to
+                */
+                std::string begin_object(const std::string& object_key);
+
+                /*! \fn void commit_object(const std::string& tmp_path, const std::string& object_path);
+                    \brief Syncs the temporary file according to local_fsync and renames it to the object path
+                */
+                void commit_object(const std::string& tmp_path, const std::string& object_path);
+
+                /*! \fn static void sync_path(const std::string& path);
+                    \brief Flushes a file or directory to the storage device. Throws a FileException on failure
+                */
+                static void sync_path(const std::string& path);
+
+        };
+
+    }
+}
+
+#endif // LOCALSTORE_H
@@ -0,0 +1,64 @@
+#ifndef REPOSITORYINDEX_H
+#define REPOSITORYINDEX_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ctime>
+#include <boost/filesystem.hpp>
+
+#include <vessel/types.hpp>
+#include <vessel/log/log.hpp>
+#include <vessel/database/local_db.hpp>
+
+using namespace Vessel::Types;
+using namespace Vessel::Logging;
+using namespace Vessel::Database;
+
+namespace fs = boost::filesystem;
+
+namespace Vessel {
+    namespace File {
+
+        /*! \class RepositoryIndex
+            \brief Local index of the blobs stored in the pack repository of a storage provider, keyed by the SHA-256 hash of the blob.
+
+            A blob is a content-defined chunk of a file. The repository holds each blob once, so the index
+            is kept per provider: a blob stored in the repository of one provider is uploaded again to another.
+        */
+        class RepositoryIndex
+        {
+
+            public:
+
+                /*! \fn RepositoryIndex(const std::string& provider_id);
+                    \param provider_id Storage provider holding the repository
+                */
+                RepositoryIndex(const std::string& provider_id);
+
+                /*! \fn bool contains(const std::string& hash);
+                    \return Returns true if the blob is stored in a pack of the repository
+                */
+                bool contains(const std::string& hash);
+
+                /*! \fn bool add_pack(const std::string& object_key, const std::vector<PackEntry>& entries);
+                    \brief Records the blobs of a stored pack
+                */
+                bool add_pack(const std::string& object_key, const std::vector<PackEntry>& entries);
+
+                /*! \fn bool get_snapshot_files(std::vector<SnapshotFile>& files);
+                    \brief Lists the backed up files whose content is stored in the repository, with their blobs in order
+                    \return Returns false if the files could not be read
+                */
+                bool get_snapshot_files(std::vector<SnapshotFile>& files);
+
+            private:
+                LocalDatabase* m_database;
+                std::string m_provider_id;
+
+        };
+
+    }
+}
+
+#endif // REPOSITORYINDEX_H
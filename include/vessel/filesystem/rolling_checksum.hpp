@@ -0,0 +1,79 @@
+#ifndef ROLLINGCHECKSUM_H
+#define ROLLINGCHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Vessel {
+    namespace File {
+
+        /*! \class RollingChecksum
+            \brief rsync style weak checksum of a fixed size window that can be moved one byte at a time.
+
+            a = sum of the bytes in the window, b = sum of the bytes weighted by their distance to the end of
+            the window. Both sums are kept modulo 2^32 and truncated to 16 bits when the digest is taken, so
+            rolling costs a few additions per byte. The class is header only so the scan loop is inlined.
+        */
+        class RollingChecksum
+        {
+
+            public:
+                RollingChecksum() : m_a(0), m_b(0), m_length(0) {}
+
+                /*! \fn void init(const unsigned char* data, size_t length);
+                    \brief Computes the checksum of a new window
+                */
+                inline void init(const unsigned char* data, size_t length)
+                {
+                    uint32_t a = 0;
+                    uint32_t b = 0;
+
+                    for ( size_t i=0; i < length; i++ )
+                    {
+                        a += data[i];
+                        b += a;
+                    }
+
+                    m_a = a;
+                    m_b = b;
+                    m_length = length;
+                }
+
+                /*! \fn void roll(unsigned char out, unsigned char in);
+                    \brief Moves the window one byte forward. out is the first byte of the old window, in the last byte of the new one
+                */
+                inline void roll(unsigned char out, unsigned char in)
+                {
+                    m_a += (uint32_t)in - out;
+                    m_b += m_a - (uint32_t)m_length * out;
+                }
+
+                /*! \fn uint32_t digest() const;
+                    \return Returns the 32 bit checksum of the window
+                */
+                inline uint32_t digest() const
+                {
+                    return (m_a & 0xFFFF) | (m_b << 16);
+                }
+
+                /*! \fn static uint32_t get_checksum(const unsigned char* data, size_t length);
+                    \return Returns the checksum of a block
+                */
+                static inline uint32_t get_checksum(const unsigned char* data, size_t length)
+                {
+                    RollingChecksum sum;
+                    sum.init(data, length);
+                    return sum.digest();
+                }
+
+            private:
+                uint32_t m_a;
+                uint32_t m_b;
+                size_t m_length;
+
+        };
+
+    }
+}
+
+#endif // ROLLINGCHECKSUM_H
@@ -0,0 +1,127 @@
+#ifndef CIRCUITBREAKER_H
+#define CIRCUITBREAKER_H
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include <vessel/database/local_db.hpp>
+#include <vessel/log/log.hpp>
+
+#define BREAKER_FAILURE_RATE 50 //Default failure rate in percent that opens the breaker if not defined in DB
+#define BREAKER_OPEN_SECS 30 //Default seconds the breaker stays open before a probe if not defined in DB
+#define BREAKER_MAX_OPEN_SECS 900 //Default longest pause after repeated failed probes if not defined in DB
+#define BREAKER_SLOW_SECS 120 //Default seconds after which a request counts as failed if not defined in DB
+#define BREAKER_MIN_CALLS 5 //Requests recorded before the failure rate can open the breaker
+#define BREAKER_SAMPLE_WEIGHT 0.2 //Weight of the newest request in the failure rate
+
+using namespace Vessel::Database;
+using namespace Vessel::Logging;
+
+namespace Vessel
+{
+    namespace Networking
+    {
+
+        /*! \class CircuitBreaker
+            \brief Tracks the health of a storage provider from the results of its requests.
+
+            Closed:    requests are sent. A failure rate above breaker_failure_rate opens the breaker
+            Open:      requests fail fast for the open period, uploads are paused
+            Half-open: a single probe request is sent. Success closes the breaker, failure opens it again for twice as long
+
+            Network errors, timeouts, 408, 429 and 5xx responses and requests slower than breaker_slow_secs are provider failures.
+            Other responses are the result of the request itself and count as successes.
+        */
+        class CircuitBreaker
+        {
+
+            public:
+
+                enum State
+                {
+                    Closed = 0,
+                    Open,
+                    HalfOpen
+                };
+
+                CircuitBreaker(const std::string& name);
+
+                /*! \fn static std::shared_ptr<CircuitBreaker> get_breaker(const std::string& name);
+                    \brief The breakers are shared by all clients of a provider and kept for the life of the process
+                    \return Returns the breaker of a provider, it is created on first use
+                */
+                static std::shared_ptr<CircuitBreaker> get_breaker(const std::string& name);
+
+                /*! \fn bool allow_request();
+                    \return Returns false while the breaker is open, or a probe is already sent in the half-open state
+                */
+                bool allow_request();
+
+                /*! \fn void record_result(unsigned int http_status, double seconds);
+                    \brief Records the result of an allowed request. A status of 0 is a network error or timeout
+                */
+                void record_result(unsigned int http_status, double seconds);
+
+                /*! \fn void abandon_request();
+                    \brief Ends an allowed request that failed before it reached the provider, without a result
+                */
+                void abandon_request();
+
+                /*! \fn double get_wait_secs();
+                    \return Returns the seconds until a probe is allowed, 0 if the breaker is not open
+                */
+                double get_wait_secs();
+
+                /*! \fn void wait();
+                    \brief Sleeps until a probe is allowed
+                */
+                void wait();
+
+                State get_state();
+                std::string get_name() const { return m_name; }
+
+                /*! \fn size_t get_total_failures();
+                    \return Returns the number of provider failures recorded since the breaker was created
+                */
+                size_t get_total_failures();
+
+                /*! \fn static bool is_provider_failure(unsigned int http_status);
+                    \return Returns true if the status is caused by the provider rather than the request
+                */
+                static bool is_provider_failure(unsigned int http_status);
+
+            private:
+                std::string m_name;
+                State m_state;
+                double m_failure_rate; //Average ratio of failed requests
+                double m_max_failure_rate; //Failure rate that opens the breaker
+                double m_slow_secs; //Requests slower than this are failures
+                int m_base_open_secs; //Open period after the breaker trips
+                int m_max_open_secs; //Longest open period
+                int m_open_secs; //Current open period, doubled after each failed probe
+                unsigned int m_calls; //Requests recorded since the breaker closed
+                size_t m_total_failures;
+                bool m_probing; //A half-open probe is in flight
+                std::chrono::steady_clock::time_point m_opened_at;
+                std::mutex m_mutex;
+
+                static std::map<std::string, std::shared_ptr<CircuitBreaker>> m_breakers;
+                static std::mutex m_breakers_mutex;
+
+                /*! \fn void trip();
+                    \brief Opens the breaker for the current open period
+                */
+                void trip();
+
+        };
+
+    }
+}
+
+#endif //CIRCUITBREAKER_H
@@ -8,6 +8,7 @@
 #include <regex>
 #include <memory>
 #include <map>
+#include <chrono>
 
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
@@ -23,8 +24,10 @@
 #include <vessel/network/http_exception.hpp>
 #include <vessel/network/http_request.hpp>
 #include <vessel/network/token_bucket.hpp>
+#include <vessel/network/circuit_breaker.hpp>
 
 #define MIN_TRANSFER_SPEED 500
+#define HTTP_KEEP_ALIVE_IDLE 10 //Seconds an idle connection is reused for, servers close idle connections after a few seconds
 
 using namespace Vessel;
 using namespace Vessel::Database;
@@ -103,11 +106,11 @@ namespace Vessel {
 
                 boost::system::error_code get_error_code();
 
-                /*! \fn std::string encode_url(const std::string& url);
+                /*! \fn static std::string encode_uri(const std::string& uri);
                     \brief Encodes URL according to RFC 3986. Spaces are encoded to "%20"
                     \return Returns the URL encoded string
                 */
-                std::string encode_uri(const std::string& uri);
+                static std::string encode_uri(const std::string& uri);
 
                 //TBD
                 std::string decode_uri(const std::string& uri);
@@ -152,6 +155,16 @@ namespace Vessel {
                 */
                 void max_transfer_speed(size_t limit);
 
+                /*! \fn void keep_alive(bool flag);
+                    \brief Enables or disables reusing the connection for the next request. Defaults to the http_keep_alive setting
+                */
+                void keep_alive(bool flag);
+
+                /*! \fn void set_circuit_breaker(std::shared_ptr<CircuitBreaker> breaker);
+                    \brief Records the result of every request with the breaker. Requests throw an HttpException while it is open
+                */
+                void set_circuit_breaker(std::shared_ptr<CircuitBreaker> breaker);
+
             private:
 
                 LocalDatabase* m_ldb;
@@ -171,10 +184,14 @@ namespace Vessel {
                 bool m_ssl_good;
                 bool m_chunked_encoding;
                 bool m_stopped;
+                bool m_keep_alive;
+                bool m_reusable; //The response was read to its end and the connection can carry the next request
+                bool m_head_request; //Responses to HEAD requests have no body, whatever their Content-Length
                 static bool m_http_logging;
                 long m_transfer_start_time;
                 long m_last_write_time;
                 size_t m_last_bytes_transferred;
+                std::chrono::steady_clock::time_point m_last_used;
 
                 boost::asio::ssl::context m_ssl_ctx;
                 boost::posix_time::time_duration m_timeout;
@@ -192,6 +209,7 @@ namespace Vessel {
                 boost::system::error_code m_response_ec;
 
                 std::shared_ptr<TokenBucket> m_token_bucket;
+                std::shared_ptr<CircuitBreaker> m_breaker;
                 std::shared_ptr<std::string> m_request_data;
                 std::shared_ptr<boost::asio::const_buffer> m_request_buffer;
 
@@ -209,6 +227,7 @@ namespace Vessel {
                 void handle_read_content( const boost::system::error_code& e, size_t bytes_transferred );
                 void handle_read_headers( const boost::system::error_code& e );
                 void read_chunked_content( const boost::system::error_code& e, size_t bytes_transferred );
+                void read_content_length( const boost::system::error_code& e, size_t bytes_transferred );
                 void read_buffer_data();
                 void cancel_deadline();
                 void init_deadline_timer();
@@ -218,8 +237,26 @@ namespace Vessel {
 
 
                 void write_socket( const std::string& str );
+
+                /*! \fn void write_socket_stream( const std::string& header, const HttpBodySource& source );
+                    \brief Writes the request header, then each piece of the body as the source produces it.
+                    Only one piece of the body is held in memory at a time
+                */
+                void write_socket_stream( const std::string& header, const HttpBodySource& source );
+
                 void run_io_service();
 
+                /*! \fn void write_request( const std::string& header, const HttpRequest& request );
+                    \brief Writes the request and runs the handlers until the response has been read
+                */
+                void write_request( const std::string& header, const HttpRequest& request );
+
+                /*! \fn bool can_reuse_connection();
+                    \brief A connection can be reused if keep-alive is enabled, it was idle less than HTTP_KEEP_ALIVE_IDLE seconds and the server has not closed it
+                    \return Returns true if the next request can be sent on the open connection
+                */
+                bool can_reuse_connection();
+
             protected:
 
                 /*! \fn bool connect();
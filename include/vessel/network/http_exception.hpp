@@ -17,7 +17,8 @@ namespace Exception {
                     NoError = 0,
                     InvalidUrl,
                     ConnectFailed,
-                    HandshakeFailed
+                    HandshakeFailed,
+                    CircuitOpen
                 };
 
                 HttpException(ErrorCode e, const std::string& msg) : _msg(msg),_code(e)
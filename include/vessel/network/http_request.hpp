@@ -4,10 +4,16 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <functional>
 
 namespace Vessel {
     namespace Networking {
 
+        /*! \typedef HttpBodySource
+            \brief Fills the next piece of a streamed request body. Returns false when the body is complete
+        */
+        typedef std::function<bool(std::string& chunk)> HttpBodySource;
+
         class HttpRequest
         {
             public:
@@ -23,6 +29,12 @@ namespace Vessel {
                 void set_auth_header( const std::string& str);
                 void accept(const std::string& str);
 
+                /*! \fn void set_body_source( HttpBodySource source, size_t length );
+                    \brief Streams the body from a source instead of sending a body held in memory
+                    \param length Total bytes the source writes, sent as the Content-Length
+                */
+                void set_body_source( HttpBodySource source, size_t length );
+
                 std::string get_url() const;
                 std::string get_method() const;
                 std::vector<std::string> get_headers() const;
@@ -31,6 +43,8 @@ namespace Vessel {
                 std::string get_accept() const;
                 std::string get_auth() const;
                 size_t get_body_length() const;
+                HttpBodySource get_body_source() const;
+                bool has_body_source() const;
 
             private:
                 std::string m_url;
@@ -41,6 +55,8 @@ namespace Vessel {
                 std::string m_content_type;
                 std::string m_body;
                 std::vector<std::string> m_headers;
+                HttpBodySource m_body_source;
+                size_t m_body_length = 0; //Length of a streamed body
 
 
         };
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <memory>
 
 namespace Vessel {
     namespace Types {
@@ -43,6 +44,7 @@ namespace Vessel {
             std::string provider_type;
             std::string endpoint;
             int priority;
+            int weight; //Share of the uploads when load is split across providers
         };
         typedef struct StorageProvider StorageProvider;
 
@@ -61,9 +63,87 @@ namespace Vessel {
         {
             int part_number;
             std::string tag;
+            size_t total_bytes;
         };
         typedef struct UploadTagSet UploadTagSet;
 
+        struct PackEntry
+        {
+            std::string type; //file, chunk or recipe
+            std::shared_ptr<unsigned char> file_id;
+            std::string file_id_text;
+            std::string file_name;
+            std::string file_path;
+            std::string file_type;
+            std::string hash;
+            size_t file_size;
+            size_t offset;
+            size_t length;
+        };
+        typedef struct PackEntry PackEntry;
+
+        struct ChunkRef
+        {
+            std::string hash; //SHA-256 of the chunk
+            size_t length;
+        };
+        typedef struct ChunkRef ChunkRef;
+
+        struct SnapshotFile
+        {
+            std::string file_path;
+            size_t file_size;
+            unsigned long last_modified;
+            std::string hash; //SHA-1 of the file
+            std::vector<ChunkRef> blobs; //Content of the file, in order
+        };
+        typedef struct SnapshotFile SnapshotFile;
+
+        struct UploadCompletion
+        {
+            std::string vessel_id;
+            bool compressed;
+            bool encrypted;
+        };
+        typedef struct UploadCompletion UploadCompletion;
+
+        struct UploadRegistration
+        {
+            std::string vessel_id; //Empty if the file was rejected
+            bool stored; //The content was sent inline and stored by the Vessel API
+        };
+        typedef struct UploadRegistration UploadRegistration;
+
+        struct QueueEntry
+        {
+            unsigned int upload_id;
+            std::string file_key; //Raw file id
+            int weight; //Weight of the file extension
+            unsigned long last_modified; //Last write time of the file
+            size_t file_size;
+            unsigned long queued_time; //Time the file was added to the upload queue
+        };
+        typedef struct QueueEntry QueueEntry;
+
+        struct MovedFile
+        {
+            std::string file_key; //Raw file id of the catalog entry
+            std::string file_path; //Directory the file was backed up from
+            std::string file_name;
+            std::string hash; //SHA-1 of the backed up content
+        };
+        typedef struct MovedFile MovedFile;
+
+        struct DeletedFile
+        {
+            unsigned long delete_id; //Entry of the delete journal
+            std::string provider_id; //Provider holding the object
+            std::string file_path; //Directory the file was backed up from
+            std::string file_name;
+            std::string hash; //Content of the object, other files with the same content may reference it
+        };
+        typedef struct DeletedFile DeletedFile;
+
     }
 }
 
@@ -0,0 +1,65 @@
+#ifndef PARTSIZER_H
+#define PARTSIZER_H
+
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include <vessel/database/local_db.hpp>
+#include <vessel/filesystem/file.hpp>
+#include <vessel/filesystem/buffer_pool.hpp>
+#include <vessel/vessel/stat_manager.hpp>
+
+#define PART_SZ_ALIGN 1048576 //Part sizes are rounded up to the nearest MB
+#define PART_TARGET_SECS 30 //Preferred time in seconds to upload a single part
+#define PART_BUFFER_COPIES 2 //Part buffers that fit in the memory budget at once, leaving room for a part held by another provider client
+#define PART_STAT_WEIGHT 0.2 //Weight of the newest sample in the moving averages of the link stats
+
+using namespace Vessel;
+using namespace Vessel::Database;
+using namespace Vessel::Logging;
+using namespace Vessel::File;
+
+namespace Vessel
+{
+    class PartSizer
+    {
+
+        public:
+
+            PartSizer(const std::string& provider_type);
+
+            /*! \fn size_t get_part_size(size_t file_size) const;
+                \brief Chooses the part size for a file from the provider part limits, the observed link throughput and failure rate, and the memory budget
+                \return Returns the part size in bytes for a multipart upload of the file
+            */
+            size_t get_part_size(size_t file_size) const;
+
+            /*! \fn static void record_part(size_t bytes, double seconds, bool success);
+                \brief Adds the result of a single part upload to the link throughput and failure rate averages
+            */
+            static void record_part(size_t bytes, double seconds, bool success);
+
+            size_t get_min_part_size() const { return m_min_part_size; }
+            size_t get_max_part_size() const { return m_max_part_size; }
+            unsigned int get_max_parts() const { return m_max_parts; }
+
+        private:
+            size_t m_min_part_size; //Smallest part accepted by the provider (except the last part)
+            size_t m_max_part_size; //Largest part accepted by the provider
+            unsigned int m_max_parts; //Maximum number of parts in a single upload
+            size_t m_default_part_size; //Part size used before any link stats have been recorded
+            size_t m_memory_budget; //Memory in bytes available for part buffers
+            double m_throughput; //Average bytes per second of a part upload
+            double m_failure_rate; //Average ratio of failed part uploads
+
+            /*! \fn static size_t align_size(size_t size);
+                \brief Rounds a part size up to PART_SZ_ALIGN
+            */
+            static size_t align_size(size_t size);
+
+    };
+}
+
+#endif //PARTSIZER_H
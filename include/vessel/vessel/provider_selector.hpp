@@ -0,0 +1,107 @@
+#ifndef PROVIDERSELECTOR_H
+#define PROVIDERSELECTOR_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+
+#include <vessel/types.hpp>
+#include <vessel/database/local_db.hpp>
+#include <vessel/log/log.hpp>
+#include <vessel/network/circuit_breaker.hpp>
+
+#define PROVIDER_MODE "failover" //Default provider selection if not defined in DB
+#define PROVIDER_FAILOVER_RATE 25 //Default upload error rate in percent at which a provider is skipped if not defined in DB
+#define PROVIDER_RETRY_SECS 300 //Default seconds before a skipped provider is tried again if not defined in DB
+#define PROVIDER_MIN_UPLOADS 5 //Uploads recorded before a provider can be skipped
+#define PROVIDER_STAT_WEIGHT 0.2 //Weight of the newest upload in the goodput and error rate
+#define PROVIDER_BASELINE_WEIGHT 0.02 //Weight of the newest upload in the long term goodput
+#define PROVIDER_SLOW_RATIO 0.25 //A provider is skipped when its goodput drops below this share of its long term goodput
+#define PROVIDER_GOODPUT_MIN_SZ 1048576 //Smaller uploads are dominated by request latency and are not used for the goodput
+
+using namespace Vessel::Types;
+using namespace Vessel::Database;
+using namespace Vessel::Logging;
+using namespace Vessel::Networking;
+
+namespace Vessel
+{
+
+    /*! \struct ProviderStats
+        \brief Upload results of a storage provider since the process started
+    */
+    struct ProviderStats
+    {
+        double goodput; //Average bytes per second of successful uploads
+        double baseline; //Long term average bytes per second of successful uploads
+        double error_rate; //Average ratio of uploads that failed on the provider
+        unsigned int uploads;
+        std::chrono::steady_clock::time_point last_upload;
+    };
+
+    /*! \class ProviderSelector
+        \brief Chooses the storage provider for the next uploads.
+
+        A provider is healthy unless its circuit breaker is open, its error rate reached provider_failover_rate, or its goodput
+        dropped below PROVIDER_SLOW_RATIO of its long term goodput. A skipped provider is tried again after provider_retry_secs.
+
+        failover: the highest priority healthy provider
+        weighted: the healthy providers in turn, each in proportion to its weight (smooth weighted round robin)
+
+        If no provider is healthy the highest priority provider is used.
+    */
+    class ProviderSelector
+    {
+
+        public:
+
+            /*! \fn ProviderSelector(const std::vector<StorageProvider>& providers);
+                \param providers Storage providers, highest priority first
+            */
+            ProviderSelector(const std::vector<StorageProvider>& providers);
+
+            /*! \fn StorageProvider select();
+                \return Returns the provider for the next uploads
+            */
+            StorageProvider select();
+
+            /*! \fn bool is_healthy(const StorageProvider& provider);
+                \return Returns true if uploads can be sent to the provider
+            */
+            bool is_healthy(const StorageProvider& provider);
+
+            /*! \fn bool find_provider(const std::string& provider_id, StorageProvider& provider) const;
+                \return Returns false if the provider no longer exists
+            */
+            bool find_provider(const std::string& provider_id, StorageProvider& provider) const;
+
+            /*! \fn static void record_upload(const std::string& provider_id, size_t bytes, double seconds, bool success);
+                \brief Adds the result of an upload to the goodput and error rate of a provider. Failures caused by the file are not recorded
+            */
+            static void record_upload(const std::string& provider_id, size_t bytes, double seconds, bool success);
+
+            /*! \fn static ProviderStats get_stats(const std::string& provider_id);
+                \return Returns the upload results of a provider
+            */
+            static ProviderStats get_stats(const std::string& provider_id);
+
+        private:
+            std::vector<StorageProvider> m_providers;
+            std::map<std::string, int> m_current_weights; //Weighted round robin state
+            std::string m_last_provider_id; //Provider of the previous selection
+            bool m_weighted;
+            double m_failover_rate;
+            int m_retry_secs;
+
+            static std::map<std::string, ProviderStats> m_stats;
+            static std::mutex m_stats_mutex;
+
+    };
+
+}
+
+#endif //PROVIDERSELECTOR_H
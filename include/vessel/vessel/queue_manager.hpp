@@ -3,10 +3,17 @@
 
 #include <iostream>
 #include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <ctime>
 
 #include <vessel/database/local_db.hpp>
 #include <vessel/filesystem/file.hpp>
 #include <vessel/filesystem/file_upload.hpp>
+#include <vessel/vessel/upload_heap.hpp>
+#include <vessel/vessel/schedule_policy.hpp>
 
 using namespace Vessel;
 using namespace Vessel::Exception;
@@ -14,26 +21,67 @@ using namespace Vessel::Database;
 using namespace Vessel::File;
 
 #define QUEUE_MAX_ROWS 100
+#define QUEUE_AGING 10 //Default priority gained per hour in queue if not defined in DB. A file without weight passes a new file of weight 1000 after 100 hours
+#define QUEUE_FLUSH_SZ 50 //Popped uploads are removed from backup_upload in batches of this size
 
 namespace Vessel
 {
+  /*! \class QueueManager
+      \brief The upload queue is held in memory by all queue managers of the process. It is loaded once from backup_upload,
+      new uploads are added as they are queued and popped uploads are removed from backup_upload in batches.
+      Uploads are taken in the order of the scheduling policy chosen by the queue_policy setting.
+  */
   class QueueManager
   {
 
       public:
           QueueManager();
+          ~QueueManager();
 
           BackupFile get_next_file();
           FileUpload get_next_upload();
+
+          /*! \fn std::vector<FileUpload> get_next_uploads(int count);
+              \brief Takes the next uploads in queue order. Uploads that are not popped return to the queue when the manager is destroyed
+          */
+          std::vector<FileUpload> get_next_uploads(int count);
+
+          /*! \fn int get_total_pending();
+              \return Returns the number of queued uploads, including the uploads taken by a manager
+          */
           int get_total_pending();
           void rebuild_queue();
           void pop_file(std::shared_ptr<unsigned char> file_id);
 
+          /*! \fn void persist_queue();
+              \brief Removes the popped uploads from backup_upload
+          */
+          void persist_queue();
+
       private:
           LocalDatabase* m_database;
+          std::vector<unsigned int> m_taken_ids; //Uploads taken by this manager
+
+          static std::unique_ptr<UploadHeap> m_queue;
+          static std::map<unsigned int, QueueEntry> m_taken; //Uploads taken by any manager
+          static std::vector<std::string> m_popped; //Files whose uploads are removed from backup_upload on the next persist
+          static std::mutex m_queue_mutex;
+
+          void load_queue();
+
+          /*! \fn std::shared_ptr<SchedulePolicy> get_policy();
+              \return Returns the scheduling policy chosen by the queue_policy setting
+          */
+          std::shared_ptr<SchedulePolicy> get_policy();
+          void rebuild();
+          void persist();
+          void push_file(std::shared_ptr<unsigned char> file_id, int weight);
+          bool is_queued(std::shared_ptr<unsigned char> file_id);
 
-          void push_file(std::shared_ptr<unsigned char> file_id);
-          void apply_weights();
+          /*! \fn static std::string get_file_key(std::shared_ptr<unsigned char> file_id);
+              \return Returns the raw file id, as it is bound to queries
+          */
+          static std::string get_file_key(std::shared_ptr<unsigned char> file_id);
 
       protected:
           void clear_queue();
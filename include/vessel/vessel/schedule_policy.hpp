@@ -0,0 +1,131 @@
+#ifndef SCHEDULEPOLICY_H
+#define SCHEDULEPOLICY_H
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <vector>
+
+#include <vessel/types.hpp>
+
+#define QUEUE_POLICY "priority" //Default scheduling policy if not defined in DB
+#define QUEUE_SLA_HOURS 24 //Default hours a changed file may wait for its backup if not defined in DB
+
+using namespace Vessel::Types;
+
+namespace Vessel
+{
+
+    /*! \class SchedulePolicy
+        \brief Orders the uploads in the upload queue.
+
+        The order of two queued uploads must not change while they wait, so the queue can be kept in a heap.
+        A policy that depends on time must move every upload at the same rate.
+    */
+    class SchedulePolicy
+    {
+
+        public:
+
+            virtual ~SchedulePolicy() {}
+
+            /*! \fn virtual bool is_before(const QueueEntry& a, const QueueEntry& b) const;
+                \return Returns true if a is uploaded before b
+            */
+            virtual bool is_before(const QueueEntry& a, const QueueEntry& b) const = 0;
+
+            virtual std::string get_name() const = 0;
+
+            /*! \fn static std::shared_ptr<SchedulePolicy> create(const std::string& name, double aging, unsigned long sla_secs);
+                \brief Creates a policy by the name used in the queue_policy setting: priority, newest, shortest or deadline
+                \return Returns the policy, or an empty pointer if the name is unknown
+            */
+            static std::shared_ptr<SchedulePolicy> create(const std::string& name, double aging, unsigned long sla_secs);
+
+            /*! \fn static std::vector<std::string> get_policy_names();
+                \return Returns the names of the built in policies
+            */
+            static std::vector<std::string> get_policy_names();
+
+    };
+
+    /*! \class PriorityPolicy
+        \brief Highest priority first: weight of the file extension + aging * hours in queue. Ties go to the newest file
+    */
+    class PriorityPolicy : public SchedulePolicy
+    {
+
+        public:
+
+            PriorityPolicy(double aging) : m_aging(aging) {}
+
+            bool is_before(const QueueEntry& a, const QueueEntry& b) const;
+            std::string get_name() const { return "priority"; }
+
+            /*! \fn double get_priority(const QueueEntry& entry, unsigned long now) const;
+                \return Returns the priority of an upload at the given time
+            */
+            double get_priority(const QueueEntry& entry, unsigned long now) const;
+
+        private:
+            double m_aging; //Priority gained per hour in queue
+
+            /*! \fn double get_key(const QueueEntry& entry) const;
+                \brief Every upload ages at the same rate, so the priority at any time orders uploads like weight - aging * queued_time / 3600
+            */
+            double get_key(const QueueEntry& entry) const;
+
+    };
+
+    /*! \class NewestFirstPolicy
+        \brief Most recently changed file first. The files a user is working on are protected first
+    */
+    class NewestFirstPolicy : public SchedulePolicy
+    {
+
+        public:
+
+            bool is_before(const QueueEntry& a, const QueueEntry& b) const;
+            std::string get_name() const { return "newest"; }
+
+    };
+
+    /*! \class ShortestFirstPolicy
+        \brief Smallest file first. Protects the most files per hour, large files wait until the small ones are uploaded
+    */
+    class ShortestFirstPolicy : public SchedulePolicy
+    {
+
+        public:
+
+            bool is_before(const QueueEntry& a, const QueueEntry& b) const;
+            std::string get_name() const { return "shortest"; }
+
+    };
+
+    /*! \class DeadlinePolicy
+        \brief Earliest deadline first. A file must be backed up within sla_secs of its last change
+    */
+    class DeadlinePolicy : public SchedulePolicy
+    {
+
+        public:
+
+            DeadlinePolicy(unsigned long sla_secs) : m_sla_secs(sla_secs) {}
+
+            bool is_before(const QueueEntry& a, const QueueEntry& b) const;
+            std::string get_name() const { return "deadline"; }
+
+            /*! \fn unsigned long get_deadline(const QueueEntry& entry) const;
+                \return Returns the time the file must be backed up by
+            */
+            unsigned long get_deadline(const QueueEntry& entry) const { return entry.last_modified + m_sla_secs; }
+
+        private:
+            unsigned long m_sla_secs;
+
+    };
+
+}
+
+#endif // SCHEDULEPOLICY_H
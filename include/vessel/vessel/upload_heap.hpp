@@ -0,0 +1,77 @@
+#ifndef UPLOADHEAP_H
+#define UPLOADHEAP_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+
+#include <vessel/types.hpp>
+#include <vessel/vessel/schedule_policy.hpp>
+
+#define HEAP_ARITY 4 //Children per node, a wider node makes the heap shallower and pops touch fewer cache lines
+
+using namespace Vessel::Types;
+
+namespace Vessel
+{
+
+    /*! \class UploadHeap
+        \brief Indexed d-ary heap of queued uploads, ordered by a scheduling policy. The next upload is on top
+    */
+    class UploadHeap
+    {
+
+        public:
+
+            UploadHeap(std::shared_ptr<SchedulePolicy> policy);
+
+            /*! \fn void push(const QueueEntry& entry);
+                \brief Adds an upload, or moves an upload that is already queued to its new position. O(log n)
+            */
+            void push(const QueueEntry& entry);
+
+            /*! \fn QueueEntry pop();
+                \brief Removes the next upload. O(log n)
+                \return Returns the removed upload
+            */
+            QueueEntry pop();
+
+            /*! \fn bool remove(unsigned int upload_id);
+                \brief Removes an upload from any position in the heap. O(log n)
+                \return Returns false if the upload is not queued
+            */
+            bool remove(unsigned int upload_id);
+
+            /*! \fn const QueueEntry& top() const;
+                \return Returns the next upload. The heap must not be empty
+            */
+            const QueueEntry& top() const { return m_entries.front(); }
+
+            bool contains(unsigned int upload_id) const { return m_index.count(upload_id) > 0; }
+            bool empty() const { return m_entries.empty(); }
+            size_t size() const { return m_entries.size(); }
+            void clear();
+
+            std::shared_ptr<SchedulePolicy> get_policy() const { return m_policy; }
+
+        private:
+            std::vector<QueueEntry> m_entries;
+            std::unordered_map<unsigned int, size_t> m_index; //Position of every upload in m_entries
+            std::shared_ptr<SchedulePolicy> m_policy;
+
+            /*! \fn bool is_before(const QueueEntry& a, const QueueEntry& b) const;
+                \return Returns true if a is uploaded before b. Uploads the policy can not order are taken in the order they were queued
+            */
+            bool is_before(const QueueEntry& a, const QueueEntry& b) const;
+
+            void sift_up(size_t pos);
+            void sift_down(size_t pos);
+            void swap_entries(size_t a, size_t b);
+
+    };
+
+}
+
+#endif // UPLOADHEAP_H
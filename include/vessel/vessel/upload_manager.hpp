@@ -4,11 +4,24 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <chrono>
+#include <algorithm>
+#include <set>
+#include <sstream>
 
 #include <vessel/vessel/vessel_exception.hpp>
 #include <vessel/filesystem/file.hpp>
 #include <vessel/filesystem/file_upload.hpp>
+#include <vessel/filesystem/file_pack.hpp>
+#include <vessel/filesystem/chunker.hpp>
+#include <vessel/filesystem/chunk_index.hpp>
+#include <vessel/filesystem/file_delta.hpp>
+#include <vessel/filesystem/local_store.hpp>
+#include <vessel/filesystem/repository_index.hpp>
+#include <vessel/filesystem/delete_journal.hpp>
 #include <vessel/vessel/queue_manager.hpp>
+#include <vessel/vessel/part_sizer.hpp>
+#include <vessel/vessel/provider_selector.hpp>
 #include <vessel/aws/aws_s3_client.hpp>
 #include <vessel/azure/azure_client.hpp>
 #include <vessel/vessel/vessel_client.hpp>
@@ -23,16 +36,84 @@ namespace Vessel
     class UploadInterface
     {
         public:
-            UploadInterface();
+            UploadInterface(const StorageProvider& provider);
             virtual void upload_file(FileUpload& upload) {}
             virtual void resume_uploads() {}
             virtual void complete_upload() {}
+            virtual void upload_pack(FilePack& pack) {}
+            virtual bool supports_packing() { return false; }
+            virtual bool supports_batching() { return false; }
+            virtual bool supports_copy() { return false; }
+
+            /*! \fn virtual bool supports_dedup();
+                \return Returns true if the service stores each content once itself, copies of uploaded content are then not registered as references
+            */
+            virtual bool supports_dedup() { return false; }
+
+            /*! \fn virtual bool copy_file(FileUpload& upload, const MovedFile& moved);
+                \brief Stores a moved or renamed file by copying the object of its old path on the provider, the content is not sent again
+                \return Returns false if the provider no longer holds the object of the old path
+            */
+            virtual bool copy_file(FileUpload& upload, const MovedFile& moved) { return false; }
+
+            /*! \fn virtual size_t get_delete_batch_size();
+                \return Returns the most objects removed with one request, or 0 if the service does not remove objects
+            */
+            virtual size_t get_delete_batch_size() { return 0; }
+
+            /*! \fn virtual std::vector<unsigned long> remove_files(const std::vector<DeletedFile>& files);
+                \brief Removes the objects of deleted files from the provider, with one request if the provider supports it
+                \return Returns the journal ids of the files whose objects were removed or no longer exist
+            */
+            virtual std::vector<unsigned long> remove_files(const std::vector<DeletedFile>& files) { return std::vector<unsigned long>(); }
+
+            /*! \fn bool add_reference(const BackupFile& file, const std::string& hash);
+                \brief Registers a file whose content has already been uploaded with the Vessel API
+                \return Returns false if the content must be uploaded
+            */
+            bool add_reference(const BackupFile& file, const std::string& hash);
+
+            /*! \fn std::set<unsigned int> register_uploads(std::vector<FileUpload>& uploads);
+                \brief Registers the uploads that have no Vessel upload id with a single API request and stores the ids in backup_upload.
+                Uploads that could not be registered are registered on their own when they are uploaded
+                \return Returns the ids of the uploads whose content was sent inline and stored by the Vessel API
+            */
+            std::set<unsigned int> register_uploads(std::vector<FileUpload>& uploads);
+
+            /*! \fn bool can_inline(const BackupFile& file);
+                \return Returns true if the file is sent inline with its batch registration instead of being uploaded or packed
+            */
+            bool can_inline(const BackupFile& file);
+
+            /*! \fn virtual void flush_completions();
+                \brief Marks the finished uploads as completed with the Vessel API
+            */
+            virtual void flush_completions();
 
         protected:
             std::shared_ptr<VesselClient> get_vessel_client();
+            const StorageProvider& get_provider() const { return m_provider; }
+
+            /*! \fn bool should_compress(const BackupFile& file);
+                \return Returns true if compress_transfer is enabled and the file type is not already compressed
+            */
+            bool should_compress(const BackupFile& file);
+
+            /*! \fn std::shared_ptr<FileCipher> get_cipher(FileUpload& upload, bool resume);
+                \brief A resumed upload keeps the key it was started with. A new upload gets a new key if encrypt_transfer is enabled
+                \return Returns the cipher for the upload, or an empty pointer if the upload is not encrypted
+            */
+            std::shared_ptr<FileCipher> get_cipher(FileUpload& upload, bool resume);
+
+            /*! \fn void queue_completion(FileUpload& upload, bool compressed, bool encrypted);
+                \brief Queues the completion of an upload, it is sent with the next batch
+            */
+            void queue_completion(FileUpload& upload, bool compressed, bool encrypted);
 
         private:
+            StorageProvider m_provider;
             std::shared_ptr<VesselClient> m_vessel;
+            std::string m_tenant_key; //Read from the tenant key file on first use
 
     };
 
@@ -41,15 +122,31 @@ namespace Vessel
 
         public:
 
-            VesselUpload();
+            VesselUpload(const StorageProvider& provider);
 
-            virtual void upload_file();
-            virtual void resume_uploads();
-            virtual void complete_upload();
+            void upload_file(FileUpload& upload);
+            void resume_uploads();
+            void complete_upload();
 
         private:
             std::shared_ptr<LocalDatabase> m_database;
 
+            /*! \fn bool upload_delta(BackupFile& file, const std::string& signature_path);
+                \brief Sends the delta of a file against the signature of its last backup
+                \return Returns false if there is no usable signature or the server could not apply the delta
+            */
+            bool upload_delta(BackupFile& file, const std::string& signature_path);
+
+            /*! \fn static std::string get_signature_path(const BackupFile& file);
+                \return Returns the local path of the block signature of a file
+            */
+            static std::string get_signature_path(const BackupFile& file);
+
+            /*! \fn static bool is_delta_candidate(const BackupFile& file);
+                \return Returns true if the file is large enough to keep a block signature
+            */
+            static bool is_delta_candidate(const BackupFile& file);
+
     };
 
     class AwsUpload : public UploadInterface
@@ -57,11 +154,18 @@ namespace Vessel
 
         public:
 
-            AwsUpload();
+            AwsUpload(const StorageProvider& provider);
 
             void upload_file(FileUpload& upload);
             void resume_uploads();
             void complete_upload();
+            void upload_pack(FilePack& pack);
+            bool copy_file(FileUpload& upload, const MovedFile& moved);
+            std::vector<unsigned long> remove_files(const std::vector<DeletedFile>& files);
+            size_t get_delete_batch_size() { return AWS_DELETE_MAX_KEYS; }
+            bool supports_packing() { return true; }
+            bool supports_batching() { return true; }
+            bool supports_copy() { return true; }
 
         private:
             std::shared_ptr<LocalDatabase> m_database;
@@ -69,6 +173,12 @@ namespace Vessel
 
             std::string init_upload(const BackupFile& file);
 
+            /*! \fn bool resume_upload(FileUpload& upload);
+                \brief Reconciles the stored parts of an interrupted multipart upload with ListParts
+                \return Returns false if the upload must start over
+            */
+            bool resume_upload(FileUpload& upload);
+
     };
 
     class AzureUpload : public UploadInterface
@@ -76,17 +186,168 @@ namespace Vessel
 
         public:
 
-            AzureUpload();
+            AzureUpload(const StorageProvider& provider);
 
             void upload_file(FileUpload& upload);
             void resume_uploads();
             void complete_upload();
+            void upload_pack(FilePack& pack);
+            bool copy_file(FileUpload& upload, const MovedFile& moved);
+            std::vector<unsigned long> remove_files(const std::vector<DeletedFile>& files);
+            size_t get_delete_batch_size() { return AZURE_BATCH_MAX_BLOBS; }
+            bool supports_packing() { return true; }
+            bool supports_batching() { return true; }
+            bool supports_copy() { return true; }
 
         private:
             std::shared_ptr<LocalDatabase> m_database;
             std::shared_ptr<AzureClient> m_client;
 
-            void init_upload(const BackupFile& file);
+            std::string init_upload(const BackupFile& file);
+
+            /*! \fn bool resume_upload(FileUpload& upload);
+                \brief Reconciles the stored blocks of an interrupted block upload with Get Block List
+                \return Returns false if the upload must start over
+            */
+            bool resume_upload(FileUpload& upload);
+
+    };
+
+    class LocalUpload : public UploadInterface
+    {
+
+        public:
+
+            LocalUpload(const StorageProvider& provider);
+            ~LocalUpload();
+
+            void upload_file(FileUpload& upload);
+            void upload_pack(FilePack& pack);
+            bool copy_file(FileUpload& upload, const MovedFile& moved);
+            std::vector<unsigned long> remove_files(const std::vector<DeletedFile>& files);
+            size_t get_delete_batch_size() { return LOCAL_DELETE_BATCH; }
+            bool supports_packing() { return true; }
+            bool supports_copy() { return true; }
+
+            /*! \fn void flush_completions();
+                \brief Syncs the objects of the batch before their uploads are completed, if local_fsync is batch
+            */
+            void flush_completions();
+
+        private:
+
+            struct PendingCompletion
+            {
+                FileUpload upload;
+                bool encrypted;
+            };
+
+            std::unique_ptr<LocalStore> m_store;
+            std::string m_user_id;
+            std::vector<PendingCompletion> m_pending; //Stored objects that are not synced yet
+
+            /*! \fn std::string get_object_key(const std::string& parent_path, const std::string& file_name);
+                \return Returns the path of an object relative to the storage path, laid out like the keys of the cloud providers
+            */
+            std::string get_object_key(const std::string& parent_path, const std::string& file_name);
+
+            /*! \fn void complete(FileUpload& upload, bool encrypted);
+                \brief Queues the completion of an upload, or holds it until the next sync in batch mode
+            */
+            void complete(FileUpload& upload, bool encrypted);
+
+            /*! \fn void sync_pending();
+                \brief Syncs the stored objects and queues the completions held for them
+            */
+            void sync_pending();
+
+            /*! \fn void requeue_pending();
+                \brief Queues the files of the held completions again, their objects may not be durable
+            */
+            void requeue_pending();
+
+    };
+
+    /*! \class RepositoryUpload
+        \brief Stores files in a content-addressable pack repository instead of one object per file.
+
+        Files are split in content-defined chunks (blobs) named by their SHA-256 hash. New blobs are appended
+        to packs, a blob already held by the repository is not stored again. Objects under <prefix>/repository:
+
+            data/<2 hex>/<pack hash>   Immutable FilePack holding blobs, named by the SHA-1 hash of its contents
+            index/<sha256>             Blob locations: "vessel-index 1", then per pack "pack <hash>" followed by
+                                       "blob <sha256> <offset> <length>" lines
+            snapshots/<sha256>         Manifest of the backup: "vessel-snapshot 1", "time <unix>", then per file
+                                       "file <size> <modified> <sha1> <path>" followed by its "blob <sha256> <length>" lines
+
+        A snapshot lists every file backed up to the provider, so a backup is listed by reading one manifest.
+        The index objects can be rebuilt from the pack footers. Uploads are completed with the Vessel API once
+        the packs holding their blobs are stored.
+
+        Enabled with repository_format set to packs, for AWS S3, Azure Blob and local providers. Packs, index and
+        snapshot objects are not encrypted, while encrypt_transfer is enabled files are stored one object per file.
+    */
+    class RepositoryUpload : public UploadInterface
+    {
+
+        public:
+
+            RepositoryUpload(const StorageProvider& provider);
+            ~RepositoryUpload();
+
+            void upload_file(FileUpload& upload);
+
+            /*! \fn void complete_upload();
+                \brief Stores the open pack, the index of the new blobs and a snapshot manifest
+            */
+            void complete_upload();
+            bool supports_dedup() { return true; }
+
+            /*! \fn static bool is_enabled();
+                \return Returns true if repository_format is packs and encrypt_transfer is disabled
+            */
+            static bool is_enabled();
+
+        private:
+            std::shared_ptr<AwsS3Client> m_aws;
+            std::shared_ptr<AzureClient> m_azure;
+            std::unique_ptr<LocalStore> m_store;
+            std::unique_ptr<RepositoryIndex> m_index;
+            std::unique_ptr<FilePack> m_pack;
+            std::string m_user_id;
+            std::vector<FileUpload> m_pending; //Uploads with blobs in the open pack
+            std::ostringstream m_index_content; //Blob locations not stored in an index object yet
+            size_t m_index_blobs;
+
+            /*! \fn void flush_pack();
+                \brief Stores the open pack and completes the uploads waiting for it. Throws if the pack could not be stored
+            */
+            void flush_pack();
+
+            /*! \fn void write_index();
+                \brief Stores the locations of the blobs added since the last index object
+            */
+            void write_index();
+
+            /*! \fn void write_snapshot();
+                \brief Stores the manifest of the files backed up to the provider
+            */
+            void write_snapshot();
+
+            /*! \fn void put_object(const std::string& object_key, const std::string& local_path);
+                \brief Stores a local file as an object of the repository. Throws on failure
+            */
+            void put_object(const std::string& object_key, const std::string& local_path);
+
+            /*! \fn void put_data(const std::string& object_key, const std::string& data);
+                \brief Stores data as an object of the repository. Throws on failure
+            */
+            void put_data(const std::string& object_key, const std::string& data);
+
+            /*! \fn std::string get_object_key(const std::string& dir, const std::string& name);
+                \return Returns the object key of a repository object, under the path the provider stores files at
+            */
+            std::string get_object_key(const std::string& dir, const std::string& name);
 
     };
 
@@ -94,24 +355,93 @@ namespace Vessel
     {
 
         public:
-            UploadManager(const StorageProvider& provider);
+            /*! \fn UploadManager(const std::vector<StorageProvider>& providers);
+                \param providers Storage providers, highest priority first
+            */
+            UploadManager(const std::vector<StorageProvider>& providers);
             ~UploadManager();
 
             void run_uploader();
 
+            /*! \fn void run_retention();
+                \brief Removes the objects of files deleted longer than delete_retention_days ago from the providers, in batches.
+                Every batch is written to the delete journal before it is sent and removed from it once the provider confirmed it
+            */
+            void run_retention();
+
         protected:
 
-            /*! \fn std::shared_ptr<UploadInterface> get_upload_service(const std::string& provider_type);
-                \brief Returns upload service interface for a given provider type
-                \return Returns upload service interface for a given provider type
+            /*! \fn std::shared_ptr<UploadInterface> get_upload_service(const StorageProvider& provider);
+                \brief The services are kept for the whole run, so their connections and signing keys are reused
+                \return Returns upload service interface for a given provider
             */
-            std::shared_ptr<UploadInterface> get_upload_service(const std::string& provider_type);
+            std::shared_ptr<UploadInterface> get_upload_service(const StorageProvider& provider);
 
         private:
-            StorageProvider m_provider;
+            std::vector<StorageProvider> m_providers;
+            StorageProvider m_provider; //Provider of the current uploads
             std::shared_ptr<UploadInterface> m_service;
+            std::shared_ptr<CircuitBreaker> m_breaker;
+            std::unique_ptr<ProviderSelector> m_selector;
+            std::map<std::string, std::shared_ptr<UploadInterface>> m_services;
+
+            std::unique_ptr<FilePack> m_pack;
+
+            /*! \fn bool prepare_upload(FileUpload& upload, QueueManager& manager);
+                \brief Validates a queued file and handles the files that are not uploaded on their own (purged, deduplicated, packed or chunked)
+                \return Returns true if the file must be uploaded by the provider service
+            */
+            bool prepare_upload(FileUpload& upload, QueueManager& manager);
+
+            /*! \fn void upload_file(FileUpload& upload, QueueManager& manager);
+                \brief Uploads a file with the provider service and removes it from the queue on success
+            */
+            void upload_file(FileUpload& upload, QueueManager& manager);
+
+            /*! \fn bool pack_file(FileUpload& upload);
+                \brief Adds a small file to the current pack instead of uploading it on its own
+                \return Returns true if the file was packed
+            */
+            bool pack_file(FileUpload& upload);
+
+            /*! \fn bool chunk_file(FileUpload& upload);
+                \brief Splits a large file in content-defined chunks and packs the chunks that have not been uploaded yet, followed by the file recipe
+                \return Returns true if the file was chunked
+            */
+            bool chunk_file(FileUpload& upload);
+
+            /*! \fn bool dedup_file(FileUpload& upload, BackupFile& file);
+                \brief Skips the upload of content that has already been backed up. Unchanged files only update their backup time, copies are registered as references to the uploaded content
+                \return Returns true if no content needs to be uploaded
+            */
+            bool dedup_file(FileUpload& upload, BackupFile& file);
+
+            /*! \fn bool move_file(FileUpload& upload, BackupFile& file);
+                \brief Detects a moved or renamed file by its size, modified time and content hash, and has the provider copy the object of its old path
+                \return Returns true if the file was copied and no content needs to be uploaded
+            */
+            bool move_file(FileUpload& upload, BackupFile& file);
 
-            void cleanup_service();
+            /*! \fn void use_provider(const StorageProvider& provider);
+                \brief Sends the next uploads to a provider
+            */
+            void use_provider(const StorageProvider& provider);
+
+            /*! \fn bool route_upload(FileUpload& upload, StorageProvider& provider);
+                \brief Finds the provider of an upload. Started uploads are completed by the provider holding their parts
+                \return Returns false if the upload must wait for its provider to recover
+            */
+            bool route_upload(FileUpload& upload, StorageProvider& provider);
+
+            /*! \fn void wait_for_provider();
+                \brief Switches to another provider, or pauses the uploads while the circuit breaker of every provider is open
+            */
+            void wait_for_provider();
+
+            /*! \fn void flush_pack();
+                \brief Uploads the current pack and marks the packed files as backed up
+            */
+            void flush_pack();
 
     };
 }
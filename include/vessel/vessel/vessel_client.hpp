@@ -4,6 +4,8 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <fstream>
+#include <iterator>
 #include <vector>
 #include <map>
 #include <boost/array.hpp>
@@ -33,9 +35,14 @@
 #include <vessel/log/log.hpp>
 #include <vessel/network/http_client.hpp>
 #include <vessel/vessel/vessel_exception.hpp>
+#include <vessel/crypto/file_cipher.hpp>
 
 //#define BOOST_NETWORK_ENABLE_HTTPS 1
 
+#define VESSEL_BATCH_SZ 100 //Default number of uploads registered or completed per API request if not defined in DB
+#define VESSEL_INLINE_MAX_SZ 4096 //Default size in bytes of the largest file sent inline with its registration if not defined in DB
+#define VESSEL_STREAM_CHUNK_SZ 1048576 //Bytes of a file or delta read into the request body at a time (1MB)
+
 using boost::asio::ip::tcp;
 using boost::asio::deadline_timer;
 
@@ -44,6 +51,7 @@ using namespace Vessel::Types;
 using namespace Vessel::File;
 using namespace Vessel::Database;
 using namespace Vessel::Logging;
+using namespace Vessel::Compression;
 using namespace rapidjson;
 
 namespace ssl = boost::asio::ssl;
@@ -66,10 +74,59 @@ namespace Vessel {
                 */
                 std::string init_upload( const Vessel::File::BackupFile& bf );
 
-                /*! \fn void complete_upload( const std::string& upload_id );
+                /*! \fn std::vector<UploadRegistration> init_uploads( std::vector<BackupFile>& files );
+                    \brief Initializes the uploads of many files with a single request. Files are registered one by one if the API does not support batches.
+                    Tiny files are sent gzip compressed with their registration and stored by the API
+                    \return Returns the registration of each file, in the order of the files. The upload id of a file that was rejected is empty
+                */
+                std::vector<UploadRegistration> init_uploads( std::vector<BackupFile>& files );
+
+                /*! \fn bool can_inline( const BackupFile& bf );
+                    \return Returns true if the file is small enough to be sent inline with its registration. Encrypted backups are never sent inline
+                */
+                bool can_inline( const BackupFile& bf );
+
+                /*! \fn void queue_completion( const std::string& upload_id, bool compressed = false, bool encrypted = false );
+                    \brief Records a finished upload in the local database. It is marked as completed with the next call to complete_uploads
+                */
+                void queue_completion( const std::string& upload_id, bool compressed = false, bool encrypted = false );
+
+                /*! \fn int complete_uploads();
+                    \brief Marks the queued uploads as completed, vessel_batch_size uploads per request.
+                    Uploads stay queued if the request fails, uploads rejected by the API are dropped
+                    \return Returns the number of completed uploads
+                */
+                int complete_uploads();
+
+                /*! \fn void complete_upload( const std::string& upload_id, bool compressed = false, bool encrypted = false );
                     \brief Marks an upload as completed via the Vessel API
+                    \param compressed The object was stored gzip encoded
+                    \param encrypted The object was encrypted on the client, the wrapped key is stored with the object
+                */
+                void complete_upload( const std::string& upload_id, bool compressed = false, bool encrypted = false );
+
+                /*! \fn void add_pack_files( const std::string& upload_id, const std::vector<PackEntry>& entries );
+                    \brief Registers the files stored in a pack with the Vessel API. The upload id is the upload of the pack object
+                */
+                void add_pack_files( const std::string& upload_id, const std::vector<PackEntry>& entries );
+
+                /*! \fn bool add_file_reference( const BackupFile& bf, const std::string& hash );
+                    \brief Registers a file whose content has already been uploaded. The file points to the stored copy and no content is sent
+                    \return Returns false if no uploaded file with the same content hash was found
+                */
+                bool add_file_reference( const BackupFile& bf, const std::string& hash );
+
+                /*! \fn void upload_file( BackupFile& bf );
+                    \brief Sends the entire file to the Vessel storage server
+                */
+                void upload_file( BackupFile& bf );
+
+                /*! \fn bool upload_delta( BackupFile& bf, const std::string& base_hash, const std::string& delta_path );
+                    \brief Sends the delta of a file against the version stored on the Vessel storage server
+                    \param base_hash SHA-1 hash of the stored version the delta was computed against
+                    \return Returns false if the stored version does not match the base hash and the entire file must be sent
                 */
-                void complete_upload( const std::string& upload_id );
+                bool upload_delta( BackupFile& bf, const std::string& base_hash, const std::string& delta_path );
 
                 /*! \fn upload_file_part( Vessel::File::BackupFile * bf, int part_number );
                     \brief Sends part of a file (or the entire file) to the server with metadata
@@ -102,11 +159,21 @@ namespace Vessel {
                 void install_client();
 
                 /*! \fn StorageProvider get_storage_provider();
-                    \brief Returns the highest priority storage provider
-                    \return Returns the highest priority storage provider
+                    \brief Returns the storage provider set with use_storage_provider, or the highest priority storage provider
+                    \return Returns the storage provider uploads are registered with
                 */
                 StorageProvider get_storage_provider();
 
+                /*! \fn std::vector<StorageProvider> get_storage_providers();
+                    \return Returns all storage providers, highest priority first. Throws a VesselException if there are none
+                */
+                std::vector<StorageProvider> get_storage_providers();
+
+                /*! \fn void use_storage_provider(const std::string& provider_id);
+                    \brief Registers the uploads of this client with a storage provider instead of the highest priority one
+                */
+                void use_storage_provider(const std::string& provider_id);
+
                 /*! \fn void set_client_token();
                     \brief Refreshes the client token from the database
                 */
@@ -119,11 +186,30 @@ namespace Vessel {
 
                 std::string get_auth_header(const std::string& token, const std::string& user_id);
 
+                /*! \fn void write_upload_file( Writer<StringBuffer>& writer, const BackupFile& bf );
+                    \brief Writes the file fields of an upload registration
+                */
+                void write_upload_file( Writer<StringBuffer>& writer, const BackupFile& bf );
+
+                /*! \fn std::vector<UploadCompletion> get_pending_completions( int limit );
+                    \return Returns the oldest queued upload completions
+                */
+                std::vector<UploadCompletion> get_pending_completions( int limit );
+
+                void remove_completion( const std::string& upload_id );
+
+                /*! \fn void send_file_request( HttpRequest& request, const std::string& path );
+                    \brief Sends a request with the content of a file as its body, read VESSEL_STREAM_CHUNK_SZ bytes at a time.
+                    The request is sent again on a new connection if the server closed an idle connection
+                */
+                void send_file_request( HttpRequest& request, const std::string& path );
+
                 std::string m_auth_header;
                 std::string m_auth_token;
                 std::string m_client_token;
                 std::string m_api_path;
                 std::string m_user_id;
+                std::string m_provider_id; //Storage provider set with use_storage_provider
 
                 /*! \fn bool sync_storage_provider(const Value& obj);
                     \brief Syncs a single storage provider to the local database
@@ -33,8 +33,16 @@ class File extends Model
 			return $this->hasOne('App\AppClient', 'client_id', 'client_id');
 		}
 
+		public function pack() {
+			return $this->belongsTo('App\File', 'pack_id', 'file_id');
+		}
+
+		public function source() {
+			return $this->belongsTo('App\File', 'source_id', 'file_id');
+		}
+
 		protected $fillable = [
-			'file_id', 'file_name', 'file_path_id', 'file_type', 'file_size', 'hash', 'uploaded', 'encrypted', 'compressed', 'last_backup'
+			'file_id', 'file_name', 'file_path_id', 'file_type', 'file_size', 'hash', 'uploaded', 'encrypted', 'compressed', 'last_backup', 'pack_offset', 'pack_length', 'chunked', 'inline'
 		];
 
 		public function getKeyName() {
@@ -60,7 +68,7 @@ class File extends Model
 		public $primaryKey = 'file_id';
 		public $incrementing = false;
 		protected $table = 'file';
-		protected $uuids = ['user_id','file_path_id','provider_id','client_id'];
+		protected $uuids = ['user_id','file_path_id','provider_id','client_id','pack_id','source_id'];
 		protected $dates = ['created_at','updated_at','last_backup'];
 
 }
@@ -56,6 +56,7 @@ class StorageController extends Controller
 			$provider->storage_path = trim($request->input('storage_path'), "/\\");
 			$provider->region = $request->input('region');
 			$provider->priority = $request->input('priority');
+			$provider->weight = max( (int)$request->input('weight', 1), 1 );
 			$provider->description = $request->input('description');
 			$provider->save();
 
@@ -106,6 +107,7 @@ class StorageController extends Controller
 				$provider->storage_path = trim( $request->input('storage_path'), "/\\");
 				$provider->region = $request->input('region');
 				$provider->priority = $request->input('priority');
+				$provider->weight = max( (int)$request->input('weight', 1), 1 );
 				$provider->description = $request->input('description');
 				$provider->active = filter_var($request->input('active'), FILTER_VALIDATE_BOOLEAN);
 				$provider->save();
@@ -29,8 +29,9 @@ class AwsUploadController extends UploadController
 			$storageProvider = App\StorageProvider::withUuid($providerId)->firstOrFail();
 
 			$secret = $storageProvider->access_key; //Decrypted from DB automatically using application key
+			$region = empty($storageProvider->region) ? 'us-east-1' : $storageProvider->region; //S3-compatible servers without a region, same default as the client
 	    $keyDate = hash_hmac("sha256", $amzDate, ("AWS4" . $secret), true);
-	    $keyRegion = hash_hmac("sha256", $storageProvider->region, $keyDate, true);
+	    $keyRegion = hash_hmac("sha256", $region, $keyDate, true);
 	    $keyService = hash_hmac("sha256", "s3", $keyRegion, true);
 	    $keySigning = base64_encode(hash_hmac("sha256", "aws4_request", $keyService, true));
 
@@ -36,6 +36,64 @@ class AzureUploadController extends UploadController
 
 		}
 
+		/**
+		 * Issues a short-lived service SAS for the container of the provider, so the client can
+		 * upload blobs and blocks without sending every StringToSign to the API
+		 */
+		public function getSas(Request $request)
+		{
+
+			$providerId = $request->input('providerId');
+
+			if ( empty($providerId) ) {
+				return response()->json(['error' => 'Invalid provider id'], 400);
+			}
+
+			$storageProvider = App\StorageProvider::withUuid($providerId)->firstOrFail();
+			$sharedKey = base64_decode($storageProvider->access_key);
+
+			//Lifetime is capped, the client refreshes the token before it expires
+			$lifetime = min( max( (int)$request->input('expiresIn', 3600), 300 ), 3600 );
+
+			$version = '2018-03-28';
+			$permissions = 'rcwd'; //Read (Get Block List), create and write blobs and blocks, delete blobs of deleted files
+			$start = gmdate('Y-m-d\TH:i:s\Z', time() - 300); //Allow for clock skew between the client and Azure
+			$expiry = gmdate('Y-m-d\TH:i:s\Z', time() + $lifetime);
+			$resource = '/blob/' . $storageProvider->access_id . '/' . $storageProvider->bucket_name;
+
+			//https://docs.microsoft.com/en-us/rest/api/storageservices/create-service-sas
+			$stringToSign = implode("\n", [
+				$permissions,
+				$start,
+				$expiry,
+				$resource,
+				'', //Signed identifier
+				'', //Signed IP
+				'https',
+				$version,
+				'', //Cache-Control
+				'', //Content-Disposition
+				'', //Content-Encoding
+				'', //Content-Language
+				'' //Content-Type
+			]);
+
+			$signature = base64_encode(hash_hmac("sha256", $stringToSign, $sharedKey, true));
+
+			$sas = http_build_query([
+				'sv' => $version,
+				'sr' => 'c',
+				'sp' => $permissions,
+				'st' => $start,
+				'se' => $expiry,
+				'spr' => 'https',
+				'sig' => $signature
+			], '', '&', PHP_QUERY_RFC3986);
+
+			return response()->json(['sas' => $sas, 'expiresIn' => $lifetime]);
+
+		}
+
 		/**
 		 * Display a listing of the resource.
 		 *
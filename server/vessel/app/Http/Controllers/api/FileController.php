@@ -8,6 +8,88 @@ use App\Http\Controllers\Controller;
 
 class FileController extends Controller
 {
+		/**
+		 * Registers a file whose content has already been uploaded. The file points to the
+		 * stored copy, so nothing is uploaded
+		 */
+		public function addReference(Request $request)
+		{
+
+			$client = App\AppClient::where('token', $request->bearerToken() )->first();
+
+			if ( !$client ) {
+				return response()->json(['error' => 'Bad client'], 400);
+			}
+
+			$user = App\User::where(['user_name' => $request->input('user_name')])->first();
+
+			if ( !$user ) {
+				return response()->json(['error' => 'User could not be found'], 400);
+			}
+
+			$storageProvider = App\StorageProvider::withUuid($request->input('storage_provider_id'))->first();
+
+			if ( !$storageProvider ) {
+				return response()->json(['error' => 'Invalid storage provider'], 400);
+			}
+
+			//Find an uploaded copy of the content
+			$fileHash = hex2bin( $request->input('hash') );
+			$source = App\File::where(['hash' => $fileHash, 'user_id' => $user->user_id, 'provider_id' => $storageProvider->provider_id])
+				->where(function ($query) {
+					$query->where('uploaded', true)->orWhereHas('uploads', function ($upload) {
+						$upload->where('uploaded', true);
+					});
+				})->first();
+
+			if ( !$source ) {
+				return response()->json(['error' => 'No uploaded file with the same content'], 404);
+			}
+
+			//References always point to the file holding the content
+			if ( $source->source_id ) {
+				$source = $source->source;
+			}
+
+			//Create or find the file path
+			$fpHashRaw = sha1( $request->input('file_path'), true );
+			$filePath = App\FilePath::where(['hash' => $fpHashRaw, 'user_id' => $user->user_id])->first();
+
+			if ( !$filePath ) {
+				$filePath = new App\FilePath;
+				$filePath->user_id = $user->user_id;
+				$filePath->file_path = $request->input('file_path');
+				$filePath->hash = $fpHashRaw;
+				$filePath->save();
+			}
+
+			$file = App\File::firstOrNew(['file_path_id' => $filePath->path_id, 'user_id' => $user->user_id, 'file_name' => $request->input('file_name')]);
+
+			//The file is its own source when the content did not change
+			if ( $file->exists && $file->file_id_text == $source->file_id_text ) {
+				return response()->json(['file' => $file]);
+			}
+
+			$file->user_id = $user->user_id;
+			$file->client_id = $client->client_id;
+			$file->file_name = $request->input('file_name');
+			$file->file_path_id = $filePath->path_id;
+			$file->file_type = $request->input('file_type');
+			$file->file_size = $request->input('file_size');
+			$file->hash = $fileHash;
+			$file->provider_id = $source->provider_id;
+			$file->source_id = $source->file_id;
+			$file->pack_id = $source->pack_id;
+			$file->pack_offset = $source->pack_offset;
+			$file->pack_length = $source->pack_length;
+			$file->chunked = $source->chunked;
+			$file->uploaded = true;
+			$file->save();
+
+			return response()->json(['file' => $file]);
+
+		}
+
     /**
      * Display a listing of the resource.
      *
@@ -5,6 +5,7 @@ namespace App\Http\Controllers\api;
 use App;
 use Illuminate\Http\Request;
 use App\Http\Controllers\Controller;
+use Storage;
 
 class UploadController extends Controller
 {
@@ -33,9 +34,163 @@ class UploadController extends Controller
 				return response()->json(['error' => 'Invalid storage provider'], 400);
 			}
 
+			$result = $this->registerUpload($client, $user, $storageProvider, $request->all());
+
+			if ( is_string($result) ) {
+				return response()->json(['error' => $result], 400);
+			}
+
+			list($file, $upload) = $result;
+
+			return response()->json([
+				'file' => $file,
+				'upload' => $upload
+			]);
+
+		}
+
+		/**
+		 * Registers the uploads of many files with a single request. Every file is registered on its own,
+		 * a rejected file does not fail the batch
+		 */
+		public function initUploads(Request $request)
+		{
+
+			$client = App\AppClient::where('token', $request->bearerToken() )->first();
+
+			if ( !$client ) {
+				return response()->json(['error' => 'Bad client'], 400);
+			}
+
+			$user = App\User::where(['user_name' => $request->input('user_name')])->first();
+
+			if ( !$user ) {
+				return response()->json(['error' => 'User could not be found'], 400);
+			}
+
+			$storageProvider = App\StorageProvider::withUuid($request->input('storage_provider_id'))->first();
+
+			if ( !$storageProvider ) {
+				return response()->json(['error' => 'Invalid storage provider'], 400);
+			}
+
+			$uploads = [];
+
+			foreach ( $request->input('files', []) as $index => $entry ) {
+
+				try {
+					$result = $this->registerUpload($client, $user, $storageProvider, $entry);
+				}
+				catch ( \Exception $e ) {
+					$result = 'Unable to register file';
+				}
+
+				if ( is_string($result) ) {
+					$uploads[] = ['index' => $index, 'error' => $result];
+					continue;
+				}
+
+				list($file, $upload) = $result;
+
+				//Tiny files are sent with their registration and stored on the Vessel server
+				$stored = isset($entry['content']) && $this->storeInline($file, $upload, $entry);
+
+				$uploads[] = ['index' => $index, 'upload_id' => $upload->upload_id_text, 'stored' => $stored];
+
+			}
+
+			return response()->json(['uploads' => $uploads]);
+
+		}
+
+		/**
+		 * Marks many uploads of the client as completed with a single request
+		 */
+		public function completeUploads(Request $request)
+		{
+
+			$client = App\AppClient::where('token', $request->bearerToken() )->first();
+
+			if ( !$client ) {
+				return response()->json(['error' => 'Bad client'], 400);
+			}
+
+			$completed = [];
+			$failed = [];
+
+			foreach ( $request->input('uploads', []) as $entry ) {
+
+				$uploadId = isset($entry['upload_id']) ? $entry['upload_id'] : '';
+
+				try {
+					$fileUpload = App\FileUpload::withUuid($uploadId)->first();
+				}
+				catch ( \Exception $e ) {
+					$fileUpload = null; //Not a valid uuid
+				}
+
+				if ( !$fileUpload || $fileUpload->client_id_text != $client->client_id_text ) {
+					$failed[] = ['upload_id' => $uploadId, 'error' => 'Invalid upload'];
+					continue;
+				}
+
+				$this->markUploaded($fileUpload, true, !empty($entry['compressed']), !empty($entry['encrypted']));
+				$completed[] = $uploadId;
+
+			}
+
+			return response()->json(['completed' => $completed, 'failed' => $failed]);
+
+		}
+
+		/**
+		 * Stores the inline content of a tiny file by its hash and marks the upload as completed.
+		 * Content that does not match the registered hash is not stored, the client uploads the file instead
+		 */
+		protected function storeInline($file, $upload, array $entry)
+		{
+
+			$content = base64_decode($entry['content'], true);
+
+			if ( $content === false ) {
+				return false;
+			}
+
+			if ( isset($entry['content_encoding']) && $entry['content_encoding'] == 'gzip' ) {
+				$content = @gzdecode($content);
+
+				if ( $content === false ) {
+					return false;
+				}
+			}
+
+			if ( sha1($content) !== strtolower($entry['hash']) ) {
+				return false;
+			}
+
+			Storage::disk('vessel')->put('inline/' . $file->user_id_text . '/' . sha1($content), $content);
+
+			$file->inline = true;
+			$file->uploaded = true;
+			$file->save();
+
+			$this->markUploaded($upload, true, false, false);
+
+			return true;
+
+		}
+
+		/**
+		 * Creates the file, its path and a new upload for a file of a user
+		 *
+		 * @return array|string The file and upload, or the reason the file was rejected
+		 */
+		protected function registerUpload($client, $user, $storageProvider, array $input)
+		{
+
 			//Create or find the file path
-			$fileHash = hex2bin( $request->input('hash') );
-			$fpHashRaw = sha1( $request->input('file_path'), true );
+			$fileHash = hex2bin( $input['hash'] );
+			$fpHashRaw = sha1( $input['file_path'], true );
 			$filePath = App\FilePath::where(['hash' => $fpHashRaw, 'user_id' => $user->user_id])->first();
 
 			//Create FilePath if it doesn't exist
@@ -46,45 +201,104 @@ class UploadController extends Controller
 				if ( $preventDuplicate ) {
 					$duplicate = App\File::where(['hash' => $fileHash, 'user_id' => $user->user_id, 'provider_id' => $storageProvider->provider_id])->first();
 					if ( $duplicate ) {
-						return response()->json(['error' => 'Duplicate file: File has already been uploaded'], 400);
+						return 'Duplicate file: File has already been uploaded';
 					}
 				}
 
 				$filePath = new App\FilePath;
 				$filePath->user_id = $user->user_id;
-				$filePath->file_path = $request->input('file_path');
+				$filePath->file_path = $input['file_path'];
 				$filePath->hash = $fpHashRaw;
 				$filePath->save();
 			}
 
 			//Create or get existing file
-			$file = App\File::firstOrNew(['file_path_id' => $filePath->path_id, 'user_id' => $user->user_id, 'file_name' => $request->input('file_name')]);
+			$file = App\File::firstOrNew(['file_path_id' => $filePath->path_id, 'user_id' => $user->user_id, 'file_name' => $input['file_name']]);
 
 			if ( !$file->exists ) {
 				$file->user_id = $user->user_id;
 				$file->client_id = $client->client_id;
-				$file->file_name = $request->input('file_name');
+				$file->file_name = $input['file_name'];
 				$file->file_path_id = $filePath->path_id;
-				$file->file_type = $request->input('file_type');
-				$file->file_size = $request->input('file_size');
+				$file->file_type = $input['file_type'];
+				$file->file_size = $input['file_size'];
 				$file->hash = $fileHash;
 				$file->provider_id = $storageProvider->provider_id;
 				$file->save();
 			}
-
 			//Add a new file upload
 			$upload = new App\FileUpload;
 			$upload->file_id = $file->file_id;
 			$upload->user_id = $user->user_id;
 			$upload->client_id = $client->client_id;
+			$upload->provider_id = $storageProvider->provider_id; //The file points to this provider once the upload completes
 			$upload->parts = 0;
 			$upload->total_bytes = $file->file_size;
 			$upload->hash = $fileHash;
 			$upload->save();
 
+			return [$file, $upload];
+
+		}
+
+		/**
+		 * Registers the files stored in a pack object. The upload is the upload of the pack itself.
+		 * For chunked files the pack range holds the chunk recipe of the file
+		 */
+		public function addPackFiles(Request $request, $id)
+		{
+
+			$client = App\AppClient::where('token', $request->bearerToken() )->first();
+
+			if ( !$client ) {
+				return response()->json(['error' => 'Bad client'], 400);
+			}
+
+			$packUpload = App\FileUpload::withUuid($id)->first();
+
+			if ( !$packUpload || $packUpload->client_id_text != $client->client_id_text ) {
+				return response()->json(['error' => 'Invalid pack upload'], 400);
+			}
+
+			$pack = $packUpload->file;
+			$files = $request->input('files', []);
+
+			foreach ( $files as $entry ) {
+
+				//Create or find the file path
+				$fpHashRaw = sha1( $entry['file_path'], true );
+				$filePath = App\FilePath::where(['hash' => $fpHashRaw, 'user_id' => $pack->user_id])->first();
+
+				if ( !$filePath ) {
+					$filePath = new App\FilePath;
+					$filePath->user_id = $pack->user_id;
+					$filePath->file_path = $entry['file_path'];
+					$filePath->hash = $fpHashRaw;
+					$filePath->save();
+				}
+
+				//Packed files point to the pack object and their byte range in it
+				$file = App\File::firstOrNew(['file_path_id' => $filePath->path_id, 'user_id' => $pack->user_id, 'file_name' => $entry['file_name']]);
+				$file->user_id = $pack->user_id;
+				$file->client_id = $client->client_id;
+				$file->file_name = $entry['file_name'];
+				$file->file_path_id = $filePath->path_id;
+				$file->file_type = $entry['file_type'];
+				$file->file_size = $entry['file_size'];
+				$file->hash = hex2bin( $entry['hash'] );
+				$file->provider_id = $pack->provider_id;
+				$file->pack_id = $pack->file_id;
+				$file->pack_offset = $entry['offset'];
+				$file->pack_length = $entry['length'];
+				$file->chunked = !empty($entry['chunked']);
+				$file->uploaded = true;
+				$file->save();
+
+			}
+
 			return response()->json([
-				'file' => $file,
-				'upload' => $upload
+				'pack' => $pack,
+				'total_files' => count($files)
 			]);
 
 		}
@@ -132,11 +346,34 @@ class UploadController extends Controller
     {
         //Get Upload from DB
 				$fileUpload = App\FileUpload::withUuid($id)->firstOrFail();
-				$fileUpload->uploaded = $request->input('uploaded');
-				$fileUpload->save();
+				$this->markUploaded($fileUpload, $request->input('uploaded'), $request->input('compressed', false), $request->input('encrypted', false));
 
     }
 
+		protected function markUploaded($fileUpload, $uploaded, $compressed, $encrypted)
+		{
+
+				$fileUpload->uploaded = $uploaded;
+				$fileUpload->compressed = $compressed;
+				$fileUpload->encrypted = $encrypted;
+				$fileUpload->save();
+
+				//The stored object is gzip encoded and must be decompressed on restore
+				//Encrypted objects can only be restored by a client holding the tenant key
+				if ( $fileUpload->file ) {
+					$fileUpload->file->compressed = $fileUpload->compressed;
+					$fileUpload->file->encrypted = $fileUpload->encrypted;
+
+					//The client failed over or shares its uploads, the latest version is held by the provider of this upload
+					if ( $uploaded && $fileUpload->provider_id ) {
+						$fileUpload->file->provider_id = $fileUpload->provider_id;
+					}
+
+					$fileUpload->file->save();
+				}
+
+		}
+
     /**
      * Remove the specified resource from storage.
      *
@@ -73,6 +73,102 @@ class VesselUploadController extends Controller
 
 		}
 
+		/**
+		* Rebuilds a file from the stored version and a delta sent by the client.
+		*
+		* Delta layout (integers are little endian):
+		*   "VESSDLT1", block size (4 bytes), new file size (8 bytes), then instructions:
+		*   'L' length (4 bytes) literal bytes
+		*   'C' first block (4 bytes) block count (4 bytes), copied from the stored version
+		*
+		* Responds with 409 when the stored version or the rebuilt file do not match the hashes
+		* sent by the client. The client then uploads the entire file.
+		*
+		* @return \Illuminate\Http\Response
+		*/
+		public function uploadDelta(Request $request, $filePath) {
+
+			$providerId = $request->header('X-Vessel-Storage-Provider');
+			$storageProvider = App\StorageProvider::withUuid($providerId)->firstOrFail();
+
+			$userId = $request->header('X-Vessel-User-Id');
+			$user = App\User::withUuid($userId)->firstOrFail();
+
+			$pathParts = pathinfo($filePath);
+			$fpHashRaw = sha1( $pathParts['dirname'], true );
+			$dbFilePath = App\FilePath::where(['hash' => $fpHashRaw, 'user_id' => $user->user_id])->first();
+
+			if ( !$dbFilePath || !Storage::disk('vessel')->exists($filePath) ) {
+				return response()->json(['error' => 'No stored version of the file'], 409);
+			}
+
+			$base = Storage::disk('vessel')->get($filePath);
+
+			if ( sha1($base) !== strtolower( $request->header('X-Vessel-Base-Hash') ) ) {
+				return response()->json(['error' => 'Stored version does not match the delta base'], 409);
+			}
+
+			$delta = $request->getContent();
+
+			if ( strlen($delta) < 20 || substr($delta, 0, 8) !== 'VESSDLT1' ) {
+				return response()->json(['error' => 'Invalid delta'], 400);
+			}
+
+			$header = unpack('VblockSize/PfileSize', substr($delta, 8, 12));
+			$blockSize = $header['blockSize'];
+			$fileContents = '';
+			$pos = 20;
+			$deltaLength = strlen($delta);
+
+			while ( $pos < $deltaLength ) {
+
+				$op = $delta[$pos];
+
+				if ( $op === 'L' ) {
+					$length = unpack('V', substr($delta, $pos + 1, 4))[1];
+					$fileContents .= substr($delta, $pos + 5, $length);
+					$pos += 5 + $length;
+				}
+				else if ( $op === 'C' ) {
+					$copy = unpack('Vblock/Vcount', substr($delta, $pos + 1, 8));
+					$fileContents .= substr($base, $copy['block'] * $blockSize, $copy['count'] * $blockSize);
+					$pos += 9;
+				}
+				else {
+					return response()->json(['error' => 'Invalid delta instruction'], 400);
+				}
+
+			}
+
+			$fileHash = sha1( $fileContents );
+
+			if ( strlen($fileContents) != $header['fileSize'] || $fileHash !== strtolower( $request->header('X-Vessel-Hash') ) ) {
+				return response()->json(['error' => 'Rebuilt file does not match the file hash'], 409);
+			}
+
+			Storage::disk('vessel')->put($filePath, $fileContents);
+
+			$file = App\File::where(['file_path_id' => $dbFilePath->path_id, 'user_id' => $user->user_id, 'file_name' => $pathParts['filename']])->first();
+
+			if ( !$file ) {
+				$file = new App\File;
+				$file->user_id = $user->user_id;
+				$file->file_name = $pathParts['filename'];
+				$file->file_path_id = $dbFilePath->path_id;
+				$file->provider_id = $storageProvider->provider_id;
+				$file->file_type = $pathParts['extension'];
+			}
+
+			$file->file_size = strlen($fileContents);
+			$file->hash = hex2bin($fileHash);
+			$file->uploaded = 1;
+			$file->last_backup = Carbon::now();
+			$file->save();
+
+			return response()->json(['result' => $file, 'delta_size' => $deltaLength]);
+
+		}
+
 		/**
 		* Initialize a multipart upload
 		*
@@ -0,0 +1,34 @@
+<?php
+
+use Illuminate\Support\Facades\Schema;
+use Illuminate\Database\Schema\Blueprint;
+use Illuminate\Database\Migrations\Migration;
+
+class AddPackToFileTable extends Migration
+{
+    /**
+     * Run the migrations.
+     *
+     * @return void
+     */
+    public function up()
+    {
+        Schema::table('file', function (Blueprint $table) {
+						$table->uuid('pack_id')->nullable()->index()->after('provider_id')->comment('File id of the pack object containing this file');
+						$table->unsignedBigInteger('pack_offset')->nullable()->after('pack_id')->comment('Byte offset of the file contents in the pack');
+						$table->unsignedBigInteger('pack_length')->nullable()->after('pack_offset')->comment('Length in bytes of the file contents in the pack');
+        });
+    }
+
+    /**
+     * Reverse the migrations.
+     *
+     * @return void
+     */
+    public function down()
+    {
+        Schema::table('file', function (Blueprint $table) {
+						$table->dropColumn(['pack_id', 'pack_offset', 'pack_length']);
+        });
+    }
+}
@@ -0,0 +1,32 @@
+<?php
+
+use Illuminate\Support\Facades\Schema;
+use Illuminate\Database\Schema\Blueprint;
+use Illuminate\Database\Migrations\Migration;
+
+class AddChunkedToFileTable extends Migration
+{
+    /**
+     * Run the migrations.
+     *
+     * @return void
+     */
+    public function up()
+    {
+        Schema::table('file', function (Blueprint $table) {
+						$table->boolean('chunked')->default(false)->after('pack_length')->comment('The pack range holds the chunk recipe of the file instead of its contents');
+        });
+    }
+
+    /**
+     * Reverse the migrations.
+     *
+     * @return void
+     */
+    public function down()
+    {
+        Schema::table('file', function (Blueprint $table) {
+						$table->dropColumn('chunked');
+        });
+    }
+}
@@ -0,0 +1,32 @@
+<?php
+
+use Illuminate\Support\Facades\Schema;
+use Illuminate\Database\Schema\Blueprint;
+use Illuminate\Database\Migrations\Migration;
+
+class AddSourceToFileTable extends Migration
+{
+    /**
+     * Run the migrations.
+     *
+     * @return void
+     */
+    public function up()
+    {
+        Schema::table('file', function (Blueprint $table) {
+						$table->uuid('source_id')->nullable()->index()->after('provider_id')->comment('File id of the uploaded file holding the same content');
+        });
+    }
+
+    /**
+     * Reverse the migrations.
+     *
+     * @return void
+     */
+    public function down()
+    {
+        Schema::table('file', function (Blueprint $table) {
+						$table->dropColumn('source_id');
+        });
+    }
+}
@@ -0,0 +1,32 @@
+<?php
+
+use Illuminate\Support\Facades\Schema;
+use Illuminate\Database\Schema\Blueprint;
+use Illuminate\Database\Migrations\Migration;
+
+class AddEncryptedToFileUploadTable extends Migration
+{
+    /**
+     * Run the migrations.
+     *
+     * @return void
+     */
+    public function up()
+    {
+        Schema::table('file_upload', function (Blueprint $table) {
+						$table->boolean('encrypted')->default(0)->after('compressed')->comment('The object was encrypted on the client with a per file key');
+        });
+    }
+
+    /**
+     * Reverse the migrations.
+     *
+     * @return void
+     */
+    public function down()
+    {
+        Schema::table('file_upload', function (Blueprint $table) {
+						$table->dropColumn('encrypted');
+        });
+    }
+}
@@ -0,0 +1,32 @@
+<?php
+
+use Illuminate\Support\Facades\Schema;
+use Illuminate\Database\Schema\Blueprint;
+use Illuminate\Database\Migrations\Migration;
+
+class AddInlineToFileTable extends Migration
+{
+    /**
+     * Run the migrations.
+     *
+     * @return void
+     */
+    public function up()
+    {
+        Schema::table('file', function (Blueprint $table) {
+						$table->boolean('inline')->default(false)->after('chunked')->comment('The content was sent with the registration and is stored on the Vessel server');
+        });
+    }
+
+    /**
+     * Reverse the migrations.
+     *
+     * @return void
+     */
+    public function down()
+    {
+        Schema::table('file', function (Blueprint $table) {
+						$table->dropColumn('inline');
+        });
+    }
+}
@@ -0,0 +1,32 @@
+<?php
+
+use Illuminate\Support\Facades\Schema;
+use Illuminate\Database\Schema\Blueprint;
+use Illuminate\Database\Migrations\Migration;
+
+class AddWeightToStorageProviderTable extends Migration
+{
+    /**
+     * Run the migrations.
+     *
+     * @return void
+     */
+    public function up()
+    {
+        Schema::table('storage_provider', function (Blueprint $table) {
+						$table->integer('weight')->default(1)->after('priority')->comment('Share of the uploads sent to the provider when clients split load across providers');
+        });
+    }
+
+    /**
+     * Reverse the migrations.
+     *
+     * @return void
+     */
+    public function down()
+    {
+        Schema::table('storage_provider', function (Blueprint $table) {
+						$table->dropColumn('weight');
+        });
+    }
+}
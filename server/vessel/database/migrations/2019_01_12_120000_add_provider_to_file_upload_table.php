@@ -0,0 +1,32 @@
+<?php
+
+use Illuminate\Support\Facades\Schema;
+use Illuminate\Database\Schema\Blueprint;
+use Illuminate\Database\Migrations\Migration;
+
+class AddProviderToFileUploadTable extends Migration
+{
+    /**
+     * Run the migrations.
+     *
+     * @return void
+     */
+    public function up()
+    {
+        Schema::table('file_upload', function (Blueprint $table) {
+						$table->uuid('provider_id')->nullable()->after('client_id')->comment('Storage provider the upload is sent to, the file points to it once the upload completes');
+        });
+    }
+
+    /**
+     * Reverse the migrations.
+     *
+     * @return void
+     */
+    public function down()
+    {
+        Schema::table('file_upload', function (Blueprint $table) {
+						$table->dropColumn('provider_id');
+        });
+    }
+}
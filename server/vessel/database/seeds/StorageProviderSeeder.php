@@ -25,6 +25,18 @@ class StorageProviderSeeder extends Seeder
 						'provider_type' => 'aws_s3',
 						'active' => false
 					],
+					[
+						'provider_id' => HasBinaryUuid::encodeUuid( Uuid::generate() ),
+						'provider_name' => 'S3-Compatible Example Provider',
+						'description' => 'An example storage provider configuration for MinIO or Ceph RGW. The bucket is addressed by path when it is not part of the server host name',
+						'server' => 'http://localhost:9000',
+						'region' => 'us-east-1',
+						'bucket_name' => '<your-bucket>',
+						'access_id' => '<your-access-id>',
+						'storage_path' => '/backup',
+						'provider_type' => 'aws_s3',
+						'active' => false
+					],
 					[
 						'provider_id' => HasBinaryUuid::encodeUuid( Uuid::generate() ),
 						'provider_name' => 'Azure Blob Storage Example Provider',
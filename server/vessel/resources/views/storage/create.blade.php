@@ -41,6 +41,7 @@
 						<option value="aws_s3">AWS S3</option>
 						<option value="azure">Azure Storage</option>
 						<option value="google">Google Cloud Storage</option>
+						<option value="local">Local / NFS</option>
 						<option value="user_remote">User Remote</option>
 					</select>
 				</div>
@@ -108,6 +109,13 @@
 				</div>
 			</div>
 
+			<div class="eight wide column">
+				<div class="field">
+					<label>Weight</label>
+					<input name="weight" id="weight" type="number" value="1" placeholder="Share of the uploads when load is split across providers">
+				</div>
+			</div>
+
 			<div class="sixteen wide column">
 				<div class="field">
 					<label>Description</label>
@@ -63,6 +63,7 @@
 						<option value="aws_s3">AWS S3</option>
 						<option value="azure_blob">Azure Blob Storage</option>
 						<option value="google">Google Cloud Storage</option>
+						<option value="local">Local / NFS</option>
 						<option value="user_remote">User Remote</option>
 					</select>
 				</div>
@@ -137,6 +138,13 @@
 				</div>
 			</div>
 
+			<div class="eight wide column">
+				<div class="field">
+					<label>Weight</label>
+					<input name="weight" id="weight" type="number" value="{{ $provider->weight }}" placeholder="Share of the uploads when load is split across providers">
+				</div>
+			</div>
+
 			<div class="sixteen wide column">
 				<div class="field">
 					<label>Description</label>
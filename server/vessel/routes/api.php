@@ -24,10 +24,13 @@ Route::post('/heartbeat', 'api\AppClientController@heartbeat')->middleware('veri
 Route::post('/client/install', 'api\AppClientController@install')->middleware('verifyDeploymentKey');
 
 //File Uploads
+Route::post('/upload/batch', 'api\UploadController@initUploads')->middleware('verifyClientToken');
+Route::post('/upload/complete', 'api\UploadController@completeUploads')->middleware('verifyClientToken');
 Route::get('/upload/{id}', 'api\UploadController@show')->middleware('verifyClientToken');
 Route::post('/upload/{id}/complete', 'api\UploadController@complete')->middleware('verifyClientToken');
 Route::delete('/upload/{id}', 'api\UploadController@destroy')->middleware('verifyClientToken');
 Route::put('/upload/{id}', 'api\UploadController@update')->middleware('verifyClientToken');
+Route::post('/upload/{id}/pack', 'api\UploadController@addPackFiles')->middleware('verifyClientToken');
 
 //AWS S3 Uploads
 Route::post('/upload/aws', 'api\AwsUploadController@initUpload')->middleware('verifyClientToken');
@@ -36,10 +39,13 @@ Route::post('/upload/aws/sign', 'api\AwsUploadController@getSigningKey')->middle
 //Azure Uploads
 Route::post('/upload/azure', 'api\AzureUploadController@initUpload')->middleware('verifyClientToken');
 Route::post('/upload/azure/sign', 'api\AzureUploadController@getSignature')->middleware('verifyClientToken');
+Route::post('/upload/azure/sas', 'api\AzureUploadController@getSas')->middleware('verifyClientToken');
 
 //Vessel Uploads
-Route::put('/upload/vessel/{filePath}', 'api\VesselUploadController@uploadFile')->middleware('verifyClientToken');
+Route::put('/upload/vessel/delta/{filePath}', 'api\VesselUploadController@uploadDelta')->where('filePath', '.*')->middleware('verifyClientToken');
+Route::put('/upload/vessel/{filePath}', 'api\VesselUploadController@uploadFile')->where('filePath', '.*')->middleware('verifyClientToken');
 Route::post('/upload/vessel/multipart/{filePath}', 'api\VesselUploadController@initMultiPartUpload')->middleware('verifyClientToken');
 
 //File
 Route::put('/file/{id}', 'api\FileController@update')->middleware('verifyClientToken');
+Route::post('/file/reference', 'api\FileController@addReference')->middleware('verifyClientToken');
@@ -1,12 +1,24 @@
 #include <vessel/aws/aws_s3_client.hpp>
 
+std::map<std::string,AwsS3Client::SigningKey> AwsS3Client::m_signing_keys;
+std::mutex AwsS3Client::m_signing_key_mutex;
+
 AwsS3Client::AwsS3Client(const StorageProvider& provider) : HttpClient(provider.server), m_storage_provider(provider), m_reduced_redundancy(true)
 {
+    m_compressed = false;
+    m_compressed_size = 0;
+    m_encrypted = false;
+    m_streaming = false;
+    m_unsigned_payload = false;
+    m_stream_offset = 0;
+    m_stream_length = 0;
+    m_part_length = 0;
     m_ldb = &LocalDatabase::get_database();
     m_http_verb = "PUT"; //Default for uploading new files
     m_part_size = BackupFile::get_chunk_size();
     m_remote_signing=true;
     m_user_id = m_ldb->get_setting_str("user_id");
+    init_endpoint();
     init_amz_date();
 }
 
@@ -16,7 +28,7 @@ std::string AwsS3Client::get_canonical_request()
     std::stringstream ss;
 
     ss << m_http_verb << "\n";
-    ss << "/" << encode_uri( get_file_uri_path() ) << "\n";
+    ss << get_resource_path( get_file_uri_path() ) << "\n";
     ss << m_query_str << "\n";
     ss << get_amz_headers() << "\n";
     ss << get_signed_headers() << "\n";
@@ -48,20 +60,77 @@ std::string AwsS3Client::get_string_to_sign()
 std::string AwsS3Client::get_signing_key()
 {
 
+    std::string scope = get_signing_scope();
+    std::time_t now = std::time(nullptr);
+
+    {
+        std::lock_guard<std::mutex> lock(m_signing_key_mutex);
+
+        auto it = m_signing_keys.find(scope);
+
+        if ( it != m_signing_keys.end() && it->second.expires > now ) {
+            return it->second.key;
+        }
+    }
+
+    std::string key_signing;
+
     if ( m_remote_signing )
     {
-        return api_get_signing_key();
+        key_signing = api_get_signing_key();
+    }
+    else
+    {
+        std::string secret = m_storage_provider.access_key;
+        std::string key_date = Hash::get_hmac_256("AWS4" + secret, m_amzdate_short, false);
+        std::string key_region = Hash::get_hmac_256(key_date, m_storage_provider.region, false);
+        std::string key_service = Hash::get_hmac_256(key_region, "s3", false);
+        key_signing = Hash::get_hmac_256(key_service, "aws4_request", false);
+    }
+
+    //A signing key is only valid for the date in its scope, it expires at the following UTC midnight
+    boost::gregorian::date key_date = boost::gregorian::from_undelimited_string(m_amzdate_short) + boost::gregorian::days(1);
+    std::time_t expires = boost::posix_time::to_time_t( boost::posix_time::ptime(key_date) );
+
+    std::lock_guard<std::mutex> lock(m_signing_key_mutex);
+
+    //Drop the keys of previous days
+    for ( auto it = m_signing_keys.begin(); it != m_signing_keys.end(); )
+    {
+        if ( it->second.expires <= now ) {
+            it = m_signing_keys.erase(it);
+        }
+        else {
+            ++it;
+        }
     }
 
-    std::string secret = m_storage_provider.access_key;
-    std::string key_date = Hash::get_hmac_256("AWS4" + secret, m_amzdate_short, false);
-    std::string key_region = Hash::get_hmac_256(key_date, m_storage_provider.region, false);
-    std::string key_service = Hash::get_hmac_256(key_region, "s3", false);
-    std::string key_signing = Hash::get_hmac_256(key_service, "aws4_request", false);
+    m_signing_keys[scope] = { key_signing, expires };
 
     return key_signing;
 }
 
+std::string AwsS3Client::get_signing_scope()
+{
+    return ( m_remote_signing ? "remote/" : "local/" ) + m_storage_provider.provider_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3";
+}
+
+int AwsS3Client::send_signed_request(const HttpRequest& request)
+{
+
+    int status = send_http_request(request);
+
+    //A rejected signature may come from a revoked or rotated key, the next request fetches a new one
+    if ( status == 403 )
+    {
+        std::lock_guard<std::mutex> lock(m_signing_key_mutex);
+        m_signing_keys.erase( get_signing_scope() );
+    }
+
+    return status;
+
+}
+
 std::string AwsS3Client::api_get_signing_key()
 {
 
@@ -102,12 +171,11 @@ std::string AwsS3Client::get_signature_v4()
 
 }
 
-std::string AwsS3Client::get_stream_signature_v4(const std::string& prev_signature)
+std::string AwsS3Client::get_stream_signature_v4(const std::string& signing_key, const std::string& prev_signature, const char* data, size_t length)
 {
-    //If it's the first part use the seed signature
-    if ( m_current_part <= 1 ) {
-        return get_signature_v4();
-    }
+
+    //SHA-256 of an empty string, part of every chunk string to sign
+    static const std::string empty_hash = Hash::get_sha256_hash("");
 
     //String to sign for Chunked uploads
     std::ostringstream oss;
@@ -115,11 +183,101 @@ std::string AwsS3Client::get_stream_signature_v4(const std::string& prev_signatu
     oss << m_amzdate << "\n";
     oss << m_amzdate_short << "/" << m_storage_provider.region << "/s3/aws4_request\n";
     oss << prev_signature << "\n";
-    oss << Hash::get_sha256_hash("") << "\n";
-    oss << Hash::get_sha256_hash(&m_file.get_file_part(m_current_part)[0]);
+    oss << empty_hash << "\n";
+    oss << Hash::get_sha256_hash(data, length);
 
     //Return the signature using the parted version of the string to sign
-    return Hash::get_hmac_256(get_signing_key(), oss.str());
+    return Hash::get_hmac_256(signing_key, oss.str());
+
+}
+
+size_t AwsS3Client::get_stream_length(size_t decoded_length)
+{
+
+    //<hex size>;chunk-signature=<64 hex chars>\r\n<data>\r\n
+    const size_t signature_sz = 17 + 64 + 2 + 2;
+
+    size_t full_chunks = decoded_length / AWS_STREAM_CHUNK_SZ;
+    size_t remainder = decoded_length % AWS_STREAM_CHUNK_SZ;
+
+    std::ostringstream hex;
+    hex << std::hex << AWS_STREAM_CHUNK_SZ;
+
+    size_t length = full_chunks * ( hex.str().size() + signature_sz + AWS_STREAM_CHUNK_SZ );
+
+    if ( remainder > 0 )
+    {
+        hex.str("");
+        hex << std::hex << remainder;
+        length += hex.str().size() + signature_sz + remainder;
+    }
+
+    //Final empty chunk
+    length += 1 + signature_sz;
+
+    return length;
+
+}
+
+int AwsS3Client::send_stream_request(HttpRequest& request)
+{
+
+    //One signing key for the seed and every chunk of the request
+    std::string signing_key = get_signing_key();
+    std::string signature = Hash::get_hmac_256(signing_key, get_string_to_sign());
+
+    request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + signature );
+
+    std::ifstream infile( m_file.get_file_path(), std::ios::in | std::ios::binary );
+    if ( !infile.is_open() ) {
+        throw AwsException( AwsException::UploadFailed, "Unable to open file for streaming: " + m_file.get_file_path() );
+    }
+
+    infile.seekg( m_stream_offset, std::ios::beg );
+
+    std::string data( AWS_STREAM_CHUNK_SZ, '\0' );
+    size_t remaining = m_stream_length;
+    bool finished = false;
+
+    //The file is read one chunk at a time while the request is written, the length sent is the length the file had when the upload started
+    request.set_body_source( [&](std::string& chunk) -> bool {
+
+        if ( finished ) {
+            return false;
+        }
+
+        size_t length = std::min( (size_t)AWS_STREAM_CHUNK_SZ, remaining );
+
+        if ( length > 0 )
+        {
+            infile.read( &data[0], length );
+
+            if ( (size_t)infile.gcount() != length ) {
+                throw AwsException( AwsException::UploadFailed, "File was truncated while it was uploaded: " + m_file.get_file_path() );
+            }
+        }
+
+        remaining -= length;
+        finished = ( length == 0 ); //The empty chunk ends the body
+
+        signature = get_stream_signature_v4( signing_key, signature, data.data(), length );
+
+        std::ostringstream oss;
+        oss << std::hex << length << ";chunk-signature=" << signature << "\r\n";
+
+        chunk = oss.str();
+        chunk.append( data, 0, length );
+        chunk.append("\r\n");
+
+        return true;
+
+    }, get_stream_length(m_stream_length) );
+
+    int status = send_signed_request(request);
+
+    m_previous_signature = signature;
+
+    return status;
 
 }
 
@@ -136,17 +294,34 @@ bool AwsS3Client::init_upload(const BackupFile& bf, AwsFlags flags )
     init_amz_date();
 
     m_file = bf;
+    m_part_size = bf.get_part_size();
 
     //Build the relative path on the cloud server
     build_file_uri_path();
 
     m_multipart = (flags & AwsFlags::Multipart);
-    m_reduced_redundancy = (flags & AwsFlags::ReducedRedundancy);
-    m_streaming = (flags & AwsFlags::Streaming);
+    //Storage classes other than STANDARD are not supported by every S3-compatible server
+    m_reduced_redundancy = (flags & AwsFlags::ReducedRedundancy) && m_aws_endpoint;
+    m_compressed = (flags & AwsFlags::Compressed) && !m_multipart && !(flags & AwsFlags::Streaming);
+    m_compressed_size = 0;
+    m_encrypted = (flags & AwsFlags::Encrypted);
+    m_stream_offset = 0;
+    m_stream_length = 0;
+
+    //The client is reused for every file, a resumed upload sets its upload id before init
+    if ( !(flags & AwsFlags::SkipMultiInit) ) {
+        m_upload_id.clear();
+    }
+
+    //The payload is not hashed for the signature, TLS protects it in transit and S3 checks it against Content-MD5
+    m_unsigned_payload = ( m_ldb->get_setting_int("aws_unsigned_payload") == 1 ) && is_https();
+    m_content_md5.clear();
 
-    //For streaming uploads
-    if ( m_streaming ) {
-        m_content_sha256 = "STREAMING-AWS4-HMAC-SHA256-PAYLOAD";
+    //Compressed and encrypted payloads are produced in memory before they are sent. Chunk signatures are not needed for an unsigned payload
+    m_streaming = (flags & AwsFlags::Streaming) && !m_compressed && !m_encrypted && !m_unsigned_payload;
+
+    if ( m_encrypted && !m_cipher ) {
+        throw AwsException( AwsException::InitFailed, "Encrypted upload of " + m_file.get_file_name() + " without a cipher" );
     }
 
     if ( m_multipart )
@@ -172,11 +347,59 @@ bool AwsS3Client::init_upload(const BackupFile& bf, AwsFlags flags )
         m_http_verb = "PUT";
         m_query_str = "";
 
-        //Set the file content
-        m_file_content = std::make_shared<std::string>( m_file.get_file_contents() );
+        //The file is read and signed chunk by chunk when the request is sent
+        if ( m_streaming )
+        {
+            m_stream_length = m_file.get_file_size();
+            m_content_sha256 = AWS_STREAMING_PAYLOAD;
+        }
+        else if ( m_compressed )
+        {
+            Compressor compressor;
+            compressor.set_z_level( m_ldb->get_setting_int("compression_level") );
+
+            //Deflate the file in blocks, so the uncompressed contents are never held in memory
+            std::string content = compressor.compress_file( m_file.get_file_path() );
+
+            //Incompressible content is sent as is
+            if ( !content.empty() && content.size() < m_file.get_file_size() )
+            {
+                m_compressed_size = content.size();
+                m_file_content = std::make_shared<std::string>( std::move(content) );
+            }
+            else
+            {
+                m_compressed = false;
+            }
+        }
+
+        if ( !m_compressed && !m_streaming )
+        {
+            //Set the file content
+            m_file_content = std::make_shared<std::string>( m_file.get_file_contents() );
+        }
+
+        //Encrypt after compression, ciphertext does not compress
+        if ( m_encrypted )
+        {
+            m_cipher->encrypt_part( *m_file_content, 1, true );
+        }
 
-        //Get the SHA256 hash of the current payload, in this case - the entire file contents
-        m_content_sha256 = m_file.get_hash_sha256();
+        //Streamed payloads are hashed chunk by chunk as they are sent
+        if ( m_unsigned_payload && !m_streaming )
+        {
+            m_content_sha256 = AWS_UNSIGNED_PAYLOAD;
+            m_content_md5 = Hash::get_md5_hash( *m_file_content, true );
+        }
+        else if ( m_compressed || m_encrypted )
+        {
+            m_content_sha256 = Hash::get_sha256_hash( *m_file_content );
+        }
+        else if ( !m_streaming )
+        {
+            //Get the SHA256 hash of the current payload, in this case - the entire file contents
+            m_content_sha256 = m_file.get_hash_sha256();
+        }
 
         //Rebuild the request headers
         build_request_headers();
@@ -203,8 +426,25 @@ void AwsS3Client::build_request_headers()
 
         //m_headers.insert ( std::pair<std::string,std::string>("Cache-Control", "no-cache") );
 
+        //An encrypted body can not be decoded by the provider, the encoding is kept as metadata instead
+        if ( m_compressed && !m_encrypted ) {
+            m_headers.insert ( std::pair<std::string,std::string>("Content-Encoding", "gzip") );
+        }
+        else if ( m_compressed ) {
+            m_headers.insert ( std::pair<std::string,std::string>("x-amz-meta-vessel-encoding", "gzip") );
+        }
+
+        if ( m_encrypted ) {
+            m_headers.insert ( std::pair<std::string,std::string>("x-amz-meta-vessel-key", m_cipher->get_wrapped_key() ) );
+            //Plaintext bytes per sealed part, a single request upload is one part
+            size_t sealed_size = m_multipart ? m_part_size : ( m_file_content->size() - CIPHER_TAG_SZ );
+            m_headers.insert ( std::pair<std::string,std::string>("x-amz-meta-vessel-cipher", std::string(CIPHER_NAME) + ";" + std::to_string(sealed_size) ) );
+        }
+
         if ( !m_file.get_mime_type().empty() ) {
-            m_headers.insert ( std::pair<std::string,std::string>("Content-Encoding", m_file.get_mime_type()) );
+            if ( !m_compressed && !m_streaming ) {
+                m_headers.insert ( std::pair<std::string,std::string>("Content-Encoding", m_file.get_mime_type()) );
+            }
             m_headers.insert ( std::pair<std::string,std::string>("Content-Type", m_file.get_mime_type()) );
 
         }
@@ -219,22 +459,16 @@ void AwsS3Client::build_request_headers()
     else if ( m_current_part > 0 && !m_streaming ) //Multipart upload part
     {
         //m_headers.insert ( std::pair<std::string,std::string>("Cache-Control", "no-cache") );
-        m_headers.insert ( std::pair<std::string,std::string>("Content-Length", std::to_string( m_file_content->size() ) ) );
+        m_headers.insert ( std::pair<std::string,std::string>("Content-Length", std::to_string( m_part_length ) ) );
         m_headers.insert ( std::pair<std::string,std::string>("Content-MD5", m_content_md5 ) );
         //m_headers.insert ( std::pair<std::string,std::string>("Expect", "100-continue") );
     }
 
-    //Build these headers for streaming uploads
-    if ( m_streaming )
+    //Build these headers for streaming uploads (object or part). The multipart initialization has no body
+    if ( m_streaming && m_content_sha256 == AWS_STREAMING_PAYLOAD )
     {
         m_headers.insert ( std::pair<std::string,std::string>("Content-Encoding", (m_file.get_mime_type().empty() ? "aws-chunked" : ("aws-chunked," + m_file.get_mime_type()) ) ) );
-        m_headers.insert ( std::pair<std::string,std::string>("Expect", "100-continue") );
-        m_headers.insert ( std::pair<std::string,std::string>("x-amz-decoded-content-length", std::to_string( m_file_content->size() ) ) );
-
-        if ( m_reduced_redundancy ) {
-                m_headers.insert ( std::pair<std::string,std::string>("x-amz-storage-class", "REDUCED_REDUNDANCY" ) );
-        }
-
+        m_headers.insert ( std::pair<std::string,std::string>("x-amz-decoded-content-length", std::to_string( m_stream_length ) ) );
     }
 
 }
@@ -305,18 +539,35 @@ bool AwsS3Client::upload()
 
     HttpRequest request;
     request.set_method("PUT");
-    request.set_url("/" + encode_uri( get_file_uri_path() ));
+    request.set_url(get_resource_path( get_file_uri_path() ));
     request.add_header("Date: " + m_amzdate_clean);
-    request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+
+    if ( m_compressed && !m_encrypted )
+    {
+        request.add_header("Content-Encoding: gzip");
+    }
+
+    if ( m_streaming )
+    {
+        request.add_header("Content-Encoding: " + m_headers["Content-Encoding"]);
+        request.add_header("x-amz-decoded-content-length: " + std::to_string(m_stream_length));
+    }
 
     if ( !m_file.get_mime_type().empty() )
     {
-        request.add_header("Content-Encoding: " + m_file.get_mime_type());
+        if ( !m_compressed && !m_streaming ) {
+            request.add_header("Content-Encoding: " + m_file.get_mime_type());
+        }
         request.add_header("Content-Type: " + m_file.get_mime_type());
     }
 
     request.add_header("x-amz-content-sha256: " + m_content_sha256);
 
+    if ( !m_content_md5.empty() )
+    {
+        request.add_header("Content-MD5: " + m_content_md5);
+    }
+
     if ( m_reduced_redundancy )
     {
         request.add_header("x-amz-storage-class: REDUCED_REDUNDANCY");
@@ -324,10 +575,21 @@ bool AwsS3Client::upload()
 
     request.add_header("x-amz-date: " + m_amzdate);
 
-    request.set_body(*m_file_content);
+    add_meta_headers(request);
+
+    int status = 0;
 
     //Upload the file
-    int status = send_http_request(request);
+    if ( m_streaming )
+    {
+        status = send_stream_request(request);
+    }
+    else
+    {
+        request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+        request.set_body(*m_file_content);
+        status = send_signed_request(request);
+    }
 
     //Empty file content from memory
     m_file_content.reset();
@@ -349,7 +611,7 @@ void AwsS3Client::init_multipart_upload()
 
     HttpRequest request;
     request.set_method("POST");
-    request.set_url("/" + encode_uri( get_file_uri_path() ) + "?uploads");
+    request.set_url(get_resource_path( get_file_uri_path() ) + "?uploads");
     request.add_header("Date: " + m_amzdate_clean);
     request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + signature);
 
@@ -367,8 +629,10 @@ void AwsS3Client::init_multipart_upload()
         request.add_header("x-amz-storage-class: REDUCED_REDUNDANCY");
     }
 
+    add_meta_headers(request);
+
     //Send the request
-    send_http_request(request);
+    send_signed_request(request);
 
     //Parse the response and get the upload ID here
     m_upload_id = parse_upload_id( get_response() );
@@ -384,11 +648,39 @@ std::string AwsS3Client::upload_part(int part, const std::string& upload_id )
     //Set HTTP verb for part upload
     m_http_verb = "PUT";
 
-    //Set the MD5 of the current part
-    m_file_content = std::make_shared<std::string>( m_file.get_file_part(m_current_part) );
+    std::shared_ptr<PartBuffer> buffer;
+
+    if ( m_streaming )
+    {
+        //The part is read and signed chunk by chunk when the request is sent
+        m_file_content.reset();
+        m_content_md5.clear();
+        m_content_sha256 = AWS_STREAMING_PAYLOAD;
+        m_stream_offset = m_part_size * (part - 1);
+        m_stream_length = ( m_stream_offset < m_file.get_file_size() ) ? std::min( m_part_size, m_file.get_file_size() - m_stream_offset ) : 0;
+    }
+    else
+    {
+        //The part is read into a pooled buffer, it goes back to the pool when this call returns or throws
+        buffer = m_file.read_part(m_current_part, m_encrypted ? CIPHER_TAG_SZ : 0);
+
+        if ( !buffer ) {
+            throw AwsException( AwsException::UploadFailed, "Unable to read part " + std::to_string(part) + " of " + m_file.get_file_path() );
+        }
+
+        //The part is sealed in place, S3 stores and checks the ciphertext
+        if ( m_encrypted ) {
+            size_t length = buffer->size();
+            buffer->resize( length + CIPHER_TAG_SZ );
+            m_cipher->encrypt_part( buffer->data(), length, part, ( (unsigned int)part == m_file.get_total_parts() ) );
+        }
+
+        //Set the MD5 of the current part
+        m_part_length = buffer->size();
+        m_content_sha256 = m_unsigned_payload ? AWS_UNSIGNED_PAYLOAD : Hash::get_sha256_hash( buffer->data(), buffer->size() );
+        m_content_md5 = Hash::get_md5_hash( buffer->data(), buffer->size(), true );
+    }
 
-    m_content_sha256 =  Hash::get_sha256_hash(*m_file_content);
-    m_content_md5 = Hash::get_md5_hash(*m_file_content, true);
     m_query_str = "partNumber=" + std::to_string(part) + "&uploadId=" + encode_uri(upload_id);
 
     //Refresh the date/time vars
@@ -399,25 +691,58 @@ std::string AwsS3Client::upload_part(int part, const std::string& upload_id )
 
     HttpRequest request;
     request.set_method("PUT");
-    request.set_url("/" + encode_uri( get_file_uri_path() ) + "?partNumber=" + std::to_string(part) + "&uploadId=" + encode_uri(upload_id) );
+    request.set_url(get_resource_path( get_file_uri_path() ) + "?partNumber=" + std::to_string(part) + "&uploadId=" + encode_uri(upload_id) );
     request.add_header("Date: " + m_amzdate_clean);
-    request.add_header("Content-MD5: " + m_content_md5);
     request.add_header("x-amz-content-sha256: " + m_content_sha256);
     request.add_header("x-amz-date: " + m_amzdate);
-    request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
-    request.set_body(*m_file_content);
 
-    //Clear file content - free some memory
-    m_file_content.reset();
+    if ( m_streaming )
+    {
+        request.add_header("Content-Encoding: " + m_headers["Content-Encoding"]);
+        request.add_header("x-amz-decoded-content-length: " + std::to_string(m_stream_length));
 
-    //Send the request
-    send_http_request(request);
+        //Send the request
+        send_stream_request(request);
+    }
+    else
+    {
+        request.add_header("Content-MD5: " + m_content_md5);
+        request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+
+        //The body is written from the pooled buffer, without a copy of the part
+        size_t offset = 0;
+
+        request.set_body_source( [buffer, offset](std::string& chunk) mutable -> bool {
+            return buffer->read_chunk(chunk, offset);
+        }, buffer->size() );
+
+        //Send the request
+        send_signed_request(request);
+    }
 
     //Parse the ETag from the response
     return get_header("ETag");
 
 }
 
+void AwsS3Client::add_meta_headers(HttpRequest& request)
+{
+
+    //Metadata is only signed and sent with the request that creates the object
+    for ( const auto& header : m_headers )
+    {
+        if ( boost::starts_with(header.first, "x-amz-meta-") ) {
+            request.add_header( header.first + ": " + header.second );
+        }
+    }
+
+}
+
+void AwsS3Client::set_cipher(std::shared_ptr<FileCipher> cipher)
+{
+    m_cipher = cipher;
+}
+
 void AwsS3Client::set_file(const BackupFile& bf)
 {
     m_file = bf;
@@ -438,6 +763,11 @@ size_t AwsS3Client::get_current_part_size()
 
 }
 
+size_t AwsS3Client::get_compressed_size()
+{
+    return m_compressed ? m_compressed_size : 0;
+}
+
 std::string AwsS3Client::get_last_signature()
 {
     return m_previous_signature;
@@ -563,7 +893,7 @@ std::string AwsS3Client::complete_multipart_upload(const std::vector<UploadTagSe
 
     HttpRequest request;
     request.set_method("POST");
-    request.set_url("/" + encode_uri( get_file_uri_path() ) + "?uploadId=" + encode_uri(upload_key));
+    request.set_url(get_resource_path( get_file_uri_path() ) + "?uploadId=" + encode_uri(upload_key));
     request.add_header("Date: " + m_amzdate_clean);
     request.add_header("x-amz-content-sha256: " + m_content_sha256);
     request.add_header("x-amz-date: " + m_amzdate);
@@ -571,7 +901,7 @@ std::string AwsS3Client::complete_multipart_upload(const std::vector<UploadTagSe
     request.set_body(*m_file_content);
 
     //Send the request
-    send_http_request(request);
+    send_signed_request(request);
 
     //Clear content
     m_file_content.reset();
@@ -596,10 +926,528 @@ std::string AwsS3Client::complete_multipart_upload(const std::vector<UploadTagSe
 
 }
 
+bool AwsS3Client::list_parts(const std::string& upload_id, std::vector<UploadTagSet>& parts)
+{
+
+    using namespace boost::property_tree;
+
+    /*Example Payload
+
+    <ListPartsResult>
+      <UploadId>XXBsb2FkIElEIGZvciBlbHZpbmcncyVcdS1tb3ZpZS5tMnRzEEEwbG9hZA</UploadId>
+      <PartNumberMarker>0</PartNumberMarker>
+      <NextPartNumberMarker>2</NextPartNumberMarker>
+      <MaxParts>1000</MaxParts>
+      <IsTruncated>false</IsTruncated>
+      <Part>
+        <PartNumber>1</PartNumber>
+        <LastModified>2010-11-10T20:48:34.000Z</LastModified>
+        <ETag>"7778aef83f66abc1fa1e8477f296d394"</ETag>
+        <Size>10485760</Size>
+      </Part>
+    </ListPartsResult>
+    */
+
+    parts.clear();
+
+    int marker = 0;
+    bool truncated = true;
+
+    while ( truncated )
+    {
+
+        m_current_part = -1; //Skip additional headers
+
+        m_http_verb = "GET";
+        m_file_content.reset();
+        m_content_sha256 = Hash::get_sha256_hash("");
+        m_query_str = "part-number-marker=" + std::to_string(marker) + "&uploadId=" + encode_uri(upload_id);
+
+        //Refresh the date/time vars
+        init_amz_date();
+
+        //Rebuild the request headers
+        build_request_headers();
+
+        HttpRequest request;
+        request.set_method("GET");
+        request.set_url(get_resource_path( get_file_uri_path() ) + "?" + m_query_str);
+        request.add_header("Date: " + m_amzdate_clean);
+        request.add_header("x-amz-content-sha256: " + m_content_sha256);
+        request.add_header("x-amz-date: " + m_amzdate);
+        request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+
+        int status = send_signed_request(request);
+
+        //NoSuchUpload: the upload was completed, aborted or expired
+        if ( status == 404 ) {
+            parts.clear();
+            return false;
+        }
+
+        if ( status != 200 ) {
+            throw AwsException( AwsException::BadResponse, "Unable to list parts for upload id " + upload_id + " (HTTP " + std::to_string(status) + ")" );
+        }
+
+        std::stringstream iss; //Response stream
+        iss << get_response();
+
+        try
+        {
+
+            ptree rt;
+            read_xml(iss, rt);
+
+            for ( const auto& node : rt.get_child("ListPartsResult") )
+            {
+                if ( node.first != "Part" ) {
+                    continue;
+                }
+
+                UploadTagSet part;
+                part.part_number = node.second.get<int>("PartNumber");
+                part.tag = node.second.get<std::string>("ETag");
+                part.total_bytes = node.second.get<size_t>("Size");
+                parts.push_back(part);
+            }
+
+            truncated = ( rt.get<std::string>("ListPartsResult.IsTruncated", "false") == "true" );
+            marker = rt.get<int>("ListPartsResult.NextPartNumberMarker", 0);
+
+        }
+        catch ( const ptree_error& e )
+        {
+            throw AwsException(AwsException::XmlParseError, e.what());
+        }
+
+        //Guard against a truncated listing without a marker
+        if ( truncated && marker == 0 ) {
+            break;
+        }
+
+    }
+
+    return true;
+
+}
+
+bool AwsS3Client::abort_multipart_upload(const std::string& upload_id)
+{
+
+    m_current_part = -1; //Skip additional headers
+
+    m_http_verb = "DELETE";
+    m_file_content.reset();
+    m_content_sha256 = Hash::get_sha256_hash("");
+    m_query_str = "uploadId=" + encode_uri(upload_id);
+
+    //Refresh the date/time vars
+    init_amz_date();
+
+    //Rebuild the request headers
+    build_request_headers();
+
+    HttpRequest request;
+    request.set_method("DELETE");
+    request.set_url(get_resource_path( get_file_uri_path() ) + "?uploadId=" + encode_uri(upload_id));
+    request.add_header("Date: " + m_amzdate_clean);
+    request.add_header("x-amz-content-sha256: " + m_content_sha256);
+    request.add_header("x-amz-date: " + m_amzdate);
+    request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+
+    int status = send_signed_request(request);
+
+    return ( status == 204 || status == 200 || status == 404 );
+
+}
+
+std::set<std::string> AwsS3Client::delete_objects(const std::vector<std::string>& object_keys)
+{
+
+    std::set<std::string> failed;
+
+    if ( object_keys.empty() ) {
+        return failed;
+    }
+
+    if ( object_keys.size() > AWS_DELETE_MAX_KEYS ) {
+        throw AwsException( AwsException::BadResponse, "Unable to delete " + std::to_string( object_keys.size() ) + " objects with one request" );
+    }
+
+    m_current_part = -1; //Skip additional headers
+
+    m_http_verb = "POST";
+    m_file_content = std::make_shared<std::string>( get_delete_body(object_keys) );
+    m_content_sha256 = Hash::get_sha256_hash(*m_file_content);
+    m_content_md5 = Hash::get_md5_hash(*m_file_content, true);
+    m_query_str = "delete=";
+
+    //The request is signed for the bucket
+    m_uri_file_path.clear();
+
+    //Refresh the date/time vars
+    init_amz_date();
+
+    //Rebuild the request headers
+    build_request_headers();
+
+    //Required by DeleteObjects
+    m_headers["Content-MD5"] = m_content_md5;
+
+    HttpRequest request;
+    request.set_method("POST");
+    request.set_url(get_resource_path("") + "?delete");
+    request.add_header("Date: " + m_amzdate_clean);
+    request.add_header("Content-MD5: " + m_content_md5);
+    request.add_header("x-amz-content-sha256: " + m_content_sha256);
+    request.add_header("x-amz-date: " + m_amzdate);
+    request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+    request.set_body(*m_file_content);
+
+    int status = send_signed_request(request);
+
+    //Clear content
+    m_file_content.reset();
+    m_content_md5.clear();
+
+    if ( status != 200 ) {
+        throw AwsException( AwsException::BadResponse, "Unable to delete objects (HTTP " + std::to_string(status) + ")" );
+    }
+
+    std::map<std::string,std::string> errors = get_delete_errors( get_response() );
+
+    if ( !errors.empty() ) {
+        Log::get_log().add_error("Unable to delete " + errors.begin()->first + ": " + errors.begin()->second, "AWS");
+    }
+
+    for ( const auto& error : errors ) {
+        failed.insert(error.first);
+    }
+
+    return failed;
+
+}
+
+std::string AwsS3Client::get_delete_body(const std::vector<std::string>& object_keys)
+{
+
+    using namespace boost::property_tree;
+
+    /*Example Payload
+
+    <Delete>
+      <Quiet>true</Quiet>
+      <Object>
+        <Key>user/home/docs/report.pdf</Key>
+      </Object>
+    </Delete>
+    */
+
+    ptree pt;
+    auto& root_node = pt.add("Delete", "");
+
+    //Only the objects that could not be removed are listed in the response
+    root_node.put("Quiet", "true");
+
+    for ( const auto& object_key : object_keys ) {
+        root_node.add_child("Object", ptree{}).put("Key", object_key);
+    }
+
+    std::ostringstream oss;
+    write_xml(oss, pt, xml_parser::xml_writer_make_settings<std::string>(' ',4) );
+
+    return oss.str();
+
+}
+
+std::map<std::string,std::string> AwsS3Client::get_delete_errors(const std::string& response)
+{
+
+    using namespace boost::property_tree;
+
+    /*Example Payload
+
+    <DeleteResult>
+      <Error>
+        <Key>user/home/docs/report.pdf</Key>
+        <Code>AccessDenied</Code>
+        <Message>Access Denied</Message>
+      </Error>
+    </DeleteResult>
+    */
+
+    std::map<std::string,std::string> errors;
+
+    std::stringstream iss; //Response stream
+    iss << response;
+
+    try
+    {
+        ptree rt;
+        read_xml(iss, rt);
+
+        for ( const auto& node : rt.get_child("DeleteResult") )
+        {
+            if ( node.first != "Error" ) {
+                continue;
+            }
+
+            errors[ node.second.get<std::string>("Key", "") ] = node.second.get<std::string>("Code", "");
+        }
+    }
+    catch ( const ptree_error& e )
+    {
+        throw AwsException(AwsException::XmlParseError, e.what());
+    }
+
+    return errors;
+
+}
+
+bool AwsS3Client::copy_object(const BackupFile& bf, const std::string& source_key, bool& compressed, bool& encrypted)
+{
+
+    size_t source_size = 0;
+    std::map<std::string,std::string> properties;
+
+    if ( !head_object(source_key, source_size, properties) ) {
+        return false;
+    }
+
+    compressed = ( properties["Content-Encoding"] == "gzip" || properties["x-amz-meta-vessel-encoding"] == "gzip" );
+    encrypted = !properties["x-amz-meta-vessel-key"].empty();
+
+    //The copy is stored at the path of the file
+    m_file = bf;
+    build_file_uri_path();
+
+    std::string copy_source = "/" + m_storage_provider.bucket_name + "/" + encode_uri(source_key);
+
+    m_current_part = -1; //Skip additional headers
+    m_file_content.reset();
+    m_content_sha256 = Hash::get_sha256_hash("");
+
+    if ( source_size <= AWS_COPY_MAX_SZ )
+    {
+
+        m_http_verb = "PUT";
+        m_query_str = "";
+
+        //Refresh the date/time vars
+        init_amz_date();
+
+        //Rebuild the request headers
+        build_request_headers();
+
+        //Metadata and content headers are copied from the source object
+        m_headers["x-amz-copy-source"] = copy_source;
+
+        if ( m_reduced_redundancy ) {
+            m_headers["x-amz-storage-class"] = "REDUCED_REDUNDANCY";
+        }
+
+        HttpRequest request;
+        request.set_method("PUT");
+        request.set_url(get_resource_path( get_file_uri_path() ));
+        request.add_header("Date: " + m_amzdate_clean);
+        request.add_header("x-amz-content-sha256: " + m_content_sha256);
+        request.add_header("x-amz-date: " + m_amzdate);
+        request.add_header("x-amz-copy-source: " + copy_source);
+
+        if ( m_reduced_redundancy ) {
+            request.add_header("x-amz-storage-class: REDUCED_REDUNDANCY");
+        }
+
+        request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+
+        int status = send_signed_request(request);
+
+        //S3 reports a copy that fails after it started in the body of a 200 response
+        if ( status != 200 || get_response().find("CopyObjectResult") == std::string::npos ) {
+            throw AwsException( AwsException::UploadFailed, "Unable to copy " + source_key + " (HTTP " + std::to_string(status) + ")" );
+        }
+
+        return true;
+
+    }
+
+    //Larger objects are copied in ranges. The metadata of the source is set when the upload is initialized
+    m_http_verb = "POST";
+    m_query_str = "uploads=";
+
+    //Refresh the date/time vars
+    init_amz_date();
+
+    //Rebuild the request headers
+    build_request_headers();
+
+    for ( const auto& property : properties )
+    {
+        if ( boost::starts_with(property.first, "x-amz-meta-") && !property.second.empty() ) {
+            m_headers[property.first] = property.second;
+        }
+    }
+
+    if ( m_reduced_redundancy ) {
+        m_headers["x-amz-storage-class"] = "REDUCED_REDUNDANCY";
+    }
+
+    init_multipart_upload();
+
+    size_t part_size = std::max( (size_t)AWS_COPY_PART_SZ, ( source_size + AWS_MAX_PARTS - 1 ) / AWS_MAX_PARTS );
+    std::vector<UploadTagSet> etags;
+
+    try
+    {
+        int part = 1;
+
+        for ( size_t offset = 0; offset < source_size; offset += part_size )
+        {
+            size_t last_byte = std::min( offset + part_size, source_size ) - 1;
+
+            UploadTagSet tag = { part, copy_part(copy_source, part, offset, last_byte, m_upload_id), last_byte - offset + 1 };
+            etags.push_back(tag);
+
+            part++;
+        }
+
+        complete_multipart_upload(etags, m_upload_id);
+    }
+    catch ( const std::exception& )
+    {
+        //S3 keeps the copied parts of an unfinished upload until it is aborted
+        abort_multipart_upload(m_upload_id);
+        throw;
+    }
+
+    return true;
+
+}
+
+bool AwsS3Client::head_object(const std::string& object_key, size_t& object_size, std::map<std::string,std::string>& properties)
+{
+
+    m_current_part = -1; //Skip additional headers
+
+    m_http_verb = "HEAD";
+    m_file_content.reset();
+    m_content_sha256 = Hash::get_sha256_hash("");
+    m_query_str = "";
+
+    //The request is signed for the path of the object
+    m_uri_file_path = object_key;
+
+    //Refresh the date/time vars
+    init_amz_date();
+
+    //Rebuild the request headers
+    build_request_headers();
+
+    HttpRequest request;
+    request.set_method("HEAD");
+    request.set_url( get_resource_path(object_key) );
+    request.add_header("Date: " + m_amzdate_clean);
+    request.add_header("x-amz-content-sha256: " + m_content_sha256);
+    request.add_header("x-amz-date: " + m_amzdate);
+    request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+
+    int status = send_signed_request(request);
+
+    if ( status == 404 ) {
+        return false;
+    }
+
+    if ( status != 200 ) {
+        throw AwsException( AwsException::BadResponse, "Unable to read the properties of " + object_key + " (HTTP " + std::to_string(status) + ")" );
+    }
+
+    try
+    {
+        object_size = std::stoull( boost::trim_copy( get_header("Content-Length") ) );
+    }
+    catch ( const std::exception& )
+    {
+        throw AwsException( AwsException::BadResponse, "Invalid Content-Length for " + object_key );
+    }
+
+    for ( const char* name : { "Content-Encoding", "x-amz-meta-vessel-encoding", "x-amz-meta-vessel-key", "x-amz-meta-vessel-cipher" } ) {
+        properties[name] = boost::trim_copy( get_header(name) );
+    }
+
+    return true;
+
+}
+
+std::string AwsS3Client::copy_part(const std::string& copy_source, int part, size_t first_byte, size_t last_byte, const std::string& upload_id)
+{
+
+    using namespace boost::property_tree;
+
+    std::string range = "bytes=" + std::to_string(first_byte) + "-" + std::to_string(last_byte);
+
+    m_current_part = -1; //Skip additional headers
+
+    m_http_verb = "PUT";
+    m_file_content.reset();
+    m_content_sha256 = Hash::get_sha256_hash("");
+    m_query_str = "partNumber=" + std::to_string(part) + "&uploadId=" + encode_uri(upload_id);
+
+    //Refresh the date/time vars
+    init_amz_date();
+
+    //Rebuild the request headers
+    build_request_headers();
+
+    m_headers["x-amz-copy-source"] = copy_source;
+    m_headers["x-amz-copy-source-range"] = range;
+
+    HttpRequest request;
+    request.set_method("PUT");
+    request.set_url(get_resource_path( get_file_uri_path() ) + "?" + m_query_str);
+    request.add_header("Date: " + m_amzdate_clean);
+    request.add_header("x-amz-content-sha256: " + m_content_sha256);
+    request.add_header("x-amz-date: " + m_amzdate);
+    request.add_header("x-amz-copy-source: " + copy_source);
+    request.add_header("x-amz-copy-source-range: " + range);
+    request.set_auth_header("AWS4-HMAC-SHA256 Credential=" + m_storage_provider.access_id + "/" + m_amzdate_short + "/" + m_storage_provider.region + "/s3/aws4_request,SignedHeaders=" + get_signed_headers() + ",Signature=" + get_signature_v4() );
+
+    int status = send_signed_request(request);
+
+    if ( status != 200 ) {
+        throw AwsException( AwsException::UploadFailed, "Unable to copy part " + std::to_string(part) + " (HTTP " + std::to_string(status) + ")" );
+    }
+
+    /*Example Payload
+
+    <CopyPartResult>
+        <LastModified>2011-04-11T20:34:56.000Z</LastModified>
+        <ETag>"9b2cf535f27731c974343645a3985328"</ETag>
+    </CopyPartResult>
+    */
+
+    std::stringstream iss; //Response stream
+    iss << get_response();
+
+    try
+    {
+        ptree rt;
+        read_xml(iss, rt);
+
+        return rt.get<std::string>("CopyPartResult.ETag");
+    }
+    catch ( const ptree_error& e )
+    {
+        //A copy that fails after it started is reported in the body of a 200 response
+        throw AwsException( AwsException::UploadFailed, "Unable to copy part " + std::to_string(part) + ": " + e.what() );
+    }
+
+}
+
 void AwsS3Client::remote_signing(bool flag)
 {
     if ( !flag ) {
         read_key_file();
+        init_endpoint();
         m_remote_signing=false;
     }
     else {
@@ -650,17 +1498,87 @@ void AwsS3Client::read_key_file()
 void AwsS3Client::set_storage_provider( const StorageProvider& provider )
 {
     m_storage_provider = provider;
+    init_endpoint();
+}
+
+void AwsS3Client::init_endpoint()
+{
+
+    std::string hostname = boost::to_lower_copy( get_hostname() );
+
+    m_path_style = is_path_style( hostname, m_storage_provider.bucket_name );
+
+    m_aws_endpoint = boost::ends_with( hostname, ".amazonaws.com" ) || boost::ends_with( hostname, ".amazonaws.com.cn" );
+
+    m_storage_provider.region = get_signing_region( m_storage_provider.region );
+
+    if ( !m_aws_endpoint ) {
+        m_reduced_redundancy = false;
+    }
+
+}
+
+bool AwsS3Client::is_path_style(const std::string& hostname, const std::string& bucket_name)
+{
+
+    std::string bucket = boost::to_lower_copy( bucket_name );
+
+    //Virtual-hosted servers carry the bucket in the host name (<bucket>.s3.<region>.amazonaws.com). Other servers,
+    //such as MinIO, Ceph RGW or a regional AWS endpoint, are addressed by path (<server>/<bucket>/<key>)
+    return !bucket.empty() && !boost::starts_with( boost::to_lower_copy(hostname), bucket + "." );
+
+}
+
+std::string AwsS3Client::get_resource_path(const std::string& object_key)
+{
+    return get_resource_path( m_storage_provider.bucket_name, m_path_style, object_key );
+}
+
+std::string AwsS3Client::get_resource_path(const std::string& bucket_name, bool path_style, const std::string& object_key)
+{
+
+    if ( !path_style ) {
+        return "/" + encode_uri(object_key);
+    }
+
+    //The bucket is the first segment of the path, it is signed as part of the canonical URI
+    return "/" + encode_uri( object_key.empty() ? bucket_name : bucket_name + "/" + object_key );
+
+}
+
+std::string AwsS3Client::get_signing_region(const std::string& region)
+{
+
+    //S3-compatible servers accept requests signed for the AWS default region unless they are configured otherwise
+    if ( region.empty() ) {
+        return AWS_DEFAULT_REGION;
+    }
+
+    return region;
+
+}
+
+void AwsS3Client::set_object_key(const std::string& object_key)
+{
+    m_uri_file_path = object_key;
 }
 
 void AwsS3Client::build_file_uri_path()
 {
+    m_uri_file_path = get_object_key( m_file.get_parent_path(), m_file.get_file_name() );
+}
 
-    m_uri_file_path = BackupFile::trim_path( m_storage_provider.storage_path + "/" + m_user_id + m_file.get_parent_path() + "/" + m_file.get_file_name() );
+std::string AwsS3Client::get_object_key(const std::string& parent_path, const std::string& file_name)
+{
+
+    std::string object_key = BackupFile::trim_path( m_storage_provider.storage_path + "/" + m_user_id + parent_path + "/" + file_name );
 
     #ifdef _WIN32
-        boost::replace_all(m_uri_file_path, "\\", "/");
+        boost::replace_all(object_key, "\\", "/");
     #endif
 
+    return object_key;
+
 }
 
 std::string AwsS3Client::get_file_uri_path()
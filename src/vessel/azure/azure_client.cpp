@@ -1,5 +1,8 @@
 #include <vessel/azure/azure_client.hpp>
 
+std::map<std::string,AzureClient::SasToken> AzureClient::m_sas_tokens;
+std::mutex AzureClient::m_sas_mutex;
+
 AzureClient::AzureClient(const StorageProvider& provider) : HttpClient(provider.server), m_storage_provider(provider)
 {
     m_ldb = &LocalDatabase::get_database();
@@ -10,6 +13,10 @@ AzureClient::AzureClient(const StorageProvider& provider) : HttpClient(provider.
     m_user_id = m_ldb->get_setting_str("user_id");
     m_current_part = 0;
     m_chunk_size = BackupFile::get_chunk_size();
+    m_compression = false;
+    m_compressed_size = 0;
+    m_remote_signing = false;
+    m_sas_enabled = ( m_ldb->get_setting_int("azure_sas") == 1 ) && is_https();
 }
 
 AzureClient::~AzureClient()
@@ -47,6 +54,19 @@ void AzureClient::build_headers()
             m_headers.insert( std::pair<std::string,std::string>("x-ms-blob-content-md5", m_content_md5 ) );
         }
 
+        if ( !m_content_encoding.empty() )
+        {
+            m_headers.insert( std::pair<std::string,std::string>("x-ms-blob-content-encoding", m_content_encoding ) );
+        }
+
+        //Put Block does not accept metadata, it is set when the blob is created and again when the block list is committed
+        if ( m_query_params.find("blockid") == m_query_params.end() )
+        {
+            for ( const auto& meta : m_metadata ) {
+                m_headers.insert( std::pair<std::string,std::string>("x-ms-meta-" + meta.first, meta.second ) );
+            }
+        }
+
     }
 
     //...
@@ -77,7 +97,11 @@ std::string AzureClient::get_canonical_resources()
     std::stringstream ss;
     ss << "/" << m_storage_provider.access_id;
     ss << "/" << m_storage_provider.bucket_name;
-    ss << "/" << encode_uri( m_file_uri_path );
+
+    //Container requests have no blob path
+    if ( m_query_params.find("restype") == m_query_params.end() ) {
+        ss << "/" << encode_uri( m_file_uri_path );
+    }
 
     if ( m_query_params.find("blockid") != m_query_params.end() )
     {
@@ -98,6 +122,11 @@ std::string AzureClient::get_canonical_resources()
             ss << "\n";
             ss << "comp:blocklist";
         }
+        else if ( m_query_params["comp"] == "batch" )
+        {
+            ss << "\n";
+            ss << "comp:batch\nrestype:container";
+        }
 
     }
 
@@ -224,10 +253,132 @@ std::string AzureClient::get_ms_signature()
 
 }
 
+void AzureClient::authorize(HttpRequest& request)
+{
+
+    if ( m_remote_signing && m_sas_enabled )
+    {
+        std::string sas = get_sas_token();
+
+        //The SAS token is the only credential of the request, nothing is signed per request
+        if ( !sas.empty() )
+        {
+            std::string url = request.get_url();
+            request.set_url( url + ( url.find('?') == std::string::npos ? "?" : "&" ) + sas );
+            return;
+        }
+    }
+
+    request.set_auth_header("SharedKey " + m_storage_provider.access_id + ":" + get_ms_signature());
+
+}
+
+int AzureClient::send_signed_request(const HttpRequest& request)
+{
+
+    int status = send_http_request(request);
+
+    //The SAS may have been revoked with the account key, the next request asks the API for a new one
+    if ( status == 403 && m_remote_signing && m_sas_enabled )
+    {
+        std::lock_guard<std::mutex> lock(m_sas_mutex);
+        m_sas_tokens.erase( m_storage_provider.provider_id );
+    }
+
+    return status;
+
+}
+
+std::string AzureClient::get_sas_token()
+{
+
+    std::time_t now = std::time(nullptr);
+
+    std::lock_guard<std::mutex> lock(m_sas_mutex);
+
+    auto it = m_sas_tokens.find( m_storage_provider.provider_id );
+
+    //Refresh ahead of the expiry, so a block upload never starts with a token that expires in flight
+    if ( it != m_sas_tokens.end() && it->second.expires - AZURE_SAS_REFRESH > now ) {
+        return it->second.token;
+    }
+
+    SasToken sas;
+
+    if ( !api_get_sas(sas) )
+    {
+        //The Vessel server does not issue SAS tokens, fall back to remote signing of every request
+        Log::get_log().add_message("Unable to obtain a SAS token for provider " + m_storage_provider.provider_id + ", requests are signed remotely", "Azure");
+        m_sas_enabled = false;
+        m_sas_tokens.erase( m_storage_provider.provider_id );
+        return "";
+    }
+
+    m_sas_tokens[m_storage_provider.provider_id] = sas;
+
+    return sas.token;
+
+}
+
+bool AzureClient::api_get_sas(SasToken& sas)
+{
+
+    std::unique_ptr<HttpClient> vessel = std::make_unique<HttpClient>( m_ldb->get_setting_str("master_server") );
+
+    int lifetime = m_ldb->get_setting_int("azure_sas_lifetime");
+
+    if ( lifetime <= AZURE_SAS_REFRESH ) {
+        lifetime = AZURE_SAS_LIFETIME;
+    }
+
+    HttpRequest request;
+    request.set_method("POST");
+    request.set_auth_header( "Bearer " + m_ldb->get_setting_str("client_token") );
+    request.set_content_type("application/json");
+    request.accept("application/json");
+    request.set_url( m_ldb->get_setting_str("vessel_api_path") + "/upload/azure/sas");
+    request.set_body("{\"providerId\" : \"" + m_storage_provider.provider_id + "\", \"expiresIn\" : " + std::to_string(lifetime) + "}");
+
+    std::time_t requested = std::time(nullptr);
+
+    try
+    {
+        vessel->send_http_request(request);
+    }
+    catch ( const std::exception& e )
+    {
+        Log::get_log().add_error( std::string("Unable to request a SAS token: ") + e.what(), "Azure");
+        return false;
+    }
+
+    if ( vessel->get_http_status() != 200 ) {
+        return false;
+    }
+
+    Document document;
+    document.Parse( vessel->get_response().c_str() );
+
+    if ( document.HasParseError() || !document.IsObject() || !document.HasMember("sas") || !document["sas"].IsString() || !document.HasMember("expiresIn") || !document["expiresIn"].IsInt() ) {
+        return false;
+    }
+
+    //The expiry is counted from the time of the request, the token is never used past the expiry set by the server
+    sas.token = document["sas"].GetString();
+    sas.expires = requested + document["expiresIn"].GetInt();
+
+    return !sas.token.empty();
+
+}
+
 std::string AzureClient::get_file_uri_path()
 {
+    return get_object_key( m_file.get_parent_path(), m_file.get_file_name() );
+}
 
-    std::string path = m_user_id + m_file.get_parent_path() + "/" + m_file.get_file_name();
+std::string AzureClient::get_object_key(const std::string& parent_path, const std::string& file_name)
+{
+
+    std::string path = m_user_id + parent_path + "/" + file_name;
 
     #ifdef _WIN32
         boost::replace_all(path, "\\", "/");
@@ -237,6 +388,11 @@ std::string AzureClient::get_file_uri_path()
 
 }
 
+void AzureClient::set_object_key(const std::string& object_key)
+{
+    m_file_uri_path = object_key;
+}
+
 void AzureClient::reset()
 {
     //Reset vars to defaults
@@ -247,6 +403,7 @@ void AzureClient::reset()
     m_content_length = 0;
     m_content_md5.clear();
     m_content_type.clear();
+    m_content_encoding.clear();
     m_query_params.clear();
     m_xms_blob_type = "BlockBlob";
 
@@ -260,6 +417,19 @@ void AzureClient::init_upload(const BackupFile& file)
 
     //Set file
     m_file = file;
+    m_chunk_size = file.get_part_size();
+
+    //The client is reused for every file, compression is set again for each upload
+    m_compression = false;
+    m_compressed_size = 0;
+
+    //Azure metadata names must be C# identifiers, hyphens are not allowed
+    m_metadata.clear();
+
+    if ( m_cipher ) {
+        m_metadata["vesselkey"] = m_cipher->get_wrapped_key();
+        m_metadata["vesselcipher"] = std::string(CIPHER_NAME) + ";" + std::to_string(m_chunk_size);
+    }
 
     //Build the relative path on the cloud server
     m_file_uri_path = get_file_uri_path();
@@ -275,8 +445,43 @@ bool AzureClient::upload()
     //Reset vars
     reset();
 
+    m_compressed_size = 0;
+
+    if ( m_compression )
+    {
+        Compressor compressor;
+        compressor.set_z_level( m_ldb->get_setting_int("compression_level") );
+
+        //Deflate the file in blocks, so the uncompressed contents are never held in memory
+        std::string content = compressor.compress_file( m_file.get_file_path() );
+
+        //Incompressible content is sent as is
+        if ( !content.empty() && content.size() < m_file.get_file_size() )
+        {
+            m_compressed_size = content.size();
+            m_content_body = std::make_shared<std::string>( std::move(content) );
+            m_content_encoding = "gzip";
+        }
+    }
+
     //Set the file content
-    m_content_body = std::make_shared<std::string>( m_file.get_file_contents() );
+    if ( !m_content_body ) {
+        m_content_body = std::make_shared<std::string>( m_file.get_file_contents() );
+    }
+
+    //Encrypt after compression, the blob is a single sealed part
+    if ( m_cipher )
+    {
+        m_metadata["vesselcipher"] = std::string(CIPHER_NAME) + ";" + std::to_string( m_content_body->size() );
+        m_cipher->encrypt_part( *m_content_body, 1, true );
+
+        //An encrypted body can not be decoded by the service, the encoding is kept as metadata instead
+        if ( !m_content_encoding.empty() ) {
+            m_metadata["vesselencoding"] = m_content_encoding;
+            m_content_encoding.clear();
+        }
+    }
+
     m_content_length = m_content_body->size();
     m_content_type = m_file.get_mime_type();
     m_content_md5 = Hash::get_md5_hash( *m_content_body, true ); //Get the MD% hash of the current payload, in this case - the entire file contents
@@ -293,16 +498,21 @@ bool AzureClient::upload()
         request.add_header("Content-Type: " + m_content_type);
         request.add_header("x-ms-blob-content-type: " + m_content_type);
     }
+    if ( !m_content_encoding.empty() ) {
+        request.add_header("Content-Encoding: " + m_content_encoding);
+        request.add_header("x-ms-blob-content-encoding: " + m_content_encoding);
+    }
     request.add_header("Content-MD5: " + m_content_md5);
     request.add_header("x-ms-date: " + m_xms_date);
     request.add_header("x-ms-version: " + m_xms_version);
     request.add_header("x-ms-blob-type: " + m_xms_blob_type);
     request.add_header("x-ms-blob-content-md5: " + m_content_md5);
-    request.set_auth_header("SharedKey " + m_storage_provider.access_id + ":" + get_ms_signature());
+    add_meta_headers(request);
+    authorize(request);
     request.set_body( *m_content_body );
     request.accept("application/json");
 
-    int status = send_http_request(request);
+    int status = send_signed_request(request);
 
     //std::cout << "HTTP Status: " << status << '\n';
     //std::cout << get_response() << '\n';
@@ -322,9 +532,23 @@ bool AzureClient::upload_part(int part_number)
 
     //Prepare the block blob
     m_current_part = part_number;
-    m_content_body = std::make_shared<std::string>(m_file.get_file_part(part_number));
-    m_content_md5 = Hash::get_md5_hash(*m_content_body, true);
-    m_content_length = m_content_body->size();
+
+    //The block is read into a pooled buffer, it goes back to the pool when this call returns or throws
+    std::shared_ptr<PartBuffer> buffer = m_file.read_part(part_number, m_cipher ? CIPHER_TAG_SZ : 0);
+
+    if ( !buffer ) {
+        return false;
+    }
+
+    //The block is sealed in place, Azure stores and checks the ciphertext
+    if ( m_cipher ) {
+        size_t length = buffer->size();
+        buffer->resize( length + CIPHER_TAG_SZ );
+        m_cipher->encrypt_part( buffer->data(), length, part_number, ( (unsigned int)part_number == m_file.get_total_parts() ) );
+    }
+
+    m_content_md5 = Hash::get_md5_hash(buffer->data(), buffer->size(), true);
+    m_content_length = buffer->size();
     m_content_type.clear(); //Content-Type should not be passed with blocks
     m_block_id = Hash::get_base64( get_padded_block_id(std::to_string(part_number)) );
     m_xms_blob_type.clear(); //Do not pass when uploading a block chunk
@@ -347,11 +571,16 @@ bool AzureClient::upload_part(int part_number)
     request.add_header("x-ms-date: " + m_xms_date);
     request.add_header("x-ms-version: " + m_xms_version);
     request.add_header("x-ms-blob-content-md5: " + m_content_md5);
-    request.set_auth_header("SharedKey " + m_storage_provider.access_id + ":" + get_ms_signature());
-    request.set_body( *m_content_body );
+    authorize(request);
     request.accept("application/json");
 
-    int status = send_http_request(request);
+    //The body is written from the pooled buffer, without a copy of the block
+    size_t offset = 0;
+    request.set_body_source( [buffer, offset](std::string& chunk) mutable -> bool {
+        return buffer->read_chunk(chunk, offset);
+    }, buffer->size() );
+
+    int status = send_signed_request(request);
 
     if ( status != 200 && status != 201 ) {
         return false;
@@ -390,10 +619,11 @@ bool AzureClient::init_block()
     request.add_header("x-ms-date: " + m_xms_date);
     request.add_header("x-ms-version: " + m_xms_version);
     request.add_header("x-ms-blob-type: " + m_xms_blob_type);
-    request.set_auth_header("SharedKey " + m_storage_provider.access_id + ":" + get_ms_signature());
+    add_meta_headers(request);
+    authorize(request);
     request.accept("application/json");
 
-    int status = send_http_request(request);
+    int status = send_signed_request(request);
 
     if ( status != 200 && status != 201 ) {
         return false;
@@ -453,7 +683,8 @@ bool AzureClient::complete_multipart_upload(int total_parts)
     request.add_header("x-ms-date: " + m_xms_date);
     request.add_header("x-ms-version: " + m_xms_version);
     request.add_header("x-ms-blob-content-md5: " + m_content_md5);
-    request.set_auth_header("SharedKey " + m_storage_provider.access_id + ":" + get_ms_signature());
+    add_meta_headers(request);
+    authorize(request);
     if ( !m_content_type.empty() ) {
         request.add_header("Content-Type: " + m_content_type);
         request.add_header("x-ms-blob-content-type: " + m_content_type);
@@ -461,7 +692,7 @@ bool AzureClient::complete_multipart_upload(int total_parts)
     request.set_body( *m_content_body );
     request.accept("application/json");
 
-    send_http_request(request);
+    send_signed_request(request);
 
     if ( get_http_status() != 200 && get_http_status() != 201 ) {
         return false;
@@ -493,10 +724,10 @@ std::string AzureClient::get_block_list()
     request.set_url("/" + m_storage_provider.bucket_name + "/" + encode_uri( m_file_uri_path ) + "?comp=blocklist&blocklisttype=all" );
     request.add_header("x-ms-date: " + m_xms_date);
     request.add_header("x-ms-version: " + m_xms_version);
-    request.set_auth_header("SharedKey " + m_storage_provider.access_id + ":" + get_ms_signature());
+    authorize(request);
     request.accept("application/json");
 
-    send_http_request(request);
+    send_signed_request(request);
 
     //std::cout << "HTTP Status: " << get_http_status() << '\n';
     //std::cout << get_response() << '\n';
@@ -510,6 +741,382 @@ std::string AzureClient::get_block_list()
 }
 
 
+bool AzureClient::list_blocks(std::vector<UploadTagSet>& blocks)
+{
+
+    using namespace boost::property_tree;
+
+    /*
+    <?xml version="1.0" encoding="utf-8"?>
+    <BlockList>
+        <CommittedBlocks />
+        <UncommittedBlocks>
+            <Block>
+                <Name>base64-encoded-block-id</Name>
+                <Size>size-in-bytes</Size>
+            </Block>
+        </UncommittedBlocks>
+    </BlockList>
+    */
+
+    blocks.clear();
+
+    std::string response = get_block_list();
+
+    //The zero length blob created by init_block no longer exists
+    if ( get_http_status() == 404 ) {
+        return false;
+    }
+
+    if ( response.empty() ) {
+        throw AzureException( AzureException::UploadFailed, "Unable to get the block list: " + last_request_id() );
+    }
+
+    std::stringstream iss;
+    iss << response;
+
+    try
+    {
+
+        ptree rt;
+        read_xml(iss, rt);
+
+        auto uncommitted = rt.get_child_optional("BlockList.UncommittedBlocks");
+
+        if ( !uncommitted ) {
+            return true;
+        }
+
+        for ( const auto& node : *uncommitted )
+        {
+            if ( node.first != "Block" ) {
+                continue;
+            }
+
+            UploadTagSet block;
+            block.tag = node.second.get<std::string>("Name");
+            block.total_bytes = node.second.get<size_t>("Size");
+
+            //Block ids are the padded part number
+            try
+            {
+                block.part_number = std::stoi( Hash::base64_decode(block.tag) );
+            }
+            catch ( const std::exception& )
+            {
+                continue; //Not a block of this client
+            }
+
+            blocks.push_back(block);
+        }
+
+    }
+    catch ( const ptree_error& e )
+    {
+        throw AzureException( AzureException::UploadFailed, std::string("Unable to parse the block list: ") + e.what() );
+    }
+
+    return true;
+
+}
+
+bool AzureClient::copy_blob(const BackupFile& file, const std::string& source_path, bool& compressed, bool& encrypted)
+{
+
+    std::map<std::string,std::string> properties;
+
+    if ( !get_blob_properties(source_path, properties) ) {
+        return false;
+    }
+
+    compressed = ( properties["Content-Encoding"] == "gzip" || properties["x-ms-meta-vesselencoding"] == "gzip" );
+    encrypted = !properties["x-ms-meta-vesselkey"].empty();
+
+    //Reset vars
+    reset();
+
+    //The copy is stored at the path of the file
+    m_file = file;
+    m_file_uri_path = get_file_uri_path();
+
+    //Properties and metadata are copied from the source blob when none are sent
+    m_metadata.clear();
+    m_xms_blob_type.clear();
+
+    std::string copy_source = ( is_https() ? "https://" : "http://" ) + get_hostname() + "/" + m_storage_provider.bucket_name + "/" + encode_uri(source_path);
+
+    //A container SAS also authorizes the read of the source blob
+    std::string sas = ( m_remote_signing && m_sas_enabled ) ? get_sas_token() : "";
+
+    if ( !sas.empty() ) {
+        copy_source += "?" + sas;
+    }
+
+    //Rebuild the request headers
+    build_headers();
+    m_headers["x-ms-copy-source"] = copy_source;
+
+    HttpRequest request;
+    request.set_method("PUT");
+    request.set_url("/" + m_storage_provider.bucket_name + "/" + encode_uri( m_file_uri_path ) );
+    request.add_header("x-ms-date: " + m_xms_date);
+    request.add_header("x-ms-version: " + m_xms_version);
+    request.add_header("x-ms-copy-source: " + copy_source);
+    authorize(request);
+    request.accept("application/json");
+
+    int status = send_signed_request(request);
+
+    if ( status != 202 ) {
+        throw AzureException( AzureException::UploadFailed, "Unable to copy " + source_path + ": " + last_request_id() );
+    }
+
+    std::string copy_status = boost::trim_copy( get_header("x-ms-copy-status") );
+
+    //Copies within a storage account usually finish before the response, the others are polled
+    for ( int i=0; copy_status == "pending" && i < AZURE_COPY_WAIT_SECS; i++ )
+    {
+        std::this_thread::sleep_for( std::chrono::seconds(1) );
+
+        if ( !get_blob_properties(m_file_uri_path, properties) ) {
+            break;
+        }
+
+        copy_status = properties["x-ms-copy-status"];
+    }
+
+    if ( copy_status != "success" ) {
+        throw AzureException( AzureException::UploadFailed, "Copy of " + source_path + " did not complete (" + copy_status + ")" );
+    }
+
+    return true;
+
+}
+
+std::set<std::string> AzureClient::delete_blobs(const std::vector<std::string>& paths)
+{
+
+    std::set<std::string> failed;
+
+    if ( paths.empty() ) {
+        return failed;
+    }
+
+    if ( paths.size() > AZURE_BATCH_MAX_BLOBS ) {
+        throw AzureException( AzureException::UploadFailed, "Unable to delete " + std::to_string( paths.size() ) + " blobs with one request" );
+    }
+
+    //A container SAS authorizes every sub-request, otherwise each one carries its own signature
+    std::string sas = ( m_remote_signing && m_sas_enabled ) ? get_sas_token() : "";
+
+    std::string boundary = "batch_" + Hash::get_sha256_hash( get_ms_date() + paths.front() + paths.back() ).substr(0, 32);
+    std::ostringstream body;
+
+    /*Example Sub-request
+
+    --batch_6ab1e17e
+    Content-Type: application/http
+    Content-Transfer-Encoding: binary
+    Content-ID: 0
+
+    DELETE /container/user/home/docs/report.pdf HTTP/1.1
+    x-ms-date: Thu, 14 Jun 2018 16:46:54 GMT
+    Authorization: SharedKey account:G4jjBXA7LI/RnWKIOQ8i9xH4p76pAQ+4Fs4R1VxasaE=
+    Content-Length: 0
+    */
+
+    for ( size_t i=0; i < paths.size(); i++ )
+    {
+
+        //Reset vars
+        reset();
+
+        m_http_verb = "DELETE";
+        m_file_uri_path = paths[i];
+
+        //Sub-requests use the version of the batch request
+        build_headers();
+        m_headers.erase("x-ms-version");
+
+        std::string url = "/" + m_storage_provider.bucket_name + "/" + encode_uri( m_file_uri_path );
+
+        body << "--" << boundary << "\r\n";
+        body << "Content-Type: application/http\r\n";
+        body << "Content-Transfer-Encoding: binary\r\n";
+        body << "Content-ID: " << i << "\r\n\r\n";
+        body << "DELETE " << url << ( sas.empty() ? "" : "?" + sas ) << " HTTP/1.1\r\n";
+        body << "x-ms-date: " << m_xms_date << "\r\n";
+
+        if ( sas.empty() ) {
+            body << "Authorization: SharedKey " << m_storage_provider.access_id << ":" << get_ms_signature() << "\r\n";
+        }
+
+        body << "Content-Length: 0\r\n\r\n";
+
+    }
+
+    body << "--" << boundary << "--\r\n";
+
+    std::string version = m_xms_version;
+
+    //Reset vars
+    reset();
+
+    m_http_verb = "POST";
+    m_file_uri_path.clear();
+    m_query_params["restype"] = "container";
+    m_query_params["comp"] = "batch";
+    m_content_type = "multipart/mixed; boundary=" + boundary;
+    m_content_body = std::make_shared<std::string>( body.str() );
+    m_content_length = m_content_body->size();
+    m_xms_version = AZURE_BATCH_VERSION;
+
+    //Rebuild the request headers
+    build_headers();
+
+    HttpRequest request;
+    request.set_method("POST");
+    request.set_url("/" + m_storage_provider.bucket_name + "?restype=container&comp=batch");
+    request.add_header("Content-Type: " + m_content_type);
+    request.add_header("x-ms-date: " + m_xms_date);
+    request.add_header("x-ms-version: " + m_xms_version);
+    authorize(request);
+    request.set_body( *m_content_body );
+
+    int status = 0;
+
+    try
+    {
+        status = send_signed_request(request);
+    }
+    catch ( ... )
+    {
+        m_xms_version = version;
+        throw;
+    }
+
+    m_xms_version = version;
+    m_content_body.reset();
+
+    if ( status != 202 ) {
+        throw AzureException( AzureException::UploadFailed, "Unable to delete blobs: " + last_request_id() );
+    }
+
+    std::vector<int> statuses = get_batch_statuses( get_response(), paths.size() );
+
+    for ( size_t i=0; i < paths.size(); i++ )
+    {
+        if ( is_blob_deleted( statuses[i] ) ) {
+            continue;
+        }
+
+        if ( failed.empty() ) {
+            Log::get_log().add_error("Unable to delete " + paths[i] + " (HTTP " + ( statuses[i] ? std::to_string(statuses[i]) : std::string("none") ) + ")", "Azure");
+        }
+
+        //A SAS issued without the delete permission is dropped, the next batch asks the API for a new one
+        if ( statuses[i] == 403 && !sas.empty() )
+        {
+            std::lock_guard<std::mutex> lock(m_sas_mutex);
+            m_sas_tokens.erase( m_storage_provider.provider_id );
+        }
+
+        failed.insert( paths[i] );
+    }
+
+    return failed;
+
+}
+
+std::vector<int> AzureClient::get_batch_statuses(const std::string& response, size_t count)
+{
+
+    std::vector<int> statuses(count, 0);
+
+    /*Example Sub-response
+
+    --batchresponse_66925647-d0cb-4109-b6d3-28efe3e1e5ed
+    Content-Type: application/http
+    Content-ID: 0
+
+    HTTP/1.1 202 Accepted
+    x-ms-delete-type-permanent: true
+    x-ms-request-id: 778fdc83-801e-0000-62ff-0334671e284f
+    x-ms-version: 2020-04-08
+    */
+
+    //Every sub-response carries the Content-ID of its sub-request and its own status line
+    std::istringstream stream(response);
+    std::string line;
+    size_t content_id = count;
+
+    while ( std::getline(stream, line) )
+    {
+        boost::trim(line);
+
+        try
+        {
+            if ( boost::istarts_with(line, "Content-ID:") ) {
+                content_id = std::stoul( boost::trim_copy( line.substr(11) ) );
+            }
+            else if ( boost::starts_with(line, "HTTP/1.1 ") && content_id < count ) {
+                statuses[content_id] = std::stoi( line.substr(9, 3) );
+                content_id = count;
+            }
+        }
+        catch ( const std::exception& )
+        {
+            content_id = count;
+        }
+    }
+
+    return statuses;
+
+}
+
+bool AzureClient::is_blob_deleted(int status)
+{
+    //A blob that no longer exists is reported as BlobNotFound
+    return status == 202 || status == 404;
+}
+
+bool AzureClient::get_blob_properties(const std::string& path, std::map<std::string,std::string>& properties)
+{
+
+    //Reset vars
+    reset();
+
+    m_http_verb = "HEAD";
+    m_file_uri_path = path;
+
+    //Rebuild the request headers
+    build_headers();
+
+    HttpRequest request;
+    request.set_method("HEAD");
+    request.set_url("/" + m_storage_provider.bucket_name + "/" + encode_uri( m_file_uri_path ) );
+    request.add_header("x-ms-date: " + m_xms_date);
+    request.add_header("x-ms-version: " + m_xms_version);
+    authorize(request);
+
+    int status = send_signed_request(request);
+
+    if ( status == 404 ) {
+        return false;
+    }
+
+    if ( status != 200 ) {
+        throw AzureException( AzureException::UploadFailed, "Unable to read the properties of " + path + ": " + last_request_id() );
+    }
+
+    for ( const char* name : { "Content-Encoding", "x-ms-meta-vesselencoding", "x-ms-meta-vesselkey", "x-ms-copy-status" } ) {
+        properties[name] = boost::trim_copy( get_header(name) );
+    }
+
+    return true;
+
+}
+
 std::string AzureClient::api_get_signature()
 {
 
@@ -544,6 +1151,31 @@ std::string AzureClient::api_get_signature()
 
 }
 
+void AzureClient::add_meta_headers(HttpRequest& request)
+{
+    for ( const auto& header : m_headers )
+    {
+        if ( boost::starts_with(header.first, "x-ms-meta-") ) {
+            request.add_header( header.first + ": " + header.second );
+        }
+    }
+}
+
+void AzureClient::set_cipher(std::shared_ptr<FileCipher> cipher)
+{
+    m_cipher = cipher;
+}
+
+void AzureClient::set_compression(bool flag)
+{
+    m_compression = flag;
+}
+
+size_t AzureClient::get_compressed_size()
+{
+    return m_compressed_size;
+}
+
 std::string AzureClient::last_request_id()
 {
     return get_header("x-ms-request-id");
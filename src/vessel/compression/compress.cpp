@@ -2,14 +2,14 @@
 
 using namespace Vessel::Compression;
 
-Compressor::Compressor() : m_z_level(Z_COMP_LEVEL)
+Compressor::Compressor() : m_z_level(Z_COMP_LEVEL), m_compressing(false)
 {
 
 }
 
 Compressor::~Compressor()
 {
-
+    end_compression();
 }
 
 void Compressor::set_z_level(int level)
@@ -17,6 +17,119 @@ void Compressor::set_z_level(int level)
     m_z_level = level;
 }
 
+bool Compressor::is_compressible( const std::string& file_type )
+{
+
+    static const std::set<std::string> compressed_types = {
+        ".gz", ".tgz", ".bz2", ".xz", ".zst", ".lz4", ".zip", ".7z", ".rar", ".jar", ".apk", ".dmg",
+        ".jpg", ".jpeg", ".png", ".gif", ".webp", ".heic",
+        ".mp3", ".m4a", ".aac", ".ogg", ".flac", ".mp4", ".m4v", ".mov", ".mkv", ".webm", ".avi",
+        ".docx", ".xlsx", ".pptx", ".odt", ".ods", ".odp", ".vpk"
+    };
+
+    return compressed_types.find( boost::algorithm::to_lower_copy(file_type) ) == compressed_types.end();
+
+}
+
+bool Compressor::start_compression()
+{
+
+    end_compression();
+
+    m_zs_comp = {0};
+
+    if ( deflateInit2(&m_zs_comp, m_z_level, Z_DEFLATED, MAX_WBITS | GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY) != Z_OK )
+        return false;
+
+    m_compressing = true;
+
+    return true;
+
+}
+
+std::string Compressor::compress( const char* data, size_t len, bool finish )
+{
+
+    std::string out_s;
+
+    if ( !m_compressing )
+        return out_s;
+
+    //Output Buffer
+    unsigned char out[Z_CHUNK];
+
+    m_zs_comp.next_in = (unsigned char*)data;
+    m_zs_comp.avail_in = len;
+
+    //Deflate until the block is consumed, or the stream is finished
+    do
+    {
+
+        m_zs_comp.next_out = out;
+        m_zs_comp.avail_out = sizeof(out);
+
+        int ret = deflate(&m_zs_comp, finish ? Z_FINISH : Z_NO_FLUSH );
+
+        assert(ret != Z_STREAM_ERROR);
+
+        out_s.append((char*)out, (Z_CHUNK - m_zs_comp.avail_out) );
+
+    }
+    while (m_zs_comp.avail_out == 0);
+
+    assert(m_zs_comp.avail_in == 0); //All input should be used
+
+    return out_s;
+
+}
+
+void Compressor::end_compression()
+{
+
+    if ( !m_compressing )
+        return;
+
+    deflateEnd(&m_zs_comp); //Cleanup
+    m_compressing = false;
+
+}
+
+std::string Compressor::compress_file( const std::string& in )
+{
+
+    std::string out_s;
+
+    std::ifstream infile( in, std::ifstream::in | std::ifstream::binary );
+    if ( !infile.is_open() )
+        return out_s;
+
+    if ( !start_compression() )
+        return out_s;
+
+    std::vector<char> buffer(Z_READ_CHUNK);
+
+    while ( infile.good() )
+    {
+
+        infile.read( buffer.data(), buffer.size() );
+
+        if ( infile.bad() )
+        {
+            end_compression();
+            return std::string();
+        }
+
+        //The last read finishes the stream
+        out_s += compress( buffer.data(), infile.gcount(), !infile.good() );
+
+    }
+
+    end_compression();
+
+    return out_s;
+
+}
+
 std::string Compressor::compress_str(const std::string& str)
 {
     return (*this << str);
@@ -117,6 +230,7 @@ std::string Compressor::operator>>(const std::string & str)
     unsigned char out[Z_CHUNK];
 
     m_zs_decomp.next_in = (unsigned char*)str.c_str();
+    m_zs_decomp.avail_in = str.size();
 
     //Decompress contents
     do
@@ -154,18 +268,19 @@ void Compressor::compress_file( const std::string & in, const std::string & out
     size_t fs = boost::filesystem::file_size(in);
     size_t bytes_read=0;
 
-    while ( !infile.eof() && infile.good() )
-    {
+    //The whole file is deflated into a single stream
+    if ( !start_compression() )
+        return;
 
-        char* buffer = new char[Z_CHUNK];
+    std::vector<char> buffer(Z_READ_CHUNK);
 
-        infile.read(buffer, Z_CHUNK );
+    while ( infile.good() )
+    {
 
-        //Save buffer to string
-        std::string ts(buffer, infile.gcount() );
+        infile.read(buffer.data(), buffer.size() );
 
         //Compress the block of data and save it to out file
-        std::string ds = *this << ts;
+        std::string ds = compress( buffer.data(), infile.gcount(), !infile.good() );
 
         //Write to outfile
         outfile << ds;
@@ -174,10 +289,10 @@ void Compressor::compress_file( const std::string & in, const std::string & out
 
         std::cout << bytes_read << " / " << fs << " bytes compressed" << " (" << (((double)bytes_read / fs)*100) << "%)" << std::endl;
 
-        delete[] buffer;
-
     }
 
+    end_compression();
+
     infile.close();
     outfile.close();
 
@@ -0,0 +1,242 @@
+#include <vessel/crypto/file_cipher.hpp>
+
+using namespace Vessel::Utilities;
+using namespace CryptoPP;
+
+FileCipher::FileCipher(const std::string& tenant_key) : m_key(CIPHER_KEY_SZ), m_nonce_prefix(CIPHER_NONCE_PREFIX_SZ)
+{
+
+    AutoSeededRandomPool rng;
+    rng.GenerateBlock( m_key.BytePtr(), m_key.size() );
+    rng.GenerateBlock( m_nonce_prefix.BytePtr(), m_nonce_prefix.size() );
+
+    std::string key_material( (const char*)m_key.BytePtr(), m_key.size() );
+    key_material.append( (const char*)m_nonce_prefix.BytePtr(), m_nonce_prefix.size() );
+
+    m_wrapped_key = wrap_key( tenant_key, key_material );
+
+    init_ciphers();
+
+}
+
+FileCipher::FileCipher(const std::string& tenant_key, const std::string& wrapped_key) : m_key(CIPHER_KEY_SZ), m_nonce_prefix(CIPHER_NONCE_PREFIX_SZ), m_wrapped_key(wrapped_key)
+{
+
+    std::string key_material = unwrap_key( tenant_key, wrapped_key );
+
+    m_key.Assign( (const byte*)key_material.data(), CIPHER_KEY_SZ );
+    m_nonce_prefix.Assign( (const byte*)key_material.data() + CIPHER_KEY_SZ, CIPHER_NONCE_PREFIX_SZ );
+
+    init_ciphers();
+
+}
+
+void FileCipher::init_ciphers()
+{
+
+    //The key schedule and GHASH tables are computed once per file, the IV is set for every part
+    m_encryption.SetKey( m_key.BytePtr(), m_key.size() );
+    m_decryption.SetKey( m_key.BytePtr(), m_key.size() );
+
+}
+
+void FileCipher::get_part_iv(int part_number, byte* iv) const
+{
+
+    std::copy( m_nonce_prefix.BytePtr(), m_nonce_prefix.BytePtr() + CIPHER_NONCE_PREFIX_SZ, iv );
+
+    for ( int i=0; i < 4; i++ )
+    {
+        iv[CIPHER_NONCE_PREFIX_SZ + i] = (byte)( (unsigned int)part_number >> (8 * (3 - i)) );
+    }
+
+}
+
+void FileCipher::get_part_aad(int part_number, bool last, byte* aad)
+{
+
+    for ( int i=0; i < 4; i++ )
+    {
+        aad[i] = (byte)( (unsigned int)part_number >> (8 * (3 - i)) );
+    }
+
+    aad[4] = last ? 1 : 0;
+
+}
+
+void FileCipher::encrypt_part(std::string& buffer, int part_number, bool last)
+{
+
+    size_t length = buffer.size();
+
+    buffer.resize( length + CIPHER_TAG_SZ );
+    encrypt_part( &buffer[0], length, part_number, last );
+
+}
+
+void FileCipher::encrypt_part(char* buffer, size_t length, int part_number, bool last)
+{
+
+    byte iv[CIPHER_IV_SZ];
+    byte aad[5];
+
+    get_part_iv( part_number, iv );
+    get_part_aad( part_number, last, aad );
+
+    //GCM is a stream mode, the ciphertext overwrites the plaintext
+    byte* data = (byte*)buffer;
+    m_encryption.EncryptAndAuthenticate( data, data + length, CIPHER_TAG_SZ, iv, sizeof(iv), aad, sizeof(aad), data, length );
+
+}
+
+bool FileCipher::decrypt_part(std::string& buffer, int part_number, bool last)
+{
+
+    if ( buffer.size() < CIPHER_TAG_SZ ) {
+        return false;
+    }
+
+    byte iv[CIPHER_IV_SZ];
+    byte aad[5];
+
+    get_part_iv( part_number, iv );
+    get_part_aad( part_number, last, aad );
+
+    size_t length = buffer.size() - CIPHER_TAG_SZ;
+    byte* data = (byte*)&buffer[0];
+
+    if ( !m_decryption.DecryptAndVerify( data, data + length, CIPHER_TAG_SZ, iv, sizeof(iv), aad, sizeof(aad), data, length ) ) {
+        return false;
+    }
+
+    buffer.resize(length);
+
+    return true;
+
+}
+
+std::string FileCipher::wrap_key(const std::string& tenant_key, const std::string& key)
+{
+
+    if ( tenant_key.size() != CIPHER_KEY_SZ ) {
+        throw CryptoException( CryptoException::BadKey, "Tenant key must be " + std::to_string(CIPHER_KEY_SZ) + " bytes" );
+    }
+
+    byte iv[CIPHER_IV_SZ];
+    byte tag[CIPHER_TAG_SZ];
+    byte version = CIPHER_WRAP_VERSION;
+
+    AutoSeededRandomPool rng;
+    rng.GenerateBlock( iv, sizeof(iv) );
+
+    std::string sealed(key);
+
+    GCM<AES>::Encryption wrap;
+    wrap.SetKey( (const byte*)tenant_key.data(), tenant_key.size() );
+    wrap.EncryptAndAuthenticate( (byte*)&sealed[0], tag, sizeof(tag), iv, sizeof(iv), &version, 1, (const byte*)sealed.data(), sealed.size() );
+
+    std::string wrapped;
+    wrapped.append( (const char*)&version, 1 );
+    wrapped.append( (const char*)iv, sizeof(iv) );
+    wrapped.append( sealed );
+    wrapped.append( (const char*)tag, sizeof(tag) );
+
+    return Hash::get_base64(wrapped);
+
+}
+
+std::string FileCipher::unwrap_key(const std::string& tenant_key, const std::string& wrapped_key)
+{
+
+    if ( tenant_key.size() != CIPHER_KEY_SZ ) {
+        throw CryptoException( CryptoException::BadKey, "Tenant key must be " + std::to_string(CIPHER_KEY_SZ) + " bytes" );
+    }
+
+    std::string wrapped = Hash::base64_decode(wrapped_key);
+    size_t key_size = CIPHER_KEY_SZ + CIPHER_NONCE_PREFIX_SZ;
+
+    if ( wrapped.size() != 1 + CIPHER_IV_SZ + key_size + CIPHER_TAG_SZ || (byte)wrapped[0] != CIPHER_WRAP_VERSION ) {
+        throw CryptoException( CryptoException::BadKey, "Unsupported wrapped file key" );
+    }
+
+    const byte* version = (const byte*)wrapped.data();
+    const byte* iv = version + 1;
+    const byte* sealed = iv + CIPHER_IV_SZ;
+    const byte* tag = sealed + key_size;
+
+    std::string key( key_size, '\0' );
+
+    GCM<AES>::Decryption unwrap;
+    unwrap.SetKey( (const byte*)tenant_key.data(), tenant_key.size() );
+
+    if ( !unwrap.DecryptAndVerify( (byte*)&key[0], tag, CIPHER_TAG_SZ, iv, CIPHER_IV_SZ, version, 1, sealed, key_size ) ) {
+        throw CryptoException( CryptoException::DecryptFailed, "File key was not wrapped with the tenant key" );
+    }
+
+    return key;
+
+}
+
+std::string FileCipher::get_tenant_key()
+{
+
+    std::string key_file = LocalDatabase::get_database().get_setting_str("tenant_key_file");
+
+    if ( key_file.empty() ) {
+        key_file = CIPHER_TENANT_KEY_FILE;
+    }
+
+    std::string key;
+
+    if ( !fs::exists(key_file) )
+    {
+
+        SecByteBlock block(CIPHER_KEY_SZ);
+        AutoSeededRandomPool rng;
+        rng.GenerateBlock( block.BytePtr(), block.size() );
+
+        key.assign( (const char*)block.BytePtr(), block.size() );
+
+        boost::system::error_code ec;
+        fs::create_directories( fs::path(key_file).parent_path(), ec );
+
+        std::ofstream outfile( key_file, std::ios::out | std::ios::trunc );
+        if ( !outfile.is_open() ) {
+            throw CryptoException( CryptoException::BadKeyFile, "Unable to create tenant key file: " + key_file );
+        }
+
+        outfile << Hash::get_base64(key) << '\n';
+        outfile.close();
+
+        fs::permissions( key_file, fs::owner_read | fs::owner_write, ec );
+
+        //Encrypted backups can not be restored without this key
+        Log::get_log().add_message("Generated a new tenant key, keep a copy of " + key_file + " to restore encrypted files", "Encryption");
+
+        return key;
+
+    }
+
+    std::ifstream infile( key_file, std::ios::in );
+    if ( !infile.is_open() ) {
+        throw CryptoException( CryptoException::BadKeyFile, "Unable to open tenant key file: " + key_file );
+    }
+
+    std::string line;
+    std::getline( infile, line );
+    infile.close();
+
+    key = Hash::base64_decode( boost::trim_copy(line) );
+
+    if ( key.size() != CIPHER_KEY_SZ ) {
+        throw CryptoException( CryptoException::BadKeyFile, "Invalid tenant key in " + key_file );
+    }
+
+    return key;
+
+}
+
+bool FileCipher::is_enabled()
+{
+    return LocalDatabase::get_database().get_setting_int("encrypt_transfer") == 1;
+}
@@ -36,6 +36,18 @@ std::string Hash::get_sha256_hash(const std::string& data)
     return digest;
 }
 
+std::string Hash::get_sha256_hash(const char* data, size_t length)
+{
+
+    SHA256 hash;
+    std::string digest;
+
+    StringSource s((const unsigned char*)data, length, true, new HashFilter(hash, new HexEncoder( new StringSink(digest), false ) ) );
+
+    return digest;
+
+}
+
 std::string Hash::get_md5_hash(const std::string& data, bool base64)
 {
 
@@ -70,6 +82,23 @@ std::string Hash::get_md5_hash(const std::string& data, bool base64)
     return digest;
 }
 
+std::string Hash::get_md5_hash(const char* data, size_t length, bool base64)
+{
+
+    Weak::MD5 hash;
+    std::string digest;
+
+    if ( !base64 ) {
+        StringSource s((const unsigned char*)data, length, true, new HashFilter(hash, new HexEncoder( new StringSink(digest), false ) ) );
+    }
+    else {
+        StringSource s((const unsigned char*)data, length, true, new HashFilter(hash, new Base64Encoder( new StringSink(digest), false ) ) );
+    }
+
+    return digest;
+
+}
+
 std::string Hash::get_base64( const std::string& data )
 {
 
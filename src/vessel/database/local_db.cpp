@@ -198,8 +198,9 @@ bool LocalDatabase::update_ext_count(const std::string& ext, int total )
 
 void LocalDatabase::clean()
 {
-    this->clean_dirs();
+    //Files are cleaned first, the delete journal needs the path of their directory
     this->clean_files();
+    this->clean_dirs();
 }
 
 void LocalDatabase::clean_dirs()
@@ -273,7 +274,7 @@ void LocalDatabase::clean_files()
 
         if ( !boost::filesystem::exists(dir + PATH_SEPARATOR() + filename) )
         {
-            purge_file( file_id );
+            purge_file( file_id, true );
         }
 
     }
@@ -448,9 +449,14 @@ std::string LocalDatabase::get_sqlite_str(const void* data)
     return (data != NULL) ? (const char*)data : "";
 }
 
-void LocalDatabase::purge_file( unsigned char* file_id )
+void LocalDatabase::purge_file( unsigned char* file_id, bool remove_object )
 {
 
+    //The object is removed from the provider once the retention period is over
+    if ( remove_object ) {
+        journal_delete( file_id );
+    }
+
     std::vector<std::string> queries;
     queries.push_back("DELETE FROM backup_file WHERE file_id=?1");
     queries.push_back("DELETE FROM backup_upload WHERE file_id=?1");
@@ -485,6 +491,35 @@ void LocalDatabase::purge_file( unsigned char* file_id )
 
 }
 
+void LocalDatabase::journal_delete( unsigned char* file_id )
+{
+
+    //Files stored in the pack repository of their provider (backup_repo_file) share their blobs, they have no object of their own to remove
+    sqlite3_stmt* stmt;
+    std::string query = "INSERT INTO backup_delete_journal (provider_id,file_path,file_name,hash,created) "
+                        "SELECT bf.provider_id,bd.path,bf.filename,bf.last_backup_hash,?2 FROM backup_file AS bf "
+                        "INNER JOIN backup_directory AS bd ON bf.directory_id=bd.directory_id "
+                        "INNER JOIN backup_provider AS bp ON bf.provider_id=bp.provider_id "
+                        "WHERE bf.file_id=?1 AND bf.last_backup_time > 0 AND bp.type != 'vessel' "
+                        "AND NOT EXISTS (SELECT 1 FROM backup_repo_file AS rf WHERE rf.file_id=bf.file_id)";
+
+    if ( sqlite3_prepare_v2(m_db, query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        m_log->add_error("Failed to journal deleted file: " + get_last_err(), "Database Cleaner");
+        return;
+    }
+
+    sqlite3_bind_blob(stmt, 1, file_id, sizeof(file_id), 0);
+    sqlite3_bind_int64(stmt, 2, std::time(nullptr) );
+
+    if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+        m_log->add_error("Failed to journal deleted file: " + get_last_err(), "Database Cleaner");
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
 void LocalDatabase::purge_upload(unsigned int upload_id)
 {
 
@@ -0,0 +1,202 @@
+#include <vessel/filesystem/buffer_pool.hpp>
+
+#ifdef _WIN32
+    #include <malloc.h>
+#else
+    #include <stdlib.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+#endif
+
+using namespace Vessel::File;
+
+PartBuffer::PartBuffer(char* data, size_t capacity) : m_data(data), m_capacity(capacity), m_size(0)
+{
+
+}
+
+PartBuffer::~PartBuffer()
+{
+    BufferPool::get_pool().release(m_data, m_capacity);
+}
+
+void PartBuffer::resize(size_t size)
+{
+    m_size = std::min(size, m_capacity);
+}
+
+bool PartBuffer::read_chunk(std::string& chunk, size_t& offset) const
+{
+
+    if ( offset >= m_size ) {
+        return false;
+    }
+
+    size_t length = std::min( (size_t)BUFFER_SEND_SZ, m_size - offset );
+    chunk.assign( m_data + offset, length );
+    offset += length;
+
+    return true;
+
+}
+
+BufferPool& BufferPool::get_pool()
+{
+    static BufferPool pool;
+    return pool;
+}
+
+BufferPool::BufferPool() : m_in_use(0), m_cached(0)
+{
+
+    LocalDatabase* ldb = &LocalDatabase::get_database();
+
+    int budget = ldb->get_setting_int("upload_memory_budget");
+    m_budget = ( budget > 0 ) ? budget : BUFFER_POOL_BUDGET;
+
+    #ifdef _WIN32
+        m_alignment = 4096;
+        m_huge_pages = false;
+    #else
+        m_alignment = sysconf(_SC_PAGESIZE);
+
+        //Transparent huge pages cut TLB misses while large parts are hashed and encrypted
+        #ifdef MADV_HUGEPAGE
+            m_huge_pages = ( ldb->get_setting_int("upload_huge_pages") == 1 );
+        #else
+            m_huge_pages = false;
+        #endif
+
+        if ( m_huge_pages ) {
+            m_alignment = BUFFER_HUGE_PAGE_SZ;
+        }
+    #endif
+
+}
+
+BufferPool::~BufferPool()
+{
+
+    for ( auto& itr : m_free ) {
+        free_buffer(itr.second);
+    }
+
+}
+
+std::shared_ptr<PartBuffer> BufferPool::acquire(size_t size)
+{
+
+    //Buffers are a whole number of pages
+    size_t capacity = ( (std::max(size, (size_t)1) + m_alignment - 1) / m_alignment ) * m_alignment;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    //Buffers are only released by the thread that holds them, waiting for the budget would never return
+    if ( m_in_use > 0 && m_in_use + capacity > m_budget ) {
+        Log::get_log().add_message("Part buffer of " + std::to_string(capacity) + " bytes exceeds the upload memory budget, " + std::to_string(m_in_use) + " bytes are in use", "Buffer Pool");
+    }
+    else if ( capacity > m_budget ) {
+        Log::get_log().add_message("Part buffer of " + std::to_string(capacity) + " bytes exceeds the upload memory budget", "Buffer Pool");
+    }
+
+    char* data = nullptr;
+
+    //Reuse a released buffer that is not much larger than needed
+    auto itr = m_free.lower_bound(capacity);
+
+    if ( itr != m_free.end() && itr->first <= capacity * 2 )
+    {
+        capacity = itr->first;
+        data = itr->second;
+        m_cached -= capacity;
+        m_free.erase(itr);
+    }
+    else
+    {
+        trim(capacity);
+        data = allocate(capacity);
+    }
+
+    m_in_use += capacity;
+
+    return std::make_shared<PartBuffer>(data, capacity);
+
+}
+
+size_t BufferPool::get_in_use()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_in_use;
+}
+
+void BufferPool::release(char* data, size_t capacity)
+{
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_in_use -= capacity;
+
+    //Buffers are kept for the next part while they fit in the budget
+    if ( m_in_use + m_cached + capacity <= m_budget )
+    {
+        m_free.insert( std::make_pair(capacity, data) );
+        m_cached += capacity;
+    }
+    else
+    {
+        free_buffer(data);
+    }
+
+}
+
+void BufferPool::trim(size_t capacity)
+{
+
+    //Free the smallest buffers first, they are the least likely to be reused for large parts
+    while ( !m_free.empty() && m_in_use + m_cached + capacity > m_budget )
+    {
+        auto itr = m_free.begin();
+        m_cached -= itr->first;
+        free_buffer(itr->second);
+        m_free.erase(itr);
+    }
+
+}
+
+char* BufferPool::allocate(size_t capacity)
+{
+
+    void* data = nullptr;
+
+    #ifdef _WIN32
+        data = _aligned_malloc(capacity, m_alignment);
+    #else
+        if ( posix_memalign(&data, m_alignment, capacity) != 0 ) {
+            data = nullptr;
+        }
+
+        #ifdef MADV_HUGEPAGE
+            if ( data && m_huge_pages ) {
+                madvise(data, capacity, MADV_HUGEPAGE);
+            }
+        #endif
+    #endif
+
+    if ( !data ) {
+        throw std::bad_alloc();
+    }
+
+    return (char*)data;
+
+}
+
+void BufferPool::free_buffer(char* data)
+{
+
+    #ifdef _WIN32
+        _aligned_free(data);
+    #else
+        free(data);
+    #endif
+
+}
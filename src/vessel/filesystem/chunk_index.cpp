@@ -0,0 +1,152 @@
+#include <vessel/filesystem/chunk_index.hpp>
+
+using namespace Vessel::File;
+
+ChunkIndex::ChunkIndex()
+{
+    m_database = &LocalDatabase::get_database();
+}
+
+bool ChunkIndex::is_chunkable(const BackupFile& file)
+{
+
+    int min_size = LocalDatabase::get_database().get_setting_int("cdc_min_filesize");
+
+    return file.get_file_size() >= (size_t)( ( min_size > 0 ) ? min_size : CDC_MIN_FILE_SZ );
+
+}
+
+bool ChunkIndex::contains(const std::string& hash)
+{
+
+    bool found = false;
+
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT 1 FROM backup_chunk WHERE hash=?1";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to find chunk: " + m_database->get_last_err(), "Chunk Index");
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, hash.c_str(), hash.size(), 0 );
+
+    if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        found = true;
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return found;
+
+}
+
+bool ChunkIndex::add_chunk(const std::string& hash, sqlite3_int64 pack_id, size_t offset, size_t length)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "INSERT OR IGNORE INTO backup_chunk (hash,pack_id,byte_offset,length,created) VALUES(?1,?2,?3,?4,?5)";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to add chunk: " + m_database->get_last_err(), "Chunk Index");
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, hash.c_str(), hash.size(), 0 );
+    sqlite3_bind_int64(stmt, 2, pack_id );
+    sqlite3_bind_int64(stmt, 3, offset );
+    sqlite3_bind_int64(stmt, 4, length );
+    sqlite3_bind_int64(stmt, 5, std::time(nullptr) );
+
+    bool success = ( sqlite3_step(stmt) == SQLITE_DONE );
+
+    if ( !success ) {
+        Log::get_log().add_error("Failed to add chunk: " + m_database->get_last_err(), "Chunk Index");
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return success;
+
+}
+
+bool ChunkIndex::get_location(const std::string& hash, std::string& object_key, size_t& offset)
+{
+
+    bool found = false;
+
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT p.object_key,c.byte_offset FROM backup_chunk c INNER JOIN backup_pack p ON p.pack_id=c.pack_id WHERE c.hash=?1";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to find chunk: " + m_database->get_last_err(), "Chunk Index");
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, hash.c_str(), hash.size(), 0 );
+
+    if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        object_key = std::string( (const char*)sqlite3_column_text(stmt, 0) );
+        offset = sqlite3_column_int64(stmt, 1);
+        found = true;
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return found;
+
+}
+
+bool ChunkIndex::save_recipe(std::shared_ptr<unsigned char> file_id, const std::vector<ChunkRef>& chunks)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "DELETE FROM backup_file_chunk WHERE file_id=?1";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to save file chunks: " + m_database->get_last_err(), "Chunk Index");
+        return false;
+    }
+
+    m_database->start_transaction();
+
+    sqlite3_bind_blob(stmt, 1, file_id.get(), sizeof(file_id.get()), 0 );
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    query = "INSERT INTO backup_file_chunk (file_id,seq,hash,length) VALUES(?1,?2,?3,?4)";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to save file chunks: " + m_database->get_last_err(), "Chunk Index");
+        m_database->end_transaction();
+        return false;
+    }
+
+    bool success = true;
+
+    for ( size_t i=0; i < chunks.size(); i++ )
+    {
+        sqlite3_bind_blob(stmt, 1, file_id.get(), sizeof(file_id.get()), 0 );
+        sqlite3_bind_int(stmt, 2, i );
+        sqlite3_bind_text(stmt, 3, chunks[i].hash.c_str(), chunks[i].hash.size(), 0 );
+        sqlite3_bind_int64(stmt, 4, chunks[i].length );
+
+        if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+            Log::get_log().add_error("Failed to save file chunk: " + m_database->get_last_err(), "Chunk Index");
+            success = false;
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    m_database->end_transaction();
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return success;
+
+}
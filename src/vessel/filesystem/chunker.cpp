@@ -0,0 +1,143 @@
+#include <vessel/filesystem/chunker.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace Vessel::File;
+
+Chunker::Chunker(size_t min_size, size_t avg_size, size_t max_size) : m_min_size(min_size), m_avg_size(avg_size), m_max_size(max_size)
+{
+
+    //Number of bits in the average chunk size
+    int bits = 0;
+    while ( ((size_t)1 << (bits+1)) <= m_avg_size ) {
+        bits++;
+    }
+
+    m_mask_s = get_mask( bits + CDC_NORMALIZATION );
+    m_mask_l = get_mask( bits - CDC_NORMALIZATION );
+
+}
+
+const uint64_t* Chunker::get_gear_table()
+{
+
+    static uint64_t gear[256];
+    static bool initialized = false;
+
+    if ( !initialized )
+    {
+        //SplitMix64 with a fixed seed
+        uint64_t seed = 0x56657373656C4344ULL;
+
+        for ( int i=0; i < 256; i++ )
+        {
+            uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            gear[i] = z ^ (z >> 31);
+        }
+
+        initialized = true;
+    }
+
+    return gear;
+
+}
+
+uint64_t Chunker::get_mask(int bits)
+{
+
+    //The gear hash shifts left, so the upper bits depend on the most bytes
+    bits = std::max( 1, std::min( bits, 48 ) );
+
+    return ~0ULL << (64 - bits);
+
+}
+
+size_t Chunker::find_boundary(const unsigned char* data, size_t length) const
+{
+
+    if ( length <= m_min_size )
+        return length;
+
+    const uint64_t* gear = get_gear_table();
+
+    size_t max_len = std::min( length, m_max_size );
+    size_t normal_len = std::min( max_len, m_avg_size );
+    size_t i = m_min_size; //Cut-point skipping: no boundary before the minimum size
+    uint64_t fp = 0;
+
+    //Before the average size, use the stricter mask
+    for ( ; i < normal_len; i++ )
+    {
+        fp = (fp << 1) + gear[ data[i] ];
+        if ( !(fp & m_mask_s) )
+            return i + 1;
+    }
+
+    //After the average size, use the looser mask
+    for ( ; i < max_len; i++ )
+    {
+        fp = (fp << 1) + gear[ data[i] ];
+        if ( !(fp & m_mask_l) )
+            return i + 1;
+    }
+
+    return max_len;
+
+}
+
+bool Chunker::chunk_file(const std::string& file_path, const ChunkCallback& callback) const
+{
+
+    std::ifstream infile( file_path, std::ios::in | std::ios::binary );
+    if ( !infile.is_open() ) {
+        return false;
+    }
+
+    std::vector<char> buffer( std::max( (size_t)CDC_BUFFER_SZ, m_max_size * 2 ) );
+    size_t start = 0; //Start of unchunked data in the buffer
+    size_t end = 0; //End of the data in the buffer
+    size_t file_offset = 0;
+    bool eof = false;
+
+    while ( true )
+    {
+
+        //Refill the buffer when less than a maximum chunk remains
+        if ( !eof && (end - start) < m_max_size )
+        {
+            std::memmove( buffer.data(), buffer.data() + start, end - start );
+            end -= start;
+            start = 0;
+
+            infile.read( buffer.data() + end, buffer.size() - end );
+            end += infile.gcount();
+
+            if ( infile.bad() ) {
+                return false;
+            }
+
+            if ( !infile ) {
+                eof = true;
+            }
+        }
+
+        if ( start == end )
+            break;
+
+        size_t length = find_boundary( (const unsigned char*)buffer.data() + start, end - start );
+
+        if ( !callback( buffer.data() + start, length, file_offset ) ) {
+            return false;
+        }
+
+        start += length;
+        file_offset += length;
+
+    }
+
+    return true;
+
+}
@@ -0,0 +1,287 @@
+#include <vessel/filesystem/delete_journal.hpp>
+
+using namespace Vessel::File;
+
+DeleteJournal::DeleteJournal()
+{
+    m_database = &LocalDatabase::get_database();
+}
+
+size_t DeleteJournal::remove_expired(const std::string& provider_id, size_t batch_size, const RemoveCallback& remove_files)
+{
+
+    size_t total_removed = 0;
+
+    for ( ;; )
+    {
+
+        std::vector<DeletedFile> expired;
+
+        if ( !get_expired( provider_id, batch_size, expired ) || expired.empty() ) {
+            break;
+        }
+
+        std::vector<DeletedFile> batch;
+        std::vector<DeletedFile> referenced;
+        std::vector<unsigned long> superseded;
+
+        for ( const auto& file : expired )
+        {
+            //A file backed up to the same path again owns the object now
+            if ( is_backed_up(file) ) {
+                superseded.push_back( file.delete_id );
+            }
+            //Duplicates on the server still point at the object, it is removed once they are gone
+            else if ( is_referenced(file) ) {
+                referenced.push_back(file);
+            }
+            else {
+                batch.push_back(file);
+            }
+        }
+
+        remove(superseded);
+        postpone(referenced);
+
+        if ( batch.empty() ) {
+            continue;
+        }
+
+        //Recorded before the request, so an interrupted batch is sent again once DELETE_RETRY_SECS have passed
+        start_delete(batch);
+
+        std::vector<unsigned long> removed = remove_files(batch);
+
+        remove(removed);
+        total_removed += removed.size();
+
+        //The provider is not removing objects, the rest of the journal waits for the next run
+        if ( removed.empty() ) {
+            break;
+        }
+
+    }
+
+    return total_removed;
+
+}
+
+bool DeleteJournal::get_expired(const std::string& provider_id, size_t limit, std::vector<DeletedFile>& files)
+{
+
+    std::time_t now = std::time(nullptr);
+    std::time_t deleted_before = now - (std::time_t)get_retention_days() * 86400;
+
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT delete_id,provider_id,file_path,file_name,hash FROM backup_delete_journal WHERE provider_id=?1 AND created <= ?2 AND last_attempt <= ?3 ORDER BY delete_id LIMIT ?4";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to read delete journal: " + m_database->get_last_err(), "Delete Journal");
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, provider_id.c_str(), provider_id.size(), 0 );
+    sqlite3_bind_int64(stmt, 2, deleted_before );
+    sqlite3_bind_int64(stmt, 3, now - DELETE_RETRY_SECS );
+    sqlite3_bind_int64(stmt, 4, limit );
+
+    while ( sqlite3_step(stmt) == SQLITE_ROW )
+    {
+        DeletedFile file;
+        file.delete_id = sqlite3_column_int64(stmt, 0);
+        file.provider_id = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 1) );
+        file.file_path = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 2) );
+        file.file_name = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 3) );
+        file.hash = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 4) );
+        files.push_back(file);
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return true;
+
+}
+
+bool DeleteJournal::is_backed_up(const DeletedFile& file)
+{
+
+    bool found = false;
+
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT 1 FROM backup_file AS bf INNER JOIN backup_directory AS bd ON bf.directory_id=bd.directory_id WHERE bd.path=?1 AND bf.filename=?2 AND bf.provider_id=?3 AND bf.last_backup_time > 0";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to find backed up file: " + m_database->get_last_err(), "Delete Journal");
+        return true; //The object is kept if in doubt
+    }
+
+    sqlite3_bind_text(stmt, 1, file.file_path.c_str(), file.file_path.size(), 0 );
+    sqlite3_bind_text(stmt, 2, file.file_name.c_str(), file.file_name.size(), 0 );
+    sqlite3_bind_text(stmt, 3, file.provider_id.c_str(), file.provider_id.size(), 0 );
+
+    if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        found = true;
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return found;
+
+}
+
+bool DeleteJournal::is_referenced(const DeletedFile& file)
+{
+
+    //Entries journaled without a hash can not be matched
+    if ( file.hash.empty() ) {
+        return false;
+    }
+
+    bool found = false;
+
+    //Uses idx_file_backup_hash
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT 1 FROM backup_file WHERE last_backup_hash=?1 AND last_backup_time > 0 LIMIT 1";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to find referencing file: " + m_database->get_last_err(), "Delete Journal");
+        return true; //The object is kept if in doubt
+    }
+
+    sqlite3_bind_text(stmt, 1, file.hash.c_str(), file.hash.size(), 0 );
+
+    if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        found = true;
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return found;
+
+}
+
+void DeleteJournal::start_delete(const std::vector<DeletedFile>& files)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "UPDATE backup_delete_journal SET attempts=attempts+1,last_attempt=?2 WHERE delete_id=?1";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to update delete journal: " + m_database->get_last_err(), "Delete Journal");
+        return;
+    }
+
+    std::time_t now = std::time(nullptr);
+
+    m_database->start_transaction();
+
+    for ( const auto& file : files )
+    {
+        sqlite3_bind_int64(stmt, 1, file.delete_id );
+        sqlite3_bind_int64(stmt, 2, now );
+
+        if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+            Log::get_log().add_error("Failed to update delete journal: " + m_database->get_last_err(), "Delete Journal");
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    m_database->end_transaction();
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+void DeleteJournal::postpone(const std::vector<DeletedFile>& files)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "UPDATE backup_delete_journal SET last_attempt=?2 WHERE delete_id=?1";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to update delete journal: " + m_database->get_last_err(), "Delete Journal");
+        return;
+    }
+
+    std::time_t now = std::time(nullptr);
+
+    m_database->start_transaction();
+
+    for ( const auto& file : files )
+    {
+        sqlite3_bind_int64(stmt, 1, file.delete_id );
+        sqlite3_bind_int64(stmt, 2, now );
+
+        if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+            Log::get_log().add_error("Failed to update delete journal: " + m_database->get_last_err(), "Delete Journal");
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    m_database->end_transaction();
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+void DeleteJournal::remove(const std::vector<unsigned long>& delete_ids)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "DELETE FROM backup_delete_journal WHERE delete_id=?1";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to update delete journal: " + m_database->get_last_err(), "Delete Journal");
+        return;
+    }
+
+    m_database->start_transaction();
+
+    for ( const auto& delete_id : delete_ids )
+    {
+        sqlite3_bind_int64(stmt, 1, delete_id );
+
+        if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+            Log::get_log().add_error("Failed to update delete journal: " + m_database->get_last_err(), "Delete Journal");
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    m_database->end_transaction();
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+void DeleteJournal::remove_orphans()
+{
+
+    std::string query = "DELETE FROM backup_delete_journal WHERE provider_id NOT IN (SELECT provider_id FROM backup_provider)";
+
+    if ( sqlite3_exec(m_database->get_handle(), query.c_str(), NULL, NULL, NULL) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to clean delete journal: " + m_database->get_last_err(), "Delete Journal");
+    }
+
+}
+
+int DeleteJournal::get_retention_days()
+{
+
+    std::string days = LocalDatabase::get_database().get_setting_str("delete_retention_days");
+
+    if ( days.empty() ) {
+        return DELETE_RETENTION_DAYS;
+    }
+
+    return std::max( LocalDatabase::get_database().get_setting_int("delete_retention_days"), 0 );
+
+}
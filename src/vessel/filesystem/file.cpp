@@ -4,14 +4,14 @@ using namespace Vessel::File;
 
 size_t BackupFile::m_chunk_size = BACKUP_CHUNK_SZ;
 
-BackupFile::BackupFile(const fs::path& fp ) : m_file_path(fp)
+BackupFile::BackupFile(const fs::path& fp ) : m_file_path(fp), m_part_size(m_chunk_size)
 {
     m_directory_id=-1;
     m_readable=true;
     update_attributes();
 }
 
-BackupFile::BackupFile( std::shared_ptr<unsigned char> file_id )
+BackupFile::BackupFile( std::shared_ptr<unsigned char> file_id ) : m_part_size(m_chunk_size)
 {
 
     //Set the file id
@@ -39,7 +39,7 @@ BackupFile::BackupFile( std::shared_ptr<unsigned char> file_id )
     m_file_attrs.parent_path = m_file_path.parent_path().string();
     m_file_attrs.file_type = m_file_path.extension().string();
     m_file_attrs.mime_type = find_mime_type(m_file_attrs.file_type);
-    m_file_attrs.file_size = (unsigned long)sqlite3_column_int(stmt,2);
+    m_file_attrs.file_size = (unsigned long)sqlite3_column_int64(stmt,2);
     m_file_attrs.last_write_time = (unsigned long)sqlite3_column_int(stmt, 4);
     m_directory_id = (int)sqlite3_column_int(stmt, 3);
 
@@ -217,6 +217,9 @@ std::string BackupFile::get_hash_sha1()
 
     }
 
+    //Cache the hash so the file is only read once
+    m_file_attrs.content_sha1 = digest;
+
     return digest;
 
 }
@@ -403,9 +406,19 @@ void BackupFile::set_chunk_size(size_t chunk_sz)
     m_chunk_size = chunk_sz;
 }
 
+void BackupFile::set_part_size(size_t part_sz)
+{
+    m_part_size = part_sz;
+}
+
+size_t BackupFile::get_part_size() const
+{
+    return m_part_size;
+}
+
 unsigned int BackupFile::get_total_parts() const
 {
-    return std::ceil( get_file_size() / (double)m_chunk_size );
+    return std::ceil( get_file_size() / (double)m_part_size );
 }
 
 void BackupFile::set_upload_id(unsigned int upload_id)
@@ -428,15 +441,15 @@ std::string BackupFile::get_upload_key() const
     return m_upload_key;
 }
 
-std::string BackupFile::get_file_part(unsigned int num) {
+std::string BackupFile::get_file_part(unsigned int num, size_t reserve) {
 
     size_t total_bytes = get_file_size();
 
-    size_t start_pos = ((m_chunk_size * num) - m_chunk_size);
-    size_t end_pos = (start_pos + m_chunk_size) -1;
+    size_t start_pos = ((m_part_size * num) - m_part_size);
+    size_t end_pos = (start_pos + m_part_size) -1;
 
     if ( start_pos >= total_bytes )
-        start_pos = (total_bytes - m_chunk_size) >= 0 ? (total_bytes - m_chunk_size) : 0;
+        start_pos = (total_bytes > m_part_size) ? (total_bytes - m_part_size) : 0;
 
     if ( total_bytes <= end_pos )
         end_pos = get_file_size()-1;
@@ -449,6 +462,7 @@ std::string BackupFile::get_file_part(unsigned int num) {
 
         size_t bytes_to_read = (end_pos - start_pos) + 1;
 
+        file_part.reserve( bytes_to_read + reserve );
         file_part.resize( bytes_to_read ); //Optimize string alloc
 
         //Read file contents
@@ -469,13 +483,45 @@ std::string BackupFile::get_file_part(unsigned int num) {
         if ( m_content.empty() )
             get_file_contents();
 
-        file_part = m_content.substr(start_pos, end_pos);
+        file_part.reserve( (end_pos - start_pos) + 1 + reserve );
+        file_part.assign( m_content, start_pos, (end_pos - start_pos) + 1 );
     }
 
     return file_part;
 
 }
 
+std::shared_ptr<PartBuffer> BackupFile::read_part(unsigned int num, size_t reserve)
+{
+
+    size_t total_bytes = get_file_size();
+    size_t start_pos = (m_part_size * num) - m_part_size;
+
+    if ( start_pos >= total_bytes ) {
+        return std::shared_ptr<PartBuffer>();
+    }
+
+    size_t bytes_to_read = std::min( m_part_size, total_bytes - start_pos );
+
+    std::ifstream infile( get_file_path(), std::ios::in | std::ios::binary );
+    if ( !infile.is_open() ) {
+        m_readable = false;
+        return std::shared_ptr<PartBuffer>();
+    }
+
+    std::shared_ptr<PartBuffer> buffer = BufferPool::get_pool().acquire( bytes_to_read + reserve );
+
+    infile.seekg( start_pos, std::ios::beg );
+    infile.read( buffer->data(), bytes_to_read );
+
+    buffer->resize( infile.gcount() );
+
+    infile.close();
+
+    return buffer;
+
+}
+
 /*
 std::shared_ptr<BackupFile> BackupFile::get_compressed_copy()
 {
@@ -536,23 +582,24 @@ bool BackupFile::is_readable()
 
 void BackupFile::update_last_backup()
 {
-    update_last_backup( get_file_id() );
+    update_last_backup( get_file_id(), get_hash_sha1() );
 }
 
-void BackupFile::update_last_backup(std::shared_ptr<unsigned char> file_id)
+void BackupFile::update_last_backup(std::shared_ptr<unsigned char> file_id, const std::string& hash)
 {
 
     std::time_t now = std::time(nullptr);
 
     sqlite3_stmt* stmt;
-    std::string query = "UPDATE backup_file SET last_backup_time=?1 WHERE file_id=?2";
+    std::string query = "UPDATE backup_file SET last_backup_time=?1,last_backup_hash=?2 WHERE file_id=?3";
 
     if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
         Log::get_log().add_error("Unable to set file last backup time: " + LocalDatabase::get_database().get_last_err(), "File Backup");
     }
 
     sqlite3_bind_int(stmt, 1, now );
-    sqlite3_bind_blob(stmt, 2, file_id.get(), sizeof(file_id.get()), 0 );
+    sqlite3_bind_text(stmt, 2, hash.c_str(), hash.size(), 0 );
+    sqlite3_bind_blob(stmt, 3, file_id.get(), sizeof(file_id.get()), 0 );
 
     if ( sqlite3_step(stmt) != SQLITE_DONE ) {
         Log::get_log().add_error("Unable to set file last backup time: " + LocalDatabase::get_database().get_last_err(), "File Backup");
@@ -563,6 +610,181 @@ void BackupFile::update_last_backup(std::shared_ptr<unsigned char> file_id)
 
 }
 
+void BackupFile::reset_last_backup(std::shared_ptr<unsigned char> file_id)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "UPDATE backup_file SET last_backup_time=0,last_backup_hash=NULL WHERE file_id=?1";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Unable to reset file last backup time: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+        return;
+    }
+
+    sqlite3_bind_blob(stmt, 1, file_id.get(), sizeof(file_id.get()), 0 );
+
+    if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+        Log::get_log().add_error("Unable to reset file last backup time: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+void BackupFile::update_compressed_size(size_t compressed_size)
+{
+
+    std::shared_ptr<unsigned char> file_id = get_file_id();
+
+    sqlite3_stmt* stmt;
+    std::string query = "UPDATE backup_file SET compressed_size=?1 WHERE file_id=?2";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Unable to set file compressed size: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+        return;
+    }
+
+    sqlite3_bind_int64(stmt, 1, compressed_size );
+    sqlite3_bind_blob(stmt, 2, file_id.get(), sizeof(file_id.get()), 0 );
+
+    if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+        Log::get_log().add_error("Unable to set file compressed size: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+void BackupFile::update_provider(const std::string& provider_id)
+{
+    update_provider( get_file_id(), provider_id );
+}
+
+void BackupFile::update_provider(std::shared_ptr<unsigned char> file_id, const std::string& provider_id)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "UPDATE backup_file SET provider_id=?1 WHERE file_id=?2";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Unable to set file storage provider: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+        return;
+    }
+
+    sqlite3_bind_text(stmt, 1, provider_id.c_str(), provider_id.size(), 0 );
+    sqlite3_bind_blob(stmt, 2, file_id.get(), sizeof(file_id.get()), 0 );
+
+    if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+        Log::get_log().add_error("Unable to set file storage provider: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+bool BackupFile::find_moved_file(const std::string& provider_id, MovedFile& moved) const
+{
+
+    bool found = false;
+    std::shared_ptr<unsigned char> file_id = get_file_id();
+
+    //Uses idx_file_moved
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT bf.file_id,bd.path,bf.filename,bf.last_backup_hash FROM backup_file AS bf INNER JOIN backup_directory AS bd ON bf.directory_id=bd.directory_id WHERE bf.filesize=?1 AND bf.last_modified=?2 AND bf.provider_id=?3 AND bf.file_id!=?4 AND bf.last_backup_hash IS NOT NULL";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Unable to find moved file: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt, 1, get_file_size() );
+    sqlite3_bind_int64(stmt, 2, get_last_modified() );
+    sqlite3_bind_text(stmt, 3, provider_id.c_str(), provider_id.size(), 0 );
+    sqlite3_bind_blob(stmt, 4, file_id.get(), sizeof(file_id.get()), 0 );
+
+    while ( !found && sqlite3_step(stmt) == SQLITE_ROW )
+    {
+
+        std::string file_path = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 1) );
+        std::string file_name = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 2) );
+
+        //The entry of a file that still exists is a copy, not the source of a move
+        if ( fs::exists( file_path + PATH_SEPARATOR() + file_name ) ) {
+            continue;
+        }
+
+        moved.file_key = std::string( (const char*)sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0) );
+        moved.file_path = file_path;
+        moved.file_name = file_name;
+        moved.hash = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 3) );
+        found = true;
+
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return found;
+
+}
+
+std::string BackupFile::get_last_backup_hash() const
+{
+
+    std::string hash;
+    std::shared_ptr<unsigned char> file_id = get_file_id();
+
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT last_backup_hash FROM backup_file WHERE file_id=?1";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Unable to get file last backup hash: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+        return hash;
+    }
+
+    sqlite3_bind_blob(stmt, 1, file_id.get(), sizeof(file_id.get()), 0 );
+
+    if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        hash = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 0) );
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return hash;
+
+}
+
+bool BackupFile::is_content_backed_up(const std::string& hash)
+{
+
+    bool found = false;
+
+    //Uses idx_file_backup_hash
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT 1 FROM backup_file WHERE last_backup_hash=?1 LIMIT 1";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Unable to find backed up content: " + LocalDatabase::get_database().get_last_err(), "File Backup");
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, hash.c_str(), hash.size(), 0 );
+
+    if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        found = true;
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return found;
+
+}
+
 std::string BackupFile::get_chunk(size_t offset, size_t length)
 {
 
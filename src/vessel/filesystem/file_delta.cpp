@@ -0,0 +1,410 @@
+#include <vessel/filesystem/file_delta.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace Vessel::File;
+using namespace Vessel::Logging;
+
+static void write_le(std::ostream& out, uint64_t value, int bytes)
+{
+    char buf[8];
+
+    for ( int i=0; i < bytes; i++ ) {
+        buf[i] = (value >> (8*i)) & 0xFF;
+    }
+
+    out.write( buf, bytes );
+}
+
+static uint64_t read_le(const unsigned char* data, int bytes)
+{
+    uint64_t value = 0;
+
+    for ( int i=0; i < bytes; i++ ) {
+        value |= (uint64_t)data[i] << (8*i);
+    }
+
+    return value;
+}
+
+FileSignature::FileSignature() : m_block_size(0), m_file_size(0)
+{
+
+}
+
+size_t FileSignature::get_block_size(size_t file_size)
+{
+
+    size_t block_size = ( (size_t)std::sqrt( (double)file_size ) / 1024 ) * 1024;
+
+    return std::max( (size_t)DELTA_MIN_BLOCK_SZ, std::min( block_size, (size_t)DELTA_MAX_BLOCK_SZ ) );
+
+}
+
+bool FileSignature::generate(const std::string& file_path)
+{
+
+    std::ifstream infile( file_path, std::ios::in | std::ios::binary );
+    if ( !infile.is_open() ) {
+        return false;
+    }
+
+    boost::system::error_code ec;
+    m_file_size = fs::file_size( file_path, ec );
+
+    if ( ec ) {
+        return false;
+    }
+
+    m_block_size = get_block_size( m_file_size );
+    m_blocks.clear();
+    m_blocks.reserve( m_file_size / m_block_size );
+
+    //Read several blocks at a time
+    std::vector<char> buffer( ( DELTA_BUFFER_SZ / m_block_size ) * m_block_size );
+    CryptoPP::SHA1 sha1;
+
+    while ( infile )
+    {
+        infile.read( buffer.data(), buffer.size() );
+        size_t length = infile.gcount();
+
+        if ( infile.bad() ) {
+            return false;
+        }
+
+        for ( size_t offset=0; offset + m_block_size <= length; offset += m_block_size )
+        {
+            const unsigned char* block = (const unsigned char*)buffer.data() + offset;
+
+            BlockSignature sig;
+            sig.weak = RollingChecksum::get_checksum( block, m_block_size );
+            sha1.CalculateDigest( sig.strong, block, m_block_size );
+
+            m_blocks.push_back(sig);
+        }
+    }
+
+    return true;
+
+}
+
+bool FileSignature::load(const std::string& signature_path)
+{
+
+    std::ifstream infile( signature_path, std::ios::in | std::ios::binary );
+    if ( !infile.is_open() ) {
+        return false;
+    }
+
+    unsigned char header[20];
+    infile.read( (char*)header, sizeof(header) );
+
+    if ( infile.gcount() != sizeof(header) || std::memcmp( header, SIGNATURE_MAGIC, 8 ) != 0 ) {
+        return false;
+    }
+
+    m_block_size = read_le( header + 8, 4 );
+    m_file_size = read_le( header + 12, 8 );
+
+    if ( m_block_size < DELTA_MIN_BLOCK_SZ || m_block_size > DELTA_MAX_BLOCK_SZ ) {
+        return false;
+    }
+
+    size_t total_blocks = m_file_size / m_block_size;
+    m_blocks.resize( total_blocks );
+
+    unsigned char entry[4 + DELTA_STRONG_SZ];
+
+    for ( size_t i=0; i < total_blocks; i++ )
+    {
+        infile.read( (char*)entry, sizeof(entry) );
+
+        if ( infile.gcount() != sizeof(entry) ) {
+            m_blocks.clear();
+            return false;
+        }
+
+        m_blocks[i].weak = read_le( entry, 4 );
+        std::memcpy( m_blocks[i].strong, entry + 4, DELTA_STRONG_SZ );
+    }
+
+    return true;
+
+}
+
+bool FileSignature::save(const std::string& signature_path) const
+{
+
+    fs::path tmp_path = signature_path + ".tmp";
+
+    std::ofstream outfile( tmp_path.string(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !outfile.is_open() ) {
+        return false;
+    }
+
+    outfile.write( SIGNATURE_MAGIC, 8 );
+    write_le( outfile, m_block_size, 4 );
+    write_le( outfile, m_file_size, 8 );
+
+    for ( const auto& block : m_blocks )
+    {
+        write_le( outfile, block.weak, 4 );
+        outfile.write( (const char*)block.strong, DELTA_STRONG_SZ );
+    }
+
+    outfile.close();
+
+    if ( !outfile ) {
+        return false;
+    }
+
+    boost::system::error_code ec;
+    fs::rename( tmp_path, signature_path, ec );
+
+    return !ec;
+
+}
+
+FileDelta::FileDelta(const FileSignature& signature) : m_signature(signature), m_literal_bytes(0), m_copied_bytes(0), m_delta_size(0), m_copy_start(-1), m_copy_count(0)
+{
+
+    const std::vector<BlockSignature>& blocks = m_signature.get_blocks();
+
+    //About 64 filter bits per block keeps false positives under 2%
+    m_filter_bits = DELTA_MIN_FILTER_BITS;
+    while ( m_filter_bits < DELTA_MAX_FILTER_BITS && ( (size_t)1 << m_filter_bits ) < blocks.size() * 64 ) {
+        m_filter_bits++;
+    }
+
+    m_filter.assign( ( (size_t)1 << m_filter_bits ) / 64, 0 );
+    m_weak_index.reserve( blocks.size() );
+
+    for ( size_t i=0; i < blocks.size(); i++ )
+    {
+        m_weak_index[ blocks[i].weak ].push_back(i);
+
+        uint32_t bit = get_filter_bit( blocks[i].weak );
+        m_filter[ bit >> 6 ] |= 1ULL << (bit & 63);
+    }
+
+}
+
+int64_t FileDelta::find_block(uint32_t weak, const unsigned char* data)
+{
+
+    auto it = m_weak_index.find(weak);
+
+    if ( it == m_weak_index.end() )
+        return -1;
+
+    unsigned char strong[DELTA_STRONG_SZ];
+    CryptoPP::SHA1().CalculateDigest( strong, data, m_signature.get_block_size() );
+
+    const std::vector<BlockSignature>& blocks = m_signature.get_blocks();
+
+    //Prefer the block following the previous copy so copies can be merged
+    if ( m_copy_start >= 0 )
+    {
+        uint32_t next = m_copy_start + m_copy_count;
+
+        for ( uint32_t block : it->second )
+        {
+            if ( block == next && std::memcmp( blocks[block].strong, strong, DELTA_STRONG_SZ ) == 0 )
+                return block;
+        }
+    }
+
+    for ( uint32_t block : it->second )
+    {
+        if ( std::memcmp( blocks[block].strong, strong, DELTA_STRONG_SZ ) == 0 )
+            return block;
+    }
+
+    return -1;
+
+}
+
+void FileDelta::write_literal(const char* data, size_t length)
+{
+
+    if ( length == 0 )
+        return;
+
+    flush_copy();
+
+    while ( length > 0 )
+    {
+        size_t size = std::min( length, (size_t)DELTA_MAX_LITERAL );
+
+        m_stream.put('L');
+        write_le( m_stream, size, 4 );
+        m_stream.write( data, size );
+
+        m_delta_size += size + 5;
+        m_literal_bytes += size;
+        data += size;
+        length -= size;
+    }
+
+}
+
+void FileDelta::write_copy(uint32_t block)
+{
+
+    m_copied_bytes += m_signature.get_block_size();
+
+    //Merge consecutive blocks into a single instruction
+    if ( m_copy_start >= 0 && (uint32_t)(m_copy_start + m_copy_count) == block )
+    {
+        m_copy_count++;
+        return;
+    }
+
+    flush_copy();
+
+    m_copy_start = block;
+    m_copy_count = 1;
+
+}
+
+void FileDelta::flush_copy()
+{
+
+    if ( m_copy_start < 0 )
+        return;
+
+    m_stream.put('C');
+    write_le( m_stream, m_copy_start, 4 );
+    write_le( m_stream, m_copy_count, 4 );
+
+    m_delta_size += 9;
+    m_copy_start = -1;
+    m_copy_count = 0;
+
+}
+
+bool FileDelta::encode(const std::string& file_path, const std::string& delta_path)
+{
+
+    std::ifstream infile( file_path, std::ios::in | std::ios::binary );
+    if ( !infile.is_open() ) {
+        return false;
+    }
+
+    m_stream.open( delta_path, std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !m_stream.is_open() ) {
+        Log::get_log().add_error("Unable to create delta file: " + delta_path, "File Delta");
+        return false;
+    }
+
+    boost::system::error_code ec;
+    size_t file_size = fs::file_size( file_path, ec );
+
+    m_stream.write( DELTA_MAGIC, 8 );
+    write_le( m_stream, m_signature.get_block_size(), 4 );
+    write_le( m_stream, file_size, 8 );
+    m_delta_size = 20;
+
+    const size_t block_size = m_signature.get_block_size();
+    bool have_blocks = !m_signature.get_blocks().empty();
+
+    std::vector<char> buffer( std::max( (size_t)DELTA_BUFFER_SZ, block_size * 4 ) );
+    const unsigned char* data = (const unsigned char*)buffer.data();
+    size_t literal = 0; //Start of the pending literal bytes in the buffer
+    size_t pos = 0; //Start of the window
+    size_t end = 0; //End of the data in the buffer
+    bool eof = false;
+    bool rolling = false; //The checksum holds the window at pos
+
+    RollingChecksum sum;
+    const uint64_t* filter = m_filter.data();
+    const int filter_shift = 32 - m_filter_bits;
+
+    while ( true )
+    {
+
+        //Refill the buffer when less than a block remains after the window
+        if ( !eof && end - pos <= block_size * 2 )
+        {
+            write_literal( buffer.data() + literal, pos - literal );
+
+            std::memmove( buffer.data(), buffer.data() + pos, end - pos );
+            end -= pos;
+            literal = pos = 0;
+
+            infile.read( buffer.data() + end, buffer.size() - end );
+            end += infile.gcount();
+
+            if ( infile.bad() ) {
+                m_stream.close();
+                return false;
+            }
+
+            if ( !infile ) {
+                eof = true;
+            }
+        }
+
+        //The remaining bytes are shorter than a block
+        if ( !have_blocks || end - pos < block_size )
+            break;
+
+        if ( !rolling )
+        {
+            sum.init( data + pos, block_size );
+            rolling = true;
+        }
+
+        //Scan until a block matches or the buffer needs to be refilled
+        size_t scan_end = eof ? end - block_size : end - block_size * 2;
+        int64_t block = -1;
+
+        while ( true )
+        {
+            uint32_t weak = sum.digest();
+            uint32_t bit = ( weak * DELTA_FILTER_MULTIPLIER ) >> filter_shift;
+
+            //Most positions are rejected by the filter without a hash table lookup
+            if ( filter[ bit >> 6 ] & ( 1ULL << (bit & 63) ) )
+            {
+                block = find_block( weak, data + pos );
+                if ( block >= 0 )
+                    break;
+            }
+
+            if ( pos >= scan_end )
+                break;
+
+            sum.roll( data[pos], data[pos + block_size] );
+            pos++;
+        }
+
+        if ( block >= 0 )
+        {
+            write_literal( buffer.data() + literal, pos - literal );
+            write_copy( block );
+
+            pos += block_size;
+            literal = pos;
+            rolling = false;
+        }
+        else if ( eof && pos >= scan_end )
+        {
+            //The window reached the end of the file
+            pos = end;
+            break;
+        }
+
+    }
+
+    write_literal( buffer.data() + literal, end - literal );
+    flush_copy();
+
+    m_stream.close();
+
+    return !m_stream.fail();
+
+}
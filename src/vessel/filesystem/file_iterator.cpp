@@ -309,7 +309,7 @@ bool FileIterator::add_file( const BackupFile& bf )
     sqlite3_bind_blob(stmt, 1, file_id.get(), sizeof(file_id.get()), 0 );
     sqlite3_bind_text(stmt, 2, file_name.c_str(), file_name.size(), 0 );
     sqlite3_bind_text(stmt, 3, file_type.c_str(), file_type.size(), 0 );
-    sqlite3_bind_int(stmt, 4, bf.get_file_size() );
+    sqlite3_bind_int64(stmt, 4, bf.get_file_size() ); //Sizes over 2 GB are matched when files are moved
     sqlite3_bind_int(stmt, 5, bf.get_directory_id() );
     sqlite3_bind_int(stmt, 6, bf.get_last_modified() );
 
@@ -0,0 +1,272 @@
+#include <vessel/filesystem/file_pack.hpp>
+
+FilePack::FilePack() : m_size(0), m_closed(false)
+{
+
+    int target_size = LocalDatabase::get_database().get_setting_int("pack_target_size");
+    m_target_size = ( target_size > 0 ) ? target_size : PACK_TARGET_SZ;
+
+    fs::path pack_dir = fs::path( AppManager::get().get_data_dir() ) / "packs";
+
+    try
+    {
+        fs::create_directories(pack_dir);
+    }
+    catch ( const fs::filesystem_error& ex )
+    {
+        throw FileException(FileException::FileNotFound, std::string("Unable to create pack directory: ") + ex.what() );
+    }
+
+    //Temporary name until the pack is closed
+    m_pack_path = pack_dir / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+
+    m_stream.open( m_pack_path.string(), std::ios::out | std::ios::binary | std::ios::trunc );
+
+    if ( !m_stream.is_open() )
+    {
+        throw FileException(FileException::FileNotFound, "Unable to create pack file: " + m_pack_path.string() );
+    }
+
+}
+
+FilePack::~FilePack()
+{
+    if ( m_stream.is_open() )
+    {
+        m_stream.close();
+    }
+}
+
+bool FilePack::is_packable(const BackupFile& file)
+{
+
+    int max_size = LocalDatabase::get_database().get_setting_int("pack_max_filesize");
+
+    return file.get_file_size() <= (size_t)( ( max_size > 0 ) ? max_size : PACK_MAX_FILE_SZ );
+
+}
+
+bool FilePack::is_full() const
+{
+    return m_size >= m_target_size;
+}
+
+bool FilePack::add_file(BackupFile& file)
+{
+
+    if ( m_closed )
+        return false;
+
+    std::string content = file.get_file_contents();
+
+    //Empty content is also returned for unreadable files
+    if ( content.size() != file.get_file_size() )
+        return false;
+
+    PackEntry entry;
+    entry.type = "file";
+    entry.file_id = file.get_file_id();
+    entry.file_id_text = file.get_file_id_text();
+    entry.file_name = file.get_file_name();
+    entry.file_path = file.get_parent_path();
+    entry.file_type = file.get_file_type();
+    entry.hash = file.get_hash_sha1();
+    entry.file_size = content.size();
+
+    return write_entry( entry, content.data(), content.size() );
+
+}
+
+bool FilePack::add_chunk(const std::string& hash, const char* data, size_t length)
+{
+
+    if ( m_closed )
+        return false;
+
+    PackEntry entry;
+    entry.type = "chunk";
+    entry.file_id_text = hash;
+    entry.hash = hash;
+    entry.file_size = length;
+
+    if ( !write_entry( entry, data, length ) )
+        return false;
+
+    m_chunks.insert(hash);
+
+    return true;
+
+}
+
+bool FilePack::add_recipe(BackupFile& file, const std::string& recipe)
+{
+
+    if ( m_closed )
+        return false;
+
+    PackEntry entry;
+    entry.type = "recipe";
+    entry.file_id = file.get_file_id();
+    entry.file_id_text = file.get_file_id_text();
+    entry.file_name = file.get_file_name();
+    entry.file_path = file.get_parent_path();
+    entry.file_type = file.get_file_type();
+    entry.hash = file.get_hash_sha1();
+    entry.file_size = file.get_file_size();
+
+    return write_entry( entry, recipe.data(), recipe.size() );
+
+}
+
+bool FilePack::has_chunk(const std::string& hash) const
+{
+    return m_chunks.find(hash) != m_chunks.end();
+}
+
+bool FilePack::write_entry(PackEntry& entry, const char* data, size_t length)
+{
+
+    entry.offset = m_size;
+    entry.length = length;
+
+    m_stream.write( data, length );
+
+    if ( !m_stream.good() )
+    {
+        Log::get_log().add_error("Failed to write " + entry.type + " to pack: " + entry.file_id_text, "File Pack");
+        return false;
+    }
+
+    m_size += length;
+    m_entries.push_back(entry);
+
+    return true;
+
+}
+
+void FilePack::write_index()
+{
+
+    std::ostringstream index;
+
+    for ( const auto& entry : m_entries )
+    {
+        index << entry.type << " " << entry.file_id_text << " " << entry.offset << " " << entry.length << " " << entry.hash << "\n";
+    }
+
+    std::string index_str = index.str();
+    m_stream.write( index_str.data(), index_str.size() );
+
+    //Footer: offset of the index followed by the magic string
+    unsigned char offset_bytes[8];
+    unsigned long long index_offset = m_size;
+
+    for ( int i=0; i < 8; i++ )
+    {
+        offset_bytes[i] = (index_offset >> (8*i)) & 0xFF;
+    }
+
+    m_stream.write( (char*)offset_bytes, sizeof(offset_bytes) );
+    m_stream.write( PACK_MAGIC, 8 );
+
+}
+
+void FilePack::close()
+{
+
+    if ( m_closed )
+        return;
+
+    write_index();
+    m_stream.close();
+    m_closed = true;
+
+    //Name the pack after its contents
+    BackupFile pack_file( m_pack_path );
+    fs::path pack_path = m_pack_path.parent_path() / ( pack_file.get_hash_sha1() + ".vpk" );
+
+    fs::rename( m_pack_path, pack_path );
+    m_pack_path = pack_path;
+
+}
+
+void FilePack::save(const std::string& vessel_id, const std::string& object_key, const std::string& provider_id)
+{
+
+    LocalDatabase* ldb = &LocalDatabase::get_database();
+
+    sqlite3_stmt* stmt;
+    std::string query = "INSERT INTO backup_pack (vessel_id,object_key,total_files,total_bytes,created,provider_id) VALUES(?1,?2,?3,?4,?5,?6)";
+
+    if ( sqlite3_prepare_v2(ldb->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to save pack: " + ldb->get_last_err(), "File Pack");
+        return;
+    }
+
+    sqlite3_bind_text(stmt, 1, vessel_id.c_str(), vessel_id.size(), 0 );
+    sqlite3_bind_text(stmt, 2, object_key.c_str(), object_key.size(), 0 );
+    sqlite3_bind_int(stmt, 3, m_entries.size() );
+    sqlite3_bind_int64(stmt, 4, m_size );
+    sqlite3_bind_int64(stmt, 5, std::time(nullptr) );
+    sqlite3_bind_text(stmt, 6, provider_id.c_str(), provider_id.size(), 0 );
+
+    if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+        Log::get_log().add_error("Failed to save pack: " + ldb->get_last_err(), "File Pack");
+        sqlite3_finalize(stmt);
+        return;
+    }
+
+    sqlite3_finalize(stmt);
+
+    sqlite3_int64 pack_id = sqlite3_last_insert_rowid( ldb->get_handle() );
+
+    query = "REPLACE INTO backup_pack_file (file_id,pack_id,byte_offset,length,hash) VALUES(?1,?2,?3,?4,?5)";
+
+    if ( sqlite3_prepare_v2(ldb->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to save pack files: " + ldb->get_last_err(), "File Pack");
+        return;
+    }
+
+    ChunkIndex chunk_index;
+
+    ldb->start_transaction();
+
+    for ( const auto& entry : m_entries )
+    {
+        //Chunks are located through the chunk index
+        if ( entry.type == "chunk" )
+        {
+            chunk_index.add_chunk( entry.hash, pack_id, entry.offset, entry.length );
+            continue;
+        }
+
+        sqlite3_bind_blob(stmt, 1, entry.file_id.get(), sizeof(entry.file_id.get()), 0 );
+        sqlite3_bind_int64(stmt, 2, pack_id );
+        sqlite3_bind_int64(stmt, 3, entry.offset );
+        sqlite3_bind_int64(stmt, 4, entry.length );
+        sqlite3_bind_text(stmt, 5, entry.hash.c_str(), entry.hash.size(), 0 );
+
+        if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+            Log::get_log().add_error("Failed to save pack file: " + entry.file_name, "File Pack");
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    ldb->end_transaction();
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+void FilePack::remove()
+{
+
+    if ( m_stream.is_open() )
+        m_stream.close();
+
+    boost::system::error_code ec;
+    fs::remove( m_pack_path, ec );
+
+}
@@ -15,6 +15,10 @@ FileUpload::FileUpload(unsigned int upload_id)
 void FileUpload::init()
 {
 
+    m_file_size = 0;
+    m_file_modified = 0;
+    m_exists = false;
+
     std::string where = "upload_id";
 
     if ( !m_upload_key.empty() ) {
@@ -22,7 +26,7 @@ void FileUpload::init()
     }
 
     sqlite3_stmt* stmt;
-    std::string query = "SELECT file_id,total_parts,byte_offset,chunk_size,hash,signature,weight,last_modified,upload_id,upload_key,vessel_id FROM backup_upload WHERE " + where + "=?1";
+    std::string query = "SELECT file_id,total_parts,byte_offset,chunk_size,hash,signature,weight,last_modified,upload_id,upload_key,vessel_id,file_size,file_modified,encryption_key,provider_id FROM backup_upload WHERE " + where + "=?1";
 
     if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
         Log::get_log().add_error("Failed to init FileUpload: " + m_upload_id, "FileUpload");
@@ -45,14 +49,23 @@ void FileUpload::init()
         m_upload_key = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 9) );
         m_total_parts = sqlite3_column_int(stmt, 1);
         m_offset = sqlite3_column_int(stmt, 2);
-        m_chunk_size = sqlite3_column_int(stmt, 3);
+        m_chunk_size = sqlite3_column_int64(stmt, 3);
         m_file_hash = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 4) );
         m_signature = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 5) );
         m_weight = sqlite3_column_int(stmt, 6);
         m_last_modified = sqlite3_column_int(stmt, 7);
         m_vessel_id = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 10) );
+        m_file_size = sqlite3_column_int64(stmt, 11);
+        m_file_modified = sqlite3_column_int64(stmt, 12);
+        m_encryption_key = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 13) );
+        m_provider_id = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 14) );
         m_exists = true;
 
+        //Parts must keep the size the upload was started with
+        if ( m_chunk_size > 0 ) {
+            m_file.set_part_size(m_chunk_size);
+        }
+
     }
     else {
         Log::get_log().add_error("Failed to init FileUpload: " + m_upload_id, "FileUpload");
@@ -66,8 +79,20 @@ void FileUpload::init()
 void FileUpload::update_key(const std::string& upload_key)
 {
 
+    //The size and last write time of the file are recorded with the key so a resumed upload can detect changes without hashing the file
+    boost::system::error_code ec;
+    size_t file_size = fs::file_size( m_file.get_file_path(), ec );
+    if ( ec ) {
+        file_size = 0;
+    }
+
+    unsigned long file_modified = fs::last_write_time( m_file.get_file_path(), ec );
+    if ( ec ) {
+        file_modified = 0;
+    }
+
     sqlite3_stmt* stmt;
-    std::string query = "UPDATE backup_upload SET upload_key=?1 WHERE upload_id=?2";
+    std::string query = "UPDATE backup_upload SET upload_key=?1,file_size=?2,file_modified=?3 WHERE upload_id=?4";
 
     if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
         Log::get_log().add_error("Failed to set upload_id: " + upload_key, "FileUpload");
@@ -75,10 +100,14 @@ void FileUpload::update_key(const std::string& upload_key)
     }
 
     sqlite3_bind_text(stmt, 1, upload_key.c_str(), upload_key.size(), 0);
-    sqlite3_bind_int(stmt, 2, m_upload_id );
+    sqlite3_bind_int64(stmt, 2, file_size );
+    sqlite3_bind_int64(stmt, 3, file_modified );
+    sqlite3_bind_int(stmt, 4, m_upload_id );
 
     if ( sqlite3_step(stmt) == SQLITE_DONE ) {
         m_upload_key = upload_key;
+        m_file_size = file_size;
+        m_file_modified = file_modified;
     }
     else {
         Log::get_log().add_error("Failed to set upload_id: " + upload_key, "FileUpload");
@@ -89,35 +118,269 @@ void FileUpload::update_key(const std::string& upload_key)
 
 }
 
+void FileUpload::update_chunk_size(size_t chunk_size)
+{
+
+    m_file.set_part_size(chunk_size);
+    int total_parts = m_file.get_total_parts();
+
+    sqlite3_stmt* stmt;
+    std::string query = "UPDATE backup_upload SET chunk_size=?1,total_parts=?2 WHERE upload_id=?3";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to set chunk size for upload id: " + std::to_string(m_upload_id), "FileUpload");
+        return;
+    }
+
+    sqlite3_bind_int64(stmt, 1, chunk_size );
+    sqlite3_bind_int(stmt, 2, total_parts );
+    sqlite3_bind_int(stmt, 3, m_upload_id );
+
+    if ( sqlite3_step(stmt) == SQLITE_DONE ) {
+        m_chunk_size = chunk_size;
+        m_total_parts = total_parts;
+    }
+    else {
+        Log::get_log().add_error("Failed to set chunk size for upload id: " + std::to_string(m_upload_id), "FileUpload");
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
 int FileUpload::get_current_part() const
 {
 
-    int part_number = 1; //Default
+    //Parts can be missing from the middle of an upload after the stored parts were reconciled with the provider
+    std::vector<int> missing = get_missing_parts();
+
+    if ( missing.empty() ) {
+        return m_total_parts + 1;
+    }
+
+    return missing.front();
+
+}
+
+std::vector<int> FileUpload::get_missing_parts() const
+{
+
+    std::vector<int> missing;
+    std::set<int> stored;
+
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT part_number FROM backup_upload_part WHERE upload_id=?1";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Query failed to return stored parts: " + std::to_string(m_upload_id), "FileUpload");
+        return missing;
+    }
+
+    sqlite3_bind_int(stmt, 1, m_upload_id);
+
+    while ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        stored.insert( sqlite3_column_int(stmt, 0) );
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    for ( int part_number = 1; part_number <= m_total_parts; part_number++ )
+    {
+        if ( stored.find(part_number) == stored.end() ) {
+            missing.push_back(part_number);
+        }
+    }
+
+    return missing;
+
+}
+
+bool FileUpload::has_parts() const
+{
+
+    bool has_parts = false;
 
     sqlite3_stmt* stmt;
-    std::string query = "SELECT part_number FROM backup_upload_part WHERE upload_id=?1 ORDER BY part_number DESC LIMIT 1";
+    std::string query = "SELECT 1 FROM backup_upload_part WHERE upload_id=?1 LIMIT 1";
 
     if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
-        Log::get_log().add_error("Query failed to return current part number: " + std::to_string(m_upload_id), "FileUpload");
-        return part_number;
+        Log::get_log().add_error("Query failed to return stored parts: " + std::to_string(m_upload_id), "FileUpload");
+        return has_parts;
     }
 
     sqlite3_bind_int(stmt, 1, m_upload_id);
 
     if ( sqlite3_step(stmt) == SQLITE_ROW ) {
-        part_number = sqlite3_column_int(stmt, 0) + 1; //Current part is the last uploaded plus one
+        has_parts = true;
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return has_parts;
+
+}
+
+size_t FileUpload::get_part_bytes(int part_number) const
+{
+
+    size_t file_size = m_file.get_file_size();
+    size_t part_size = ( m_chunk_size > 0 ) ? m_chunk_size : file_size;
+    size_t start = part_size * (part_number - 1);
+
+    if ( part_number < 1 || start >= file_size ) {
+        return 0;
+    }
+
+    size_t part_bytes = std::min( part_size, file_size - start );
+
+    return m_encryption_key.empty() ? part_bytes : FileCipher::get_encrypted_size(part_bytes);
+
+}
+
+void FileUpload::sync_parts(const std::vector<UploadTagSet>& remote_parts)
+{
+
+    std::map<int,UploadTagSet> remote;
+
+    for ( const auto& part : remote_parts )
+    {
+        //Parts of the wrong size were uploaded with another part size and are overwritten
+        if ( part.part_number >= 1 && part.part_number <= m_total_parts && part.total_bytes == get_part_bytes(part.part_number) ) {
+            remote[part.part_number] = part;
+        }
+    }
+
+    std::vector<UploadTagSet> stored = get_part_tags();
+    std::set<int> verified;
+
+    LocalDatabase* ldb = &LocalDatabase::get_database();
+
+    sqlite3_stmt* stmt;
+    std::string query = "DELETE FROM backup_upload_part WHERE upload_id=?1 AND part_number=?2";
+
+    if ( sqlite3_prepare_v2(ldb->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to reconcile parts for upload id: " + std::to_string(m_upload_id), "FileUpload");
+        return;
+    }
+
+    ldb->start_transaction();
+
+    for ( const auto& part : stored )
+    {
+
+        auto it = remote.find(part.part_number);
+
+        //ETags are quoted by S3, the quotes are not part of the tag
+        if ( it != remote.end() && boost::trim_copy_if(it->second.tag, boost::is_any_of("\"")) == boost::trim_copy_if(part.tag, boost::is_any_of("\"")) )
+        {
+            verified.insert(part.part_number);
+            continue;
+        }
+
+        Log::get_log().add_message("Part " + std::to_string(part.part_number) + " is not held by the provider and will be uploaded again: " + std::to_string(m_upload_id), "FileUpload");
+
+        sqlite3_bind_int(stmt, 1, m_upload_id );
+        sqlite3_bind_int(stmt, 2, part.part_number );
+
+        if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+            Log::get_log().add_error("Failed to remove part " + std::to_string(part.part_number) + " for upload id: " + std::to_string(m_upload_id), "FileUpload");
+        }
+
+        sqlite3_reset(stmt);
+
     }
+
+    ldb->end_transaction();
+
     //Cleanup
     sqlite3_finalize(stmt);
 
-    return part_number;
+    //Parts uploaded before a crash but never saved
+    for ( const auto& it : remote )
+    {
+
+        if ( verified.find(it.first) != verified.end() ) {
+            continue;
+        }
+
+        FilePart part;
+        part.upload_id = m_upload_id;
+        part.upload_key = m_upload_key;
+        part.part_number = it.first;
+        part.total_bytes = it.second.total_bytes;
+        part.tag = it.second.tag;
+
+        add_part(part);
+
+    }
+
+}
+
+void FileUpload::clear_parts()
+{
+
+    std::vector<std::string> queries;
+    queries.push_back("DELETE FROM backup_upload_part WHERE upload_id=?1");
+    //A new key is generated when the upload starts over, GCM nonces must never be reused with different content
+    queries.push_back("UPDATE backup_upload SET upload_key=NULL,file_size=0,file_modified=0,encryption_key=NULL WHERE upload_id=?1");
+
+    for ( const auto& query : queries )
+    {
+
+        sqlite3_stmt* stmt;
+
+        if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+            Log::get_log().add_error("Failed to clear parts for upload id: " + std::to_string(m_upload_id), "FileUpload");
+            return;
+        }
+
+        sqlite3_bind_int(stmt, 1, m_upload_id );
+
+        if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+            Log::get_log().add_error("Failed to clear parts for upload id: " + std::to_string(m_upload_id), "FileUpload");
+        }
+
+        //Cleanup
+        sqlite3_finalize(stmt);
+
+    }
+
+    m_upload_key.clear();
+    m_encryption_key.clear();
+    m_file_size = 0;
+    m_file_modified = 0;
+
+}
+
+bool FileUpload::is_file_unchanged() const
+{
+
+    if ( m_file_modified == 0 ) {
+        return false;
+    }
+
+    boost::system::error_code ec;
+    size_t file_size = fs::file_size( m_file.get_file_path(), ec );
+    if ( ec ) {
+        return false;
+    }
+
+    unsigned long file_modified = fs::last_write_time( m_file.get_file_path(), ec );
+    if ( ec ) {
+        return false;
+    }
+
+    return file_size == m_file_size && file_modified == m_file_modified;
 
 }
 
 void FileUpload::add_part(const FilePart& part) const
 {
 
-    std::string query = "INSERT INTO backup_upload_part (upload_id,part_number,bytes,tag,signature) VALUES(?1,?2,?3,?4,?5)";
+    std::string query = "REPLACE INTO backup_upload_part (upload_id,part_number,bytes,tag,signature) VALUES(?1,?2,?3,?4,?5)";
 
     sqlite3_stmt* stmt;
     if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
@@ -146,7 +409,7 @@ std::vector<UploadTagSet> FileUpload::get_part_tags() const
     std::vector<UploadTagSet> tags;
 
     sqlite3_stmt* stmt;
-    std::string query = "SELECT part_number,tag FROM backup_upload_part WHERE upload_id=?1 ORDER BY part_number ASC";
+    std::string query = "SELECT part_number,tag,bytes FROM backup_upload_part WHERE upload_id=?1 ORDER BY part_number ASC";
 
     if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
         Log::get_log().add_error("Failed to retrieve upload tags: " + std::to_string(m_upload_id), "FileUpload");
@@ -159,6 +422,7 @@ std::vector<UploadTagSet> FileUpload::get_part_tags() const
         UploadTagSet tag_pair;
         tag_pair.part_number = sqlite3_column_int(stmt,0);
         tag_pair.tag = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 1) );
+        tag_pair.total_bytes = sqlite3_column_int64(stmt, 2);
         tags.push_back( tag_pair );
     }
 
@@ -251,3 +515,64 @@ std::string FileUpload::get_vessel_id()
 {
     return m_vessel_id;
 }
+
+void FileUpload::update_encryption_key(const std::string& wrapped_key)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "UPDATE backup_upload SET encryption_key = ?1 WHERE upload_id=?2";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Unable to set encryption key for FileUpload: " + LocalDatabase::get_database().get_last_err(), "File Upload");
+        return;
+    }
+
+    sqlite3_bind_text(stmt, 1, wrapped_key.c_str(), wrapped_key.size(), 0 );
+    sqlite3_bind_int(stmt, 2, m_upload_id );
+
+    if ( sqlite3_step(stmt) == SQLITE_DONE ) {
+        m_encryption_key = wrapped_key;
+    }
+    else {
+        Log::get_log().add_error("Unable to set encryption key for FileUpload: " + LocalDatabase::get_database().get_last_err(), "File Upload");
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+void FileUpload::update_provider(const std::string& provider_id)
+{
+
+    if ( provider_id == m_provider_id ) {
+        return;
+    }
+
+    //The upload was registered with the Vessel API for another provider
+    std::string vessel_id = m_provider_id.empty() ? m_vessel_id : "";
+
+    sqlite3_stmt* stmt;
+    std::string query = "UPDATE backup_upload SET provider_id=?1,vessel_id=?2 WHERE upload_id=?3";
+
+    if ( sqlite3_prepare_v2(LocalDatabase::get_database().get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Unable to set storage provider for FileUpload: " + LocalDatabase::get_database().get_last_err(), "File Upload");
+        return;
+    }
+
+    sqlite3_bind_text(stmt, 1, provider_id.c_str(), provider_id.size(), 0 );
+    sqlite3_bind_text(stmt, 2, vessel_id.c_str(), vessel_id.size(), 0 );
+    sqlite3_bind_int(stmt, 3, m_upload_id );
+
+    if ( sqlite3_step(stmt) == SQLITE_DONE ) {
+        m_provider_id = provider_id;
+        m_vessel_id = vessel_id;
+    }
+    else {
+        Log::get_log().add_error("Unable to set storage provider for FileUpload: " + LocalDatabase::get_database().get_last_err(), "File Upload");
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
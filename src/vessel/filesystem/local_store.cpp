@@ -0,0 +1,463 @@
+#include <vessel/filesystem/local_store.hpp>
+
+#include <fstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cerrno>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+
+    #ifdef __linux__
+        #include <sys/ioctl.h>
+        #include <sys/sendfile.h>
+        #include <linux/fs.h>
+    #endif
+#endif
+
+using namespace Vessel::File;
+using namespace Vessel::Exception;
+
+#ifndef _WIN32
+static bool write_all(int fd, const char* data, size_t length)
+{
+
+    while ( length > 0 )
+    {
+        ssize_t written = ::write(fd, data, length);
+
+        if ( written < 0 )
+        {
+            if ( errno == EINTR ) {
+                continue;
+            }
+
+            return false;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return true;
+
+}
+#endif
+
+LocalStore::LocalStore(const std::string& root_path) : m_root_path(root_path), m_pending_objects(0)
+{
+
+    boost::system::error_code ec;
+
+    if ( root_path.empty() || !fs::is_directory(m_root_path, ec) ) {
+        throw FileException(FileException::DirNotFound, "Storage path does not exist: " + root_path);
+    }
+
+    //A missing setting reads as 0, which is a valid mode
+    std::string sync_mode = LocalDatabase::get_database().get_setting_str("local_fsync");
+    int mode = sync_mode.empty() ? LOCAL_FSYNC : std::atoi( sync_mode.c_str() );
+
+    m_sync_mode = (SyncMode)std::min( std::max( mode, (int)SyncNone ), (int)SyncBatch );
+
+}
+
+std::string LocalStore::get_object_path(const std::string& object_key) const
+{
+    return ( m_root_path / object_key ).string();
+}
+
+LocalStore::CopyMethod LocalStore::store_file(const std::string& source_path, const std::string& object_key)
+{
+
+    std::string object_path = get_object_path(object_key);
+    std::string tmp_path = begin_object(object_key);
+
+    CopyMethod method = copy_content(source_path, tmp_path);
+
+    commit_object(tmp_path, object_path);
+
+    //The key of an encrypted object that was stored at this path before no longer applies
+    boost::system::error_code ec;
+    fs::remove( object_path + LOCAL_KEY_EXT, ec );
+
+    return method;
+
+}
+
+void LocalStore::store_parts(BackupFile& file, const std::string& object_key, FileCipher& cipher)
+{
+
+    std::string object_path = get_object_path(object_key);
+    std::string tmp_path = begin_object(object_key);
+    boost::system::error_code ec;
+
+    std::ofstream outfile(tmp_path, std::ios::binary | std::ios::trunc);
+
+    if ( !outfile ) {
+        throw FileException(FileException::WriteError, "Unable to create " + tmp_path);
+    }
+
+    unsigned int total_parts = file.get_total_parts();
+
+    for ( unsigned int part = 1; part <= total_parts; part++ )
+    {
+
+        //The part is read into a pooled buffer and sealed in place
+        std::shared_ptr<PartBuffer> buffer = file.read_part(part, CIPHER_TAG_SZ);
+
+        if ( !buffer )
+        {
+            outfile.close();
+            fs::remove(tmp_path, ec);
+            throw FileException(FileException::ReadError, "Unable to read part " + std::to_string(part) + " of " + file.get_file_path());
+        }
+
+        size_t length = buffer->size();
+        buffer->resize( length + CIPHER_TAG_SZ );
+        cipher.encrypt_part( buffer->data(), length, part, ( part == total_parts ) );
+
+        outfile.write( buffer->data(), buffer->size() );
+
+        if ( !outfile ) {
+            break;
+        }
+
+    }
+
+    outfile.close();
+
+    if ( !outfile )
+    {
+        fs::remove(tmp_path, ec);
+        throw FileException(FileException::WriteError, "Unable to write " + tmp_path);
+    }
+
+    //The key is stored first, so an encrypted object is never visible without it
+    std::string key_path = object_path + LOCAL_KEY_EXT;
+    std::string key_tmp_path = begin_object( object_key + LOCAL_KEY_EXT );
+
+    std::ofstream keyfile(key_tmp_path, std::ios::trunc);
+    keyfile << cipher.get_wrapped_key() << '\n' << file.get_part_size() << '\n';
+    keyfile.close();
+
+    if ( !keyfile )
+    {
+        fs::remove(tmp_path, ec);
+        fs::remove(key_tmp_path, ec);
+        throw FileException(FileException::WriteError, "Unable to write " + key_tmp_path);
+    }
+
+    commit_object(key_tmp_path, key_path);
+    commit_object(tmp_path, object_path);
+
+}
+
+bool LocalStore::copy_object(const std::string& source_key, const std::string& object_key, bool& encrypted)
+{
+
+    boost::system::error_code ec;
+    std::string source_path = get_object_path(source_key);
+
+    if ( !fs::is_regular_file(source_path, ec) ) {
+        return false;
+    }
+
+    std::string source_key_path = source_path + LOCAL_KEY_EXT;
+    encrypted = fs::exists(source_key_path, ec);
+
+    if ( encrypted )
+    {
+        std::string key_tmp_path = begin_object( object_key + LOCAL_KEY_EXT );
+        copy_content(source_key_path, key_tmp_path);
+        commit_object(key_tmp_path, get_object_path( object_key + LOCAL_KEY_EXT ));
+    }
+
+    //A reflink shares the extents of the old object, nothing is read or written
+    std::string object_path = get_object_path(object_key);
+    std::string tmp_path = begin_object(object_key);
+
+    copy_content(source_path, tmp_path);
+    commit_object(tmp_path, object_path);
+
+    if ( !encrypted ) {
+        fs::remove( object_path + LOCAL_KEY_EXT, ec );
+    }
+
+    return true;
+
+}
+
+bool LocalStore::remove_object(const std::string& object_key)
+{
+
+    std::string object_path = get_object_path(object_key);
+    boost::system::error_code ec;
+
+    fs::remove( object_path + LOCAL_KEY_EXT, ec );
+    fs::remove( object_path, ec );
+
+    if ( ec ) {
+        Log::get_log().add_error("Unable to remove " + object_path + ": " + ec.message(), "Local Storage");
+        return false;
+    }
+
+    return true;
+
+}
+
+void LocalStore::sync()
+{
+
+    //Only batch mode leaves objects to sync
+    if ( m_pending_paths.empty() ) {
+        return;
+    }
+
+    #ifdef __linux__
+
+        //One syncfs flushes the whole batch, rather than waiting for the device once per object
+        int fd = ::open(m_root_path.string().c_str(), O_RDONLY | O_CLOEXEC);
+
+        if ( fd < 0 ) {
+            throw FileException(FileException::DirNotFound, "Unable to open storage path " + m_root_path.string());
+        }
+
+        int result = syncfs(fd);
+        ::close(fd);
+
+        if ( result != 0 ) {
+            throw FileException(FileException::WriteError, "Failed to sync storage path " + m_root_path.string());
+        }
+
+    #else
+
+        for ( const auto& path : m_pending_paths ) {
+            sync_path(path);
+        }
+
+    #endif
+
+    m_pending_paths.clear();
+    m_pending_objects = 0;
+
+}
+
+std::string LocalStore::begin_object(const std::string& object_key)
+{
+
+    fs::path object_path = m_root_path / object_key;
+    boost::system::error_code ec;
+
+    fs::create_directories( object_path.parent_path(), ec );
+
+    if ( ec ) {
+        throw FileException(FileException::WriteError, "Unable to create directory " + object_path.parent_path().string() + " (" + ec.message() + ")");
+    }
+
+    return object_path.string() + LOCAL_TMP_EXT;
+
+}
+
+void LocalStore::commit_object(const std::string& tmp_path, const std::string& object_path)
+{
+
+    boost::system::error_code ec;
+
+    //The content must be durable before the rename makes it visible
+    if ( m_sync_mode == SyncEach ) {
+        sync_path(tmp_path);
+    }
+
+    fs::rename( tmp_path, object_path, ec );
+
+    if ( ec )
+    {
+        fs::remove(tmp_path, ec);
+        throw FileException(FileException::WriteError, "Unable to rename " + tmp_path + " to " + object_path);
+    }
+
+    std::string dir_path = fs::path(object_path).parent_path().string();
+
+    //The rename is only durable once the directory is synced
+    if ( m_sync_mode == SyncEach ) {
+        sync_path(dir_path);
+    }
+    else if ( m_sync_mode == SyncBatch ) {
+        m_pending_paths.insert(object_path);
+        m_pending_paths.insert(dir_path);
+        m_pending_objects++;
+    }
+
+}
+
+void LocalStore::sync_path(const std::string& path)
+{
+
+    #ifndef _WIN32
+
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if ( fd < 0 ) {
+            throw FileException(FileException::FileNotFound, "Unable to open " + path);
+        }
+
+        int result = fsync(fd);
+        int error = errno;
+        ::close(fd);
+
+        //Some file systems cannot sync a directory, their renames are durable on their own
+        if ( result != 0 && error != EINVAL ) {
+            throw FileException(FileException::WriteError, "Failed to sync " + path);
+        }
+
+    #endif
+
+}
+
+LocalStore::CopyMethod LocalStore::copy_content(const std::string& source_path, const std::string& target_path)
+{
+
+    #ifdef _WIN32
+
+        boost::system::error_code ec;
+
+        //A temporary file left by an interrupted copy is replaced
+        fs::remove(target_path, ec);
+        fs::copy_file(source_path, target_path, ec);
+
+        if ( ec ) {
+            throw FileException(FileException::WriteError, "Unable to copy " + source_path + " to " + target_path + " (" + ec.message() + ")");
+        }
+
+        return ReadWrite;
+
+    #else
+
+        int source_fd = ::open(source_path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if ( source_fd < 0 ) {
+            throw FileException(FileException::FileNotFound, "Unable to open " + source_path);
+        }
+
+        struct stat source_stat;
+
+        if ( fstat(source_fd, &source_stat) != 0 )
+        {
+            ::close(source_fd);
+            throw FileException(FileException::ReadError, "Unable to read " + source_path);
+        }
+
+        int target_fd = ::open(target_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0640);
+
+        if ( target_fd < 0 )
+        {
+            ::close(source_fd);
+            throw FileException(FileException::WriteError, "Unable to create " + target_path);
+        }
+
+        size_t remaining = source_stat.st_size;
+        CopyMethod method = ReadWrite;
+        bool truncated = false;
+        bool failed = false;
+
+        #ifdef __linux__
+
+            #ifdef FICLONE
+            if ( remaining > 0 && ioctl(target_fd, FICLONE, source_fd) == 0 )
+            {
+                remaining = 0;
+                method = Reflink;
+            }
+            #endif
+
+            //Each method falls back to the next when the file systems do not support it. The file offsets advance
+            //with every call, so the next method continues where the previous one stopped
+            while ( remaining > 0 )
+            {
+                ssize_t copied = copy_file_range(source_fd, NULL, target_fd, NULL, std::min( remaining, (size_t)LOCAL_COPY_SZ ), 0);
+
+                if ( copied < 0 ) {
+                    break;
+                }
+
+                if ( copied == 0 ) {
+                    truncated = true;
+                    break;
+                }
+
+                remaining -= copied;
+                method = CopyRange;
+            }
+
+            while ( remaining > 0 && !truncated )
+            {
+                ssize_t copied = sendfile(target_fd, source_fd, NULL, std::min( remaining, (size_t)LOCAL_COPY_SZ ));
+
+                if ( copied < 0 ) {
+                    break;
+                }
+
+                if ( copied == 0 ) {
+                    truncated = true;
+                    break;
+                }
+
+                remaining -= copied;
+                method = SendFile;
+            }
+
+        #endif
+
+        if ( remaining > 0 && !truncated )
+        {
+            std::vector<char> buffer(LOCAL_BUFFER_SZ);
+            method = ReadWrite;
+
+            while ( remaining > 0 )
+            {
+                ssize_t bytes_read = ::read(source_fd, buffer.data(), std::min( remaining, buffer.size() ));
+
+                if ( bytes_read < 0 && errno == EINTR ) {
+                    continue;
+                }
+
+                if ( bytes_read <= 0 ) {
+                    truncated = ( bytes_read == 0 );
+                    failed = ( bytes_read < 0 );
+                    break;
+                }
+
+                if ( !write_all(target_fd, buffer.data(), bytes_read) ) {
+                    failed = true;
+                    break;
+                }
+
+                remaining -= bytes_read;
+            }
+        }
+
+        ::close(source_fd);
+
+        if ( ::close(target_fd) != 0 ) {
+            failed = true;
+        }
+
+        if ( truncated || failed )
+        {
+            boost::system::error_code ec;
+            fs::remove(target_path, ec);
+
+            if ( truncated ) {
+                throw FileException(FileException::ReadError, "File changed while it was copied: " + source_path);
+            }
+
+            throw FileException(FileException::WriteError, "Unable to copy " + source_path + " to " + target_path);
+        }
+
+        return method;
+
+    #endif
+
+}
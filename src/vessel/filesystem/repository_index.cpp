@@ -0,0 +1,137 @@
+#include <vessel/filesystem/repository_index.hpp>
+
+using namespace Vessel::File;
+
+RepositoryIndex::RepositoryIndex(const std::string& provider_id) : m_provider_id(provider_id)
+{
+    m_database = &LocalDatabase::get_database();
+}
+
+bool RepositoryIndex::contains(const std::string& hash)
+{
+
+    bool found = false;
+
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT 1 FROM backup_repo_blob WHERE provider_id=?1 AND hash=?2";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to find blob: " + m_database->get_last_err(), "Repository Index");
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, m_provider_id.c_str(), m_provider_id.size(), 0 );
+    sqlite3_bind_text(stmt, 2, hash.c_str(), hash.size(), 0 );
+
+    if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        found = true;
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return found;
+
+}
+
+bool RepositoryIndex::add_pack(const std::string& object_key, const std::vector<PackEntry>& entries)
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "INSERT OR REPLACE INTO backup_repo_blob (provider_id,hash,object_key,byte_offset,length,created) VALUES(?1,?2,?3,?4,?5,?6)";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to save blobs: " + m_database->get_last_err(), "Repository Index");
+        return false;
+    }
+
+    bool success = true;
+    std::time_t now = std::time(nullptr);
+
+    m_database->start_transaction();
+
+    for ( const auto& entry : entries )
+    {
+        if ( entry.type != "chunk" ) {
+            continue;
+        }
+
+        sqlite3_bind_text(stmt, 1, m_provider_id.c_str(), m_provider_id.size(), 0 );
+        sqlite3_bind_text(stmt, 2, entry.hash.c_str(), entry.hash.size(), 0 );
+        sqlite3_bind_text(stmt, 3, object_key.c_str(), object_key.size(), 0 );
+        sqlite3_bind_int64(stmt, 4, entry.offset );
+        sqlite3_bind_int64(stmt, 5, entry.length );
+        sqlite3_bind_int64(stmt, 6, now );
+
+        if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+            Log::get_log().add_error("Failed to save blob: " + m_database->get_last_err(), "Repository Index");
+            success = false;
+        }
+
+        sqlite3_reset(stmt);
+    }
+
+    m_database->end_transaction();
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return success;
+
+}
+
+bool RepositoryIndex::get_snapshot_files(std::vector<SnapshotFile>& files)
+{
+
+    sqlite3_stmt* stmt;
+
+    //Files without content have no blobs. Files stored as objects before the repository was enabled are left out
+    std::string query = "SELECT f.file_id,d.path,f.filename,f.filesize,f.last_modified,f.last_backup_hash,c.hash,c.length FROM backup_file f "
+                        "INNER JOIN backup_directory d ON d.directory_id=f.directory_id "
+                        "LEFT JOIN backup_file_chunk c ON c.file_id=f.file_id "
+                        "WHERE f.provider_id=?1 AND f.last_backup_time > 0 "
+                        "AND ( f.filesize=0 OR EXISTS (SELECT 1 FROM backup_repo_file rf WHERE rf.file_id=f.file_id) ) ORDER BY f.file_id,c.seq";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        Log::get_log().add_error("Failed to list snapshot files: " + m_database->get_last_err(), "Repository Index");
+        return false;
+    }
+
+    sqlite3_bind_text(stmt, 1, m_provider_id.c_str(), m_provider_id.size(), 0 );
+
+    std::string last_file_id;
+
+    while ( sqlite3_step(stmt) == SQLITE_ROW )
+    {
+
+        std::string file_id( (const char*)sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0) );
+
+        //One row per blob, the file is added with its first row
+        if ( files.empty() || file_id != last_file_id )
+        {
+            SnapshotFile file;
+            file.file_path = ( fs::path( LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 1) ) ) / LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 2) ) ).string();
+            file.file_size = sqlite3_column_int64(stmt, 3);
+            file.last_modified = sqlite3_column_int64(stmt, 4);
+            file.hash = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 5) );
+
+            files.push_back(file);
+            last_file_id = file_id;
+        }
+
+        if ( sqlite3_column_type(stmt, 6) != SQLITE_NULL )
+        {
+            ChunkRef blob;
+            blob.hash = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 6) );
+            blob.length = sqlite3_column_int64(stmt, 7);
+            files.back().blobs.push_back(blob);
+        }
+
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return true;
+
+}
@@ -0,0 +1,194 @@
+#include <vessel/network/circuit_breaker.hpp>
+
+using namespace Vessel::Networking;
+
+std::map<std::string, std::shared_ptr<CircuitBreaker>> CircuitBreaker::m_breakers;
+std::mutex CircuitBreaker::m_breakers_mutex;
+
+CircuitBreaker::CircuitBreaker(const std::string& name) : m_name(name), m_state(Closed), m_failure_rate(0), m_calls(0), m_total_failures(0), m_probing(false)
+{
+
+    LocalDatabase* ldb = &LocalDatabase::get_database();
+
+    int failure_rate = ldb->get_setting_int("breaker_failure_rate");
+    m_max_failure_rate = ( ( failure_rate > 0 ) ? failure_rate : BREAKER_FAILURE_RATE ) / 100.0;
+
+    int slow_secs = ldb->get_setting_int("breaker_slow_secs");
+    m_slow_secs = ( slow_secs > 0 ) ? slow_secs : BREAKER_SLOW_SECS;
+
+    int open_secs = ldb->get_setting_int("breaker_open_secs");
+    m_base_open_secs = ( open_secs > 0 ) ? open_secs : BREAKER_OPEN_SECS;
+
+    int max_open_secs = ldb->get_setting_int("breaker_max_open_secs");
+    m_max_open_secs = std::max( ( max_open_secs > 0 ) ? max_open_secs : BREAKER_MAX_OPEN_SECS, m_base_open_secs );
+
+    m_open_secs = m_base_open_secs;
+
+}
+
+std::shared_ptr<CircuitBreaker> CircuitBreaker::get_breaker(const std::string& name)
+{
+
+    std::lock_guard<std::mutex> lock(m_breakers_mutex);
+
+    auto itr = m_breakers.find(name);
+
+    if ( itr != m_breakers.end() ) {
+        return itr->second;
+    }
+
+    std::shared_ptr<CircuitBreaker> breaker = std::make_shared<CircuitBreaker>(name);
+    m_breakers.insert( std::make_pair(name, breaker) );
+
+    return breaker;
+
+}
+
+bool CircuitBreaker::allow_request()
+{
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ( m_state == Open )
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_opened_at;
+
+        if ( elapsed.count() < m_open_secs ) {
+            return false;
+        }
+
+        m_state = HalfOpen;
+        m_probing = false;
+    }
+
+    if ( m_state == HalfOpen )
+    {
+        //Only one request tests the provider, the others wait for its result
+        if ( m_probing ) {
+            return false;
+        }
+
+        m_probing = true;
+    }
+
+    return true;
+
+}
+
+void CircuitBreaker::record_result(unsigned int http_status, double seconds)
+{
+
+    bool failed = is_provider_failure(http_status) || seconds > m_slow_secs;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ( failed ) {
+        m_total_failures++;
+    }
+
+    switch ( m_state )
+    {
+
+        case Closed:
+
+            m_calls++;
+            m_failure_rate = (BREAKER_SAMPLE_WEIGHT * (failed ? 1.0 : 0.0)) + ((1.0 - BREAKER_SAMPLE_WEIGHT) * m_failure_rate);
+
+            if ( m_calls >= BREAKER_MIN_CALLS && m_failure_rate >= m_max_failure_rate ) {
+                trip();
+            }
+
+            break;
+
+        case HalfOpen:
+
+            m_probing = false;
+
+            if ( failed )
+            {
+                m_open_secs = std::min( m_open_secs * 2, m_max_open_secs );
+                trip();
+            }
+            else
+            {
+                Log::get_log().add_message("Provider " + m_name + " recovered, uploads are resumed", "Circuit Breaker");
+                m_state = Closed;
+                m_failure_rate = 0;
+                m_calls = 0;
+                m_open_secs = m_base_open_secs;
+            }
+
+            break;
+
+        case Open:
+            //Result of a request sent before the breaker opened
+            break;
+
+    }
+
+}
+
+void CircuitBreaker::abandon_request()
+{
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    //The probe did not test the provider, the next request is the probe
+    if ( m_state == HalfOpen ) {
+        m_probing = false;
+    }
+
+}
+
+double CircuitBreaker::get_wait_secs()
+{
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if ( m_state != Open ) {
+        return 0;
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_opened_at;
+
+    return std::max( m_open_secs - elapsed.count(), 0.0 );
+
+}
+
+void CircuitBreaker::wait()
+{
+
+    double wait_secs = get_wait_secs();
+
+    if ( wait_secs > 0 ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( (long)(wait_secs * 1000) ) );
+    }
+
+}
+
+CircuitBreaker::State CircuitBreaker::get_state()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_state;
+}
+
+size_t CircuitBreaker::get_total_failures()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_total_failures;
+}
+
+bool CircuitBreaker::is_provider_failure(unsigned int http_status)
+{
+    return ( http_status == 0 || http_status == 408 || http_status == 429 || http_status >= 500 );
+}
+
+void CircuitBreaker::trip()
+{
+
+    m_state = Open;
+    m_opened_at = std::chrono::steady_clock::now();
+
+    Log::get_log().add_error("Provider " + m_name + " is failing, uploads are paused for " + std::to_string(m_open_secs) + " seconds", "Circuit Breaker");
+
+}
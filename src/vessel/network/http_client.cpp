@@ -51,6 +51,11 @@ void HttpClient::set_defaults()
     m_connected = false;
     m_content_length = 0;
     m_stopped=true;
+    m_reusable=false;
+    m_head_request=false;
+
+    //Connections are reused for the next request unless disabled
+    m_keep_alive = ( m_ldb->get_setting_int("http_keep_alive") == 1 );
 
     //Set Max Transfer Speed (if defined)
     size_t db_max_speed = m_ldb->get_setting_int("max_transfer_speed");
@@ -331,6 +336,26 @@ void HttpClient::read_chunked_content( const boost::system::error_code& e, size_
 
     if ( chunk_sz <= 0 ) //There is no more data to read
     {
+        //Consume the blank line after the last chunk, so the connection can carry the next response
+        boost::system::error_code ec;
+        int remaining = 2 - (int)m_response_buffer->size();
+
+        if ( remaining > 0 )
+        {
+            if ( m_use_ssl ) {
+                boost::asio::read(*m_ssl_socket, *m_response_buffer, boost::asio::transfer_exactly(remaining), ec);
+            }
+            else {
+                boost::asio::read(*m_socket, *m_response_buffer, boost::asio::transfer_exactly(remaining), ec);
+            }
+        }
+
+        std::string delimiter( boost::asio::buffers_begin(m_response_buffer->data()), boost::asio::buffers_begin(m_response_buffer->data()) + std::min( (size_t)2, m_response_buffer->size() ) );
+        m_response_buffer->consume( delimiter.size() );
+
+        //Trailers are not parsed, a response with trailers closes the connection
+        m_reusable = ( !ec && delimiter == "\r\n" && m_response_buffer->size() == 0 );
+
         m_response_ec = boost::asio::error::eof;
         m_work.reset();
         return;
@@ -521,6 +546,43 @@ void HttpClient::handle_read_headers( const boost::system::error_code& e )
                 read_buffer_data();
             }
 
+            //Responses without a body
+            long response_length = -1;
+
+            if ( m_head_request || m_http_status == 204 || m_http_status == 304 || (m_http_status >= 100 && m_http_status < 200) ) {
+                response_length = 0;
+            }
+
+            for ( auto& itr : m_response_headers )
+            {
+                if ( response_length < 0 && boost::iequals( itr.first, "Content-Length" ) ) {
+                    response_length = std::stol( boost::trim_copy(itr.second) );
+                }
+            }
+
+            //The body is read up to its length instead of EOF, so the connection can carry the next request
+            if ( response_length >= 0 )
+            {
+
+                if ( m_response_data.size() >= (size_t)response_length )
+                {
+                    m_reusable = ( m_response_data.size() == (size_t)response_length );
+                    m_response_ec = boost::asio::error::eof;
+                    m_work.reset();
+                }
+                else if ( m_use_ssl )
+                {
+                    boost::asio::async_read( *m_ssl_socket, *m_response_buffer, boost::asio::transfer_exactly( response_length - m_response_data.size() ), boost::bind(&HttpClient::read_content_length, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred) );
+                }
+                else
+                {
+                    boost::asio::async_read( *m_socket, *m_response_buffer, boost::asio::transfer_exactly( response_length - m_response_data.size() ), boost::bind(&HttpClient::read_content_length, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred) );
+                }
+
+                return;
+
+            }
+
             // Start reading remaining data until EOF
             if ( m_use_ssl )
             {
@@ -583,6 +645,24 @@ void HttpClient::handle_read_content( const boost::system::error_code& e, size_t
 
 }
 
+void HttpClient::read_content_length( const boost::system::error_code& e, size_t bytes_transferred )
+{
+
+    std::cout << "Reading response body..." << '\n';
+
+    read_buffer_data();
+
+    if ( e ) {
+        m_log->add_message("Error occurred while reading the HTTP response: " + e.message(), "ASIO");
+    }
+
+    //A connection is only reused if the whole body was read
+    m_reusable = !e;
+    m_response_ec = boost::asio::error::eof;
+    m_work.reset();
+
+}
+
 void HttpClient::check_deadline()
 {
 
@@ -735,6 +815,80 @@ void HttpClient::write_socket( const std::string& http_request )
     }
 }
 
+void HttpClient::write_socket_stream( const std::string& header, const HttpBodySource& source )
+{
+
+    //Cleanup buffers / data
+    cleanup();
+
+    //Reset IO Service for next operation
+    m_io_service.reset();
+
+    //Create work object
+    m_work.reset( new boost::asio::io_service::work(m_io_service) );
+
+    boost::system::error_code ec;
+    std::string chunk = header;
+    size_t bytes_sent = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+
+        do
+        {
+
+            if ( !m_use_ssl ) {
+                boost::asio::write(*m_socket, boost::asio::buffer(chunk), ec);
+            }
+            else {
+                boost::asio::write(*m_ssl_socket, boost::asio::buffer(chunk), ec);
+            }
+
+            bytes_sent += chunk.size();
+
+            //Hold the transfer rate under max_transfer_speed
+            double min_secs = (bytes_sent * 1.0) / (m_max_transfer_speed * 1.0);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if ( min_secs > elapsed.count() ) {
+                boost::this_thread::sleep_for( boost::chrono::milliseconds( (long)((min_secs - elapsed.count()) * 1000) ) );
+            }
+
+            chunk.clear();
+
+        } while ( !ec && source(chunk) );
+
+    }
+    catch ( const std::exception& e )
+    {
+        //The request can not be completed, the server must not see a short body as the end of the request
+        m_log->add_error("Request body could not be read: " + std::string(e.what()), "HttpClient");
+        disconnect();
+        throw;
+    }
+
+    if ( ec )
+    {
+        m_log->add_error("ASIO Write Error: " + ec.message(), "HttpClient");
+        m_response_ec = ec;
+        m_work.reset(); //No more work
+        return;
+    }
+
+    std::cout << "Sent " << bytes_sent << " bytes..." << '\n';
+
+    if ( !m_use_ssl )
+    {
+        boost::asio::async_read_until(*m_socket, *m_response_buffer, "\r\n", boost::bind(&HttpClient::handle_response, this, boost::asio::placeholders::error));
+    }
+    else
+    {
+        boost::asio::async_read_until(*m_ssl_socket, *m_response_buffer, "\r\n", boost::bind(&HttpClient::handle_response, this, boost::asio::placeholders::error));
+    }
+
+}
+
 void HttpClient::handle_write_throttled( const boost::system::error_code& e, size_t bytes_transferred )
 {
 
@@ -851,6 +1005,8 @@ void HttpClient::cleanup()
     clear_response();
     clear_headers();
     m_content_length=0;
+    m_http_status=0;
+    m_reusable=false;
 }
 
 /*
@@ -895,12 +1051,18 @@ std::string HttpClient::encode_uri(const std::string& uri)
 int HttpClient::send_http_request( const HttpRequest& request )
 {
 
+    //Fail fast while the provider is failing, nothing is read or sent
+    if ( m_breaker && !m_breaker->allow_request() ) {
+        throw HttpException(HttpException::CircuitOpen, "Requests to " + m_hostname + " are paused, the provider is failing");
+    }
+
     HttpRequestStream http_stream;
     std::string accept = request.get_accept();
     std::string authorization = request.get_auth();
     std::string http_method = request.get_method();
     std::string content_type = request.get_content_type();
     m_content_length = request.get_body_length();
+    m_head_request = ( http_method == "HEAD" );
 
     //Build the HTTP Request
     http_stream << http_method << " " << request.get_url() << " HTTP/1.1\r\n";
@@ -928,7 +1090,7 @@ int HttpClient::send_http_request( const HttpRequest& request )
             http_stream << "Content-Type: " << content_type << "\r\n";
         }
 
-        if ( request.get_body_length() > 0 )
+        if ( request.get_body_length() > 0 && !request.has_body_source() )
         {
             send_body=true;
         }
@@ -941,8 +1103,8 @@ int HttpClient::send_http_request( const HttpRequest& request )
         http_stream << itr << "\r\n";
     }
 
-    //Close connection after response
-    http_stream << "Connection: close\r\n\r\n";
+    //Keep the connection open for the next request, unless keep-alive is disabled
+    http_stream << ( m_keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n" );
 
     //std::cout << "Sending request:" << '\n' << http_stream.str() << '\n';
 
@@ -950,24 +1112,84 @@ int HttpClient::send_http_request( const HttpRequest& request )
         http_stream << request.get_body();
     }
 
-    //If client is already connected, disconnect before a new attempt
-    if ( is_connected() ) {
-        disconnect();
-    }
+    auto request_start = std::chrono::steady_clock::now();
+
+    try
+    {
 
-    //Connect to server
-    connect();
+        bool reused = can_reuse_connection();
 
-    //Write HTTP request to socket
-    write_socket(http_stream.str());
+        if ( !reused )
+        {
+            //If client is already connected, disconnect before a new attempt
+            if ( is_connected() ) {
+                disconnect();
+            }
 
-    //Run the handlers until the response sets the status code or EOF
-    run_io_service();
+            //Connect to server
+            connect();
+        }
+
+        write_request(http_stream.str(), request);
+
+        //The server may close an idle connection before it reads the request, it is sent again on a new connection.
+        //A streamed body can not be read twice
+        if ( reused && get_http_status() == 0 && !request.has_body_source() )
+        {
+            m_log->add_message("Connection to " + m_hostname + " was closed by the server, reconnecting", "HttpClient");
+
+            disconnect();
+            connect();
+
+            write_request(http_stream.str(), request);
+        }
 
-    disconnect();
+    }
+    catch ( const HttpException& )
+    {
+        //The provider could not be reached
+        if ( m_breaker ) {
+            std::chrono::duration<double> request_secs = std::chrono::steady_clock::now() - request_start;
+            m_breaker->record_result(0, request_secs.count());
+        }
+        throw;
+    }
+    catch ( const boost::system::system_error& )
+    {
+        //The provider host could not be resolved
+        if ( m_breaker ) {
+            std::chrono::duration<double> request_secs = std::chrono::steady_clock::now() - request_start;
+            m_breaker->record_result(0, request_secs.count());
+        }
+        throw;
+    }
+    catch ( ... )
+    {
+        //The request body could not be read, this says nothing about the provider
+        if ( m_breaker ) {
+            m_breaker->abandon_request();
+        }
+        throw;
+    }
+
+    //Keep the connection for the next request, unless the response was not read to its end or the server closes it
+    if ( m_keep_alive && m_reusable && !boost::icontains(m_header_data, "Connection: close") )
+    {
+        m_response_ec.clear();
+        m_last_used = std::chrono::steady_clock::now();
+    }
+    else
+    {
+        disconnect();
+    }
 
     unsigned int http_status = get_http_status();
 
+    if ( m_breaker ) {
+        std::chrono::duration<double> request_secs = std::chrono::steady_clock::now() - request_start;
+        m_breaker->record_result(http_status, request_secs.count());
+    }
+
     if ( m_http_logging )
     {
         //Truncate logs > 16kb
@@ -978,6 +1200,48 @@ int HttpClient::send_http_request( const HttpRequest& request )
 
 }
 
+void HttpClient::write_request( const std::string& header, const HttpRequest& request )
+{
+
+    //Write HTTP request to socket
+    if ( request.has_body_source() ) {
+        write_socket_stream(header, request.get_body_source());
+    }
+    else {
+        write_socket(header);
+    }
+
+    //Run the handlers until the response sets the status code or EOF
+    run_io_service();
+
+}
+
+bool HttpClient::can_reuse_connection()
+{
+
+    if ( !m_keep_alive || !m_reusable || !is_connected() ) {
+        return false;
+    }
+
+    std::chrono::duration<double> idle = std::chrono::steady_clock::now() - m_last_used;
+
+    if ( idle.count() > HTTP_KEEP_ALIVE_IDLE ) {
+        return false;
+    }
+
+    //An open connection has nothing to read. A closed one has an EOF or a TLS alert waiting
+    boost::asio::ip::tcp::socket& socket = m_use_ssl ? m_ssl_socket->next_layer() : *m_socket;
+    boost::system::error_code ec, block_ec;
+    char data;
+
+    socket.non_blocking(true, ec);
+    socket.receive( boost::asio::buffer(&data, 1), boost::asio::ip::tcp::socket::message_peek, ec );
+    socket.non_blocking(false, block_ec);
+
+    return ( ec == boost::asio::error::would_block );
+
+}
+
 bool HttpClient::http_logging()
 {
     return m_http_logging;
@@ -995,6 +1259,14 @@ std::string HttpClient::get_header(const std::string& key)
         return m_response_headers[key];
     }
 
+    //Header names are case insensitive, S3 compatible servers do not all use the same case
+    for ( const auto& itr : m_response_headers )
+    {
+        if ( boost::iequals(itr.first, key) ) {
+            return itr.second;
+        }
+    }
+
     return "";
 }
 
@@ -1027,3 +1299,13 @@ void HttpClient::max_transfer_speed(size_t limit)
 {
     m_max_transfer_speed = (limit > 0) ? limit : -1;
 }
+
+void HttpClient::keep_alive(bool flag)
+{
+    m_keep_alive = flag;
+}
+
+void HttpClient::set_circuit_breaker(std::shared_ptr<CircuitBreaker> breaker)
+{
+    m_breaker = breaker;
+}
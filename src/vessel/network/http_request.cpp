@@ -32,6 +32,12 @@ void HttpRequest::accept(const std::string& str)
     m_accept = str;
 }
 
+void HttpRequest::set_body_source( HttpBodySource source, size_t length )
+{
+    m_body_source = source;
+    m_body_length = length;
+}
+
 std::string HttpRequest::get_url() const
 {
     return m_url;
@@ -70,5 +76,15 @@ std::string HttpRequest::get_auth() const
 
 size_t HttpRequest::get_body_length() const
 {
-    return m_body.size();
+    return m_body_source ? m_body_length : m_body.size();
+}
+
+HttpBodySource HttpRequest::get_body_source() const
+{
+    return m_body_source;
+}
+
+bool HttpRequest::has_body_source() const
+{
+    return (bool)m_body_source;
 }
@@ -0,0 +1,90 @@
+#include <vessel/vessel/part_sizer.hpp>
+
+PartSizer::PartSizer(const std::string& provider_type)
+{
+
+    //Provider limits
+    if ( provider_type == "azure_blob" )
+    {
+        m_min_part_size = 1048576; //1MB
+        m_max_part_size = 104857600; //100MB per block (x-ms-version 2018-03-28)
+        m_max_parts = 50000;
+    }
+    else
+    {
+        //AWS S3 and compatible
+        m_min_part_size = 5242880; //5MB
+        m_max_part_size = 5368709120; //5GB
+        m_max_parts = 10000;
+    }
+
+    LocalDatabase* ldb = &LocalDatabase::get_database();
+
+    int default_size = ldb->get_setting_int("multipart_chunk_size");
+    m_default_part_size = ( default_size > 0 ) ? default_size : BackupFile::get_chunk_size();
+
+    //Parts are read into the buffer pool, which holds the memory budget
+    m_memory_budget = BufferPool::get_pool().get_budget();
+
+    //Link stats (the failure rate is stored in hundredths of a percent)
+    StatManager stats;
+    m_throughput = std::max( stats.get_stat("part_throughput"), 0 );
+    m_failure_rate = std::max( stats.get_stat("part_failure_rate"), 0 ) / 10000.0;
+
+}
+
+size_t PartSizer::get_part_size(size_t file_size) const
+{
+
+    //Smallest part size that keeps the file within the provider part limit
+    size_t limit_size = align_size( std::ceil( file_size / (double)m_max_parts ) );
+
+    //Size the part to take about PART_TARGET_SECS on the current link
+    double part_size = ( m_throughput > 0 ) ? ( m_throughput * PART_TARGET_SECS ) : m_default_part_size;
+
+    //A failed part is uploaded again in full, so use smaller parts on an unreliable link
+    part_size *= std::max( 1.0 - (2.0 * m_failure_rate), 0.25 );
+
+    //Stay within the memory budget and the provider limits
+    part_size = std::min( part_size, (double)(m_memory_budget / PART_BUFFER_COPIES) );
+    part_size = std::min( part_size, (double)m_max_part_size );
+    part_size = std::max( part_size, (double)m_min_part_size );
+
+    size_t size = align_size( (size_t)part_size );
+
+    //The part limit cannot be exceeded, even if the memory budget is
+    if ( size < limit_size )
+    {
+        Log::get_log().add_message("Part size exceeds the memory budget to stay within " + std::to_string(m_max_parts) + " parts: " + std::to_string(limit_size), "File Upload");
+        size = limit_size;
+    }
+
+    return std::min( size, m_max_part_size );
+
+}
+
+void PartSizer::record_part(size_t bytes, double seconds, bool success)
+{
+
+    StatManager stats;
+
+    double throughput = stats.get_stat("part_throughput");
+    double failure_rate = std::max( stats.get_stat("part_failure_rate"), 0 ) / 10000.0;
+
+    //Only successful parts have a meaningful transfer rate
+    if ( success && seconds > 0 )
+    {
+        double sample = bytes / seconds;
+        throughput = ( throughput > 0 ) ? ( (PART_STAT_WEIGHT * sample) + ((1.0 - PART_STAT_WEIGHT) * throughput) ) : sample;
+        stats.update_stat("part_throughput", (int)std::min( throughput, 2147483647.0 ) );
+    }
+
+    failure_rate = (PART_STAT_WEIGHT * (success ? 0.0 : 1.0)) + ((1.0 - PART_STAT_WEIGHT) * failure_rate);
+    stats.update_stat("part_failure_rate", (int)(failure_rate * 10000) );
+
+}
+
+size_t PartSizer::align_size(size_t size)
+{
+    return ( (size + PART_SZ_ALIGN - 1) / PART_SZ_ALIGN ) * PART_SZ_ALIGN;
+}
@@ -0,0 +1,173 @@
+#include <vessel/vessel/provider_selector.hpp>
+
+using namespace Vessel;
+
+std::map<std::string, ProviderStats> ProviderSelector::m_stats;
+std::mutex ProviderSelector::m_stats_mutex;
+
+ProviderSelector::ProviderSelector(const std::vector<StorageProvider>& providers) : m_providers(providers)
+{
+
+    LocalDatabase* ldb = &LocalDatabase::get_database();
+
+    std::string mode = ldb->get_setting_str("provider_mode");
+    m_weighted = ( ( mode.empty() ? std::string(PROVIDER_MODE) : mode ) == "weighted" );
+
+    int failover_rate = ldb->get_setting_int("provider_failover_rate");
+    m_failover_rate = ( ( failover_rate > 0 ) ? failover_rate : PROVIDER_FAILOVER_RATE ) / 100.0;
+
+    int retry_secs = ldb->get_setting_int("provider_retry_secs");
+    m_retry_secs = ( retry_secs > 0 ) ? retry_secs : PROVIDER_RETRY_SECS;
+
+}
+
+StorageProvider ProviderSelector::select()
+{
+
+    std::vector<StorageProvider> healthy;
+
+    for ( const auto& provider : m_providers )
+    {
+        if ( is_healthy(provider) ) {
+            healthy.push_back(provider);
+        }
+    }
+
+    //Nothing is healthy, the uploads wait for the primary provider
+    StorageProvider selected = healthy.empty() ? m_providers.front() : healthy.front();
+
+    if ( m_weighted && healthy.size() > 1 )
+    {
+        int total_weight = 0;
+        const StorageProvider* best = nullptr;
+
+        //Every provider gains its weight, the one with the most is selected and pays back the total
+        for ( const auto& provider : healthy )
+        {
+            m_current_weights[provider.provider_id] += provider.weight;
+            total_weight += provider.weight;
+
+            if ( !best || m_current_weights[provider.provider_id] > m_current_weights[best->provider_id] ) {
+                best = &provider;
+            }
+        }
+
+        m_current_weights[best->provider_id] -= total_weight;
+        selected = *best;
+    }
+
+    //Only failovers are logged, a weighted selection changes on every call
+    if ( !m_weighted && !m_last_provider_id.empty() && selected.provider_id != m_last_provider_id )
+    {
+        if ( selected.provider_id == m_providers.front().provider_id ) {
+            Log::get_log().add_message("Uploading to the primary storage provider " + selected.provider_name + " again", "Storage Provider");
+        }
+        else {
+            Log::get_log().add_message("Storage provider is degraded, uploading to " + selected.provider_name + " instead", "Storage Provider");
+        }
+    }
+
+    m_last_provider_id = selected.provider_id;
+
+    return selected;
+
+}
+
+bool ProviderSelector::is_healthy(const StorageProvider& provider)
+{
+
+    //Open breakers fail every request
+    if ( CircuitBreaker::get_breaker(provider.provider_id)->get_wait_secs() > 0 ) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+
+    auto itr = m_stats.find(provider.provider_id);
+
+    if ( itr == m_stats.end() || itr->second.uploads < PROVIDER_MIN_UPLOADS ) {
+        return true;
+    }
+
+    ProviderStats& stats = itr->second;
+
+    bool degraded = ( stats.error_rate >= m_failover_rate ) || ( stats.baseline > 0 && stats.goodput < stats.baseline * PROVIDER_SLOW_RATIO );
+
+    if ( !degraded ) {
+        return true;
+    }
+
+    //A skipped provider gets no uploads to update its stats, it is given a fresh start after a while
+    std::chrono::duration<double> idle = std::chrono::steady_clock::now() - stats.last_upload;
+
+    if ( idle.count() >= m_retry_secs )
+    {
+        stats.goodput = stats.baseline;
+        stats.error_rate = 0;
+        stats.uploads = 0;
+        return true;
+    }
+
+    return false;
+
+}
+
+bool ProviderSelector::find_provider(const std::string& provider_id, StorageProvider& provider) const
+{
+
+    for ( const auto& itr : m_providers )
+    {
+        if ( itr.provider_id == provider_id ) {
+            provider = itr;
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+void ProviderSelector::record_upload(const std::string& provider_id, size_t bytes, double seconds, bool success)
+{
+
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+
+    auto itr = m_stats.find(provider_id);
+
+    if ( itr == m_stats.end() )
+    {
+        ProviderStats stats = {0, 0, 0, 0, std::chrono::steady_clock::now()};
+        itr = m_stats.insert( std::make_pair(provider_id, stats) ).first;
+    }
+
+    ProviderStats& stats = itr->second;
+
+    //Only successful uploads of larger files have a meaningful transfer rate
+    if ( success && seconds > 0 && bytes >= PROVIDER_GOODPUT_MIN_SZ )
+    {
+        double sample = bytes / seconds;
+        stats.goodput = ( stats.goodput > 0 ) ? ( (PROVIDER_STAT_WEIGHT * sample) + ((1.0 - PROVIDER_STAT_WEIGHT) * stats.goodput) ) : sample;
+        stats.baseline = ( stats.baseline > 0 ) ? ( (PROVIDER_BASELINE_WEIGHT * sample) + ((1.0 - PROVIDER_BASELINE_WEIGHT) * stats.baseline) ) : sample;
+    }
+
+    stats.error_rate = (PROVIDER_STAT_WEIGHT * (success ? 0.0 : 1.0)) + ((1.0 - PROVIDER_STAT_WEIGHT) * stats.error_rate);
+    stats.uploads++;
+    stats.last_upload = std::chrono::steady_clock::now();
+
+}
+
+ProviderStats ProviderSelector::get_stats(const std::string& provider_id)
+{
+
+    std::lock_guard<std::mutex> lock(m_stats_mutex);
+
+    auto itr = m_stats.find(provider_id);
+
+    if ( itr == m_stats.end() ) {
+        ProviderStats stats = {0, 0, 0, 0, std::chrono::steady_clock::now()};
+        return stats;
+    }
+
+    return itr->second;
+
+}
@@ -1,21 +1,144 @@
 #include <vessel/vessel/queue_manager.hpp>
 
+std::unique_ptr<UploadHeap> QueueManager::m_queue;
+std::map<unsigned int, QueueEntry> QueueManager::m_taken;
+std::vector<std::string> QueueManager::m_popped;
+std::mutex QueueManager::m_queue_mutex;
+
 QueueManager::QueueManager()
 {
     m_database = &LocalDatabase::get_database();
+
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+
+    //The queue is loaded once per process
+    if ( !m_queue ) {
+        load_queue();
+    }
+}
+
+QueueManager::~QueueManager()
+{
+
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+
+    //Uploads that were not popped are taken again by the next manager
+    for ( unsigned int upload_id : m_taken_ids )
+    {
+        auto itr = m_taken.find(upload_id);
+
+        if ( itr != m_taken.end() ) {
+            m_queue->push(itr->second);
+            m_taken.erase(itr);
+        }
+    }
+
+    try
+    {
+        persist();
+    }
+    catch ( const std::exception& e )
+    {
+        Log::get_log().add_error( std::string("Failed to persist the upload queue: ") + e.what(), "Upload Queue" );
+    }
+
+}
+
+std::shared_ptr<SchedulePolicy> QueueManager::get_policy()
+{
+
+    int aging = QUEUE_AGING;
+    int sla_hours = m_database->get_setting_int("queue_sla_hours");
+    std::string name = m_database->get_setting_str("queue_policy");
+
+    //A missing setting reads as 0, which turns aging off
+    if ( !m_database->get_setting_str("queue_aging").empty() ) {
+        aging = std::max( m_database->get_setting_int("queue_aging"), 0 );
+    }
+
+    if ( sla_hours <= 0 ) {
+        sla_hours = QUEUE_SLA_HOURS;
+    }
+
+    if ( name.empty() ) {
+        name = QUEUE_POLICY;
+    }
+
+    std::shared_ptr<SchedulePolicy> policy = SchedulePolicy::create( name, aging, sla_hours * 3600UL );
+
+    if ( !policy )
+    {
+        Log::get_log().add_error("Unknown upload scheduling policy: " + name + ", using " + QUEUE_POLICY, "Upload Queue");
+        policy = SchedulePolicy::create( QUEUE_POLICY, aging, sla_hours * 3600UL );
+    }
+
+    return policy;
+
+}
+
+void QueueManager::load_queue()
+{
+
+    //The policy is read again when the queue is rebuilt
+    m_queue.reset( new UploadHeap( get_policy() ) );
+
+    sqlite3_stmt* stmt;
+    //backup_upload.last_modified is set by a trigger when the row is written, the file time is kept in backup_file
+    std::string query = "SELECT a.upload_id,a.file_id,a.weight,IFNULL(b.last_modified,0),a.queued_time,IFNULL(b.filesize,0) FROM backup_upload AS a LEFT JOIN backup_file AS b ON a.file_id=b.file_id";
+
+    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
+    }
+
+    while ( sqlite3_step(stmt) == SQLITE_ROW )
+    {
+        QueueEntry entry;
+        entry.upload_id = sqlite3_column_int(stmt, 0);
+        entry.file_key = get_file_key( LocalDatabase::get_binary_id( (unsigned char*)sqlite3_column_blob(stmt, 1) ) );
+        entry.weight = sqlite3_column_int(stmt, 2);
+        entry.last_modified = sqlite3_column_int64(stmt, 3);
+        entry.queued_time = sqlite3_column_int64(stmt, 4);
+        entry.file_size = sqlite3_column_int64(stmt, 5);
+
+        //Taken uploads are not queued twice
+        if ( m_taken.count(entry.upload_id) == 0 ) {
+            m_queue->push(entry);
+        }
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
 }
 
 void QueueManager::rebuild_queue()
 {
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    rebuild();
+}
+
+void QueueManager::rebuild()
+{
+
+    //Taken uploads are still being uploaded
+    if ( !m_taken.empty() ) {
+        return;
+    }
+
+    //Popped uploads must be gone before files are queued again
+    persist();
 
     //Clear the current queue
     clear_queue();
 
+    //Started multipart uploads are kept
+    load_queue();
+
     //Implement priority queing based on file types
     //Inner join will add files with extensions that match with the weighted extensions in the backup_weight_ext table
 
     sqlite3_stmt* stmt;
-    std::string query = "SELECT a.file_id FROM backup_file AS a INNER JOIN backup_weight_ext AS b ON a.file_ext=b.file_ext WHERE a.last_modified > a.last_backup_time ORDER BY a.last_modified DESC LIMIT ?1";
+    std::string query = "SELECT a.file_id,b.weight FROM backup_file AS a INNER JOIN backup_weight_ext AS b ON a.file_ext=b.file_ext WHERE a.last_modified > a.last_backup_time ORDER BY a.last_modified DESC LIMIT ?1";
 
     if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
         throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
@@ -30,13 +153,13 @@ void QueueManager::rebuild_queue()
     while ( sqlite3_step(stmt) == SQLITE_ROW )
     {
         std::shared_ptr<unsigned char> file_id = LocalDatabase::get_binary_id( (unsigned char*)sqlite3_column_blob(stmt, 0) );
-        push_file(file_id);
+        push_file(file_id, sqlite3_column_int(stmt, 1));
         total_rows++;
 
     }
 
-    //Reset the statement
-    sqlite3_reset(stmt);
+    //Cleanup
+    sqlite3_finalize(stmt);
 
     int remainder = QUEUE_MAX_ROWS - total_rows;
 
@@ -45,7 +168,7 @@ void QueueManager::rebuild_queue()
     if ( remainder > 0 )
     {
 
-        query = "SELECT file_id FROM backup_file WHERE last_modified > last_backup_time ORDER BY last_modified DESC LIMIT ?1";
+        query = "SELECT a.file_id,IFNULL(b.weight,0) FROM backup_file AS a LEFT JOIN backup_weight_ext AS b ON a.file_ext=b.file_ext WHERE a.last_modified > a.last_backup_time ORDER BY a.last_modified DESC LIMIT ?1";
 
         if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
             throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
@@ -58,53 +181,97 @@ void QueueManager::rebuild_queue()
         while ( sqlite3_step(stmt) == SQLITE_ROW )
         {
             std::shared_ptr<unsigned char> file_id = LocalDatabase::get_binary_id( (unsigned char*)sqlite3_column_blob(stmt, 0) );
-            push_file(file_id);
+            push_file(file_id, sqlite3_column_int(stmt, 1));
             total_rows++;
 
         }
 
+        //Cleanup
+        sqlite3_finalize(stmt);
+
     }
 
-     //Cleanup
-    sqlite3_finalize(stmt);
+}
+
+void QueueManager::clear_queue()
+{
 
-    //Apply weights
-    apply_weights();
+    //Started multipart uploads stay in the queue so they are resumed instead of uploaded again
+    std::vector<std::string> queries;
+    queries.push_back("DELETE FROM backup_upload WHERE upload_key IS NULL OR upload_key=''");
+    queries.push_back("DELETE FROM backup_upload_part WHERE upload_id NOT IN (SELECT upload_id FROM backup_upload)");
+
+    for ( const auto& query : queries )
+    {
+
+        sqlite3_stmt* stmt;
+
+        if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+            throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
+            return;
+        }
+
+        //Execute query
+        sqlite3_step(stmt);
+
+        //Cleanup
+        sqlite3_finalize(stmt);
+
+    }
 
 }
 
-void QueueManager::clear_queue()
+bool QueueManager::is_queued(std::shared_ptr<unsigned char> file_id)
 {
 
+    bool queued = false;
+
     sqlite3_stmt* stmt;
-    std::string query = "DELETE FROM backup_upload";
+    std::string query = "SELECT 1 FROM backup_upload WHERE file_id=?1 LIMIT 1";
 
     if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
         throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
-        return;
     }
 
-    //Execute query
-    sqlite3_step(stmt);
+    sqlite3_bind_blob(stmt, 1, file_id.get(), sizeof(file_id.get()), 0 );
+
+    if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+        queued = true;
+    }
 
     //Cleanup
     sqlite3_finalize(stmt);
 
+    return queued;
+
 }
 
-void QueueManager::push_file(std::shared_ptr<unsigned char> file_id)
+void QueueManager::push_file(std::shared_ptr<unsigned char> file_id, int weight)
 {
 
+    //Files with a resumable upload are already queued
+    if ( is_queued(file_id) ) {
+        return;
+    }
+
     BackupFile file(file_id);
 
     sqlite3_stmt* stmt;
-    std::string query = "INSERT INTO backup_upload (file_id,total_parts,chunk_size,hash) VALUES(?1,?2,?3,?4)";
+    //The modification time is read from backup_file, backup_upload.last_modified is set by a trigger
+    std::string query = "INSERT INTO backup_upload (file_id,total_parts,chunk_size,hash,weight,queued_time) VALUES(?1,?2,?3,?4,?5,?6)";
 
     if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
         throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")");
         return;
     }
 
+    QueueEntry entry;
+    entry.file_key = get_file_key(file_id);
+    entry.weight = weight;
+    entry.last_modified = file.get_last_modified();
+    entry.file_size = file.get_file_size();
+    entry.queued_time = (unsigned long)std::time(nullptr);
+
     int total_parts = file.get_total_parts();
     int chunk_size = file.get_chunk_size();
     std::string file_hash = file.get_hash_sha1();
@@ -114,6 +281,8 @@ void QueueManager::push_file(std::shared_ptr<unsigned char> file_id)
     sqlite3_bind_int(stmt, 2, total_parts );
     sqlite3_bind_int(stmt, 3, chunk_size );
     sqlite3_bind_text(stmt, 4, file_hash.c_str(), file_hash.size(), 0 );
+    sqlite3_bind_int(stmt, 5, entry.weight );
+    sqlite3_bind_int64(stmt, 6, entry.queued_time );
 
     //Execute query
     if ( sqlite3_step(stmt) != SQLITE_DONE ) {
@@ -121,142 +290,156 @@ void QueueManager::push_file(std::shared_ptr<unsigned char> file_id)
         return;
     }
 
+    entry.upload_id = (unsigned int)sqlite3_last_insert_rowid( m_database->get_handle() );
+
     //Cleanup
     sqlite3_finalize(stmt);
 
+    m_queue->push(entry);
+
 }
 
 void QueueManager::pop_file(std::shared_ptr<unsigned char> file_id)
 {
 
-    sqlite3_stmt* stmt;
-    std::string query = "DELETE FROM backup_upload WHERE file_id=?1";
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
 
-    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
-        throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
+    std::string file_key = get_file_key(file_id);
+
+    for ( auto itr = m_taken.begin(); itr != m_taken.end(); ++itr )
+    {
+        if ( itr->second.file_key == file_key ) {
+            m_taken.erase(itr);
+            break;
+        }
     }
 
-    //Bind file id
-    sqlite3_bind_blob(stmt, 1, file_id.get(), sizeof(file_id.get()), 0 );
+    //The upload is removed from backup_upload with the next batch
+    m_popped.push_back(file_key);
 
-    //Execute query
-    if ( sqlite3_step(stmt) != SQLITE_DONE ) {
-        throw DatabaseException(DatabaseException::InvalidQuery, "Error executing query: " + query + "(" + m_database->get_last_err() + ")" );
+    if ( m_popped.size() >= QUEUE_FLUSH_SZ ) {
+        persist();
     }
 
-    //Cleanup
-    sqlite3_finalize(stmt);
+}
 
+void QueueManager::persist_queue()
+{
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+    persist();
 }
 
-void QueueManager::apply_weights()
+void QueueManager::persist()
 {
 
+    if ( m_popped.empty() ) {
+        return;
+    }
+
     sqlite3_stmt* stmt;
-    std::string query = "UPDATE backup_upload SET weight = weight + (SELECT weight FROM backup_weight_ext AS b INNER JOIN backup_file AS c ON file_id = c.file_id WHERE b.file_ext = c.file_ext)";
+    std::string query = "DELETE FROM backup_upload WHERE file_id IN (?1";
+
+    for ( size_t i=1; i < m_popped.size(); i++ ) {
+        query += ",?" + std::to_string(i + 1);
+    }
+
+    query += ")";
 
     if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
         throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
     }
 
+    //Bind file ids
+    for ( size_t i=0; i < m_popped.size(); i++ ) {
+        sqlite3_bind_blob(stmt, i + 1, m_popped[i].data(), m_popped[i].size(), 0 );
+    }
+
     //Execute query
     if ( sqlite3_step(stmt) != SQLITE_DONE ) {
-        throw DatabaseException(DatabaseException::InvalidQuery, "Error executing query: " + query + "(" + m_database->get_last_err() + ")");
+        sqlite3_finalize(stmt);
+        throw DatabaseException(DatabaseException::InvalidQuery, "Error executing query: " + query + "(" + m_database->get_last_err() + ")" );
     }
 
     //Cleanup
     sqlite3_finalize(stmt);
 
+    m_popped.clear();
+
 }
 
 int QueueManager::get_total_pending()
 {
 
-    sqlite3_stmt* stmt;
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
 
-    std::string query = "SELECT COUNT(*) FROM backup_upload";
+    return m_queue->size() + m_taken.size();
 
-    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
-        throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")");
-        return -1;
-    }
+}
 
-    int total_pending = 0;
+BackupFile QueueManager::get_next_file()
+{
 
-    if ( sqlite3_step(stmt) == SQLITE_ROW )
-    {
-        total_pending = (int)sqlite3_column_int(stmt, 0);
-    }
+    FileUpload upload = get_next_upload();
 
-    sqlite3_finalize(stmt);
+    //Get File object by database id
+    BackupFile bf = upload.get_file();
+    bf.set_upload_id( upload.get_upload_id() );
+    bf.set_upload_key( upload.get_upload_key() );
 
-    return total_pending;
+    return bf;
 
 }
 
-BackupFile QueueManager::get_next_file()
+FileUpload QueueManager::get_next_upload()
 {
 
-    //If there are no pending uploads, rebuild the queue
-    if ( get_total_pending() == 0 )
-    {
-        rebuild_queue();
-    }
+    std::vector<FileUpload> uploads = get_next_uploads(1);
 
-    sqlite3_stmt* stmt;
-
-    std::string query = "SELECT file_id,upload_id,upload_key FROM backup_upload ORDER BY last_modified,weight DESC LIMIT 1";
-
-    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
-        throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
-    }
-
-    if ( sqlite3_step(stmt) != SQLITE_ROW )
+    if ( uploads.empty() )
     {
         throw FileException(FileException::FileNotFound, "No files were found in the upload queue");
     }
 
-    std::shared_ptr<unsigned char> file_id = LocalDatabase::get_binary_id( (unsigned char*)sqlite3_column_blob(stmt, 0) );
-    unsigned int upload_id = sqlite3_column_int(stmt, 1);
-    std::string upload_key = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 2) );
-
-    sqlite3_finalize(stmt);
-
-    //Get File object by database id
-    BackupFile bf( file_id );
-    bf.set_upload_id(upload_id);
-    bf.set_upload_key(upload_key);
-
-    return bf;
+    return uploads.front();
 
 }
-FileUpload QueueManager::get_next_upload()
+
+std::vector<FileUpload> QueueManager::get_next_uploads(int count)
 {
 
+    std::lock_guard<std::mutex> lock(m_queue_mutex);
+
     //If there are no pending uploads, rebuild the queue
-    if ( get_total_pending() == 0 )
+    if ( m_queue->empty() && m_taken.empty() )
     {
-        rebuild_queue();
+        rebuild();
     }
 
-    sqlite3_stmt* stmt;
+    std::vector<FileUpload> uploads;
 
-    std::string query = "SELECT upload_id FROM backup_upload ORDER BY last_modified,weight DESC LIMIT 1";
+    while ( (int)uploads.size() < count && !m_queue->empty() )
+    {
 
-    if ( sqlite3_prepare_v2(m_database->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
-        throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_database->get_last_err() + ")" );
-    }
+        QueueEntry entry = m_queue->pop();
+        FileUpload upload( entry.upload_id );
 
-    if ( sqlite3_step(stmt) != SQLITE_ROW )
-    {
-        throw FileException(FileException::FileNotFound, "No files were found in the upload queue");
-    }
+        //Uploads of purged files are dropped from the queue
+        if ( !upload.exists() ) {
+            continue;
+        }
 
-    int upload_id = sqlite3_column_int(stmt, 0);
+        m_taken[entry.upload_id] = entry;
+        m_taken_ids.push_back(entry.upload_id);
 
-    sqlite3_finalize(stmt);
+        uploads.push_back(upload);
 
-    //Return FileUpload by Id
-    return FileUpload(upload_id);
+    }
+
+    return uploads;
 
 }
+
+std::string QueueManager::get_file_key(std::shared_ptr<unsigned char> file_id)
+{
+    return std::string( (const char*)file_id.get(), sizeof(file_id.get()) );
+}
@@ -0,0 +1,83 @@
+#include <vessel/vessel/schedule_policy.hpp>
+
+using namespace Vessel;
+
+std::shared_ptr<SchedulePolicy> SchedulePolicy::create(const std::string& name, double aging, unsigned long sla_secs)
+{
+
+    if ( name == "priority" ) return std::make_shared<PriorityPolicy>(aging);
+    if ( name == "newest" ) return std::make_shared<NewestFirstPolicy>();
+    if ( name == "shortest" ) return std::make_shared<ShortestFirstPolicy>();
+    if ( name == "deadline" ) return std::make_shared<DeadlinePolicy>(sla_secs);
+
+    return nullptr;
+
+}
+
+std::vector<std::string> SchedulePolicy::get_policy_names()
+{
+    return { "priority", "newest", "shortest", "deadline" };
+}
+
+bool PriorityPolicy::is_before(const QueueEntry& a, const QueueEntry& b) const
+{
+
+    double key_a = get_key(a);
+    double key_b = get_key(b);
+
+    if ( key_a != key_b ) {
+        return key_a > key_b;
+    }
+
+    //Recently changed files first
+    return a.last_modified > b.last_modified;
+
+}
+
+double PriorityPolicy::get_priority(const QueueEntry& entry, unsigned long now) const
+{
+
+    double hours = ( now > entry.queued_time ) ? (now - entry.queued_time) / 3600.0 : 0.0;
+
+    return entry.weight + m_aging * hours;
+
+}
+
+double PriorityPolicy::get_key(const QueueEntry& entry) const
+{
+    return entry.weight - m_aging * ( entry.queued_time / 3600.0 );
+}
+
+bool NewestFirstPolicy::is_before(const QueueEntry& a, const QueueEntry& b) const
+{
+
+    if ( a.last_modified != b.last_modified ) {
+        return a.last_modified > b.last_modified;
+    }
+
+    return a.weight > b.weight;
+
+}
+
+bool ShortestFirstPolicy::is_before(const QueueEntry& a, const QueueEntry& b) const
+{
+
+    if ( a.file_size != b.file_size ) {
+        return a.file_size < b.file_size;
+    }
+
+    return a.last_modified > b.last_modified;
+
+}
+
+bool DeadlinePolicy::is_before(const QueueEntry& a, const QueueEntry& b) const
+{
+
+    if ( get_deadline(a) != get_deadline(b) ) {
+        return get_deadline(a) < get_deadline(b);
+    }
+
+    //Weighted files first when the deadlines are equal
+    return a.weight > b.weight;
+
+}
@@ -41,6 +41,9 @@ void StatManager::update_stat(const std::string& name, int value)
     Log::get_log().add_error("Failed to update stat: " + name, "Stats");
   }
 
+  //Cleanup
+  sqlite3_finalize(stmt);
+
 }
 
 int StatManager::get_stat(const std::string& name)
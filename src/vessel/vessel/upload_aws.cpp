@@ -1,9 +1,10 @@
 #include <vessel/vessel/upload_manager.hpp>
 
-AwsUpload::AwsUpload()
+AwsUpload::AwsUpload(const StorageProvider& provider) : UploadInterface(provider)
 {
-    m_client = std::make_shared<AwsS3Client>( get_vessel_client()->get_storage_provider() );
+    m_client = std::make_shared<AwsS3Client>( provider );
     m_client->remote_signing(true);
+    m_client->set_circuit_breaker( CircuitBreaker::get_breaker(provider.provider_id) );
 }
 
 void AwsUpload::resume_uploads()
@@ -14,31 +15,53 @@ void AwsUpload::resume_uploads()
 void AwsUpload::upload_file(FileUpload& upload)
 {
 
+    //Continue an interrupted multipart upload with the parts S3 still holds
+    bool resume = resume_upload(upload);
+
+    //Choose the part size for a new upload. Uploads with stored parts keep the size they were started with
+    if ( !upload.has_parts() )
+    {
+        PartSizer sizer("aws_s3");
+        upload.update_chunk_size( sizer.get_part_size( upload.get_file().get_file_size() ) );
+    }
+
     BackupFile file = upload.get_file();
-    bool should_init=true;
     int total_parts = file.get_total_parts(); //Default
     AwsS3Client::AwsFlags aws_flags = AwsS3Client::AwsFlags::ReducedRedundancy; //Default
 
+    //Parts are encrypted on the client, the key is stored with the object
+    std::shared_ptr<FileCipher> cipher = get_cipher(upload, resume);
+    m_client->set_cipher(cipher);
+
+    if ( cipher ) {
+        aws_flags = aws_flags | AwsS3Client::AwsFlags::Encrypted;
+    }
+
+    //Parts are signed while they are read from disk instead of being buffered and hashed first
+    if ( LocalDatabase::get_database().get_setting_int("aws_streaming") == 1 ) {
+        aws_flags = aws_flags | AwsS3Client::AwsFlags::Streaming;
+    }
+
+    //Objects sent with a single request can be compressed
+    if ( total_parts == 1 && should_compress(file) )
+    {
+        aws_flags = aws_flags | AwsS3Client::AwsFlags::Compressed;
+    }
+
     //Determine if MultiPart
     if ( total_parts > 1 )
     {
         aws_flags = aws_flags | AwsS3Client::AwsFlags::Multipart;
 
-        //Determine if there is an existing multipart upload (db upload id will be set)
-        if ( !upload.get_upload_key().empty() ) {
-            //If the file hash has not changed, we do not need to re-init the upload
-            if ( file.get_hash_sha1() == upload.get_hash() )
-            {
-                should_init=false; //Do not re-init upload if it already exists
-                aws_flags = aws_flags | AwsS3Client::AwsFlags::SkipMultiInit; //Do not generate a new AWS Upload ID
-                m_client->set_upload_id( upload.get_upload_key() );
-            }
+        if ( resume ) {
+            aws_flags = aws_flags | AwsS3Client::AwsFlags::SkipMultiInit; //Do not generate a new AWS Upload ID
+            m_client->set_upload_id( upload.get_upload_key() );
         }
     }
 
-    if ( should_init )
+    //Initialize the upload with the Vessel API, unless it was registered with its batch
+    if ( upload.get_vessel_id().empty() )
     {
-        //Initialize the upload with the Vessel API
         upload.update_vessel_id( init_upload(file) );
     }
 
@@ -46,7 +69,7 @@ void AwsUpload::upload_file(FileUpload& upload)
     if ( m_client->init_upload(file, aws_flags ) )
     {
         //Update the upload key for the FileUpload if does not already exist
-        if ( upload.get_upload_key().empty() ) {
+        if ( upload.get_upload_key().empty() && total_parts > 1 ) {
             upload.update_key( m_client->get_upload_id() ); //AWS UploadId
         }
     }
@@ -61,7 +84,8 @@ void AwsUpload::upload_file(FileUpload& upload)
         //If upload was successful, mark as completed w Vessel API
         if ( m_client->upload() )
         {
-            get_vessel_client()->complete_upload( upload.get_vessel_id() );
+            file.update_compressed_size( m_client->get_compressed_size() );
+            queue_completion( upload, m_client->get_compressed_size() > 0, cipher != nullptr );
         }
     }
     //Upload Multipart
@@ -77,24 +101,21 @@ void AwsUpload::upload_file(FileUpload& upload)
         //Flag indicating whether or not the multipart upload should be completed
         bool should_complete=true;
 
-        //ETag storage
-        std::vector<UploadTagSet> etags;
-
-        //The current part number we are uploading
-        int part_number = upload.get_current_part();
+        //ETag storage, preloaded with the parts that were verified against S3
+        std::vector<UploadTagSet> etags = upload.get_part_tags();
 
-        //Determine if we are resuming an existing upload
-        //If the part number is > 1,  preload the existing etags
-        if ( part_number > 1 )
-        {
-            etags = upload.get_part_tags();
-        }
-
-        for ( int part_number = upload.get_current_part(); part_number <= total_parts; part_number++ )
+        //Only the parts S3 does not hold are uploaded
+        for ( int part_number : upload.get_missing_parts() )
         {
 
             std::cout << "Uploading file part " << part_number << " of " << total_parts << '\n';
+
+            auto part_start = std::chrono::steady_clock::now();
             std::string etag = m_client->upload_part(part_number, upload.get_upload_key() );
+            std::chrono::duration<double> part_secs = std::chrono::steady_clock::now() - part_start;
+
+            //Update the link stats used to size future uploads
+            PartSizer::record_part( m_client->get_current_part_size(), part_secs.count(), !etag.empty() );
 
             if ( etag.empty() ) {
                 should_complete=false;
@@ -102,8 +123,8 @@ void AwsUpload::upload_file(FileUpload& upload)
                 break;
             }
 
-            //Store the etags
-            UploadTagSet tag = {part_number, etag};
+            //Store the etags with the size S3 holds, which includes the tag of an encrypted part
+            UploadTagSet tag = {part_number, etag, upload.get_part_bytes(part_number)};
             etags.push_back( tag );
 
             //Add part to database
@@ -111,7 +132,7 @@ void AwsUpload::upload_file(FileUpload& upload)
             part.upload_id = upload.get_upload_id();
             part.upload_key = upload.get_upload_key();
             part.part_number = part_number;
-            part.total_bytes = m_client->get_current_part_size();
+            part.total_bytes = upload.get_part_bytes(part_number);
             part.tag = etag;
 
             //Save to database
@@ -122,11 +143,15 @@ void AwsUpload::upload_file(FileUpload& upload)
         //Complete the Multipart upload
         if ( should_complete )
         {
+            //S3 requires the parts in ascending order
+            std::sort( etags.begin(), etags.end(), [](const UploadTagSet& a, const UploadTagSet& b) { return a.part_number < b.part_number; } );
+
             std::string complete_etag = m_client->complete_multipart_upload(etags, upload.get_upload_key() );
 
             if ( !complete_etag.empty() )
             {
-                get_vessel_client()->complete_upload( upload.get_vessel_id() );
+                file.update_compressed_size(0);
+                queue_completion( upload, false, cipher != nullptr );
                 std::cout << "Multipart upload was successful with ETag " << complete_etag << '\n';
             }
 
@@ -136,11 +161,129 @@ void AwsUpload::upload_file(FileUpload& upload)
 
 }
 
+bool AwsUpload::resume_upload(FileUpload& upload)
+{
+
+    //No multipart upload was started
+    if ( upload.get_upload_key().empty() ) {
+        return false;
+    }
+
+    BackupFile file = upload.get_file();
+
+    //The client needs the file to build the object key
+    m_client->init_upload( file, AwsS3Client::AwsFlags::Multipart | AwsS3Client::AwsFlags::SkipMultiInit );
+
+    //A changed file can not be resumed. The parts S3 holds are discarded
+    if ( !upload.is_file_unchanged() )
+    {
+        Log::get_log().add_message("File changed since the upload was started, restarting upload: " + file.get_file_name(), "AWS");
+        m_client->abort_multipart_upload( upload.get_upload_key() );
+        upload.clear_parts();
+        return false;
+    }
+
+    std::vector<UploadTagSet> remote_parts;
+
+    if ( !m_client->list_parts( upload.get_upload_key(), remote_parts ) )
+    {
+        Log::get_log().add_message("Multipart upload no longer exists, restarting upload: " + file.get_file_name(), "AWS");
+        upload.clear_parts();
+        return false;
+    }
+
+    upload.sync_parts(remote_parts);
+
+    std::cout << "Resuming upload of " << file.get_file_name() << " with " << upload.get_missing_parts().size() << " of " << upload.get_total_parts() << " parts remaining" << '\n';
+
+    return true;
+
+}
+
 void AwsUpload::complete_upload()
 {
 
 }
 
+void AwsUpload::upload_pack(FilePack& pack)
+{
+
+    BackupFile pack_file( fs::path( pack.get_pack_path() ) );
+
+    //Packs are always sent with a single PUT
+    pack_file.set_part_size( std::max( pack_file.get_file_size(), (size_t)1 ) );
+
+    //The pack is registered as a file, the packed files are registered against its upload
+    std::string vessel_id = init_upload(pack_file);
+
+    //Packs are not encrypted, the cipher of the previous file is dropped
+    m_client->set_cipher(nullptr);
+
+    if ( !m_client->init_upload(pack_file, AwsS3Client::AwsFlags::ReducedRedundancy) )
+    {
+        throw AwsException( AwsException::InitFailed, "Failed to initialize AWS pack upload");
+    }
+
+    if ( !m_client->upload() )
+    {
+        throw AwsException( AwsException::UploadFailed, "Failed to upload pack: " + pack_file.get_file_name() );
+    }
+
+    get_vessel_client()->add_pack_files( vessel_id, pack.get_entries() );
+    get_vessel_client()->complete_upload( vessel_id );
+
+    pack.save( vessel_id, m_client->get_file_uri_path(), get_provider().provider_id );
+
+}
+
+bool AwsUpload::copy_file(FileUpload& upload, const MovedFile& moved)
+{
+
+    BackupFile file = upload.get_file();
+    bool compressed = false;
+    bool encrypted = false;
+
+    //Initialize the upload with the Vessel API, unless it was registered with its batch
+    if ( upload.get_vessel_id().empty() )
+    {
+        upload.update_vessel_id( init_upload(file) );
+    }
+
+    //CopyObject, or UploadPartCopy for large objects. Nothing is read from disk
+    if ( !m_client->copy_object( file, m_client->get_object_key( moved.file_path, moved.file_name ), compressed, encrypted ) ) {
+        return false;
+    }
+
+    queue_completion( upload, compressed, encrypted );
+
+    return true;
+
+}
+
+std::vector<unsigned long> AwsUpload::remove_files(const std::vector<DeletedFile>& files)
+{
+
+    std::vector<std::string> object_keys;
+
+    for ( const auto& file : files ) {
+        object_keys.push_back( m_client->get_object_key( file.file_path, file.file_name ) );
+    }
+
+    //DeleteObjects, one request for the whole batch
+    std::set<std::string> failed = m_client->delete_objects(object_keys);
+    std::vector<unsigned long> removed;
+
+    for ( size_t i=0; i < files.size(); i++ )
+    {
+        if ( failed.count( object_keys[i] ) == 0 ) {
+            removed.push_back( files[i].delete_id );
+        }
+    }
+
+    return removed;
+
+}
+
 std::string AwsUpload::init_upload(const BackupFile& file)
 {
 
@@ -1,9 +1,10 @@
 #include <vessel/vessel/upload_manager.hpp>
 
-AzureUpload::AzureUpload()
+AzureUpload::AzureUpload(const StorageProvider& provider) : UploadInterface(provider)
 {
-    m_client = std::make_shared<AzureClient>( get_vessel_client()->get_storage_provider() );
+    m_client = std::make_shared<AzureClient>( provider );
     m_client->remote_signing(true);
+    m_client->set_circuit_breaker( CircuitBreaker::get_breaker(provider.provider_id) );
 }
 
 void AzureUpload::resume_uploads()
@@ -14,65 +15,57 @@ void AzureUpload::resume_uploads()
 void AzureUpload::upload_file(FileUpload& upload)
 {
 
-    BackupFile file = upload.get_file();
-    bool should_init=true;
-    int total_parts = file.get_total_parts(); //Default
+    //Continue an interrupted block upload with the blocks Azure still holds
+    bool resume = resume_upload(upload);
 
-    //Determine if MultiPart
-    if ( total_parts > 1 )
+    //Choose the part size for a new upload. Uploads with stored parts keep the size they were started with
+    if ( !upload.has_parts() )
     {
-
-        //Determine if there is an existing multipart upload (db upload id will be set)
-        if ( !upload.get_upload_key().empty() ) {
-            //If the file hash has not changed, we do not need to re-init the upload
-            if ( file.get_hash_sha1() == upload.get_hash() )
-            {
-                should_init=false; //Do not re-init upload if it already exists
-                m_client->set_upload_id( upload.get_upload_key() );
-            }
-        }
+        PartSizer sizer("azure_blob");
+        upload.update_chunk_size( sizer.get_part_size( upload.get_file().get_file_size() ) );
     }
 
-    if ( should_init )
+    BackupFile file = upload.get_file();
+    int total_parts = file.get_total_parts(); //Default
+
+    //Initialize the upload with the Vessel API, unless it was registered with its batch
+    if ( upload.get_vessel_id().empty() )
     {
 
         std::cout << "Upload is being initialized..." << '\n';
 
-        //Initialize the upload with the Vessel API
-        init_upload(file);
+        upload.update_vessel_id( init_upload(file) );
 
     }
 
+    //Blocks are encrypted on the client, the key is stored as blob metadata
+    std::shared_ptr<FileCipher> cipher = get_cipher(upload, resume);
+    m_client->set_cipher(cipher);
+
     //Initialize the Azure upload
     m_client->init_upload(file);
 
     //Upload Single File
     if ( total_parts == 1 ) {
+
+        //Blobs sent with a single request can be compressed
+        m_client->set_compression( should_compress(file) );
+
         if ( !m_client->upload() )
         {
             throw AzureException( AzureException::UploadFailed, "Azure single blob upload failed: " + m_client->last_request_id() );
         }
+
+        file.update_compressed_size( m_client->get_compressed_size() );
+        queue_completion( upload, m_client->get_compressed_size() > 0, cipher != nullptr );
     }
     //Upload Multiple Blocks
     else {
 
-        std::cout << "Uploading file part for upload id " << upload.get_upload_key() << '\n';
-
         //Flag indicating whether or not the multi block upload should be completed
         bool should_complete=true;
 
-        //ETag storage
-        std::vector<UploadTagSet> etags;
-
-        //The current part number we are uploading
-        int part_number = upload.get_current_part();
-
-        //Determine if we are resuming an existing upload
-        //If the part number is > 1,  preload the existing etags
-        if ( part_number > 1 ) {
-            etags = upload.get_part_tags();
-        }
-        else
+        if ( !resume )
         {
             //Multi block upload must be initialized
             if ( !m_client->init_block() )
@@ -80,33 +73,38 @@ void AzureUpload::upload_file(FileUpload& upload)
                 throw AzureException( AzureException::UploadFailed, "Failed to initialize multiple block upload: " + m_client->last_request_id() );
             }
 
+            //The blob path marks the upload as started, so an interrupted upload can be resumed
+            upload.update_key( m_client->get_file_uri_path() );
         }
 
-        //std::cout << "GET Block List: " << '\n' << m_client->get_block_list();
+        std::cout << "Uploading file part for upload id " << upload.get_upload_key() << '\n';
 
-        for ( int part_number = upload.get_current_part(); part_number <= total_parts; part_number++ )
+        //Only the blocks Azure does not hold are uploaded
+        for ( int part_number : upload.get_missing_parts() )
         {
 
             std::cout << "Uploading file part " << part_number << " of " << total_parts << '\n';
 
-            if ( !m_client->upload_part(part_number) ) {
+            auto part_start = std::chrono::steady_clock::now();
+            bool part_uploaded = m_client->upload_part(part_number);
+            std::chrono::duration<double> part_secs = std::chrono::steady_clock::now() - part_start;
+
+            //Update the link stats used to size future uploads
+            PartSizer::record_part( m_client->get_content_length(), part_secs.count(), part_uploaded );
+
+            if ( !part_uploaded ) {
                 should_complete=false;
                 Log::get_log().add_error("Failed to upload file block #: " + std::to_string(part_number), "Azure");
                 break;
             }
 
-            //Store the etags
-            std::string etag = Hash::get_base64( m_client->get_padded_block_id(std::to_string(part_number)) ); //Base64 encoded part number
-            UploadTagSet tag = {part_number, etag};
-            etags.push_back( tag );
-
             //Add part to database
             FilePart part;
             part.upload_id = upload.get_upload_id();
             part.upload_key = upload.get_upload_key();
             part.part_number = part_number;
             part.total_bytes = m_client->get_content_length();
-            part.tag = etag;
+            part.tag = Hash::get_base64( m_client->get_padded_block_id(std::to_string(part_number)) ); //Base64 encoded part number
 
             //Save to database
             upload.add_part( part );
@@ -120,6 +118,8 @@ void AzureUpload::upload_file(FileUpload& upload)
             {
                 throw AzureException( AzureException::UploadFailed, "Failed to complete the multi block upload (PUT block list): " + m_client->last_request_id() );
             }
+            file.update_compressed_size(0);
+            queue_completion( upload, false, cipher != nullptr );
             std::cout << "Multi block upload was successful with Request Id: " << m_client->last_request_id() << '\n';
         }
 
@@ -127,16 +127,131 @@ void AzureUpload::upload_file(FileUpload& upload)
 
 }
 
+bool AzureUpload::resume_upload(FileUpload& upload)
+{
+
+    //No block upload was started
+    if ( upload.get_upload_key().empty() ) {
+        return false;
+    }
+
+    BackupFile file = upload.get_file();
+
+    //Uncommitted blocks of a changed file are replaced when the upload starts over
+    if ( !upload.is_file_unchanged() )
+    {
+        Log::get_log().add_message("File changed since the upload was started, restarting upload: " + file.get_file_name(), "Azure");
+        upload.clear_parts();
+        return false;
+    }
+
+    m_client->init_upload(file);
+
+    std::vector<UploadTagSet> blocks;
+
+    //Uncommitted blocks are discarded by Azure after a week
+    if ( !m_client->list_blocks(blocks) )
+    {
+        Log::get_log().add_message("Blob no longer exists, restarting upload: " + file.get_file_name(), "Azure");
+        upload.clear_parts();
+        return false;
+    }
+
+    upload.sync_parts(blocks);
+
+    std::cout << "Resuming upload of " << file.get_file_name() << " with " << upload.get_missing_parts().size() << " of " << upload.get_total_parts() << " blocks remaining" << '\n';
+
+    return true;
+
+}
+
 void AzureUpload::complete_upload()
 {
 
 }
 
-void AzureUpload::init_upload(const BackupFile& file)
+void AzureUpload::upload_pack(FilePack& pack)
+{
+
+    BackupFile pack_file( fs::path( pack.get_pack_path() ) );
+
+    //Packs are always sent as a single blob
+    pack_file.set_part_size( std::max( pack_file.get_file_size(), (size_t)1 ) );
+
+    //The pack is registered as a file, the packed files are registered against its upload
+    std::cout << "Uploading pack " << pack_file.get_file_name() << " (" << pack.get_total_files() << " files)..." << '\n';
+    std::string vessel_id = get_vessel_client()->init_upload(pack_file);
+
+    //Packed files are restored with ranged reads, so packs are never compressed or encrypted
+    m_client->set_cipher(nullptr);
+    m_client->init_upload(pack_file);
+    m_client->set_compression(false);
+
+    if ( !m_client->upload() )
+    {
+        throw AzureException( AzureException::UploadFailed, "Azure pack upload failed: " + m_client->last_request_id() );
+    }
+
+    get_vessel_client()->add_pack_files( vessel_id, pack.get_entries() );
+    get_vessel_client()->complete_upload( vessel_id );
+
+    pack.save( vessel_id, m_client->get_file_uri_path(), get_provider().provider_id );
+
+}
+
+bool AzureUpload::copy_file(FileUpload& upload, const MovedFile& moved)
+{
+
+    BackupFile file = upload.get_file();
+    bool compressed = false;
+    bool encrypted = false;
+
+    //Initialize the upload with the Vessel API, unless it was registered with its batch
+    if ( upload.get_vessel_id().empty() )
+    {
+        upload.update_vessel_id( init_upload(file) );
+    }
+
+    //Copy Blob within the container. Nothing is read from disk
+    if ( !m_client->copy_blob( file, m_client->get_object_key( moved.file_path, moved.file_name ), compressed, encrypted ) ) {
+        return false;
+    }
+
+    queue_completion( upload, compressed, encrypted );
+
+    return true;
+
+}
+
+std::vector<unsigned long> AzureUpload::remove_files(const std::vector<DeletedFile>& files)
+{
+
+    std::vector<std::string> paths;
+
+    for ( const auto& file : files ) {
+        paths.push_back( m_client->get_object_key( file.file_path, file.file_name ) );
+    }
+
+    //Blob Batch, one request for the whole batch
+    std::set<std::string> failed = m_client->delete_blobs(paths);
+    std::vector<unsigned long> removed;
+
+    for ( size_t i=0; i < files.size(); i++ )
+    {
+        if ( failed.count( paths[i] ) == 0 ) {
+            removed.push_back( files[i].delete_id );
+        }
+    }
+
+    return removed;
+
+}
+
+std::string AzureUpload::init_upload(const BackupFile& file)
 {
 
     std::cout << "Uploading " << file.get_file_name() << "..." << '\n';
-    get_vessel_client()->init_upload(file);
+    return get_vessel_client()->init_upload(file);
 
 }
 
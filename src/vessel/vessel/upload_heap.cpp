@@ -0,0 +1,144 @@
+#include <vessel/vessel/upload_heap.hpp>
+
+using namespace Vessel;
+
+UploadHeap::UploadHeap(std::shared_ptr<SchedulePolicy> policy) : m_policy(policy)
+{
+
+}
+
+void UploadHeap::push(const QueueEntry& entry)
+{
+
+    auto itr = m_index.find(entry.upload_id);
+
+    //Queued uploads are updated in place and moved up or down
+    if ( itr != m_index.end() )
+    {
+        size_t pos = itr->second;
+        m_entries[pos] = entry;
+        sift_up(pos);
+        sift_down( m_index[entry.upload_id] );
+        return;
+    }
+
+    m_entries.push_back(entry);
+    m_index[entry.upload_id] = m_entries.size() - 1;
+    sift_up( m_entries.size() - 1 );
+
+}
+
+QueueEntry UploadHeap::pop()
+{
+
+    QueueEntry entry = m_entries.front();
+    remove(entry.upload_id);
+
+    return entry;
+
+}
+
+bool UploadHeap::remove(unsigned int upload_id)
+{
+
+    auto itr = m_index.find(upload_id);
+
+    if ( itr == m_index.end() ) {
+        return false;
+    }
+
+    size_t pos = itr->second;
+    size_t last = m_entries.size() - 1;
+
+    //The last upload takes the place of the removed one
+    if ( pos != last ) {
+        swap_entries(pos, last);
+    }
+
+    m_entries.pop_back();
+    m_index.erase(upload_id);
+
+    if ( pos < m_entries.size() )
+    {
+        sift_up(pos);
+        sift_down( m_index[ m_entries[pos].upload_id ] );
+    }
+
+    return true;
+
+}
+
+void UploadHeap::clear()
+{
+    m_entries.clear();
+    m_index.clear();
+}
+
+bool UploadHeap::is_before(const QueueEntry& a, const QueueEntry& b) const
+{
+
+    if ( m_policy->is_before(a, b) ) {
+        return true;
+    }
+
+    if ( m_policy->is_before(b, a) ) {
+        return false;
+    }
+
+    return a.upload_id < b.upload_id;
+
+}
+
+void UploadHeap::sift_up(size_t pos)
+{
+
+    while ( pos > 0 )
+    {
+        size_t parent = (pos - 1) / HEAP_ARITY;
+
+        if ( !is_before( m_entries[pos], m_entries[parent] ) ) {
+            break;
+        }
+
+        swap_entries(pos, parent);
+        pos = parent;
+    }
+
+}
+
+void UploadHeap::sift_down(size_t pos)
+{
+
+    for ( ;; )
+    {
+
+        size_t first = pos * HEAP_ARITY + 1;
+        size_t best = pos;
+
+        for ( size_t child = first; child < first + HEAP_ARITY && child < m_entries.size(); child++ )
+        {
+            if ( is_before( m_entries[child], m_entries[best] ) ) {
+                best = child;
+            }
+        }
+
+        if ( best == pos ) {
+            break;
+        }
+
+        swap_entries(pos, best);
+        pos = best;
+
+    }
+
+}
+
+void UploadHeap::swap_entries(size_t a, size_t b)
+{
+
+    std::swap( m_entries[a], m_entries[b] );
+
+    m_index[ m_entries[a].upload_id ] = a;
+    m_index[ m_entries[b].upload_id ] = b;
+
+}
@@ -1,11 +1,130 @@
 #include <vessel/vessel/upload_manager.hpp>
 
-UploadInterface::UploadInterface()
+UploadInterface::UploadInterface(const StorageProvider& provider) : m_provider(provider)
 {
     m_vessel = std::make_shared<VesselClient>(LocalDatabase::get_database().get_setting_str("master_server"));
+
+    //Uploads are registered with the Vessel API for the provider that stores them
+    m_vessel->use_storage_provider(provider.provider_id);
 }
 
 std::shared_ptr<VesselClient> UploadInterface::get_vessel_client()
 {
     return m_vessel;
 }
+
+bool UploadInterface::add_reference(const BackupFile& file, const std::string& hash)
+{
+    return m_vessel->add_file_reference(file, hash);
+}
+
+std::set<unsigned int> UploadInterface::register_uploads(std::vector<FileUpload>& uploads)
+{
+
+    std::set<unsigned int> stored;
+    std::vector<FileUpload*> pending;
+    std::vector<BackupFile> files;
+
+    //Uploads keep the id they were registered with, also when they are restarted
+    for ( auto& upload : uploads )
+    {
+        if ( upload.get_vessel_id().empty() ) {
+            pending.push_back(&upload);
+            files.push_back( upload.get_file() );
+        }
+    }
+
+    if ( files.empty() ) {
+        return stored;
+    }
+
+    std::vector<UploadRegistration> registrations;
+
+    try
+    {
+        registrations = m_vessel->init_uploads(files);
+    }
+    catch ( const std::exception& e )
+    {
+        Log::get_log().add_error( std::string("Failed to register batch of uploads: ") + e.what(), "File Upload");
+        return stored;
+    }
+
+    for ( size_t i=0; i < pending.size(); i++ )
+    {
+        if ( registrations[i].vessel_id.empty() ) {
+            continue;
+        }
+
+        pending[i]->update_vessel_id( registrations[i].vessel_id );
+
+        if ( registrations[i].stored ) {
+            stored.insert( pending[i]->get_upload_id() );
+        }
+    }
+
+    return stored;
+
+}
+
+bool UploadInterface::can_inline(const BackupFile& file)
+{
+    return supports_batching() && m_vessel->can_inline(file);
+}
+
+void UploadInterface::queue_completion(FileUpload& upload, bool compressed, bool encrypted)
+{
+    m_vessel->queue_completion( upload.get_vessel_id(), compressed, encrypted );
+}
+
+void UploadInterface::flush_completions()
+{
+
+    try
+    {
+        m_vessel->complete_uploads();
+    }
+    catch ( const std::exception& e )
+    {
+        //Completions stay queued in the local database and are sent with the next batch
+        Log::get_log().add_error( std::string("Failed to complete uploads: ") + e.what(), "File Upload");
+    }
+
+}
+
+bool UploadInterface::should_compress(const BackupFile& file)
+{
+    return LocalDatabase::get_database().get_setting_int("compress_transfer") == 1 && Compressor::is_compressible( file.get_file_type() );
+}
+
+std::shared_ptr<FileCipher> UploadInterface::get_cipher(FileUpload& upload, bool resume)
+{
+
+    //Parts already held by the provider decide whether the rest of the upload is encrypted
+    if ( resume && upload.get_encryption_key().empty() ) {
+        return nullptr;
+    }
+
+    if ( !resume && !FileCipher::is_enabled() )
+    {
+        if ( !upload.get_encryption_key().empty() ) {
+            upload.update_encryption_key("");
+        }
+
+        return nullptr;
+    }
+
+    if ( m_tenant_key.empty() ) {
+        m_tenant_key = FileCipher::get_tenant_key();
+    }
+
+    if ( resume ) {
+        return std::make_shared<FileCipher>( m_tenant_key, upload.get_encryption_key() );
+    }
+
+    std::shared_ptr<FileCipher> cipher = std::make_shared<FileCipher>( m_tenant_key );
+    upload.update_encryption_key( cipher->get_wrapped_key() );
+
+    return cipher;
+
+}
@@ -0,0 +1,192 @@
+#include <vessel/vessel/upload_manager.hpp>
+
+LocalUpload::LocalUpload(const StorageProvider& provider) : UploadInterface(provider)
+{
+    //The storage path is the directory the objects are stored under, such as an NFS mount
+    m_store = std::make_unique<LocalStore>( provider.storage_path );
+    m_user_id = LocalDatabase::get_database().get_setting_str("user_id");
+}
+
+LocalUpload::~LocalUpload()
+{
+
+    //Completions held at the end of the run are queued, they are sent with the next batch
+    try
+    {
+        sync_pending();
+    }
+    catch ( const std::exception& e )
+    {
+        Log::get_log().add_error( std::string("Failed to sync stored objects: ") + e.what(), "Local Storage");
+        requeue_pending();
+    }
+
+}
+
+void LocalUpload::upload_file(FileUpload& upload)
+{
+
+    BackupFile file = upload.get_file();
+
+    //Initialize the upload with the Vessel API
+    if ( upload.get_vessel_id().empty() )
+    {
+        std::cout << "Uploading " << file.get_file_name() << "..." << '\n';
+        upload.update_vessel_id( get_vessel_client()->init_upload(file) );
+    }
+
+    std::string object_key = get_object_key( file.get_parent_path(), file.get_file_name() );
+
+    //Objects are written whole, there are no parts to resume
+    std::shared_ptr<FileCipher> cipher = get_cipher(upload, false);
+
+    if ( cipher )
+    {
+        //Sealed parts pass through the buffer pool, they cannot be copied by the kernel
+        m_store->store_parts( file, object_key, *cipher );
+    }
+    else
+    {
+        LocalStore::CopyMethod method = m_store->store_file( file.get_file_path(), object_key );
+
+        if ( method == LocalStore::ReadWrite && file.get_file_size() > 0 ) {
+            std::cout << "Copied " << file.get_file_name() << " through user space, the file systems do not support a kernel copy" << '\n';
+        }
+    }
+
+    //Local objects are never compressed
+    file.update_compressed_size(0);
+    complete( upload, cipher != nullptr );
+
+}
+
+void LocalUpload::upload_pack(FilePack& pack)
+{
+
+    BackupFile pack_file( fs::path( pack.get_pack_path() ) );
+
+    //The pack is registered as a file, the packed files are registered against its upload
+    std::cout << "Storing pack " << pack_file.get_file_name() << " (" << pack.get_total_files() << " files)..." << '\n';
+    std::string vessel_id = get_vessel_client()->init_upload(pack_file);
+
+    //Packed files are restored with ranged reads, so packs are never encrypted
+    std::string object_key = get_object_key( pack_file.get_parent_path(), pack_file.get_file_name() );
+    m_store->store_file( pack_file.get_file_path(), object_key );
+
+    //The pack is completed right away, so it is synced with the objects held for the batch
+    sync_pending();
+
+    get_vessel_client()->add_pack_files( vessel_id, pack.get_entries() );
+    get_vessel_client()->complete_upload( vessel_id );
+
+    pack.save( vessel_id, object_key, get_provider().provider_id );
+
+}
+
+bool LocalUpload::copy_file(FileUpload& upload, const MovedFile& moved)
+{
+
+    BackupFile file = upload.get_file();
+    bool encrypted = false;
+
+    //Initialize the upload with the Vessel API, unless it was registered with its batch
+    if ( upload.get_vessel_id().empty() ) {
+        upload.update_vessel_id( get_vessel_client()->init_upload(file) );
+    }
+
+    if ( !m_store->copy_object( get_object_key( moved.file_path, moved.file_name ), get_object_key( file.get_parent_path(), file.get_file_name() ), encrypted ) ) {
+        return false;
+    }
+
+    complete( upload, encrypted );
+
+    return true;
+
+}
+
+std::vector<unsigned long> LocalUpload::remove_files(const std::vector<DeletedFile>& files)
+{
+
+    std::vector<unsigned long> removed;
+
+    for ( const auto& file : files )
+    {
+        if ( m_store->remove_object( get_object_key( file.file_path, file.file_name ) ) ) {
+            removed.push_back( file.delete_id );
+        }
+    }
+
+    return removed;
+
+}
+
+void LocalUpload::flush_completions()
+{
+
+    try
+    {
+        sync_pending();
+    }
+    catch ( const std::exception& e )
+    {
+        //Objects that may not be durable are not reported as stored, the Vessel API keeps their uploads unfinished
+        Log::get_log().add_error( std::string("Failed to sync stored objects: ") + e.what(), "Local Storage");
+        requeue_pending();
+    }
+
+    UploadInterface::flush_completions();
+
+}
+
+void LocalUpload::complete(FileUpload& upload, bool encrypted)
+{
+
+    if ( m_store->get_sync_mode() == LocalStore::SyncBatch )
+    {
+        PendingCompletion pending = { upload, encrypted };
+        m_pending.push_back(pending);
+        return;
+    }
+
+    queue_completion( upload, false, encrypted );
+
+}
+
+void LocalUpload::sync_pending()
+{
+
+    m_store->sync();
+
+    for ( auto& pending : m_pending ) {
+        queue_completion( pending.upload, false, pending.encrypted );
+    }
+
+    m_pending.clear();
+
+}
+
+void LocalUpload::requeue_pending()
+{
+
+    //The held files were reported as uploaded, they are queued again
+    for ( auto& pending : m_pending ) {
+        BackupFile::reset_last_backup( pending.upload.get_file().get_file_id() );
+    }
+
+    m_pending.clear();
+
+}
+
+std::string LocalUpload::get_object_key(const std::string& parent_path, const std::string& file_name)
+{
+
+    std::string object_key = BackupFile::trim_path( m_user_id + parent_path + "/" + file_name );
+
+    #ifdef _WIN32
+        boost::replace_all(object_key, "\\", "/");
+        boost::replace_all(object_key, ":", "");
+    #endif
+
+    return object_key;
+
+}
@@ -1,9 +1,10 @@
 #include <vessel/vessel/upload_manager.hpp>
 
-UploadManager::UploadManager(const StorageProvider& provider) : m_provider(provider)
+UploadManager::UploadManager(const std::vector<StorageProvider>& providers) : m_providers(providers)
 {
 
-    m_service = get_upload_service(provider.provider_type);
+    m_selector = std::make_unique<ProviderSelector>(providers);
+    use_provider( providers.front() );
 
 }
 
@@ -26,85 +27,601 @@ void UploadManager::run_uploader()
         return; //No work to do
     }
 
-    for ( auto i=0; i < total_pending; i++ )
+    //Completions left over from an interrupted run
+    m_service->flush_completions();
+
+    int batch_size = LocalDatabase::get_database().get_setting_int("vessel_batch_size");
+
+    if ( batch_size <= 0 ) {
+        batch_size = VESSEL_BATCH_SZ;
+    }
+
+    int total_processed = 0;
+
+    while ( total_processed < total_pending )
     {
 
-        //Free memory
-        cleanup_service();
+        //Every batch goes to the best provider at the time
+        use_provider( m_selector->select() );
+
+        //Files are not read or hashed while the provider is failing
+        wait_for_provider();
 
-        //Get the next upload from the queue
-        FileUpload upload = manager->get_next_upload();
-        BackupFile file = upload.get_file();
+        //Get the next batch from the queue
+        std::vector<FileUpload> queued = manager->get_next_uploads( std::min( batch_size, total_pending - total_processed ) );
+
+        if ( queued.empty() ) {
+            break;
+        }
 
-        //Validate error count
-        //If more than 5 errors, purge the file and move on
-        if ( upload.get_error_count() >= 5 )
+        total_processed += queued.size();
+
+        //Files that are uploaded on their own
+        std::vector<FileUpload> batch;
+
+        for ( auto& upload : queued )
         {
-            Log::get_log().add_error("More than 5 errors detected for file upload - skipping: " + file.get_file_name(), "File Upload" );
-            LocalDatabase::get_database().purge_file( file.get_file_id().get() );
-            continue;
+            if ( prepare_upload(upload, *manager) )
+            {
+                //Uploads that have not started are registered for the current provider
+                if ( upload.get_upload_key().empty() ) {
+                    upload.update_provider( m_provider.provider_id );
+                }
+
+                batch.push_back(upload);
+            }
         }
 
-        //If the file no longer exists, purge it from the database
-        if ( !file.exists() ) {
-            LocalDatabase::get_database().purge_file( file.get_file_id().get() );
-            continue;
+        //One Vessel API request registers the whole batch
+        std::set<unsigned int> stored;
+
+        if ( m_service->supports_batching() ) {
+            stored = m_service->register_uploads(batch);
         }
 
-        //If the file is not readable, remove from the upload queue and move on
-        if ( !file.is_readable() )
+        for ( auto& upload : batch )
         {
-            Log::get_log().add_error("Unable to read file: " + file.get_file_name(), "Filesystem" );
-            manager->pop_file( file.get_file_id() );
+
+            //Tiny files were sent with the registration, there is nothing left to upload
+            if ( stored.count( upload.get_upload_id() ) > 0 )
+            {
+                BackupFile file = upload.get_file();
+                file.update_last_backup();
+                manager->pop_file( file.get_file_id() );
+                continue;
+            }
+
+            wait_for_provider();
+
+            StorageProvider provider;
+
+            //The upload stays in the queue until its provider recovers
+            if ( !route_upload(upload, provider) ) {
+                continue;
+            }
+
+            if ( provider.provider_id == m_provider.provider_id )
+            {
+                //The service is kept for the whole run, its connections, signing keys and provider details are reused for every file
+                upload_file(upload, *manager);
+            }
+            else
+            {
+                StorageProvider current = m_provider;
+
+                use_provider(provider);
+                upload_file(upload, *manager);
+                use_provider(current);
+            }
+
+        }
+
+        //One Vessel API request completes the whole batch
+        m_service->flush_completions();
+
+        //Popped uploads are removed from the database once per batch
+        manager->persist_queue();
+
+    }
+
+    //Upload the remaining packed files
+    flush_pack();
+
+    //Services that hold files until the end of the run store them now
+    for ( auto& service : m_services )
+    {
+        try
+        {
+            service.second->complete_upload();
+            service.second->flush_completions();
+        }
+        catch( const std::exception& ex )
+        {
+            Log::get_log().add_error(std::string("Failed to complete uploads: ") + ex.what(), "File Upload");
+        }
+    }
+
+}
+
+void UploadManager::run_retention()
+{
+
+    DeleteJournal journal;
+
+    //The objects of removed providers can not be reached
+    journal.remove_orphans();
+
+    for ( const auto& provider : m_providers )
+    {
+
+        //Deletes wait while the provider is failing
+        if ( !m_selector->is_healthy(provider) ) {
             continue;
         }
 
-        std::cout << "Uploading file " << file.get_file_name() << '\n';
+        std::shared_ptr<UploadInterface> service = get_upload_service(provider);
+        size_t batch_size = service->get_delete_batch_size();
 
-        bool upload_success=true;
+        if ( batch_size == 0 ) {
+            continue;
+        }
+
+        size_t total_removed = 0;
 
         try
         {
-            m_service->upload_file(upload);
+            total_removed = journal.remove_expired( provider.provider_id, batch_size, [&service](const std::vector<DeletedFile>& files) {
+                return service->remove_files(files);
+            });
         }
         catch( const std::exception& ex )
         {
-            Log::get_log().add_error("Failed to upload file: " + file.get_file_name() + " (" + ex.what() + ")", "File upload");
+            Log::get_log().add_error("Failed to remove deleted files from " + provider.provider_name + " (" + ex.what() + ")", "File Retention");
+        }
+
+        if ( total_removed > 0 ) {
+            Log::get_log().add_message("Removed " + std::to_string(total_removed) + " objects of deleted files from " + provider.provider_name, "File Retention");
+        }
+
+    }
+
+}
+
+bool UploadManager::prepare_upload(FileUpload& upload, QueueManager& manager)
+{
+
+    BackupFile file = upload.get_file();
+
+    //Validate error count
+    //If more than 5 errors, purge the file and move on
+    if ( upload.get_error_count() >= 5 )
+    {
+        Log::get_log().add_error("More than 5 errors detected for file upload - skipping: " + file.get_file_name(), "File Upload" );
+        LocalDatabase::get_database().purge_file( file.get_file_id().get() );
+        return false;
+    }
+
+    //If the file no longer exists, purge it from the database
+    if ( !file.exists() ) {
+        LocalDatabase::get_database().purge_file( file.get_file_id().get(), true );
+        return false;
+    }
+
+    //If the file is not readable, remove from the upload queue and move on
+    if ( !file.is_readable() )
+    {
+        Log::get_log().add_error("Unable to read file: " + file.get_file_name(), "Filesystem" );
+        manager.pop_file( file.get_file_id() );
+        return false;
+    }
+
+    //Moved and renamed files are copied by the provider instead of being uploaded again
+    if ( move_file(upload, file) )
+    {
+        manager.pop_file( file.get_file_id() );
+        return false;
+    }
+
+    //Content that is already backed up is not uploaded again
+    if ( dedup_file(upload, file) )
+    {
+        manager.pop_file( file.get_file_id() );
+        return false;
+    }
+
+    //Small files and the new chunks of large files are sent together in packs
+    if ( chunk_file(upload) || pack_file(upload) )
+    {
+        manager.pop_file( file.get_file_id() );
+        return false;
+    }
+
+    return true;
+
+}
+
+void UploadManager::upload_file(FileUpload& upload, QueueManager& manager)
+{
+
+    BackupFile file = upload.get_file();
+
+    std::cout << "Uploading file " << file.get_file_name() << '\n';
+
+    bool upload_success=true;
+    size_t provider_failures = m_breaker->get_total_failures();
+    auto start = std::chrono::steady_clock::now();
+
+    try
+    {
+        m_service->upload_file(upload);
+    }
+    catch( const std::exception& ex )
+    {
+        Log::get_log().add_error("Failed to upload file: " + file.get_file_name() + " (" + ex.what() + ")", "File upload");
+        upload_success=false;
+
+        //Provider failures do not count against the file, it is uploaded again when the provider recovers
+        if ( m_breaker->get_total_failures() == provider_failures && m_breaker->get_state() == CircuitBreaker::Closed ) {
             upload.increment_error(); //Increase upload error count in DB
-            upload_success=false;
         }
+        else {
+            ProviderSelector::record_upload( m_provider.provider_id, file.get_file_size(), 0, false );
+        }
+    }
+
+    if ( upload_success ) {
+
+        std::cout << "File Upload was successful: " << file.get_file_name() << '\n';
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        ProviderSelector::record_upload( m_provider.provider_id, file.get_file_size(), elapsed.count(), true );
+
+        //Update the last backup time for the file
+        file.update_last_backup();
+        file.update_provider( m_provider.provider_id );
+
+        //Remove the file from the queue, regardless of success or failure
+        manager.pop_file( file.get_file_id() );
+
+    }
+
+}
+
+bool UploadManager::pack_file(FileUpload& upload)
+{
+
+    BackupFile file = upload.get_file();
+
+    //Resumed uploads and large files are uploaded on their own, tiny files are sent inline with their registration
+    if ( !m_service->supports_packing() || !upload.get_upload_key().empty() || !FilePack::is_packable(file) || m_service->can_inline(file) ) {
+        return false;
+    }
+
+    if ( !m_pack ) {
+        m_pack = std::make_unique<FilePack>();
+    }
+
+    if ( !m_pack->add_file(file) ) {
+        return false;
+    }
+
+    if ( m_pack->is_full() ) {
+        flush_pack();
+    }
+
+    return true;
+
+}
+
+bool UploadManager::dedup_file(FileUpload& upload, BackupFile& file)
+{
+
+    //Started multipart uploads are completed
+    if ( !upload.get_upload_key().empty() ) {
+        return false;
+    }
+
+    //The hash is cached in the file, so it is also used to record the backup after an upload
+    std::string hash = file.get_hash_sha1();
+
+    if ( hash.empty() ) {
+        return false;
+    }
+
+    //Touched but unchanged since the last backup
+    if ( hash == file.get_last_backup_hash() )
+    {
+        BackupFile::update_last_backup( file.get_file_id(), hash );
+        return true;
+    }
+
+    //The repository stores shared content once by itself, a reference would leave the file out of its snapshots
+    if ( m_service->supports_dedup() ) {
+        return false;
+    }
+
+    //Copy of content that has already been uploaded
+    if ( !BackupFile::is_content_backed_up(hash) ) {
+        return false;
+    }
+
+    try
+    {
+        if ( !m_service->add_reference(file, hash) ) {
+            return false;
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        Log::get_log().add_error("Failed to register duplicate file: " + file.get_file_name() + " (" + ex.what() + ")", "File Upload");
+        return false;
+    }
+
+    BackupFile::update_last_backup( file.get_file_id(), hash );
+
+    //The object at the path of the file, if any, holds older content
+    BackupFile::update_provider( file.get_file_id(), "" );
+
+    std::cout << "Duplicate file was not uploaded: " << file.get_file_name() << '\n';
+
+    return true;
+
+}
+
+bool UploadManager::move_file(FileUpload& upload, BackupFile& file)
+{
+
+    MovedFile moved;
+
+    //Started uploads are completed, objects are only copied within the provider that holds them
+    if ( !m_service->supports_copy() || !upload.get_upload_key().empty() || !file.find_moved_file( m_provider.provider_id, moved ) ) {
+        return false;
+    }
+
+    //Same size and modified time, the content must be the same as well
+    if ( file.get_hash_sha1() != moved.hash ) {
+        return false;
+    }
+
+    try
+    {
+        if ( !m_service->copy_file(upload, moved) ) {
+            return false;
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        Log::get_log().add_error("Failed to copy moved file: " + file.get_file_name() + " (" + ex.what() + ")", "File Upload");
+        return false;
+    }
+
+    BackupFile::update_last_backup( file.get_file_id(), moved.hash );
+    file.update_provider( m_provider.provider_id );
+
+    //The entry of the old path is not the source of another move, its object is removed once the retention period is over
+    LocalDatabase::get_database().purge_file( (unsigned char*)moved.file_key.data(), true );
+
+    std::cout << "Moved file was copied by the provider: " << file.get_file_name() << '\n';
+
+    return true;
+
+}
+
+bool UploadManager::chunk_file(FileUpload& upload)
+{
+
+    BackupFile file = upload.get_file();
+
+    //Resumed uploads keep uploading the whole file
+    if ( !m_service->supports_packing() || !upload.get_upload_key().empty() || !ChunkIndex::is_chunkable(file) ) {
+        return false;
+    }
+
+    ChunkIndex index;
+    Chunker chunker;
+    std::vector<ChunkRef> chunks;
+    size_t new_bytes = 0;
+
+    bool chunked = chunker.chunk_file( file.get_file_path(), [&](const char* data, size_t length, size_t offset) -> bool {
+
+        ChunkRef chunk;
+        chunk.hash = Hash::get_sha256_hash( data, length );
+        chunk.length = length;
+        chunks.push_back(chunk);
+
+        //Only upload chunks that are not already stored
+        if ( index.contains(chunk.hash) || ( m_pack && m_pack->has_chunk(chunk.hash) ) ) {
+            return true;
+        }
+
+        if ( !m_pack ) {
+            m_pack = std::make_unique<FilePack>();
+        }
+
+        if ( !m_pack->add_chunk( chunk.hash, data, length ) ) {
+            return false;
+        }
+
+        new_bytes += length;
+
+        if ( m_pack->is_full() ) {
+            flush_pack();
+        }
+
+        return true;
+
+    });
 
-        if ( upload_success ) {
+    if ( !chunked ) {
+        Log::get_log().add_error("Unable to chunk file: " + file.get_file_name(), "File Upload");
+        return false;
+    }
 
-            std::cout << "File Upload was successful: " << file.get_file_name() << '\n';
+    //Recipe: one line per chunk "<sha256> <length> <object key> <offset>". Chunks in the same pack as the recipe use "-" as object key
+    std::ostringstream recipe;
 
-            //Update the last backup time for the file
-            file.update_last_backup();
+    for ( const auto& chunk : chunks )
+    {
+        std::string object_key;
+        size_t offset = 0;
 
-            //Remove the file from the queue, regardless of success or failure
-            manager->pop_file( file.get_file_id() );
+        if ( !index.get_location( chunk.hash, object_key, offset ) )
+        {
+            //A chunk from a failed pack upload is neither indexed nor in the current pack
+            if ( !m_pack || !m_pack->has_chunk(chunk.hash) )
+            {
+                Log::get_log().add_error("Missing chunk for file: " + file.get_file_name(), "File Upload");
+                return true; //The file stays out of the queue until the next rebuild
+            }
 
+            object_key = "-";
+            for ( const auto& entry : m_pack->get_entries() )
+            {
+                if ( entry.type == "chunk" && entry.hash == chunk.hash ) {
+                    offset = entry.offset;
+                    break;
+                }
+            }
         }
 
+        recipe << chunk.hash << " " << chunk.length << " " << object_key << " " << offset << "\n";
+    }
+
+    if ( !m_pack ) {
+        m_pack = std::make_unique<FilePack>();
+    }
+
+    if ( !m_pack->add_recipe( file, recipe.str() ) ) {
+        return false;
     }
 
+    index.save_recipe( file.get_file_id(), chunks );
+
+    std::cout << "Chunked file " << file.get_file_name() << ": " << chunks.size() << " chunks, " << new_bytes << " new bytes" << '\n';
+
+    if ( m_pack->is_full() ) {
+        flush_pack();
+    }
+
+    return true;
+
+}
+
+void UploadManager::use_provider(const StorageProvider& provider)
+{
+
+    m_provider = provider;
+    m_service = get_upload_service(provider);
+    m_breaker = CircuitBreaker::get_breaker(provider.provider_id);
+
 }
 
-void UploadManager::cleanup_service()
+bool UploadManager::route_upload(FileUpload& upload, StorageProvider& provider)
 {
-    m_service.reset();
-    m_service = get_upload_service(m_provider.provider_type);
+
+    provider = m_provider;
+
+    //Uploads from before providers were recorded went to the only provider
+    if ( upload.get_upload_key().empty() || upload.get_provider_id().empty() || upload.get_provider_id() == m_provider.provider_id )
+    {
+        upload.update_provider( m_provider.provider_id );
+        return true;
+    }
+
+    //The parts of a removed provider are lost, the upload starts over
+    if ( !m_selector->find_provider( upload.get_provider_id(), provider ) )
+    {
+        upload.clear_parts();
+        upload.update_provider( m_provider.provider_id );
+        provider = m_provider;
+        return true;
+    }
+
+    return m_selector->is_healthy(provider);
+
 }
 
-std::shared_ptr<UploadInterface> UploadManager::get_upload_service(const std::string& type)
+void UploadManager::wait_for_provider()
 {
 
-    if ( type == "aws_s3" ) return std::make_shared<AwsUpload>();
-    if ( type == "vessel" ) return std::make_shared<VesselUpload>();
-    if ( type == "azure_blob" ) return std::make_shared<AzureUpload>();
+    //Another provider takes over while this one is failing
+    if ( m_breaker->get_wait_secs() > 0 ) {
+        use_provider( m_selector->select() );
+    }
+
+    double wait_secs = m_breaker->get_wait_secs();
+
+    if ( wait_secs > 0 )
+    {
+        std::cout << "Provider " << m_provider.provider_name << " is failing, pausing uploads for " << (int)std::ceil(wait_secs) << " seconds" << '\n';
+        m_breaker->wait();
+    }
+
+}
+
+void UploadManager::flush_pack()
+{
+
+    if ( !m_pack || m_pack->empty() ) {
+        m_pack.reset();
+        return;
+    }
+
+    try
+    {
+        m_pack->close();
+        m_service->upload_pack(*m_pack);
+
+        //Packed files were removed from the queue when they were added to the pack
+        for ( const auto& entry : m_pack->get_entries() )
+        {
+            if ( entry.type != "chunk" ) {
+                BackupFile::update_last_backup( entry.file_id, entry.hash );
+                BackupFile::update_provider( entry.file_id, "" ); //Packed content is not an object of its own
+            }
+        }
+
+        std::cout << "Pack upload was successful: " << m_pack->get_total_files() << " files" << '\n';
+    }
+    catch( const std::exception& ex )
+    {
+        //The files were not backed up and will be queued again when the queue is rebuilt
+        Log::get_log().add_error("Failed to upload pack: " + m_pack->get_pack_path() + " (" + ex.what() + ")", "File upload");
+    }
+
+    m_pack->remove();
+    m_pack.reset();
+
+}
+
+std::shared_ptr<UploadInterface> UploadManager::get_upload_service(const StorageProvider& provider)
+{
+
+    auto itr = m_services.find(provider.provider_id);
+
+    if ( itr != m_services.end() ) {
+        return itr->second;
+    }
+
+    std::shared_ptr<UploadInterface> service;
+    const std::string& type = provider.provider_type;
+
+    //Repository objects are not encrypted, encrypted files are stored one object per file
+    if ( type != "vessel" && !RepositoryUpload::is_enabled() && LocalDatabase::get_database().get_setting_str("repository_format") == "packs" ) {
+        Log::get_log().add_message("encrypt_transfer is enabled, files are stored one object per file instead of in the pack repository", "File upload");
+    }
+
+    //The Vessel storage keeps one object per file
+    if ( type != "vessel" && RepositoryUpload::is_enabled() ) service = std::make_shared<RepositoryUpload>(provider);
+    else if ( type == "aws_s3" ) service = std::make_shared<AwsUpload>(provider);
+    else if ( type == "vessel" ) service = std::make_shared<VesselUpload>(provider);
+    else if ( type == "azure_blob" ) service = std::make_shared<AzureUpload>(provider);
     //if ( type == "google" )
-    //if ( type == "local" )
+    else if ( type == "local" ) service = std::make_shared<LocalUpload>(provider);
+    else throw VesselException(VesselException::ProviderError,"Bad storage provider type");
+
+    m_services.insert( std::make_pair(provider.provider_id, service) );
 
-    throw VesselException(VesselException::ProviderError,"Bad storage provider type");
+    return service;
 
 }
@@ -0,0 +1,328 @@
+#include <vessel/vessel/upload_manager.hpp>
+
+#define REPOSITORY_DIR "repository" //Directory of the repository under the path the provider stores files at
+#define REPOSITORY_INDEX_MAX_BLOBS 65536 //Blob locations written to a single index object
+
+RepositoryUpload::RepositoryUpload(const StorageProvider& provider) : UploadInterface(provider), m_index_blobs(0)
+{
+
+    const std::string& type = provider.provider_type;
+
+    if ( type == "aws_s3" )
+    {
+        m_aws = std::make_shared<AwsS3Client>( provider );
+        m_aws->remote_signing(true);
+        m_aws->set_circuit_breaker( CircuitBreaker::get_breaker(provider.provider_id) );
+    }
+    else if ( type == "azure_blob" )
+    {
+        m_azure = std::make_shared<AzureClient>( provider );
+        m_azure->remote_signing(true);
+        m_azure->set_circuit_breaker( CircuitBreaker::get_breaker(provider.provider_id) );
+    }
+    else if ( type == "local" )
+    {
+        m_store = std::make_unique<LocalStore>( provider.storage_path );
+    }
+    else
+    {
+        throw VesselException(VesselException::ProviderError, "Storage provider type does not support a pack repository: " + type);
+    }
+
+    m_index = std::make_unique<RepositoryIndex>( provider.provider_id );
+    m_user_id = LocalDatabase::get_database().get_setting_str("user_id");
+
+}
+
+RepositoryUpload::~RepositoryUpload()
+{
+
+    //Uploads waiting for a pack that was never stored are queued again
+    for ( auto& upload : m_pending ) {
+        BackupFile::reset_last_backup( upload.get_file().get_file_id() );
+    }
+
+    if ( m_pack ) {
+        m_pack->remove();
+    }
+
+}
+
+void RepositoryUpload::upload_file(FileUpload& upload)
+{
+
+    BackupFile file = upload.get_file();
+
+    //Initialize the upload with the Vessel API
+    if ( upload.get_vessel_id().empty() )
+    {
+        std::cout << "Uploading " << file.get_file_name() << "..." << '\n';
+        upload.update_vessel_id( get_vessel_client()->init_upload(file) );
+    }
+
+    Chunker chunker;
+    std::vector<ChunkRef> blobs;
+    size_t new_bytes = 0;
+
+    bool chunked = chunker.chunk_file( file.get_file_path(), [&](const char* data, size_t length, size_t offset) -> bool {
+
+        ChunkRef blob;
+        blob.hash = Hash::get_sha256_hash( data, length );
+        blob.length = length;
+        blobs.push_back(blob);
+
+        //Each blob is stored once in the repository
+        if ( m_index->contains(blob.hash) || ( m_pack && m_pack->has_chunk(blob.hash) ) ) {
+            return true;
+        }
+
+        if ( !m_pack ) {
+            m_pack = std::make_unique<FilePack>();
+        }
+
+        if ( !m_pack->add_chunk( blob.hash, data, length ) ) {
+            return false;
+        }
+
+        new_bytes += length;
+
+        if ( m_pack->is_full() ) {
+            flush_pack();
+        }
+
+        return true;
+
+    });
+
+    if ( !chunked ) {
+        throw FileException(FileException::ReadError, "Unable to chunk file: " + file.get_file_path());
+    }
+
+    ChunkIndex chunk_index;
+    chunk_index.save_recipe( file.get_file_id(), blobs );
+
+    std::cout << "Stored " << file.get_file_name() << ": " << blobs.size() << " blobs, " << new_bytes << " new bytes" << '\n';
+
+    //Blobs in the open pack are not stored yet
+    if ( m_pack ) {
+        m_pending.push_back(upload);
+        return;
+    }
+
+    queue_completion( upload, false, false );
+
+}
+
+void RepositoryUpload::complete_upload()
+{
+
+    flush_pack();
+    write_index();
+    write_snapshot();
+
+}
+
+void RepositoryUpload::flush_pack()
+{
+
+    if ( !m_pack || m_pack->empty() )
+    {
+        m_pack.reset();
+        return;
+    }
+
+    try
+    {
+        m_pack->close();
+
+        std::string pack_hash = fs::path( m_pack->get_pack_path() ).stem().string();
+        std::string object_key = get_object_key( "data/" + pack_hash.substr(0, 2), pack_hash );
+
+        std::cout << "Storing pack " << pack_hash << " (" << m_pack->get_total_files() << " blobs)..." << '\n';
+
+        put_object( object_key, m_pack->get_pack_path() );
+
+        m_pack->save( "", object_key, get_provider().provider_id );
+        m_index->add_pack( object_key, m_pack->get_entries() );
+
+        m_index_content << "pack " << pack_hash << "\n";
+
+        for ( const auto& entry : m_pack->get_entries() )
+        {
+            m_index_content << "blob " << entry.hash << " " << entry.offset << " " << entry.length << "\n";
+            m_index_blobs++;
+        }
+    }
+    catch ( const std::exception& ex )
+    {
+        Log::get_log().add_error("Failed to store pack: " + m_pack->get_pack_path() + " (" + ex.what() + ")", "Repository");
+
+        //The waiting files were reported as uploaded, they are queued again
+        for ( auto& upload : m_pending ) {
+            BackupFile::reset_last_backup( upload.get_file().get_file_id() );
+        }
+
+        m_pending.clear();
+        m_pack->remove();
+        m_pack.reset();
+
+        throw;
+    }
+
+    m_pack->remove();
+    m_pack.reset();
+
+    for ( auto& upload : m_pending ) {
+        queue_completion( upload, false, false );
+    }
+
+    m_pending.clear();
+
+    if ( m_index_blobs >= REPOSITORY_INDEX_MAX_BLOBS ) {
+        write_index();
+    }
+
+}
+
+void RepositoryUpload::write_index()
+{
+
+    if ( m_index_blobs == 0 ) {
+        return;
+    }
+
+    std::string index = "vessel-index 1\n" + m_index_content.str();
+
+    put_data( get_object_key( "index", Hash::get_sha256_hash(index) ), index );
+
+    m_index_content.str("");
+    m_index_blobs = 0;
+
+}
+
+void RepositoryUpload::write_snapshot()
+{
+
+    std::vector<SnapshotFile> files;
+
+    if ( !m_index->get_snapshot_files(files) || files.empty() ) {
+        return;
+    }
+
+    std::ostringstream manifest;
+
+    manifest << "vessel-snapshot 1\n";
+    manifest << "time " << std::time(nullptr) << "\n";
+
+    for ( const auto& file : files )
+    {
+        manifest << "file " << file.file_size << " " << file.last_modified << " " << ( file.hash.empty() ? "-" : file.hash ) << " " << file.file_path << "\n";
+
+        for ( const auto& blob : file.blobs ) {
+            manifest << "blob " << blob.hash << " " << blob.length << "\n";
+        }
+    }
+
+    std::string snapshot = manifest.str();
+    std::string snapshot_id = Hash::get_sha256_hash(snapshot);
+
+    put_data( get_object_key( "snapshots", snapshot_id ), snapshot );
+
+    Log::get_log().add_message("Stored snapshot " + snapshot_id + " with " + std::to_string( files.size() ) + " files", "Repository");
+
+}
+
+void RepositoryUpload::put_object(const std::string& object_key, const std::string& local_path)
+{
+
+    if ( m_store )
+    {
+        m_store->store_file( local_path, object_key );
+        m_store->sync();
+        return;
+    }
+
+    BackupFile object_file = BackupFile( fs::path(local_path) );
+
+    //Repository objects are always sent with a single PUT, blobs are read with ranged reads so they are never compressed
+    object_file.set_part_size( std::max( object_file.get_file_size(), (size_t)1 ) );
+
+    if ( m_aws )
+    {
+        m_aws->set_cipher(nullptr);
+
+        if ( !m_aws->init_upload(object_file, AwsS3Client::AwsFlags::ReducedRedundancy) ) {
+            throw AwsException( AwsException::InitFailed, "Failed to initialize AWS repository upload");
+        }
+
+        m_aws->set_object_key(object_key);
+
+        if ( !m_aws->upload() ) {
+            throw AwsException( AwsException::UploadFailed, "Failed to store repository object: " + object_key );
+        }
+
+        return;
+    }
+
+    m_azure->set_cipher(nullptr);
+    m_azure->init_upload(object_file);
+    m_azure->set_compression(false);
+    m_azure->set_object_key(object_key);
+
+    if ( !m_azure->upload() ) {
+        throw AzureException( AzureException::UploadFailed, "Failed to store repository object: " + m_azure->last_request_id() );
+    }
+
+}
+
+void RepositoryUpload::put_data(const std::string& object_key, const std::string& data)
+{
+
+    fs::path tmp_path = fs::path( AppManager::get().get_data_dir() ) / "packs" / fs::unique_path("%%%%-%%%%-%%%%-%%%%.tmp");
+
+    std::ofstream outfile( tmp_path.string(), std::ios::out | std::ios::binary | std::ios::trunc );
+    outfile.write( data.c_str(), data.size() );
+    outfile.close();
+
+    if ( !outfile ) {
+        throw FileException(FileException::WriteError, "Unable to write " + tmp_path.string());
+    }
+
+    boost::system::error_code ec;
+
+    try
+    {
+        put_object( object_key, tmp_path.string() );
+    }
+    catch ( ... )
+    {
+        fs::remove(tmp_path, ec);
+        throw;
+    }
+
+    fs::remove(tmp_path, ec);
+
+}
+
+bool RepositoryUpload::is_enabled()
+{
+    return LocalDatabase::get_database().get_setting_str("repository_format") == "packs" && !FileCipher::is_enabled();
+}
+
+std::string RepositoryUpload::get_object_key(const std::string& dir, const std::string& name)
+{
+
+    std::string parent_path = std::string("/") + REPOSITORY_DIR + "/" + dir;
+
+    //The repository is stored next to the files of the user, following the key layout of the provider
+    if ( m_aws ) {
+        return m_aws->get_object_key( parent_path, name );
+    }
+
+    if ( m_azure ) {
+        return m_azure->get_object_key( parent_path, name );
+    }
+
+    return BackupFile::trim_path( m_user_id + parent_path + "/" + name );
+
+}
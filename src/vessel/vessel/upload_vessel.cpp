@@ -1,8 +1,11 @@
 #include <vessel/vessel/upload_manager.hpp>
 
-VesselUpload::VesselUpload()
+VesselUpload::VesselUpload(const StorageProvider& provider) : UploadInterface(provider)
 {
 
+    //Files are stored by the Vessel API, its health is the health of the provider
+    get_vessel_client()->set_circuit_breaker( CircuitBreaker::get_breaker(provider.provider_id) );
+
 }
 
 void VesselUpload::resume_uploads()
@@ -10,12 +13,91 @@ void VesselUpload::resume_uploads()
 
 }
 
-void VesselUpload::upload_file()
+void VesselUpload::upload_file(FileUpload& upload)
 {
 
+    BackupFile file = upload.get_file();
+    bool keep_signature = is_delta_candidate(file);
+    std::string signature_path = get_signature_path(file);
+
+    //Large files that were modified only send the changed blocks
+    if ( !keep_signature || !upload_delta(file, signature_path) )
+    {
+        get_vessel_client()->upload_file(file);
+    }
+
+    //Signature of the uploaded version, used by the next delta
+    if ( keep_signature )
+    {
+        FileSignature signature;
+
+        if ( !signature.generate( file.get_file_path() ) || !signature.save(signature_path) ) {
+            Log::get_log().add_error("Unable to save file signature: " + file.get_file_name(), "File Delta");
+        }
+    }
+
 }
 
 void VesselUpload::complete_upload()
 {
 
 }
+
+bool VesselUpload::upload_delta(BackupFile& file, const std::string& signature_path)
+{
+
+    std::string base_hash = file.get_last_backup_hash();
+
+    if ( base_hash.empty() ) {
+        return false;
+    }
+
+    FileSignature signature;
+
+    if ( !signature.load(signature_path) ) {
+        return false;
+    }
+
+    std::string delta_path = signature_path + ".delta";
+    FileDelta delta(signature);
+
+    bool sent = false;
+
+    if ( delta.encode( file.get_file_path(), delta_path ) )
+    {
+        std::cout << "Delta of " << file.get_file_name() << ": " << delta.get_literal_bytes() << " literal bytes, " << delta.get_copied_bytes() << " copied bytes" << '\n';
+
+        //Not worth it if most of the file changed
+        if ( delta.get_delta_size() < file.get_file_size() )
+        {
+            sent = get_vessel_client()->upload_delta( file, base_hash, delta_path );
+        }
+    }
+
+    boost::system::error_code ec;
+    fs::remove( delta_path, ec );
+
+    return sent;
+
+}
+
+std::string VesselUpload::get_signature_path(const BackupFile& file)
+{
+
+    fs::path signature_dir = fs::path( AppManager::get().get_data_dir() ) / "signatures";
+
+    boost::system::error_code ec;
+    fs::create_directories( signature_dir, ec );
+
+    return ( signature_dir / ( file.get_file_id_text() + ".sig" ) ).string();
+
+}
+
+bool VesselUpload::is_delta_candidate(const BackupFile& file)
+{
+
+    int min_size = LocalDatabase::get_database().get_setting_int("delta_min_filesize");
+
+    return file.get_file_size() >= (size_t)( ( min_size > 0 ) ? min_size : DELTA_MIN_FILE_SZ );
+
+}
@@ -46,6 +46,56 @@ std::string VesselClient::init_upload ( const BackupFile& bf )
 
     writer.StartObject();
 
+    write_upload_file( writer, bf );
+
+    writer.Key("user_name");
+    writer.String( m_ldb->get_setting_str("username").c_str() );
+
+    writer.Key("storage_provider_id");
+    writer.String( provider.provider_id.c_str() );
+
+    //
+    writer.EndObject();
+
+    //Create a new HTTP request
+    std::string endpoint = "/upload/" + get_provider_endpoint( provider.provider_type );
+
+    HttpRequest r;
+    r.set_auth_header("Bearer " + m_client_token);
+    r.accept("application/json");
+    r.set_content_type("application/json");
+    r.set_body( strbuf.GetString() );
+    r.set_method("POST");
+    r.set_url(m_api_path + endpoint);
+
+    //Send the init request
+    send_http_request(r);
+
+    //Parse the upload ID from the response
+    if ( get_http_status() != 200 ) {
+        throw VesselException( VesselException::BadUpload, "Bad payload or invalid upload id");
+    }
+
+    Document document;
+    document.Parse( get_response().c_str() ) ;
+
+    if ( !document.HasMember("upload") ) {
+        throw VesselException( VesselException::BadUpload, "Bad payload or invalid upload id");
+    }
+
+    const Value& upload = document["upload"];
+
+    std::string upload_id = upload["upload_id"].GetString();
+
+    m_log->add_message("Initialized upload: " + upload_id, "File Upload");
+
+    return upload_id;
+
+}
+
+void VesselClient::write_upload_file( Writer<StringBuffer>& writer, const BackupFile& bf )
+{
+
     writer.Key("file_name");
     writer.String( bf.get_file_name().c_str() );
 
@@ -56,7 +106,7 @@ std::string VesselClient::init_upload ( const BackupFile& bf )
     writer.String( bf.get_file_type().c_str() );
 
     writer.Key("file_size");
-    writer.Uint( bf.get_file_size() );
+    writer.Uint64( bf.get_file_size() );
 
     writer.Key("hash");
     writer.String( bf.get_hash_sha1().c_str() );
@@ -64,52 +114,344 @@ std::string VesselClient::init_upload ( const BackupFile& bf )
     writer.Key("total_parts");
     writer.Uint( bf.get_total_parts() );
 
+}
+
+bool VesselClient::can_inline( const BackupFile& bf )
+{
+
+    int max_size = m_ldb->get_setting_int("inline_max_size");
+
+    if ( max_size < 0 ) {
+        max_size = VESSEL_INLINE_MAX_SZ;
+    }
+
+    //The Vessel server must never see the content of an encrypted backup
+    return max_size > 0 && bf.get_file_size() <= (size_t)max_size && !FileCipher::is_enabled();
+
+}
+
+std::vector<UploadRegistration> VesselClient::init_uploads( std::vector<BackupFile>& files )
+{
+
+    std::vector<UploadRegistration> registrations( files.size(), UploadRegistration{ "", false } );
+
+    if ( files.empty() ) {
+        return registrations;
+    }
+
+    StorageProvider provider = get_storage_provider();
+
+    //Write some JSON
+    StringBuffer strbuf;
+    Writer<StringBuffer> writer(strbuf);
+
+    writer.StartObject();
+
     writer.Key("user_name");
     writer.String( m_ldb->get_setting_str("username").c_str() );
 
     writer.Key("storage_provider_id");
     writer.String( provider.provider_id.c_str() );
 
-    //
+    writer.Key("files");
+    writer.StartArray();
+
+    Compressor compressor;
+    compressor.set_z_level( m_ldb->get_setting_int("compression_level") );
+
+    for ( auto& bf : files )
+    {
+        writer.StartObject();
+        write_upload_file( writer, bf );
+
+        //The content of a tiny file costs less than a separate request to the storage provider
+        if ( can_inline(bf) && bf.get_file_size() == 0 )
+        {
+            //An empty file has no gzip stream, the server would reject it. Its content is sent as is
+            writer.Key("content");
+            writer.String("");
+        }
+        else if ( can_inline(bf) )
+        {
+            std::string content = compressor.compress_file( bf.get_file_path() );
+
+            if ( !content.empty() )
+            {
+                writer.Key("content_encoding");
+                writer.String("gzip");
+
+                writer.Key("content");
+                writer.String( Hash::get_base64(content).c_str() );
+            }
+        }
+
+        writer.EndObject();
+    }
+
+    writer.EndArray();
+
     writer.EndObject();
 
     //Create a new HTTP request
-    std::string endpoint = "/upload/" + get_provider_endpoint( provider.provider_type );
-
     HttpRequest r;
     r.set_auth_header("Bearer " + m_client_token);
     r.accept("application/json");
     r.set_content_type("application/json");
     r.set_body( strbuf.GetString() );
     r.set_method("POST");
-    r.set_url(m_api_path + endpoint);
+    r.set_url(m_api_path + "/upload/batch");
 
-    //Send the init request
+    //Send the batch request
     send_http_request(r);
 
-    //Parse the upload ID from the response
+    //The Vessel server does not support batches, every file is registered on its own
+    if ( get_http_status() == 404 || get_http_status() == 405 )
+    {
+        for ( size_t i=0; i < files.size(); i++ )
+        {
+            try
+            {
+                registrations[i].vessel_id = init_upload( files[i] );
+            }
+            catch ( const VesselException& e )
+            {
+                m_log->add_error("Failed to initialize upload: " + files[i].get_file_name() + " (" + e.what() + ")", "File Upload");
+            }
+        }
+
+        return registrations;
+    }
+
     if ( get_http_status() != 200 ) {
-        throw VesselException( VesselException::BadUpload, "Bad payload or invalid upload id");
+        throw VesselException( VesselException::BadUpload, "Failed to initialize batch of " + std::to_string(files.size()) + " uploads");
     }
 
     Document document;
-    document.Parse( get_response().c_str() ) ;
+    document.Parse( get_response().c_str() );
 
-    if ( !document.HasMember("upload") ) {
-        throw VesselException( VesselException::BadUpload, "Bad payload or invalid upload id");
+    if ( document.HasParseError() || !document.IsObject() || !document.HasMember("uploads") || !document["uploads"].IsArray() ) {
+        throw VesselException( VesselException::BadUpload, "Bad payload for batch upload");
     }
 
-    const Value& upload = document["upload"];
+    //One result per file, a file that was rejected has an error instead of an upload id
+    for ( const auto& result : document["uploads"].GetArray() )
+    {
 
-    std::string upload_id = upload["upload_id"].GetString();
+        if ( !result.HasMember("index") || !result["index"].IsUint() || result["index"].GetUint() >= files.size() ) {
+            continue;
+        }
 
-    m_log->add_message("Initialized upload: " + upload_id, "File Upload");
+        unsigned int index = result["index"].GetUint();
 
-    return upload_id;
+        if ( result.HasMember("upload_id") && result["upload_id"].IsString() ) {
+            registrations[index].vessel_id = result["upload_id"].GetString();
+            registrations[index].stored = result.HasMember("stored") && result["stored"].IsBool() && result["stored"].GetBool();
+            continue;
+        }
+
+        std::string error = ( result.HasMember("error") && result["error"].IsString() ) ? result["error"].GetString() : "Unknown error";
+        m_log->add_error("Failed to initialize upload: " + files[index].get_file_name() + " (" + error + ")", "File Upload");
+
+    }
+
+    m_log->add_message("Initialized batch of " + std::to_string(files.size()) + " uploads", "File Upload");
+
+    return registrations;
 
 }
 
-void VesselClient::complete_upload( const std::string& upload_id )
+void VesselClient::queue_completion( const std::string& upload_id, bool compressed, bool encrypted )
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "INSERT OR REPLACE INTO backup_upload_complete (vessel_id,compressed,encrypted) VALUES(?1,?2,?3)";
+
+    if ( sqlite3_prepare_v2(m_ldb->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_ldb->get_last_err() + ")" );
+    }
+
+    sqlite3_bind_text(stmt, 1, upload_id.c_str(), upload_id.size(), 0 );
+    sqlite3_bind_int(stmt, 2, compressed ? 1 : 0 );
+    sqlite3_bind_int(stmt, 3, encrypted ? 1 : 0 );
+
+    if ( sqlite3_step(stmt) != SQLITE_DONE ) {
+        sqlite3_finalize(stmt);
+        throw DatabaseException(DatabaseException::InvalidQuery, "Error executing query: " + query + "(" + m_ldb->get_last_err() + ")" );
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+int VesselClient::complete_uploads()
+{
+
+    int batch_size = m_ldb->get_setting_int("vessel_batch_size");
+
+    if ( batch_size <= 0 ) {
+        batch_size = VESSEL_BATCH_SZ;
+    }
+
+    int total_completed = 0;
+
+    while ( true )
+    {
+
+        std::vector<UploadCompletion> completions = get_pending_completions(batch_size);
+
+        if ( completions.empty() ) {
+            break;
+        }
+
+        //Write some JSON
+        StringBuffer strbuf;
+        Writer<StringBuffer> writer(strbuf);
+
+        writer.StartObject();
+        writer.Key("uploads");
+        writer.StartArray();
+
+        for ( const auto& completion : completions )
+        {
+            writer.StartObject();
+            writer.Key("upload_id");
+            writer.String( completion.vessel_id.c_str() );
+            writer.Key("compressed");
+            writer.Bool( completion.compressed );
+            writer.Key("encrypted");
+            writer.Bool( completion.encrypted );
+            writer.EndObject();
+        }
+
+        writer.EndArray();
+        writer.EndObject();
+
+        //Create a new HTTP request
+        HttpRequest r;
+        r.set_auth_header("Bearer " + m_client_token);
+        r.accept("application/json");
+        r.set_content_type("application/json");
+        r.set_body( strbuf.GetString() );
+        r.set_method("POST");
+        r.set_url(m_api_path + "/upload/complete");
+
+        send_http_request(r);
+
+        //The Vessel server does not support batches, every upload is completed on its own
+        if ( get_http_status() == 404 || get_http_status() == 405 )
+        {
+            for ( const auto& completion : completions )
+            {
+                complete_upload( completion.vessel_id, completion.compressed, completion.encrypted );
+
+                if ( get_http_status() != 200 ) {
+                    return total_completed; //Retried with the next batch
+                }
+
+                remove_completion( completion.vessel_id );
+                total_completed++;
+            }
+
+            continue;
+        }
+
+        //The pending completions are kept and sent again with the next batch
+        if ( get_http_status() != 200 ) {
+            m_log->add_error("Failed to complete batch of " + std::to_string(completions.size()) + " uploads", "File Upload");
+            break;
+        }
+
+        Document document;
+        document.Parse( get_response().c_str() );
+
+        if ( document.HasParseError() || !document.IsObject() || !document.HasMember("completed") || !document["completed"].IsArray() ) {
+            m_log->add_error("Bad payload for batch completion", "File Upload");
+            break;
+        }
+
+        for ( const auto& id : document["completed"].GetArray() )
+        {
+            if ( id.IsString() ) {
+                remove_completion( id.GetString() );
+                total_completed++;
+            }
+        }
+
+        //Uploads the server does not know can never be completed, retrying them would block the batch
+        if ( document.HasMember("failed") && document["failed"].IsArray() )
+        {
+            for ( const auto& failed : document["failed"].GetArray() )
+            {
+                if ( !failed.HasMember("upload_id") || !failed["upload_id"].IsString() ) {
+                    continue;
+                }
+
+                std::string error = ( failed.HasMember("error") && failed["error"].IsString() ) ? failed["error"].GetString() : "Unknown error";
+                m_log->add_error("Failed to mark file as uploaded: (Upload Id=" + std::string( failed["upload_id"].GetString() ) + ") " + error, "File Upload");
+                remove_completion( failed["upload_id"].GetString() );
+            }
+        }
+
+        m_log->add_message("Completed batch of " + std::to_string(completions.size()) + " uploads", "File Upload");
+
+    }
+
+    return total_completed;
+
+}
+
+std::vector<UploadCompletion> VesselClient::get_pending_completions( int limit )
+{
+
+    std::vector<UploadCompletion> completions;
+
+    sqlite3_stmt* stmt;
+    std::string query = "SELECT vessel_id,compressed,encrypted FROM backup_upload_complete ORDER BY rowid LIMIT ?1";
+
+    if ( sqlite3_prepare_v2(m_ldb->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_ldb->get_last_err() + ")" );
+    }
+
+    sqlite3_bind_int(stmt, 1, limit );
+
+    while ( sqlite3_step(stmt) == SQLITE_ROW )
+    {
+        UploadCompletion completion;
+        completion.vessel_id = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 0) );
+        completion.compressed = sqlite3_column_int(stmt, 1) == 1;
+        completion.encrypted = sqlite3_column_int(stmt, 2) == 1;
+        completions.push_back(completion);
+    }
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+    return completions;
+
+}
+
+void VesselClient::remove_completion( const std::string& upload_id )
+{
+
+    sqlite3_stmt* stmt;
+    std::string query = "DELETE FROM backup_upload_complete WHERE vessel_id=?1";
+
+    if ( sqlite3_prepare_v2(m_ldb->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK ) {
+        throw DatabaseException(DatabaseException::InvalidStatement, "Error executing statement with query: " + query + "(" + m_ldb->get_last_err() + ")" );
+    }
+
+    sqlite3_bind_text(stmt, 1, upload_id.c_str(), upload_id.size(), 0 );
+
+    //Execute query
+    sqlite3_step(stmt);
+
+    //Cleanup
+    sqlite3_finalize(stmt);
+
+}
+
+void VesselClient::complete_upload( const std::string& upload_id, bool compressed, bool encrypted )
 {
 
     //Write some JSON
@@ -119,6 +461,10 @@ void VesselClient::complete_upload( const std::string& upload_id )
     writer.StartObject();
     writer.Key("uploaded");
     writer.Bool(true);
+    writer.Key("compressed");
+    writer.Bool(compressed);
+    writer.Key("encrypted");
+    writer.Bool(encrypted);
     writer.EndObject();
 
     //Create a new HTTP request
@@ -140,6 +486,250 @@ void VesselClient::complete_upload( const std::string& upload_id )
 
 }
 
+void VesselClient::add_pack_files( const std::string& upload_id, const std::vector<PackEntry>& entries )
+{
+
+    //Write some JSON
+    StringBuffer strbuf;
+    Writer<StringBuffer> writer(strbuf);
+
+    writer.StartObject();
+
+    writer.Key("user_name");
+    writer.String( m_ldb->get_setting_str("username").c_str() );
+
+    writer.Key("files");
+    writer.StartArray();
+
+    for ( const auto& entry : entries )
+    {
+        //Chunks are only referenced by the recipes of chunked files
+        if ( entry.type == "chunk" )
+            continue;
+
+        writer.StartObject();
+
+        writer.Key("file_name");
+        writer.String( entry.file_name.c_str() );
+
+        writer.Key("file_path");
+        writer.String( entry.file_path.c_str() );
+
+        writer.Key("file_type");
+        writer.String( entry.file_type.c_str() );
+
+        writer.Key("file_size");
+        writer.Uint64( entry.file_size );
+
+        writer.Key("hash");
+        writer.String( entry.hash.c_str() );
+
+        writer.Key("chunked");
+        writer.Bool( entry.type == "recipe" );
+
+        writer.Key("offset");
+        writer.Uint64( entry.offset );
+
+        writer.Key("length");
+        writer.Uint64( entry.length );
+
+        writer.EndObject();
+    }
+
+    writer.EndArray();
+
+    writer.EndObject();
+
+    //Create a new HTTP request
+    HttpRequest r;
+    r.set_auth_header("Bearer " + m_client_token);
+    r.accept("application/json");
+    r.set_content_type("application/json");
+    r.set_body( strbuf.GetString() );
+    r.set_method("POST");
+    r.set_url(m_api_path + "/upload/" + upload_id + "/pack");
+
+    //Send the request
+    send_http_request(r);
+
+    if ( get_http_status() != 200 ) {
+        throw VesselException( VesselException::BadUpload, "Failed to register pack files (Upload Id=" + upload_id + ")");
+    }
+
+    m_log->add_message("Registered " + std::to_string(entries.size()) + " packed files: " + upload_id, "File Upload");
+
+}
+
+bool VesselClient::add_file_reference( const BackupFile& bf, const std::string& hash )
+{
+
+    StorageProvider provider = get_storage_provider();
+
+    //Write some JSON
+    StringBuffer strbuf;
+    Writer<StringBuffer> writer(strbuf);
+
+    writer.StartObject();
+
+    writer.Key("file_name");
+    writer.String( bf.get_file_name().c_str() );
+
+    writer.Key("file_path");
+    writer.String( bf.get_parent_path().c_str() );
+
+    writer.Key("file_type");
+    writer.String( bf.get_file_type().c_str() );
+
+    writer.Key("file_size");
+    writer.Uint64( bf.get_file_size() );
+
+    writer.Key("hash");
+    writer.String( hash.c_str() );
+
+    writer.Key("user_name");
+    writer.String( m_ldb->get_setting_str("username").c_str() );
+
+    writer.Key("storage_provider_id");
+    writer.String( provider.provider_id.c_str() );
+
+    writer.EndObject();
+
+    //Create a new HTTP request
+    HttpRequest r;
+    r.set_auth_header("Bearer " + m_client_token);
+    r.accept("application/json");
+    r.set_content_type("application/json");
+    r.set_body( strbuf.GetString() );
+    r.set_method("POST");
+    r.set_url(m_api_path + "/file/reference");
+
+    //Send the request
+    send_http_request(r);
+
+    //No uploaded copy of the content, the file must be uploaded
+    if ( get_http_status() == 404 ) {
+        return false;
+    }
+
+    if ( get_http_status() != 200 ) {
+        throw VesselException( VesselException::BadUpload, "Failed to register file reference: " + bf.get_file_name() );
+    }
+
+    m_log->add_message("Registered duplicate file: " + bf.get_file_name(), "File Upload");
+
+    return true;
+
+}
+
+void VesselClient::upload_file( BackupFile& bf )
+{
+
+    StorageProvider provider = get_storage_provider();
+
+    HttpRequest r;
+    r.set_auth_header("Bearer " + m_client_token);
+    r.accept("application/json");
+    r.set_content_type("application/octet-stream");
+    r.add_header("X-Vessel-Storage-Provider: " + provider.provider_id);
+    r.add_header("X-Vessel-User-Id: " + m_user_id);
+    r.set_method("PUT");
+    r.set_url(m_api_path + "/upload/vessel/" + encode_uri( bf.get_file_path() ) );
+
+    send_file_request( r, bf.get_file_path() );
+
+    if ( get_http_status() != 200 ) {
+        throw VesselException( VesselException::BadUpload, "Failed to upload file: " + bf.get_file_name() );
+    }
+
+}
+
+bool VesselClient::upload_delta( BackupFile& bf, const std::string& base_hash, const std::string& delta_path )
+{
+
+    StorageProvider provider = get_storage_provider();
+
+    boost::system::error_code ec;
+    size_t delta_size = fs::file_size( delta_path, ec );
+
+    if ( ec ) {
+        throw VesselException( VesselException::BadUpload, "Unable to read delta: " + delta_path );
+    }
+
+    HttpRequest r;
+    r.set_auth_header("Bearer " + m_client_token);
+    r.accept("application/json");
+    r.set_content_type("application/octet-stream");
+    r.add_header("X-Vessel-Storage-Provider: " + provider.provider_id);
+    r.add_header("X-Vessel-User-Id: " + m_user_id);
+    r.add_header("X-Vessel-Base-Hash: " + base_hash);
+    r.add_header("X-Vessel-Hash: " + bf.get_hash_sha1());
+    r.set_method("PUT");
+    r.set_url(m_api_path + "/upload/vessel/delta/" + encode_uri( bf.get_file_path() ) );
+
+    send_file_request( r, delta_path );
+
+    //The stored version changed or is missing
+    if ( get_http_status() == 409 ) {
+        return false;
+    }
+
+    if ( get_http_status() != 200 ) {
+        throw VesselException( VesselException::BadUpload, "Failed to upload file delta: " + bf.get_file_name() );
+    }
+
+    m_log->add_message("Uploaded delta of " + std::to_string( delta_size ) + " bytes: " + bf.get_file_name(), "File Upload");
+
+    return true;
+
+}
+
+void VesselClient::send_file_request( HttpRequest& request, const std::string& path )
+{
+
+    //A streamed body is not sent again by the HTTP client, a request on a connection the server closed is retried here
+    for ( int attempt=0; attempt < 2; attempt++ )
+    {
+
+        std::shared_ptr<std::ifstream> infile = std::make_shared<std::ifstream>( path, std::ios::in | std::ios::binary );
+
+        if ( !infile->is_open() ) {
+            throw VesselException( VesselException::BadUpload, "Unable to read " + path );
+        }
+
+        //The length sent is the length the file had when the request started
+        infile->seekg( 0, std::ios::end );
+        size_t remaining = infile->tellg();
+        infile->seekg( 0, std::ios::beg );
+
+        request.set_body_source( [infile, remaining, path](std::string& chunk) mutable -> bool {
+
+            if ( remaining == 0 ) {
+                return false;
+            }
+
+            chunk.resize( std::min( (size_t)VESSEL_STREAM_CHUNK_SZ, remaining ) );
+            infile->read( &chunk[0], chunk.size() );
+
+            if ( (size_t)infile->gcount() != chunk.size() ) {
+                throw VesselException( VesselException::BadUpload, "File was truncated while it was uploaded: " + path );
+            }
+
+            remaining -= chunk.size();
+
+            return true;
+
+        }, remaining );
+
+        send_http_request(request);
+
+        if ( get_http_status() != 0 ) {
+            break;
+        }
+
+    }
+
+}
+
 bool VesselClient::upload_file_part( Vessel::File::BackupFile * bf, int part_number=1 )
 {
     //TODO
@@ -430,9 +1020,10 @@ bool VesselClient::sync_storage_provider(const Value& obj)
     providerObj.storage_path = obj["storage_path"].IsNull() ? "" : obj["storage_path"].GetString();
     providerObj.region = obj["region"].IsNull() ? "" : obj["region"].GetString();
     providerObj.priority = obj["priority"].IsNull() ? 0 : obj["priority"].GetInt();
+    providerObj.weight = ( obj.HasMember("weight") && obj["weight"].IsInt() ) ? obj["weight"].GetInt() : 1;
 
     sqlite3_stmt* stmt;
-    std::string query = "REPLACE INTO backup_provider (provider_id,name,server,type,storage_path,priority,bucket_name,region,access_id) VALUES(?1,?2,?3,?4,?5,?6,?7,?8,?9)";
+    std::string query = "REPLACE INTO backup_provider (provider_id,name,server,type,storage_path,priority,bucket_name,region,access_id,weight) VALUES(?1,?2,?3,?4,?5,?6,?7,?8,?9,?10)";
 
     if ( sqlite3_prepare_v2(m_ldb->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK )
         return false;
@@ -446,6 +1037,7 @@ bool VesselClient::sync_storage_provider(const Value& obj)
     sqlite3_bind_text(stmt, 7, providerObj.bucket_name.c_str(), providerObj.bucket_name.size(), 0 );
     sqlite3_bind_text(stmt, 8, providerObj.region.c_str(), providerObj.region.size(), 0 );
     sqlite3_bind_text(stmt, 9, providerObj.access_id.c_str(), providerObj.access_id.size(), 0 );
+    sqlite3_bind_int(stmt, 10, providerObj.weight );
 
     int rc = sqlite3_step(stmt);
 
@@ -511,38 +1103,67 @@ bool VesselClient::delete_storage_provider(const std::string& id)
 StorageProvider VesselClient::get_storage_provider()
 {
 
+    std::vector<StorageProvider> providers = get_storage_providers();
+
+    for ( const auto& provider : providers )
+    {
+        if ( provider.provider_id == m_provider_id ) {
+            return provider;
+        }
+    }
+
+    return providers.front();
+
+}
+
+std::vector<StorageProvider> VesselClient::get_storage_providers()
+{
+
+    std::vector<StorageProvider> providers;
+
     sqlite3_stmt* stmt;
-    std::string query = "SELECT provider_id,name,description,server,type,bucket_name,region,storage_path,priority,access_id FROM backup_provider ORDER BY priority ASC LIMIT 1";
+    std::string query = "SELECT provider_id,name,description,server,type,bucket_name,region,storage_path,priority,access_id,weight FROM backup_provider ORDER BY priority ASC";
 
     if ( sqlite3_prepare_v2(m_ldb->get_handle(), query.c_str(), -1, &stmt, NULL ) != SQLITE_OK )
     {
-        throw DatabaseException(DatabaseException::InvalidStatement, "Bad statement. Failed to get storage provider");
+        throw DatabaseException(DatabaseException::InvalidStatement, "Bad statement. Failed to get storage providers");
     }
 
-    if ( sqlite3_step(stmt) != SQLITE_ROW )
+    while ( sqlite3_step(stmt) == SQLITE_ROW )
     {
-        throw VesselException(VesselException::ProviderError, "Unable to find a storage provider");
+        StorageProvider provider;
+        provider.provider_id = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 0) );
+        provider.provider_name = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 1) );
+        provider.description = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 2) );
+        provider.server = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 3) );
+        provider.provider_type = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 4) );
+        provider.bucket_name = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 5) );
+        provider.region = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 6) );
+        provider.storage_path = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 7) );
+        provider.priority = (int)sqlite3_column_int(stmt, 8);
+        provider.access_id = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 9) );
+        provider.weight = std::max( (int)sqlite3_column_int(stmt, 10), 1 );
+
+        providers.push_back(provider);
     }
 
-    StorageProvider provider;
-    provider.provider_id = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 0) );
-    provider.provider_name = (char*)sqlite3_column_text(stmt, 1);
-    provider.description = LocalDatabase::get_sqlite_str( sqlite3_column_text(stmt, 2) );
-    provider.server = (char*)sqlite3_column_text(stmt, 3);
-    provider.provider_type = (char*)sqlite3_column_text(stmt, 4);
-    provider.bucket_name = (char*)sqlite3_column_text(stmt, 5);
-    provider.region = (char*)sqlite3_column_text(stmt, 6);
-    provider.storage_path = (char*)sqlite3_column_text(stmt, 7);
-    provider.priority = (int)sqlite3_column_int(stmt, 8);
-    provider.access_id = (char*)sqlite3_column_text(stmt, 9);
-
     //Cleanup
     sqlite3_finalize(stmt);
 
-    return provider;
+    if ( providers.empty() )
+    {
+        throw VesselException(VesselException::ProviderError, "Unable to find a storage provider");
+    }
+
+    return providers;
 
 }
 
+void VesselClient::use_storage_provider(const std::string& provider_id)
+{
+    m_provider_id = provider_id;
+}
+
 void VesselClient::refresh_client_token()
 {
     m_client_token = m_ldb->get_setting_str("client_token");
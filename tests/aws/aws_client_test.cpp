@@ -140,4 +140,105 @@ BOOST_AUTO_TEST_CASE(AwsMultiPartTest)
 
 }
 
+BOOST_AUTO_TEST_CASE(DeleteObjectsBodyTest)
+{
+
+    using namespace boost::property_tree;
+
+    std::vector<std::string> object_keys = { "user/home/docs/report.pdf", "user/home/a & <b>.txt" };
+
+    std::stringstream iss;
+    iss << AwsS3Client::get_delete_body(object_keys);
+
+    ptree pt;
+    read_xml(iss, pt);
+
+    BOOST_TEST( pt.get<std::string>("Delete.Quiet") == "true" );
+
+    //Keys are escaped and listed in order
+    std::vector<std::string> keys;
+
+    for ( const auto& node : pt.get_child("Delete") )
+    {
+        if ( node.first == "Object" ) {
+            keys.push_back( node.second.get<std::string>("Key") );
+        }
+    }
+
+    BOOST_TEST( keys == object_keys );
+
+}
+
+BOOST_AUTO_TEST_CASE(DeleteObjectsErrorTest)
+{
+
+    std::string response =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<DeleteResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+        "<Deleted><Key>user/home/a.txt</Key></Deleted>"
+        "<Error><Key>user/home/b.txt</Key><Code>AccessDenied</Code><Message>Access Denied</Message></Error>"
+        "<Error><Key>user/home/c.txt</Key><Code>InternalError</Code><Message>We encountered an internal error. Please try again.</Message></Error>"
+        "</DeleteResult>";
+
+    std::map<std::string,std::string> errors = AwsS3Client::get_delete_errors(response);
+
+    BOOST_TEST( errors.size() == 2 );
+    BOOST_TEST( errors["user/home/b.txt"] == "AccessDenied" );
+    BOOST_TEST( errors["user/home/c.txt"] == "InternalError" );
+
+    //A quiet response without errors lists nothing
+    BOOST_TEST( AwsS3Client::get_delete_errors("<DeleteResult></DeleteResult>").empty() );
+
+    BOOST_CHECK_THROW( AwsS3Client::get_delete_errors("<Error><Code>SlowDown</Code></Error>"), AwsException );
+
+}
+
+BOOST_AUTO_TEST_CASE(PathStyleTest)
+{
+
+    //Virtual-hosted servers carry the bucket in the host name
+    BOOST_TEST( !AwsS3Client::is_path_style("mybucket.s3.amazonaws.com", "mybucket") );
+    BOOST_TEST( !AwsS3Client::is_path_style("mybucket.s3.eu-west-1.amazonaws.com", "mybucket") );
+    BOOST_TEST( !AwsS3Client::is_path_style("MyBucket.S3.Amazonaws.com", "mybucket") );
+    BOOST_TEST( !AwsS3Client::is_path_style("mybucket.s3.amazonaws.com", "MyBucket") );
+
+    //Regional endpoints and S3-compatible servers are addressed by path
+    BOOST_TEST( AwsS3Client::is_path_style("s3.eu-west-1.amazonaws.com", "mybucket") );
+    BOOST_TEST( AwsS3Client::is_path_style("localhost", "mybucket") );
+    BOOST_TEST( AwsS3Client::is_path_style("127.0.0.1", "mybucket") );
+    BOOST_TEST( AwsS3Client::is_path_style("minio.example.com", "mybucket") );
+
+    //A bucket name that is only a prefix of the first label is not the host's bucket
+    BOOST_TEST( AwsS3Client::is_path_style("mybucket-backup.s3.amazonaws.com", "mybucket") );
+    BOOST_TEST( AwsS3Client::is_path_style("mybucketx.s3.amazonaws.com", "mybucket") );
+
+    //Without a bucket name there is nothing to put in the path
+    BOOST_TEST( !AwsS3Client::is_path_style("s3.amazonaws.com", "") );
+
+}
+
+BOOST_AUTO_TEST_CASE(ResourcePathTest)
+{
+
+    BOOST_TEST( AwsS3Client::get_resource_path("mybucket", true, "user/home/a.txt") == "/mybucket/user/home/a.txt" );
+    BOOST_TEST( AwsS3Client::get_resource_path("mybucket", false, "user/home/a.txt") == "/user/home/a.txt" );
+
+    //Bucket requests, such as DeleteObjects, sign the bucket alone or the root
+    BOOST_TEST( AwsS3Client::get_resource_path("mybucket", true, "") == "/mybucket" );
+    BOOST_TEST( AwsS3Client::get_resource_path("mybucket", false, "") == "/" );
+
+    //The canonical URI is encoded, separators are kept
+    BOOST_TEST( AwsS3Client::get_resource_path("mybucket", true, "user/my file+1.txt") == "/mybucket/user/my%20file%2B1.txt" );
+    BOOST_TEST( AwsS3Client::get_resource_path("mybucket", false, "user/my file+1.txt") == "/user/my%20file%2B1.txt" );
+
+}
+
+BOOST_AUTO_TEST_CASE(SigningRegionTest)
+{
+
+    BOOST_TEST( AwsS3Client::get_signing_region("") == "us-east-1" );
+    BOOST_TEST( AwsS3Client::get_signing_region("eu-west-1") == "eu-west-1" );
+
+}
+
 BOOST_AUTO_TEST_SUITE_END()
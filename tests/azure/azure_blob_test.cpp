@@ -107,4 +107,42 @@ BOOST_AUTO_TEST_CASE(AzureBlockTest)
 
 }
 
+BOOST_AUTO_TEST_CASE(BatchDeleteStatusTest)
+{
+
+    std::string response =
+        "--batchresponse_66925647-d0cb-4109-b6d3-28efe3e1e5ed\r\n"
+        "Content-Type: application/http\r\n"
+        "Content-ID: 0\r\n\r\n"
+        "HTTP/1.1 202 Accepted\r\n"
+        "x-ms-delete-type-permanent: true\r\n"
+        "x-ms-version: 2020-04-08\r\n\r\n"
+        "--batchresponse_66925647-d0cb-4109-b6d3-28efe3e1e5ed\r\n"
+        "Content-Type: application/http\r\n"
+        "Content-ID: 2\r\n\r\n"
+        "HTTP/1.1 404 The specified blob does not exist.\r\n"
+        "x-ms-error-code: BlobNotFound\r\n\r\n"
+        "--batchresponse_66925647-d0cb-4109-b6d3-28efe3e1e5ed\r\n"
+        "Content-Type: application/http\r\n"
+        "Content-ID: 1\r\n\r\n"
+        "HTTP/1.1 403 This request is not authorized to perform this operation using this permission.\r\n"
+        "x-ms-error-code: AuthorizationPermissionMismatch\r\n\r\n"
+        "--batchresponse_66925647-d0cb-4109-b6d3-28efe3e1e5ed--\r\n";
+
+    std::vector<int> statuses = AzureClient::get_batch_statuses(response, 4);
+
+    BOOST_TEST( statuses.size() == 4 );
+    BOOST_TEST( statuses[0] == 202 );
+    BOOST_TEST( statuses[1] == 403 );
+    BOOST_TEST( statuses[2] == 404 );
+    BOOST_TEST( statuses[3] == 0 );
+
+    //Removed and missing blobs are deleted, a rejected or unanswered sub-request is sent again
+    BOOST_TEST( AzureClient::is_blob_deleted(statuses[0]) );
+    BOOST_TEST( AzureClient::is_blob_deleted(statuses[2]) );
+    BOOST_TEST( !AzureClient::is_blob_deleted(statuses[1]) );
+    BOOST_TEST( !AzureClient::is_blob_deleted(statuses[3]) );
+
+}
+
 BOOST_AUTO_TEST_SUITE_END()
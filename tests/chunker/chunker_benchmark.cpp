@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <vessel/filesystem/chunker.hpp>
+
+using namespace Vessel::File;
+
+/**
+ ** Measures the throughput of the content-defined chunker on random data (single core)
+ ** and checks that an insert in the middle of the data only changes the chunks around it
+*/
+int main(int argc, char* argv[] )
+{
+
+    size_t total_bytes = (argc > 1) ? std::stoul(argv[1]) * 1048576 : 1073741824; //Default 1GB
+
+    std::vector<unsigned char> data(total_bytes);
+    std::mt19937_64 rng(42);
+
+    for ( size_t i=0; i + 8 <= data.size(); i += 8 )
+    {
+        uint64_t v = rng();
+        for ( int b=0; b < 8; b++ )
+            data[i+b] = (v >> (8*b)) & 0xFF;
+    }
+
+    Chunker chunker;
+    std::vector<size_t> lengths;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for ( size_t offset=0; offset < data.size(); )
+    {
+        size_t length = chunker.find_boundary( &data[offset], data.size() - offset );
+        lengths.push_back(length);
+        offset += length;
+    }
+
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Chunked " << (total_bytes / 1048576) << " MB in " << secs.count() << "s" << '\n';
+    std::cout << "Throughput: " << (total_bytes / secs.count() / 1048576) << " MB/s" << '\n';
+    std::cout << "Chunks: " << lengths.size() << " (average " << (total_bytes / lengths.size()) << " bytes)" << '\n';
+
+    //Insert 100 bytes in the middle and compare the chunks
+    std::vector<unsigned char> edited(data.begin(), data.begin() + data.size()/2);
+    edited.insert(edited.end(), 100, 0xAB);
+    edited.insert(edited.end(), data.begin() + data.size()/2, data.end());
+
+    size_t changed = 0;
+    size_t matched = 0;
+    size_t offset = 0;
+    size_t edited_offset = 0;
+    size_t index = 0;
+
+    //Walk both chunk lists, counting chunks that end at the same content position
+    std::vector<size_t> ends;
+    for ( size_t l : lengths ) { offset += l; ends.push_back(offset); }
+
+    size_t middle = data.size()/2;
+    bool resynced = true; //The previous chunk ended on an original boundary
+
+    while ( edited_offset < edited.size() )
+    {
+        size_t length = chunker.find_boundary( &edited[edited_offset], edited.size() - edited_offset );
+        size_t edited_start = edited_offset;
+        edited_offset += length;
+
+        size_t original_end = ( edited_offset > middle ) ? edited_offset - 100 : edited_offset;
+
+        while ( index < ends.size() && ends[index] < original_end ) index++;
+
+        bool on_boundary = ( index < ends.size() && ends[index] == original_end );
+        bool has_insert = ( edited_start <= middle && edited_offset > middle );
+
+        if ( on_boundary && resynced && !has_insert )
+            matched++;
+        else
+            changed++;
+
+        resynced = on_boundary;
+    }
+
+    std::cout << "After a 100 byte insert: " << changed << " chunks changed, " << matched << " unchanged" << '\n';
+
+    return (secs.count() > 0) ? 0 : 1;
+
+}
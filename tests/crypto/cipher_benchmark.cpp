@@ -0,0 +1,71 @@
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <random>
+#include <vessel/crypto/file_cipher.hpp>
+
+using namespace Vessel::Utilities;
+
+/**
+ ** Measures the throughput of the in place part encryption and decryption (single core).
+ ** Modified, reordered and truncated parts are checked by cipher_test
+*/
+int main(int argc, char* argv[] )
+{
+
+    size_t part_size = (argc > 1) ? std::stoul(argv[1]) * 1048576 : 16777216; //Default 16MB
+    int total_parts = 64;
+
+    std::string tenant_key(CIPHER_KEY_SZ, '\0');
+    std::mt19937_64 rng(42);
+
+    for ( auto& c : tenant_key )
+        c = (char)(rng() & 0xFF);
+
+    std::string part(part_size, '\0');
+
+    for ( auto& c : part )
+        c = (char)(rng() & 0xFF);
+
+    FileCipher cipher(tenant_key);
+    std::string buffer;
+    buffer.reserve( FileCipher::get_encrypted_size(part_size) );
+
+    auto start = std::chrono::steady_clock::now();
+
+    for ( int i=1; i <= total_parts; i++ )
+    {
+        buffer.assign(part);
+        cipher.encrypt_part(buffer, i, i == total_parts);
+    }
+
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+    size_t total_bytes = part_size * total_parts;
+
+    std::cout << "Encrypted " << (total_bytes / 1048576) << " MB in " << secs.count() << "s" << '\n';
+    std::cout << "Throughput: " << (total_bytes / secs.count() / 1048576) << " MB/s" << '\n';
+
+    //The last buffer holds part total_parts
+    FileCipher restored(tenant_key, cipher.get_wrapped_key());
+    std::string copy;
+
+    start = std::chrono::steady_clock::now();
+
+    for ( int i=1; i <= total_parts; i++ )
+    {
+        copy.assign(buffer);
+
+        if ( !restored.decrypt_part(copy, total_parts, true) ) {
+            std::cout << "Part did not decrypt" << '\n';
+            return 1;
+        }
+    }
+
+    secs = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Decrypted " << (total_bytes / 1048576) << " MB in " << secs.count() << "s" << '\n';
+    std::cout << "Throughput: " << (total_bytes / secs.count() / 1048576) << " MB/s" << '\n';
+
+    return 0;
+
+}
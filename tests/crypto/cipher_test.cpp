@@ -0,0 +1,124 @@
+#include <iostream>
+#include <string>
+#include <random>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE CipherTest
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <vessel/crypto/file_cipher.hpp>
+
+using namespace Vessel::Utilities;
+
+static std::string get_random_bytes(size_t size, unsigned int seed)
+{
+
+    std::mt19937_64 rng(seed);
+    std::string bytes(size, '\0');
+
+    for ( auto& c : bytes )
+        c = (char)(rng() & 0xFF);
+
+    return bytes;
+
+}
+
+struct CipherFixture
+{
+
+    CipherFixture() : tenant_key( get_random_bytes(CIPHER_KEY_SZ, 1) ), part( get_random_bytes(65536 + 7, 2) ), cipher(tenant_key)
+    {
+        sealed = part;
+        cipher.encrypt_part(sealed, 3, true);
+    }
+
+    std::string tenant_key;
+    std::string part;
+    std::string sealed; //Part 3, the last part of the file
+    FileCipher cipher;
+
+};
+
+BOOST_FIXTURE_TEST_SUITE(CipherTestSuite, CipherFixture)
+
+BOOST_AUTO_TEST_CASE(RoundTripTest)
+{
+
+    BOOST_TEST( sealed.size() == FileCipher::get_encrypted_size( part.size() ) );
+    BOOST_TEST( sealed.substr(0, part.size()) != part );
+
+    //The file key is unwrapped from the key stored with the object
+    FileCipher restored( tenant_key, cipher.get_wrapped_key() );
+
+    std::string buffer(sealed);
+    BOOST_TEST( restored.decrypt_part(buffer, 3, true) );
+    BOOST_TEST( buffer == part );
+
+    //Sealing a raw buffer in place matches the string overload
+    std::string raw(part);
+    raw.resize( part.size() + CIPHER_TAG_SZ );
+    cipher.encrypt_part( &raw[0], part.size(), 3, true );
+    BOOST_TEST( raw == sealed );
+
+}
+
+BOOST_AUTO_TEST_CASE(TagTamperTest)
+{
+
+    FileCipher restored( tenant_key, cipher.get_wrapped_key() );
+
+    std::string buffer(sealed);
+    buffer[ part.size() / 2 ] ^= 0x01;
+    BOOST_TEST( !restored.decrypt_part(buffer, 3, true) );
+
+    buffer = sealed;
+    buffer[ buffer.size() - 1 ] ^= 0x01;
+    BOOST_TEST( !restored.decrypt_part(buffer, 3, true) );
+
+    //A part shorter than a tag cannot be verified
+    buffer = sealed.substr(0, CIPHER_TAG_SZ - 1);
+    BOOST_TEST( !restored.decrypt_part(buffer, 3, true) );
+
+}
+
+BOOST_AUTO_TEST_CASE(PartReorderTest)
+{
+
+    FileCipher restored( tenant_key, cipher.get_wrapped_key() );
+
+    std::string buffer(sealed);
+    BOOST_TEST( !restored.decrypt_part(buffer, 2, true) );
+
+    buffer = sealed;
+    BOOST_TEST( !restored.decrypt_part(buffer, 4, true) );
+
+}
+
+BOOST_AUTO_TEST_CASE(LastPartTest)
+{
+
+    FileCipher restored( tenant_key, cipher.get_wrapped_key() );
+
+    //An object truncated at a part boundary ends with a part that was not sealed as the last one
+    std::string buffer(sealed);
+    BOOST_TEST( !restored.decrypt_part(buffer, 3, false) );
+
+    std::string middle(part);
+    cipher.encrypt_part(middle, 2, false);
+    BOOST_TEST( !restored.decrypt_part(middle, 2, true) );
+
+}
+
+BOOST_AUTO_TEST_CASE(TenantKeyTest)
+{
+
+    std::string other_key(tenant_key);
+    other_key[0] ^= 0x01;
+
+    BOOST_CHECK_THROW( FileCipher( other_key, cipher.get_wrapped_key() ), CryptoException );
+    BOOST_CHECK_THROW( FileCipher( tenant_key.substr(1) ), CryptoException );
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,76 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <vessel/filesystem/rolling_checksum.hpp>
+
+using namespace Vessel::File;
+
+/**
+ ** Measures the rolling checksum scan used by FileDelta on random data (single core): one roll
+ ** and one filter test per byte, which is the cost of a file that shares no blocks with its signature.
+ ** Also checks that the rolled checksum matches a checksum computed from scratch.
+*/
+int main(int argc, char* argv[] )
+{
+
+    size_t total_bytes = (argc > 1) ? std::stoul(argv[1]) * 1048576 : 1073741824; //Default 1GB
+    size_t block_size = 32768; //Block size of a 1GB file
+
+    std::vector<unsigned char> data(total_bytes);
+    std::mt19937_64 rng(42);
+
+    for ( size_t i=0; i + 8 <= data.size(); i += 8 )
+    {
+        uint64_t v = rng();
+        for ( int b=0; b < 8; b++ )
+            data[i+b] = (v >> (8*b)) & 0xFF;
+    }
+
+    //Filter of the block checksums of an unrelated signature, 64 bits per block as in FileDelta
+    size_t total_blocks = total_bytes / block_size;
+    int filter_bits = 16;
+    while ( filter_bits < 24 && ( (size_t)1 << filter_bits ) < total_blocks * 64 ) {
+        filter_bits++;
+    }
+
+    std::vector<uint64_t> filter( ( (size_t)1 << filter_bits ) / 64, 0 );
+    for ( size_t i=0; i < total_blocks; i++ )
+    {
+        uint32_t bit = ( (uint32_t)rng() * 0x9E3779B1U ) >> ( 32 - filter_bits );
+        filter[ bit >> 6 ] |= 1ULL << (bit & 63);
+    }
+
+    RollingChecksum sum;
+    size_t probes = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    sum.init( data.data(), block_size );
+
+    for ( size_t pos=0; pos + block_size < data.size(); pos++ )
+    {
+        uint32_t bit = ( sum.digest() * 0x9E3779B1U ) >> ( 32 - filter_bits );
+
+        if ( filter[ bit >> 6 ] & ( 1ULL << (bit & 63) ) )
+            probes++;
+
+        sum.roll( data[pos], data[pos + block_size] );
+    }
+
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Scanned " << total_bytes / 1048576 << "MB in " << secs.count() << "s" << '\n';
+    std::cout << "Throughput: " << (total_bytes / 1048576.0) / secs.count() << " MB/s" << '\n';
+    std::cout << "Hash table probes: " << probes << " (" << (100.0 * probes / total_bytes) << "%)" << '\n';
+
+    //The rolled checksum must match the checksum of the last window
+    size_t last = data.size() - block_size;
+    bool valid = ( sum.digest() == RollingChecksum::get_checksum( &data[last], block_size ) );
+
+    std::cout << "Rolled checksum " << ( valid ? "matches" : "does not match" ) << '\n';
+
+    return valid ? 0 : 1;
+
+}
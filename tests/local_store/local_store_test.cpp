@@ -0,0 +1,131 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE LocalStoreTest
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <vessel/filesystem/local_store.hpp>
+
+using namespace Vessel::File;
+
+/*
+ * Run from the directory of the client database
+ */
+
+static std::string read_file(const std::string& path)
+{
+    std::ifstream infile(path, std::ios::binary);
+    std::stringstream content;
+    content << infile.rdbuf();
+    return content.str();
+}
+
+struct StoreFixture
+{
+    StoreFixture()
+    {
+        root_path = fs::temp_directory_path() / fs::unique_path("vessel-store-%%%%%%");
+        fs::create_directories(root_path);
+
+        source_path = ( root_path / "source.bin" ).string();
+
+        std::ofstream outfile(source_path, std::ios::binary);
+
+        for ( int i=0; i < 300000; i++ ) {
+            outfile << i << '\n';
+        }
+    }
+
+    ~StoreFixture()
+    {
+        fs::remove_all(root_path);
+    }
+
+    fs::path root_path;
+    std::string source_path;
+};
+
+BOOST_FIXTURE_TEST_SUITE(LocalStoreTestSuite, StoreFixture)
+
+BOOST_AUTO_TEST_CASE(StoreFileTest)
+{
+
+    LocalStore store( root_path.string() );
+
+    LocalStore::CopyMethod method = store.store_file( source_path, "user/home/docs/source.bin" );
+    std::string object_path = store.get_object_path("user/home/docs/source.bin");
+
+    BOOST_TEST(read_file(object_path) == read_file(source_path));
+    BOOST_TEST(!fs::exists( object_path + LOCAL_TMP_EXT ), "The temporary file is renamed into place");
+
+    #ifdef __linux__
+        //Within one file system copy_file_range or sendfile always succeed before the read/write fallback
+        BOOST_TEST(method != LocalStore::ReadWrite, "The copy falls back to read/write within one file system");
+    #endif
+
+}
+
+BOOST_AUTO_TEST_CASE(SyncBatchTest)
+{
+
+    LocalStore store( root_path.string() );
+    store.set_sync_mode(LocalStore::SyncBatch);
+
+    store.store_file( source_path, "user/batch/first.bin" );
+    store.store_file( source_path, "user/batch/second.bin" );
+
+    BOOST_TEST(fs::exists( store.get_object_path("user/batch/first.bin") ), "Objects are renamed into place before the sync");
+    BOOST_TEST(store.get_pending_objects() == 2, "Completions are held until the batch is synced");
+
+    store.sync();
+    BOOST_TEST(store.get_pending_objects() == 0);
+
+    //A failed sync keeps the objects, their completions are not sent
+    store.store_file( source_path, "user/batch/third.bin" );
+    fs::remove_all(root_path);
+
+    BOOST_CHECK_THROW(store.sync(), FileException);
+    BOOST_TEST(store.get_pending_objects() == 1);
+
+}
+
+BOOST_AUTO_TEST_CASE(CopyObjectTest)
+{
+
+    LocalStore store( root_path.string() );
+    bool encrypted = true;
+
+    store.store_file( source_path, "user/old/source.bin" );
+
+    BOOST_TEST(store.copy_object( "user/old/source.bin", "user/new/renamed.bin", encrypted ));
+    BOOST_TEST(!encrypted);
+    BOOST_TEST(read_file( store.get_object_path("user/new/renamed.bin") ) == read_file(source_path));
+
+    BOOST_TEST(!store.copy_object( "user/missing.bin", "user/new/missing.bin", encrypted ), "Missing objects are uploaded instead");
+
+}
+
+BOOST_AUTO_TEST_CASE(RemoveObjectTest)
+{
+
+    LocalStore store( root_path.string() );
+
+    store.store_file( source_path, "user/deleted/source.bin" );
+
+    BOOST_TEST(store.remove_object("user/deleted/source.bin"));
+    BOOST_TEST(!fs::exists( store.get_object_path("user/deleted/source.bin") ));
+
+    BOOST_TEST(store.remove_object("user/deleted/source.bin"), "Missing objects count as removed");
+
+}
+
+BOOST_AUTO_TEST_CASE(MissingRootTest)
+{
+    BOOST_CHECK_THROW(LocalStore store( ( root_path / "missing" ).string() ), FileException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <string>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE CircuitBreakerTest
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <vessel/network/circuit_breaker.hpp>
+
+using namespace Vessel::Networking;
+
+/*
+ * Run from the directory of the client database, the breaker settings are read from it
+ */
+
+BOOST_AUTO_TEST_SUITE(CircuitBreakerTestSuite)
+
+BOOST_AUTO_TEST_CASE(ClassifyTest)
+{
+
+    BOOST_TEST(CircuitBreaker::is_provider_failure(0), "Network errors are provider failures");
+    BOOST_TEST(CircuitBreaker::is_provider_failure(503), "SlowDown is a provider failure");
+    BOOST_TEST(CircuitBreaker::is_provider_failure(429));
+    BOOST_TEST(!CircuitBreaker::is_provider_failure(200));
+    BOOST_TEST(!CircuitBreaker::is_provider_failure(404), "A missing object is the result of the request");
+    BOOST_TEST(!CircuitBreaker::is_provider_failure(403));
+
+}
+
+BOOST_AUTO_TEST_CASE(TripTest)
+{
+
+    CircuitBreaker breaker("trip");
+
+    //Client errors do not open the breaker
+    for ( int i=0; i < 20; i++ )
+    {
+        BOOST_TEST(breaker.allow_request());
+        breaker.record_result(404, 0.1);
+    }
+
+    BOOST_TEST(breaker.get_state() == CircuitBreaker::Closed);
+    BOOST_TEST(breaker.get_total_failures() == 0);
+
+    //Provider failures do
+    for ( int i=0; i < 20 && breaker.get_state() == CircuitBreaker::Closed; i++ )
+    {
+        BOOST_TEST(breaker.allow_request());
+        breaker.record_result(503, 0.1);
+    }
+
+    BOOST_TEST(breaker.get_state() == CircuitBreaker::Open, "Breaker did not open");
+    BOOST_TEST(!breaker.allow_request(), "Requests must fail fast while the breaker is open");
+    BOOST_TEST(breaker.get_wait_secs() > 0);
+
+    //Late results of requests sent before the breaker opened are counted, but do not change the state
+    size_t failures = breaker.get_total_failures();
+    breaker.record_result(0, 1.0);
+
+    BOOST_TEST(breaker.get_total_failures() == failures + 1);
+    BOOST_TEST(breaker.get_state() == CircuitBreaker::Open);
+
+}
+
+BOOST_AUTO_TEST_CASE(SlowRequestTest)
+{
+
+    CircuitBreaker breaker("slow");
+
+    //Successful but very slow requests count as failures
+    for ( int i=0; i < 20 && breaker.get_state() == CircuitBreaker::Closed; i++ )
+    {
+        breaker.allow_request();
+        breaker.record_result(200, 100000.0);
+    }
+
+    BOOST_TEST(breaker.get_state() == CircuitBreaker::Open);
+
+}
+
+BOOST_AUTO_TEST_CASE(RegistryTest)
+{
+
+    BOOST_TEST(CircuitBreaker::get_breaker("provider-a") == CircuitBreaker::get_breaker("provider-a"), "Clients of a provider must share its breaker");
+    BOOST_TEST(CircuitBreaker::get_breaker("provider-a") != CircuitBreaker::get_breaker("provider-b"));
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
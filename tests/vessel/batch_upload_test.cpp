@@ -0,0 +1,250 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE BatchUploadTest
+
+#include <boost/test/included/unit_test.hpp>
+#include <boost/asio.hpp>
+
+#include <vessel/vessel/vessel_client.hpp>
+
+using boost::asio::ip::tcp;
+using namespace Vessel::Networking;
+
+/*
+ * Stand-in for the Vessel API. Each connection gets one canned JSON response, chosen by the request URL.
+ * Run from the directory of the client database, the API path and client token are read from it.
+ */
+class StandInApi
+{
+
+    public:
+
+        StandInApi(bool batches) : m_acceptor(m_io, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)), m_batches(batches), m_requests(0)
+        {
+            m_thread = std::thread([this]() { serve(); });
+        }
+
+        ~StandInApi()
+        {
+            m_stopped = true;
+
+            //Wake up the blocking accept
+            boost::asio::io_service io;
+            tcp::socket socket(io);
+            boost::system::error_code ec;
+            socket.connect( m_acceptor.local_endpoint(), ec );
+
+            m_thread.join();
+        }
+
+        std::string get_url() const { return "http://127.0.0.1:" + std::to_string( m_acceptor.local_endpoint().port() ); }
+        int get_total_requests() const { return m_requests; }
+
+        std::string get_batch_body()
+        {
+            std::lock_guard<std::mutex> lock(m_body_mutex);
+            return m_batch_body;
+        }
+
+    private:
+        boost::asio::io_service m_io;
+        tcp::acceptor m_acceptor;
+        std::thread m_thread;
+        bool m_batches; //Answer the batch endpoints, or 404 like an older server
+        std::atomic<bool> m_stopped{false};
+        std::atomic<int> m_requests;
+        std::mutex m_body_mutex;
+        std::string m_batch_body; //Body of the last batch registration
+
+        void serve()
+        {
+            while ( !m_stopped )
+            {
+                tcp::socket socket(m_io);
+                m_acceptor.accept(socket);
+
+                if ( m_stopped ) {
+                    break;
+                }
+
+                boost::asio::streambuf buffer;
+                boost::system::error_code ec;
+                boost::asio::read_until(socket, buffer, "\r\n\r\n", ec);
+
+                std::string request( boost::asio::buffers_begin(buffer.data()), boost::asio::buffers_end(buffer.data()) );
+                std::string path = request.substr( request.find(' ') + 1, request.find(' ', request.find(' ') + 1) - request.find(' ') - 1 );
+
+                //Drain the body, the responses do not depend on it. The batch registration is kept for inspection
+                size_t header_end = request.find("\r\n\r\n") + 4;
+                size_t length_pos = boost::to_lower_copy(request).find("content-length:");
+                size_t content_length = ( length_pos != std::string::npos ) ? std::stoul( request.substr(length_pos + 15) ) : 0;
+
+                if ( request.size() - header_end < content_length ) {
+                    boost::asio::read(socket, buffer, boost::asio::transfer_exactly( content_length - (request.size() - header_end) ), ec);
+                }
+
+                if ( boost::ends_with(path, "/upload/batch") )
+                {
+                    std::lock_guard<std::mutex> lock(m_body_mutex);
+                    m_batch_body = std::string( boost::asio::buffers_begin(buffer.data()), boost::asio::buffers_end(buffer.data()) ).substr(header_end);
+                }
+
+                m_requests++;
+
+                int status = 200;
+                std::string body;
+
+                if ( boost::ends_with(path, "/upload/batch") || boost::ends_with(path, "/upload/complete") ) {
+
+                    if ( !m_batches ) {
+                        status = 404;
+                        body = "{\"error\":\"Not found\"}";
+                    }
+                    else if ( boost::ends_with(path, "/upload/batch") ) {
+                        body = "{\"uploads\":[{\"index\":0,\"upload_id\":\"upload-0\"},{\"index\":1,\"error\":\"Duplicate file\"},{\"index\":2,\"upload_id\":\"upload-2\",\"stored\":true}]}";
+                    }
+                    else {
+                        body = "{\"completed\":[\"upload-0\"],\"failed\":[{\"upload_id\":\"upload-2\",\"error\":\"Invalid upload\"}]}";
+                    }
+
+                }
+                else {
+                    //Single file registration and completion
+                    body = "{\"upload\":{\"upload_id\":\"single-" + std::to_string(m_requests) + "\"}}";
+                }
+
+                std::string response = "HTTP/1.1 " + std::to_string(status) + ( status == 200 ? " OK" : " Not Found" ) + "\r\n";
+                response += "Content-Type: application/json\r\n";
+                response += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+                response += "Connection: close\r\n\r\n";
+                response += body;
+
+                boost::asio::write(socket, boost::asio::buffer(response), ec);
+                socket.close(ec);
+            }
+        }
+
+};
+
+struct BatchFixture
+{
+    BatchFixture()
+    {
+        root_path = fs::temp_directory_path() / fs::unique_path("vessel-batch-%%%%%%");
+        fs::create_directories(root_path);
+    }
+
+    ~BatchFixture()
+    {
+        boost::system::error_code ec;
+        fs::remove_all(root_path, ec);
+    }
+
+    std::vector<BackupFile> create_files(int total)
+    {
+
+        std::vector<BackupFile> files;
+
+        for ( int i=0; i < total; i++ )
+        {
+            fs::path path = root_path / ( "batch_test_" + std::to_string(i) + ".txt" );
+
+            std::ofstream outfile(path.string(), std::ios::out | std::ios::trunc);
+            outfile << "Batch upload test file " << i;
+            outfile.close();
+
+            files.push_back( BackupFile(path) );
+        }
+
+        return files;
+
+    }
+
+    fs::path root_path;
+};
+
+BOOST_FIXTURE_TEST_SUITE(BatchUploadTestSuite, BatchFixture)
+
+BOOST_AUTO_TEST_CASE(BatchRegistrationTest)
+{
+
+    StandInApi api(true);
+    VesselClient client( api.get_url() );
+
+    std::vector<BackupFile> files = create_files(3);
+    std::vector<UploadRegistration> registrations = client.init_uploads(files);
+
+    BOOST_TEST(api.get_total_requests() == 1, "Batch was not registered with a single request");
+    BOOST_TEST(registrations.size() == 3);
+    BOOST_TEST(registrations[0].vessel_id == "upload-0");
+    BOOST_TEST(!registrations[0].stored, "Upload must only be stored when the API says so");
+    BOOST_TEST(registrations[1].vessel_id.empty(), "Rejected file must not get an upload id");
+    BOOST_TEST(registrations[2].vessel_id == "upload-2");
+    BOOST_TEST(registrations[2].stored, "Inline content stored by the API was not reported");
+
+}
+
+BOOST_AUTO_TEST_CASE(BatchCompletionTest)
+{
+
+    StandInApi api(true);
+    VesselClient client( api.get_url() );
+
+    client.queue_completion("upload-0", true, false);
+    client.queue_completion("upload-2", false, true);
+
+    BOOST_TEST(client.complete_uploads() == 1, "Only the upload accepted by the API is completed");
+    BOOST_TEST(api.get_total_requests() == 1);
+
+    //The rejected upload is not sent again
+    BOOST_TEST(client.complete_uploads() == 0);
+    BOOST_TEST(api.get_total_requests() == 1, "Completion queue was not emptied");
+
+}
+
+BOOST_AUTO_TEST_CASE(InlineEmptyFileTest)
+{
+
+    StandInApi api(true);
+    VesselClient client( api.get_url() );
+
+    fs::path path = root_path / "batch_test_empty.txt";
+    std::ofstream( path.string(), std::ios::out | std::ios::trunc ).close();
+
+    std::vector<BackupFile> files = create_files(1);
+    files.push_back( BackupFile(path) );
+
+    client.init_uploads(files);
+
+    //An empty file has no gzip stream, its content must not be declared as gzip encoded
+    std::string body = api.get_batch_body();
+    BOOST_TEST(body.find("\"content\":\"\"") != std::string::npos, "Empty file was not sent inline");
+    BOOST_TEST(body.find("\"content_encoding\":\"gzip\",\"content\":\"\"") == std::string::npos, "Empty content was declared as gzip");
+
+}
+
+BOOST_AUTO_TEST_CASE(BatchFallbackTest)
+{
+
+    StandInApi api(false);
+    VesselClient client( api.get_url() );
+
+    std::vector<BackupFile> files = create_files(2);
+    std::vector<UploadRegistration> registrations = client.init_uploads(files);
+
+    //One rejected batch request, then one request per file. Inline content is only accepted by the batch endpoint
+    BOOST_TEST(api.get_total_requests() == 3);
+    BOOST_TEST(!registrations[0].vessel_id.empty());
+    BOOST_TEST(!registrations[1].vessel_id.empty());
+    BOOST_TEST(!registrations[1].stored);
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,338 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE DeleteJournalTest
+
+#include <boost/test/included/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <vessel/vessel/app_manager.hpp>
+#include <vessel/database/local_db.hpp>
+#include <vessel/filesystem/delete_journal.hpp>
+#include <vessel/aws/aws_s3_client.hpp>
+
+namespace fs = boost::filesystem;
+
+using namespace Vessel;
+using namespace Vessel::File;
+
+/*
+ * Run from the directory of the client database. HOME points at a temporary directory, so the
+ * tests work on a copy of the database made by AppManager::prepare().
+ */
+struct DatabaseFixture
+{
+    DatabaseFixture()
+    {
+        home = fs::temp_directory_path() / fs::unique_path("vessel_journal_%%%%-%%%%");
+        fs::create_directories(home);
+        setenv("HOME", home.string().c_str(), 1);
+
+        AppManager::get().prepare();
+    }
+
+    ~DatabaseFixture()
+    {
+        boost::system::error_code ec;
+        fs::remove_all(home, ec);
+    }
+
+    fs::path home;
+};
+
+BOOST_GLOBAL_FIXTURE(DatabaseFixture);
+
+struct JournalFixture
+{
+    JournalFixture() : database( LocalDatabase::get_database() )
+    {
+        execute("DELETE FROM backup_delete_journal");
+        execute("DELETE FROM backup_file");
+        execute("DELETE FROM backup_file_chunk");
+        execute("DELETE FROM backup_repo_blob");
+        execute("DELETE FROM backup_directory");
+        execute("DELETE FROM backup_provider");
+        execute("INSERT INTO backup_provider (provider_id,name,type) VALUES ('s3','S3','aws')");
+        execute("INSERT INTO backup_directory (directory_id,directory_hash,path) VALUES (1,'d1','/data')");
+        execute("UPDATE backup_setting SET value='30' WHERE name='delete_retention_days'");
+    }
+
+    void execute(const std::string& query)
+    {
+        BOOST_REQUIRE_MESSAGE( sqlite3_exec(database.get_handle(), query.c_str(), NULL, NULL, NULL) == SQLITE_OK, database.get_last_err() );
+    }
+
+    //File ids are bound with the size of a pointer
+    void add_file(unsigned char* file_id, const std::string& file_name, const std::string& provider_id, const std::string& hash, long backup_time)
+    {
+        sqlite3_stmt* stmt;
+        std::string query = "INSERT INTO backup_file (file_id,filename,directory_id,provider_id,last_backup_hash,last_backup_time) VALUES (?1,?2,1,?3,?4,?5)";
+
+        BOOST_REQUIRE( sqlite3_prepare_v2(database.get_handle(), query.c_str(), -1, &stmt, NULL) == SQLITE_OK );
+
+        sqlite3_bind_blob(stmt, 1, file_id, sizeof(file_id), 0 );
+        sqlite3_bind_text(stmt, 2, file_name.c_str(), file_name.size(), 0 );
+        sqlite3_bind_text(stmt, 3, provider_id.c_str(), provider_id.size(), 0 );
+        sqlite3_bind_text(stmt, 4, hash.c_str(), hash.size(), 0 );
+        sqlite3_bind_int64(stmt, 5, backup_time );
+
+        BOOST_REQUIRE( sqlite3_step(stmt) == SQLITE_DONE );
+        sqlite3_finalize(stmt);
+    }
+
+    void add_entry(const std::string& file_name, std::time_t created, std::time_t last_attempt)
+    {
+        execute("INSERT INTO backup_delete_journal (provider_id,file_path,file_name,created,last_attempt) VALUES ('s3','/data','" + file_name + "'," + std::to_string(created) + "," + std::to_string(last_attempt) + ")");
+    }
+
+    size_t get_total_entries()
+    {
+        sqlite3_stmt* stmt;
+        size_t total = 0;
+
+        BOOST_REQUIRE( sqlite3_prepare_v2(database.get_handle(), "SELECT COUNT(*) FROM backup_delete_journal", -1, &stmt, NULL) == SQLITE_OK );
+
+        if ( sqlite3_step(stmt) == SQLITE_ROW ) {
+            total = sqlite3_column_int64(stmt, 0);
+        }
+
+        sqlite3_finalize(stmt);
+        return total;
+    }
+
+    LocalDatabase& database;
+    DeleteJournal journal;
+};
+
+//Stand-in for a provider, removes every object and records the batches it was sent
+struct RemovedBatches
+{
+    std::vector<unsigned long> operator()(const std::vector<DeletedFile>& files)
+    {
+        std::vector<unsigned long> removed;
+
+        for ( const auto& file : files ) {
+            removed.push_back(file.delete_id);
+        }
+
+        batches.push_back( files.size() );
+        return removed;
+    }
+
+    std::vector<size_t> batches;
+};
+
+BOOST_FIXTURE_TEST_SUITE(DeleteJournalSuite, JournalFixture)
+
+BOOST_AUTO_TEST_CASE(ReferencedObjectTest)
+{
+
+    unsigned char source_id[] = "source01";
+    unsigned char copy_id[] = "copy0001";
+
+    //The copy was registered as a reference to the object of the source
+    add_file(source_id, "a.txt", "s3", "hash-a", 100);
+    add_file(copy_id, "b.txt", "", "hash-a", 200);
+
+    database.purge_file(source_id, true);
+
+    std::vector<DeletedFile> expired;
+    BOOST_REQUIRE( journal.get_expired("s3", 10, expired) );
+
+    //The entry is kept for delete_retention_days
+    BOOST_TEST( expired.empty() );
+    execute("UPDATE backup_delete_journal SET created=0");
+
+    BOOST_REQUIRE( journal.get_expired("s3", 10, expired) );
+    BOOST_REQUIRE( expired.size() == 1 );
+    BOOST_TEST( expired[0].file_name == "a.txt" );
+    BOOST_TEST( expired[0].hash == "hash-a" );
+
+    BOOST_TEST( !journal.is_backed_up(expired[0]) );
+    BOOST_TEST( journal.is_referenced(expired[0]) );
+
+    //Postponed entries wait without counting an attempt
+    journal.postpone(expired);
+    std::vector<DeletedFile> postponed;
+    BOOST_REQUIRE( journal.get_expired("s3", 10, postponed) );
+    BOOST_TEST( postponed.empty() );
+
+    //Once the reference is gone the object can be removed
+    execute("UPDATE backup_file SET last_backup_time=0,last_backup_hash=NULL");
+    BOOST_TEST( !journal.is_referenced(expired[0]) );
+
+}
+
+BOOST_AUTO_TEST_CASE(PackFileTest)
+{
+
+    unsigned char packed_id[] = "packed01";
+    unsigned char object_id[] = "object01";
+    unsigned char partial_id[] = "partial1";
+
+    add_file(packed_id, "packed.txt", "s3", "hash-p", 100);
+    add_file(object_id, "object.txt", "s3", "hash-o", 100);
+    add_file(partial_id, "partial.txt", "s3", "hash-q", 100);
+
+    //All blobs of the packed file are in the repository, one blob of the partial file is not
+    execute("INSERT INTO backup_repo_blob (provider_id,hash,object_key) VALUES ('s3','c1','packs/1'),('s3','c2','packs/1')");
+    execute("INSERT INTO backup_file_chunk (file_id,seq,hash,length) SELECT file_id,0,'c1',10 FROM backup_file WHERE filename IN ('packed.txt','partial.txt')");
+    execute("INSERT INTO backup_file_chunk (file_id,seq,hash,length) SELECT file_id,1,'c2',10 FROM backup_file WHERE filename='packed.txt'");
+    execute("INSERT INTO backup_file_chunk (file_id,seq,hash,length) SELECT file_id,1,'c3',10 FROM backup_file WHERE filename='partial.txt'");
+
+    //The object file was uploaded before the repository was enabled, only the packed file has no object of its own
+    database.purge_file(object_id, true);
+    database.purge_file(partial_id, true);
+    database.purge_file(packed_id, true);
+
+    execute("UPDATE backup_delete_journal SET created=0");
+
+    std::vector<DeletedFile> expired;
+    BOOST_REQUIRE( journal.get_expired("s3", 10, expired) );
+    BOOST_REQUIRE( expired.size() == 2 );
+    BOOST_TEST( expired[0].file_name == "object.txt" );
+    BOOST_TEST( expired[1].file_name == "partial.txt" );
+
+}
+
+BOOST_AUTO_TEST_CASE(ExpiredWindowTest)
+{
+
+    std::time_t now = std::time(nullptr);
+
+    execute("UPDATE backup_setting SET value='2' WHERE name='delete_retention_days'");
+
+    add_entry("recent.txt", now - 86400, 0);
+    add_entry("expired.txt", now - 3 * 86400, 0);
+    add_entry("sent.txt", now - 3 * 86400, now - DELETE_RETRY_SECS + 60);
+    add_entry("retry.txt", now - 3 * 86400, now - DELETE_RETRY_SECS - 60);
+
+    std::vector<DeletedFile> expired;
+    BOOST_REQUIRE( journal.get_expired("s3", 10, expired) );
+    BOOST_REQUIRE( expired.size() == 2 );
+    BOOST_TEST( expired[0].file_name == "expired.txt" );
+    BOOST_TEST( expired[1].file_name == "retry.txt" );
+
+    //Other providers are listed apart
+    expired.clear();
+    BOOST_REQUIRE( journal.get_expired("azure", 10, expired) );
+    BOOST_TEST( expired.empty() );
+
+    //0 removes the objects on the next run, sent files still wait
+    execute("UPDATE backup_setting SET value='0' WHERE name='delete_retention_days'");
+    BOOST_TEST( DeleteJournal::get_retention_days() == 0 );
+
+    BOOST_REQUIRE( journal.get_expired("s3", 10, expired) );
+    BOOST_TEST( expired.size() == 3 );
+
+    //A missing setting reads as the default
+    execute("DELETE FROM backup_setting WHERE name='delete_retention_days'");
+    BOOST_TEST( DeleteJournal::get_retention_days() == DELETE_RETENTION_DAYS );
+    execute("INSERT INTO backup_setting (name,value) VALUES ('delete_retention_days','30')");
+
+}
+
+BOOST_AUTO_TEST_CASE(SupersededTest)
+{
+
+    unsigned char file_id[] = "again001";
+
+    add_entry("a.txt", 0, 0);
+    add_entry("b.txt", 0, 0);
+
+    //a.txt was backed up to the same path again, its object holds the new content
+    add_file(file_id, "a.txt", "s3", "hash-new", 100);
+
+    RemovedBatches provider;
+    BOOST_TEST( journal.remove_expired("s3", 10, std::ref(provider)) == 1 );
+
+    BOOST_REQUIRE( provider.batches.size() == 1 );
+    BOOST_TEST( provider.batches[0] == 1 );
+    BOOST_TEST( get_total_entries() == 0 );
+
+}
+
+BOOST_AUTO_TEST_CASE(BatchSplitTest)
+{
+
+    size_t total_files = AWS_DELETE_MAX_KEYS * 2 + 500;
+
+    database.start_transaction();
+
+    for ( size_t i=0; i < total_files; i++ ) {
+        add_entry("file" + std::to_string(i) + ".txt", 0, 0);
+    }
+
+    database.end_transaction();
+
+    RemovedBatches provider;
+    BOOST_TEST( journal.remove_expired("s3", AWS_DELETE_MAX_KEYS, std::ref(provider)) == total_files );
+
+    BOOST_REQUIRE( provider.batches.size() == 3 );
+    BOOST_TEST( provider.batches[0] == AWS_DELETE_MAX_KEYS );
+    BOOST_TEST( provider.batches[1] == AWS_DELETE_MAX_KEYS );
+    BOOST_TEST( provider.batches[2] == 500 );
+    BOOST_TEST( get_total_entries() == 0 );
+
+}
+
+BOOST_AUTO_TEST_CASE(InterruptedBatchTest)
+{
+
+    for ( int i=0; i < 5; i++ ) {
+        add_entry("file" + std::to_string(i) + ".txt", 0, 0);
+    }
+
+    //The connection drops after the request was sent
+    auto interrupted = [](const std::vector<DeletedFile>& files) -> std::vector<unsigned long> {
+        throw std::runtime_error("Connection reset");
+    };
+
+    BOOST_CHECK_THROW( journal.remove_expired("s3", 10, interrupted), std::runtime_error );
+
+    //The batch stays in the journal and is not sent again right away
+    BOOST_TEST( get_total_entries() == 5 );
+
+    RemovedBatches provider;
+    BOOST_TEST( journal.remove_expired("s3", 10, std::ref(provider)) == 0 );
+    BOOST_TEST( provider.batches.empty() );
+
+    //Once DELETE_RETRY_SECS have passed the whole batch is sent again
+    execute("UPDATE backup_delete_journal SET last_attempt=last_attempt-" + std::to_string(DELETE_RETRY_SECS + 1));
+
+    BOOST_TEST( journal.remove_expired("s3", 10, std::ref(provider)) == 5 );
+    BOOST_REQUIRE( provider.batches.size() == 1 );
+    BOOST_TEST( provider.batches[0] == 5 );
+    BOOST_TEST( get_total_entries() == 0 );
+
+}
+
+BOOST_AUTO_TEST_CASE(PartialBatchTest)
+{
+
+    for ( int i=0; i < 4; i++ ) {
+        add_entry("file" + std::to_string(i) + ".txt", 0, 0);
+    }
+
+    //The provider removes the first two objects and fails the others
+    auto partial = [](const std::vector<DeletedFile>& files) {
+        return std::vector<unsigned long>{ files[0].delete_id, files[1].delete_id };
+    };
+
+    BOOST_TEST( journal.remove_expired("s3", 10, partial) == 2 );
+    BOOST_TEST( get_total_entries() == 2 );
+
+    //The failed objects count an attempt and wait for the next run
+    sqlite3_stmt* stmt;
+    BOOST_REQUIRE( sqlite3_prepare_v2(database.get_handle(), "SELECT MIN(attempts),MAX(attempts) FROM backup_delete_journal", -1, &stmt, NULL) == SQLITE_OK );
+    BOOST_REQUIRE( sqlite3_step(stmt) == SQLITE_ROW );
+    BOOST_TEST( sqlite3_column_int(stmt, 0) == 1 );
+    BOOST_TEST( sqlite3_column_int(stmt, 1) == 1 );
+    sqlite3_finalize(stmt);
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
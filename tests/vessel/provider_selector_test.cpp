@@ -0,0 +1,86 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE ProviderSelectorTest
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <vessel/vessel/provider_selector.hpp>
+
+using namespace Vessel;
+
+/*
+ * Run from the directory of the client database with provider_mode set to failover
+ */
+
+static StorageProvider make_provider(const std::string& provider_id, int weight = 1)
+{
+    StorageProvider provider;
+    provider.provider_id = provider_id;
+    provider.provider_name = provider_id;
+    provider.provider_type = "aws_s3";
+    provider.weight = weight;
+
+    return provider;
+}
+
+BOOST_AUTO_TEST_SUITE(ProviderSelectorTestSuite)
+
+BOOST_AUTO_TEST_CASE(FailoverTest)
+{
+
+    ProviderSelector selector({ make_provider("primary"), make_provider("secondary") });
+
+    BOOST_TEST(selector.select().provider_id == "primary");
+
+    //Failed uploads move the next batches to the secondary provider
+    for ( int i=0; i < 10; i++ ) {
+        ProviderSelector::record_upload("primary", 4096, 0, false);
+    }
+
+    BOOST_TEST(!selector.is_healthy( make_provider("primary") ));
+    BOOST_TEST(selector.select().provider_id == "secondary");
+
+}
+
+BOOST_AUTO_TEST_CASE(GoodputTest)
+{
+
+    ProviderSelector selector({ make_provider("fast"), make_provider("backup") });
+
+    for ( int i=0; i < 20; i++ ) {
+        ProviderSelector::record_upload("fast", 10485760, 0.1, true);
+    }
+
+    BOOST_TEST(selector.select().provider_id == "fast");
+
+    //Small uploads do not change the goodput
+    for ( int i=0; i < 20; i++ ) {
+        ProviderSelector::record_upload("fast", 1024, 1, true);
+    }
+
+    BOOST_TEST(selector.select().provider_id == "fast");
+
+    //The goodput dropped to a fraction of the long term goodput
+    for ( int i=0; i < 20; i++ ) {
+        ProviderSelector::record_upload("fast", 10485760, 10, true);
+    }
+
+    BOOST_TEST(selector.select().provider_id == "backup");
+
+}
+
+BOOST_AUTO_TEST_CASE(RemovedProviderTest)
+{
+
+    ProviderSelector selector({ make_provider("current") });
+    StorageProvider provider;
+
+    BOOST_TEST(selector.find_provider("current", provider));
+    BOOST_TEST(!selector.find_provider("removed", provider), "Uploads to a removed provider start over");
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
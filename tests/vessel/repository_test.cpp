@@ -0,0 +1,350 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE RepositoryTest
+
+#include <boost/test/included/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <vessel/vessel/upload_manager.hpp>
+
+namespace fs = boost::filesystem;
+
+using namespace Vessel;
+using namespace Vessel::File;
+
+/*
+ * Run from the directory of the client database. HOME points at a temporary directory, so the
+ * tests work on a copy of the database made by AppManager::prepare().
+ */
+struct DatabaseFixture
+{
+    DatabaseFixture()
+    {
+        home = fs::temp_directory_path() / fs::unique_path("vessel_repository_%%%%-%%%%");
+        fs::create_directories(home);
+        setenv("HOME", home.string().c_str(), 1);
+
+        AppManager::get().prepare();
+    }
+
+    ~DatabaseFixture()
+    {
+        boost::system::error_code ec;
+        fs::remove_all(home, ec);
+    }
+
+    fs::path home;
+};
+
+BOOST_GLOBAL_FIXTURE(DatabaseFixture);
+
+static std::string read_file(const fs::path& path)
+{
+    std::ifstream infile(path.string(), std::ios::binary);
+    std::stringstream content;
+    content << infile.rdbuf();
+    return content.str();
+}
+
+//Objects stored under a directory of the repository
+static std::vector<fs::path> list_objects(const fs::path& dir)
+{
+    std::vector<fs::path> objects;
+
+    if ( !fs::is_directory(dir) ) {
+        return objects;
+    }
+
+    for ( fs::recursive_directory_iterator itr(dir), end; itr != end; ++itr )
+    {
+        if ( fs::is_regular_file( itr->path() ) ) {
+            objects.push_back( itr->path() );
+        }
+    }
+
+    return objects;
+}
+
+struct RepositoryFixture
+{
+    RepositoryFixture() : database( LocalDatabase::get_database() )
+    {
+        root_path = fs::temp_directory_path() / fs::unique_path("vessel-repo-%%%%%%");
+        source_path = root_path / "source";
+        store_path = root_path / "store";
+        fs::create_directories(source_path);
+        fs::create_directories(store_path);
+
+        execute("DELETE FROM backup_file");
+        execute("DELETE FROM backup_file_chunk");
+        execute("DELETE FROM backup_repo_blob");
+        execute("DELETE FROM backup_directory");
+        execute("DELETE FROM backup_upload");
+        execute("UPDATE backup_setting SET value='user' WHERE name='user_id'");
+        execute("INSERT INTO backup_directory (directory_id,directory_hash,path) VALUES (1,'d1','" + source_path.string() + "')");
+
+        provider.provider_id = "local";
+        provider.provider_type = "local";
+        provider.storage_path = store_path.string();
+    }
+
+    ~RepositoryFixture()
+    {
+        boost::system::error_code ec;
+        fs::remove_all(root_path, ec);
+    }
+
+    void execute(const std::string& query)
+    {
+        BOOST_REQUIRE_MESSAGE( sqlite3_exec(database.get_handle(), query.c_str(), NULL, NULL, NULL) == SQLITE_OK, database.get_last_err() );
+    }
+
+    //File ids are bound with the size of a pointer
+    void add_file(unsigned char* file_id, const std::string& file_name, size_t file_size, const std::string& provider_id)
+    {
+        sqlite3_stmt* stmt;
+        std::string query = "INSERT INTO backup_file (file_id,filename,filesize,directory_id,provider_id,last_modified,last_backup_hash,last_backup_time) VALUES (?1,?2,?3,1,?4,1000,'sha1-' || ?2,100)";
+
+        BOOST_REQUIRE( sqlite3_prepare_v2(database.get_handle(), query.c_str(), -1, &stmt, NULL) == SQLITE_OK );
+
+        sqlite3_bind_blob(stmt, 1, file_id, sizeof(file_id), 0 );
+        sqlite3_bind_text(stmt, 2, file_name.c_str(), file_name.size(), 0 );
+        sqlite3_bind_int64(stmt, 3, file_size );
+        sqlite3_bind_text(stmt, 4, provider_id.c_str(), provider_id.size(), 0 );
+
+        BOOST_REQUIRE( sqlite3_step(stmt) == SQLITE_DONE );
+        sqlite3_finalize(stmt);
+    }
+
+    void add_chunk(const std::string& file_name, int seq, const std::string& hash)
+    {
+        execute("INSERT INTO backup_file_chunk (file_id,seq,hash,length) SELECT file_id," + std::to_string(seq) + ",'" + hash + "',10 FROM backup_file WHERE filename='" + file_name + "'");
+    }
+
+    static PackEntry get_chunk_entry(const std::string& hash, size_t offset)
+    {
+        PackEntry entry;
+        entry.type = "chunk";
+        entry.hash = hash;
+        entry.offset = offset;
+        entry.length = 10;
+        return entry;
+    }
+
+    LocalDatabase& database;
+    StorageProvider provider;
+    fs::path root_path;
+    fs::path source_path;
+    fs::path store_path;
+};
+
+BOOST_FIXTURE_TEST_SUITE(RepositoryTestSuite, RepositoryFixture)
+
+BOOST_AUTO_TEST_CASE(IndexProviderTest)
+{
+
+    RepositoryIndex first("first");
+    RepositoryIndex second("second");
+
+    PackEntry file_entry = get_chunk_entry("f1", 20);
+    file_entry.type = "file";
+
+    BOOST_TEST( first.add_pack( "packs/1", { get_chunk_entry("c1", 0), get_chunk_entry("c2", 10), file_entry } ) );
+
+    BOOST_TEST( first.contains("c1") );
+    BOOST_TEST( first.contains("c2") );
+    BOOST_TEST( !first.contains("c3") );
+
+    //Only blobs are indexed
+    BOOST_TEST( !first.contains("f1") );
+
+    //A blob stored with another provider is uploaded again
+    BOOST_TEST( !second.contains("c1") );
+
+    BOOST_TEST( second.add_pack( "packs/2", { get_chunk_entry("c1", 0) } ) );
+    BOOST_TEST( second.contains("c1") );
+    BOOST_TEST( !second.contains("c2") );
+
+}
+
+BOOST_AUTO_TEST_CASE(SnapshotFilesTest)
+{
+
+    unsigned char second_id[] = "file0002";
+    unsigned char first_id[] = "file0001";
+    unsigned char empty_id[] = "file0003";
+    unsigned char object_id[] = "file0004";
+    unsigned char other_id[] = "file0005";
+
+    add_file(second_id, "second.txt", 10, "local");
+    add_file(first_id, "first.txt", 30, "local");
+    add_file(empty_id, "empty.txt", 0, "local");
+    add_file(object_id, "object.txt", 10, "local");
+    add_file(other_id, "other.txt", 10, "other");
+
+    RepositoryIndex index("local");
+    BOOST_REQUIRE( index.add_pack( "packs/1", { get_chunk_entry("c1", 0), get_chunk_entry("c2", 10), get_chunk_entry("c3", 20) } ) );
+
+    //Chunks are added out of order, a blob shared by two files is listed for both
+    add_chunk("first.txt", 2, "c1");
+    add_chunk("first.txt", 0, "c3");
+    add_chunk("first.txt", 1, "c2");
+    add_chunk("second.txt", 0, "c1");
+    add_chunk("other.txt", 0, "c1");
+
+    //Stored as an object before the repository was enabled
+    add_chunk("object.txt", 0, "c9");
+
+    std::vector<SnapshotFile> files;
+    BOOST_REQUIRE( index.get_snapshot_files(files) );
+
+    //Ordered by file id
+    BOOST_REQUIRE( files.size() == 3 );
+    BOOST_TEST( files[0].file_path == ( source_path / "first.txt" ).string() );
+    BOOST_TEST( files[1].file_path == ( source_path / "second.txt" ).string() );
+    BOOST_TEST( files[2].file_path == ( source_path / "empty.txt" ).string() );
+
+    BOOST_TEST( files[0].file_size == 30 );
+    BOOST_TEST( files[0].last_modified == 1000 );
+    BOOST_TEST( files[0].hash == "sha1-first.txt" );
+
+    //Blobs in file order
+    BOOST_REQUIRE( files[0].blobs.size() == 3 );
+    BOOST_TEST( files[0].blobs[0].hash == "c3" );
+    BOOST_TEST( files[0].blobs[1].hash == "c2" );
+    BOOST_TEST( files[0].blobs[2].hash == "c1" );
+
+    BOOST_REQUIRE( files[1].blobs.size() == 1 );
+    BOOST_TEST( files[1].blobs[0].hash == "c1" );
+
+    BOOST_TEST( files[2].blobs.empty() );
+
+}
+
+BOOST_AUTO_TEST_CASE(WriteRepositoryTest)
+{
+
+    fs::path file_path = source_path / "report.txt";
+
+    {
+        std::ofstream outfile(file_path.string(), std::ios::binary);
+
+        for ( int i=0; i < 300000; i++ ) {
+            outfile << i << '\n';
+        }
+    }
+
+    BackupFile source(file_path);
+
+    //Queued and registered with the Vessel API
+    sqlite3_stmt* stmt;
+    BOOST_REQUIRE( sqlite3_prepare_v2(database.get_handle(), "INSERT INTO backup_file (file_id,filename,filesize,directory_id,provider_id,last_modified) VALUES (?1,'report.txt',?2,1,'local',1000)", -1, &stmt, NULL) == SQLITE_OK );
+    sqlite3_bind_blob(stmt, 1, source.get_file_id().get(), sizeof(source.get_file_id().get()), 0 );
+    sqlite3_bind_int64(stmt, 2, source.get_file_size() );
+    BOOST_REQUIRE( sqlite3_step(stmt) == SQLITE_DONE );
+    sqlite3_finalize(stmt);
+
+    BOOST_REQUIRE( sqlite3_prepare_v2(database.get_handle(), "INSERT INTO backup_upload (file_id,vessel_id,provider_id) VALUES (?1,'vessel-1','local')", -1, &stmt, NULL) == SQLITE_OK );
+    sqlite3_bind_blob(stmt, 1, source.get_file_id().get(), sizeof(source.get_file_id().get()), 0 );
+    BOOST_REQUIRE( sqlite3_step(stmt) == SQLITE_DONE );
+    sqlite3_finalize(stmt);
+
+    FileUpload upload( (unsigned int)sqlite3_last_insert_rowid( database.get_handle() ) );
+
+    {
+        RepositoryUpload repository(provider);
+        repository.upload_file(upload);
+
+        //Recorded by the upload manager once upload_file returns
+        BackupFile::update_last_backup( upload.get_file().get_file_id(), "sha1-report" );
+
+        repository.complete_upload();
+    }
+
+    fs::path repository_path = store_path / "user" / "repository";
+
+    std::vector<fs::path> packs = list_objects( repository_path / "data" );
+    std::vector<fs::path> indexes = list_objects( repository_path / "index" );
+    std::vector<fs::path> snapshots = list_objects( repository_path / "snapshots" );
+
+    BOOST_REQUIRE( packs.size() == 1 );
+    BOOST_REQUIRE( indexes.size() == 1 );
+    BOOST_REQUIRE( snapshots.size() == 1 );
+
+    //Packs are stored under the first two characters of their name
+    std::string pack_hash = packs[0].filename().string();
+    BOOST_TEST( packs[0].parent_path().filename().string() == pack_hash.substr(0, 2) );
+
+    //Objects are named by the hash of their content
+    std::string index = read_file( indexes[0] );
+    std::string snapshot = read_file( snapshots[0] );
+    BOOST_TEST( indexes[0].filename().string() == Hash::get_sha256_hash(index) );
+    BOOST_TEST( snapshots[0].filename().string() == Hash::get_sha256_hash(snapshot) );
+
+    std::vector<SnapshotFile> files;
+    BOOST_REQUIRE( RepositoryIndex("local").get_snapshot_files(files) );
+    BOOST_REQUIRE( files.size() == 1 );
+    BOOST_REQUIRE( !files[0].blobs.empty() );
+
+    //Index: the pack, then the location of every blob in it
+    std::istringstream index_lines(index);
+    std::string line;
+
+    std::getline(index_lines, line);
+    BOOST_TEST( line == "vessel-index 1" );
+    std::getline(index_lines, line);
+    BOOST_TEST( line == "pack " + pack_hash );
+
+    size_t offset = 0;
+    size_t total_blobs = 0;
+
+    while ( std::getline(index_lines, line) )
+    {
+        std::istringstream fields(line);
+        std::string type, hash;
+        size_t blob_offset, length;
+        fields >> type >> hash >> blob_offset >> length;
+
+        BOOST_TEST( type == "blob" );
+        BOOST_TEST( blob_offset >= offset );
+        BOOST_TEST( RepositoryIndex("local").contains(hash) );
+
+        offset = blob_offset + length;
+        total_blobs++;
+    }
+
+    BOOST_TEST( total_blobs > 0 );
+    BOOST_TEST( offset <= fs::file_size( packs[0] ) );
+
+    //Snapshot: the file, then its blobs in order
+    std::ostringstream expected;
+    expected << "file " << source.get_file_size() << " 1000 sha1-report " << file_path.string() << "\n";
+
+    size_t total_length = 0;
+
+    for ( const auto& blob : files[0].blobs )
+    {
+        expected << "blob " << blob.hash << " " << blob.length << "\n";
+        total_length += blob.length;
+    }
+
+    BOOST_TEST( total_length == source.get_file_size() );
+
+    std::istringstream snapshot_lines(snapshot);
+    std::getline(snapshot_lines, line);
+    BOOST_TEST( line == "vessel-snapshot 1" );
+    std::getline(snapshot_lines, line);
+    BOOST_TEST( line.compare(0, 5, "time ") == 0 );
+
+    std::string files_content( std::istreambuf_iterator<char>(snapshot_lines), {} );
+    BOOST_TEST( files_content == expected.str() );
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,174 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include <sqlite3.h>
+
+#include <vessel/vessel/upload_heap.hpp>
+#include <vessel/vessel/schedule_policy.hpp>
+
+using namespace Vessel;
+
+#define SIM_FILE_SECS 0.15 //Request round trips per file (register, upload, complete)
+#define SIM_SLA_HOURS 24
+
+/**
+ ** Replays a catalog snapshot through every scheduling policy and reports the files and bytes protected per hour.
+ ** The upload link is modelled as a fixed throughput plus a fixed cost per file.
+ **
+ ** Usage: schedule_simulation [vessel.db] [link MB/s] [report hours]
+ ** Without a snapshot a synthetic catalog is used
+*/
+
+static unsigned long load_catalog(const std::string& path, std::vector<QueueEntry>& entries)
+{
+
+    sqlite3* db;
+
+    if ( sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK ) {
+        std::cout << "Unable to open catalog: " << path << '\n';
+        return 0;
+    }
+
+    //Changed files, or the whole catalog for an initial backup
+    std::vector<std::string> queries = {
+        "SELECT a.filesize,a.last_modified,IFNULL(b.weight,0) FROM backup_file AS a LEFT JOIN backup_weight_ext AS b ON a.file_ext=b.file_ext WHERE a.last_modified > a.last_backup_time",
+        "SELECT a.filesize,a.last_modified,IFNULL(b.weight,0) FROM backup_file AS a LEFT JOIN backup_weight_ext AS b ON a.file_ext=b.file_ext"
+    };
+
+    unsigned long snapshot_time = 0;
+
+    for ( const auto& query : queries )
+    {
+
+        sqlite3_stmt* stmt;
+
+        if ( sqlite3_prepare_v2(db, query.c_str(), -1, &stmt, NULL) != SQLITE_OK ) {
+            std::cout << "Invalid catalog: " << sqlite3_errmsg(db) << '\n';
+            break;
+        }
+
+        while ( sqlite3_step(stmt) == SQLITE_ROW )
+        {
+            QueueEntry entry;
+            entry.upload_id = entries.size() + 1;
+            entry.file_size = sqlite3_column_int64(stmt, 0);
+            entry.last_modified = sqlite3_column_int64(stmt, 1);
+            entry.weight = sqlite3_column_int(stmt, 2);
+            entries.push_back(entry);
+
+            snapshot_time = std::max(snapshot_time, entry.last_modified);
+        }
+
+        sqlite3_finalize(stmt);
+
+        if ( !entries.empty() ) {
+            std::cout << "Replaying " << entries.size() << ( query == queries.front() ? " changed files" : " files (initial backup)" ) << " from " << path << '\n';
+            break;
+        }
+
+    }
+
+    sqlite3_close(db);
+
+    return snapshot_time;
+
+}
+
+static unsigned long make_catalog(std::vector<QueueEntry>& entries)
+{
+
+    unsigned long snapshot_time = 1546300800;
+    std::mt19937 rng(42);
+    std::lognormal_distribution<double> sizes(11.0, 2.5); //Median ~60KB with a long tail of large files
+    std::uniform_int_distribution<unsigned long> ages(0, 22 * 3600); //Changed during the last day
+    std::uniform_int_distribution<int> weighted(0, 9);
+
+    for ( unsigned int i=1; i <= 20000; i++ )
+    {
+        QueueEntry entry;
+        entry.upload_id = i;
+        entry.file_size = std::min( (size_t)sizes(rng) + 1, (size_t)8589934592 );
+        entry.last_modified = snapshot_time - ages(rng);
+        entry.weight = ( weighted(rng) == 0 ) ? 1000 : 0;
+        entries.push_back(entry);
+    }
+
+    std::cout << "Replaying " << entries.size() << " synthetic files" << '\n';
+
+    return snapshot_time;
+
+}
+
+int main(int argc, char* argv[] )
+{
+
+    std::vector<QueueEntry> entries;
+    unsigned long now = ( argc > 1 ) ? load_catalog(argv[1], entries) : make_catalog(entries);
+    double link_rate = ( (argc > 2) ? std::stod(argv[2]) : 2.0 ) * 1048576; //Bytes per second
+    double report_hours = (argc > 3) ? std::stod(argv[3]) : 1.0;
+
+    if ( entries.empty() ) {
+        std::cout << "No files to replay" << '\n';
+        return 1;
+    }
+
+    size_t total_bytes = 0;
+
+    for ( auto& entry : entries ) {
+        entry.queued_time = now;
+        total_bytes += entry.file_size;
+    }
+
+    std::cout << "Catalog: " << (total_bytes / 1048576) << " MB, link: " << (link_rate / 1048576) << " MB/s, " << SIM_FILE_SECS << "s per file" << '\n';
+    std::cout << "First " << report_hours << " hour(s):" << '\n' << '\n';
+
+    std::cout << std::left << std::setw(10) << "Policy" << std::right
+              << std::setw(12) << "Files/h" << std::setw(12) << "MB/h"
+              << std::setw(14) << "Weighted/h" << std::setw(14) << "SLA missed" << std::setw(12) << "Total h" << '\n';
+
+    for ( const std::string& name : SchedulePolicy::get_policy_names() )
+    {
+
+        UploadHeap heap( SchedulePolicy::create(name, 10, SIM_SLA_HOURS * 3600) );
+
+        for ( const auto& entry : entries ) {
+            heap.push(entry);
+        }
+
+        double clock = 0;
+        double window = report_hours * 3600;
+        size_t files = 0, bytes = 0, weighted = 0, missed = 0;
+
+        while ( !heap.empty() )
+        {
+
+            QueueEntry entry = heap.pop();
+            clock += SIM_FILE_SECS + entry.file_size / link_rate;
+
+            if ( clock <= window )
+            {
+                files++;
+                bytes += entry.file_size;
+                weighted += ( entry.weight > 0 ) ? 1 : 0;
+            }
+
+            //The file was backed up after its SLA
+            if ( now + clock > entry.last_modified + SIM_SLA_HOURS * 3600 ) {
+                missed++;
+            }
+
+        }
+
+        std::cout << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(12) << (files / report_hours) << std::setw(12) << (bytes / 1048576.0 / report_hours)
+                  << std::setw(14) << (weighted / report_hours) << std::setw(14) << missed << std::setw(12) << (clock / 3600) << '\n';
+
+    }
+
+    return 0;
+
+}
@@ -0,0 +1,146 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <map>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE UploadHeapTest
+
+#include <boost/test/included/unit_test.hpp>
+
+#include <vessel/vessel/upload_heap.hpp>
+
+using namespace Vessel;
+
+static QueueEntry make_entry(unsigned int upload_id, int weight, unsigned long last_modified, unsigned long queued_time, size_t file_size = 1024)
+{
+    QueueEntry entry;
+    entry.upload_id = upload_id;
+    entry.file_key = std::to_string(upload_id);
+    entry.weight = weight;
+    entry.last_modified = last_modified;
+    entry.queued_time = queued_time;
+    entry.file_size = file_size;
+
+    return entry;
+}
+
+BOOST_AUTO_TEST_SUITE(UploadHeapTestSuite)
+
+BOOST_AUTO_TEST_CASE(PriorityOrderTest)
+{
+
+    UploadHeap heap( std::make_shared<PriorityPolicy>(0) );
+    unsigned long now = 1546300800;
+
+    heap.push( make_entry(1, 0, now - 10, now) );
+    heap.push( make_entry(2, 1000, now - 20, now) );
+    heap.push( make_entry(3, 0, now, now) );
+    heap.push( make_entry(4, 1000, now, now) );
+
+    //Weighted files first, then the most recently changed
+    std::vector<unsigned int> expected = {4, 2, 3, 1};
+
+    for ( unsigned int upload_id : expected ) {
+        BOOST_TEST( heap.pop().upload_id == upload_id );
+    }
+
+    BOOST_TEST( heap.empty() );
+
+}
+
+BOOST_AUTO_TEST_CASE(AgingTest)
+{
+
+    //10 points per hour in queue
+    std::shared_ptr<PriorityPolicy> policy = std::make_shared<PriorityPolicy>(10);
+    UploadHeap heap(policy);
+    unsigned long now = 1546300800;
+
+    //Queued 101 hours ago without weight, the new file has weight 1000
+    heap.push( make_entry(1, 0, now, now - 101 * 3600) );
+    heap.push( make_entry(2, 1000, now, now) );
+
+    BOOST_TEST( policy->get_priority( heap.top(), now ) > 1000, "Starved file did not age" );
+    BOOST_TEST( heap.pop().upload_id == 1 );
+
+    //Queued 99 hours ago, it has not caught up yet
+    heap.push( make_entry(3, 0, now, now - 99 * 3600) );
+    BOOST_TEST( heap.pop().upload_id == 2 );
+
+}
+
+BOOST_AUTO_TEST_CASE(UpdateAndRemoveTest)
+{
+
+    UploadHeap heap( std::make_shared<PriorityPolicy>(1) );
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> weights(0, 2000);
+
+    for ( unsigned int i=1; i <= 1000; i++ ) {
+        heap.push( make_entry(i, weights(rng), i, 1546300800) );
+    }
+
+    //Reweighted uploads move to their new position
+    heap.push( make_entry(500, 5000, 500, 1546300800) );
+    BOOST_TEST( heap.top().upload_id == 500 );
+
+    for ( unsigned int i=2; i <= 1000; i += 2 ) {
+        BOOST_TEST( heap.remove(i) );
+    }
+
+    BOOST_TEST( !heap.remove(2), "Removed upload was still queued" );
+    BOOST_TEST( heap.size() == 500 );
+
+    //The remaining uploads come out in priority order
+    QueueEntry last = heap.pop();
+
+    while ( !heap.empty() )
+    {
+        QueueEntry entry = heap.pop();
+        BOOST_TEST( entry.upload_id % 2 == 1 );
+        BOOST_TEST( ( entry.weight < last.weight || ( entry.weight == last.weight && entry.last_modified < last.last_modified ) ) );
+        last = entry;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(PolicyOrderTest)
+{
+
+    unsigned long now = 1546300800;
+
+    //Small and old, large and new, weighted and in between
+    std::vector<QueueEntry> entries = {
+        make_entry(1, 0, now - 7200, now, 1024),
+        make_entry(2, 0, now, now, 1073741824),
+        make_entry(3, 1000, now - 3600, now, 1048576)
+    };
+
+    std::map<std::string, std::vector<unsigned int>> expected = {
+        { "priority", {3, 2, 1} },
+        { "newest", {2, 3, 1} },
+        { "shortest", {1, 3, 2} },
+        { "deadline", {1, 3, 2} }
+    };
+
+    for ( const std::string& name : SchedulePolicy::get_policy_names() )
+    {
+        UploadHeap heap( SchedulePolicy::create(name, 10, 86400) );
+
+        for ( const auto& entry : entries ) {
+            heap.push(entry);
+        }
+
+        for ( unsigned int upload_id : expected[name] ) {
+            BOOST_TEST( heap.pop().upload_id == upload_id, "Wrong order for policy " + name );
+        }
+    }
+
+    BOOST_TEST( !SchedulePolicy::create("unknown", 10, 86400) );
+
+}
+
+BOOST_AUTO_TEST_SUITE_END()